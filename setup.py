@@ -2,10 +2,10 @@ from distutils.core import setup, Extension
 
 include_dirs = []
 library_dirs = []
-libraries = []
+libraries = ["pthread"]
 runtime_library_dirs = []
 extra_objects = []
-define_macros = []
+define_macros = [("MYPTHREAD", None), ("_FILE_OFFSET_BITS", "64")]
 
 setup(name = "villa",
       version = "0.1",
@@ -2986,6 +2986,22 @@ char *cbbzdecode(const char *ptr, int size, int *sp){
 }
 
 
+/* Compress a serial object with the fast LZ codec. */
+char *cblzfencode(const char *ptr, int size, int *sp, const char *dbuf, int dsiz){
+  assert(ptr && sp);
+  if(!_qdbm_lzfencode) return NULL;
+  return _qdbm_lzfencode(ptr, size, sp, dbuf, dsiz);
+}
+
+
+/* Decompress a serial object compressed with the fast LZ codec. */
+char *cblzfdecode(const char *ptr, int size, int *sp, const char *dbuf, int dsiz){
+  assert(ptr && size >= 0);
+  if(!_qdbm_lzfdecode) return NULL;
+  return _qdbm_lzfdecode(ptr, size, sp, dbuf, dsiz);
+}
+
+
 /* Convert the character encoding of a string. */
 char *cbiconv(const char *ptr, int size, const char *icode, const char *ocode, int *sp, int *mp){
   char *res;
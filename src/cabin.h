@@ -1158,6 +1158,37 @@ char *cbbzencode(const char *ptr, int size, int *sp);
 char *cbbzdecode(const char *ptr, int size, int *sp);
 
 
+/* Compress a serial object with the fast LZ codec.
+   `ptr' specifies the pointer to a region.
+   `size' specifies the size of the region.  If it is negative, the size is assigned with
+   `strlen(ptr)'.
+   `sp' specifies the pointer to a variable to which the size of the region of the return
+   value is assigned.
+   `dbuf' specifies the pointer to the region of a dictionary whose contents are referred to by
+   the result as if they preceded the object.  If it is `NULL', no dictionary is used.
+   `dsiz' specifies the size of the dictionary.  Only the last 65535 bytes of it are used.
+   If successful, the return value is the pointer to the result object, else, it is `NULL'.
+   Because the region of the return value is allocated with the `malloc' call, it should be
+   released with the `free' call if it is no longer in use. */
+char *cblzfencode(const char *ptr, int size, int *sp, const char *dbuf, int dsiz);
+
+
+/* Decompress a serial object compressed with the fast LZ codec.
+   `ptr' specifies the pointer to a region.
+   `size' specifies the size of the region.
+   `sp' specifies the pointer to a variable to which the size of the region of the return
+   value is assigned.  If it is `NULL', it is not used.
+   `dbuf' specifies the pointer to the region of the dictionary given when the object was
+   compressed.  If it is `NULL', no dictionary is used.
+   `dsiz' specifies the size of the dictionary.
+   If successful, the return value is the pointer to the result object, else, it is `NULL'.
+   `NULL' is returned if the region is truncated or broken.  Because an additional zero code is
+   appended at the end of the region of the return value, the return value can be treated as a
+   character string.  Because the region of the return value is allocated with the `malloc'
+   call, it should be released with the `free' call if it is no longer in use. */
+char *cblzfdecode(const char *ptr, int size, int *sp, const char *dbuf, int dsiz);
+
+
 /* Convert the character encoding of a string.
    `ptr' specifies the pointer to a region.
    `size' specifies the size of the region.  If it is negative, the size is assigned with
@@ -16,12 +16,18 @@
 
 #define QDBM_INTERNAL  1
 
+#if !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS  64            /* offsets of system calls beyond 2GB */
+#endif
+
 #include "depot.h"
 #include "myconf.h"
 
 #define DP_FILEMODE    00644             /* permission of a creating file */
 #define DP_MAGICNUMB   "[DEPOT]\n\f"     /* magic number on environments of big endian */
 #define DP_MAGICNUML   "[depot]\n\f"     /* magic number on environments of little endian */
+#define DP_LMAGICNUMB  "[DEPOT+]\n\f"    /* magic number of large files on big endian */
+#define DP_LMAGICNUML  "[depot+]\n\f"    /* magic number of large files on little endian */
 #define DP_HEADSIZ     48                /* size of the reagion of the header */
 #define DP_LIBVEROFF   12                /* offset of the region for the library version */
 #define DP_FLAGSOFF    16                /* offset of the region for flags */
@@ -37,8 +43,46 @@
 #define DP_TMPFSUF     MYEXTSTR "dptmp"  /* suffix of a temporary file */
 #define DP_OPTBLOAD    0.25              /* ratio of bucket loading at optimization */
 #define DP_OPTRUNIT    256               /* number of records in a process of optimization */
+#define DP_CMPUNIT     1024              /* number of records in a step of compaction */
 #define DP_NUMBUFSIZ   32                /* size of a buffer for a number */
 #define DP_IOBUFSIZ    8192              /* size of an I/O buffer */
+#define DP_AIOREQMAX   1048576           /* max size of a merged request of asynchronous I/O */
+#define DP_AIOBUFMAX   8388608           /* max total size of queued writes */
+#define DP_AIOTHNUM    4                 /* number of helper threads of asynchronous I/O */
+#define DP_AIORINGMAX  256               /* max number of entries of a ring of io_uring */
+#define DP_AIOQUEMAX   4096              /* max number of queued writes */
+#define DP_AIOIOVMAX   64                /* max number of regions gathered into a call */
+
+/* check whether the offsets of system calls can address large files */
+#define DP_LARGEOK \
+  (sizeof(off_t) >= sizeof(long long))
+
+/* get the size of an element of the bucket array */
+#define DP_BKTSIZ(DP_large) \
+  ((DP_large) ? sizeof(long long) : sizeof(int))
+
+/* get the offset stored in an element of the bucket array */
+#define DP_GETBUCKET(DP_buckets, DP_large, DP_bi) \
+  ((DP_large) ? ((long long *)(DP_buckets))[DP_bi] : (long long)((int *)(DP_buckets))[DP_bi])
+
+/* get the offset of an element in the header of a record */
+#define DP_RHOFF(DP_large, DP_idx) \
+  ((DP_idx) <= DP_RHILEFT ? (DP_idx) * sizeof(int) : \
+   DP_RHILEFT * sizeof(int) + ((DP_idx) - DP_RHILEFT) * DP_BKTSIZ(DP_large))
+
+/* get the size of the header of a record */
+#define DP_RHSIZ(DP_large) \
+  DP_RHOFF(DP_large, DP_RHNUM)
+
+/* get the size of the region of the header and the bucket array */
+#define DP_HBSIZ(DP_depot) \
+  (DP_HEADSIZ + (long long)(DP_depot)->bnum * DP_BKTSIZ((DP_depot)->large))
+
+/* count a system call for I/O if the counter is enabled */
+#define DP_SYSCOUNT() \
+  do { \
+    if(dpsyscnt >= 0) dpsyscnt++; \
+  } while(FALSE)
 
 /* get the first hash value */
 #define DP_FIRSTHASH(DP_res, DP_kbuf, DP_ksiz) \
@@ -98,35 +142,125 @@ enum {                                   /* enumeration for the flag of a record
   DP_RECFREUSE = 1 << 1                  /* reusable */
 };
 
+typedef struct {                         /* type of structure for a request of asynchronous I/O */
+  long long off;                         /* offset of the file */
+  char *buf;                             /* region of the data */
+  int size;                              /* size of the data */
+  int asiz;                              /* allocated size of the region */
+} DPAIOREQ;
+
+typedef struct {                         /* type of structure for a run of adjacent requests */
+  long long off;                         /* offset of the file */
+  DPAIOREQ *reqs;                        /* array of the requests */
+  int num;                               /* number of the requests */
+  int size;                              /* total size of the requests */
+} DPAIORUN;
+
+typedef struct {                         /* type of structure for an engine of asynchronous I/O */
+  int engine;                            /* kind of the engine */
+  int depth;                             /* max number of requests submitted at once */
+  int batch;                             /* nesting level of queuing of writes */
+  DPAIOREQ *reqs;                        /* array of queued writes */
+  int num;                               /* number of queued writes */
+  int cap;                               /* number of allocated elements of the array */
+  long long qsiz;                        /* total size of queued writes */
+  long long lo;                          /* lowest offset of queued writes */
+  long long hi;                          /* highest end of queued writes */
+  long long fend;                        /* size of the file when the queue was empty */
+  void *mutex;                           /* mutex for the ring or `NULL' */
+  int fnum;                              /* number of flushes of the queue */
+  int wnum;                              /* number of queued writes flushed */
+  int cnum;                              /* number of calls of writing by flushes */
+  double fsum;                           /* total size written by flushes */
+  long long lsiz;                        /* size written by the last flush */
+#if _qdbm_uring
+  int rfd;                               /* file descriptor of the ring */
+  unsigned int rnum;                     /* number of entries of the queue, 0 if broken */
+  unsigned int *sqhead;                  /* head of the submission queue */
+  unsigned int *sqtail;                  /* tail of the submission queue */
+  unsigned int *sqmask;                  /* mask of the submission queue */
+  unsigned int *sqarray;                 /* array of indexes of the submission queue */
+  unsigned int *cqhead;                  /* head of the completion queue */
+  unsigned int *cqtail;                  /* tail of the completion queue */
+  unsigned int *cqmask;                  /* mask of the completion queue */
+  struct io_uring_sqe *sqes;             /* array of submission entries */
+  struct io_uring_cqe *cqes;             /* array of completion entries */
+  void *sqmap;                           /* mapping of the submission queue */
+  void *cqmap;                           /* mapping of the completion queue */
+  size_t sqmsiz;                         /* size of the mapping of the submission queue */
+  size_t cqmsiz;                         /* size of the mapping of the completion queue */
+  size_t sqesiz;                         /* size of the mapping of the submission entries */
+#endif
+} DPAIO;
+
+typedef struct {                         /* type of structure for a job of a helper thread */
+  int fd;                                /* file descriptor */
+  DPAIORUN *runs;                        /* array of runs of requests */
+  int num;                               /* number of the runs */
+  int first;                             /* index of the first run of the job */
+  int step;                              /* stride of indexes of the job */
+  int write;                             /* whether to write */
+  int err;                               /* whether an error occured */
+} DPAIOJOB;
+
 
 /* private function prototypes */
 static int dpbigendian(void);
+static int dpcheckmagic(const char *hbuf, int *largep);
+static void dpheadsync(DEPOT *depot);
+static int dpremap(DEPOT *depot);
+static const char *dpmapptr(DEPOT *depot, long long off, int size);
 static char *dpstrdup(const char *str);
 static int dplock(int fd, int ex, int nb);
 static int dpwrite(int fd, const void *buf, int size);
-static int dpseekwrite(int fd, int off, const void *buf, int size);
-static int dpseekwritenum(int fd, int off, int num);
-static int dpread(int fd, void *buf, int size);
-static int dpseekread(int fd, int off, void *buf, int size);
-static int dpfcopy(int destfd, int destoff, int srcfd, int srcoff);
+static int dpseekwrite(int fd, long long off, const void *buf, int size);
+static int dpseekwritenum(int fd, long long off, int num);
+static int dpseekwriteoff(int fd, long long off, long long num, int large);
+static int dpseekread(int fd, long long off, void *buf, int size);
+static long long dpfcopy(int destfd, long long destoff, int srcfd, long long srcoff);
 static int dpgetprime(int num);
 static int dppadsize(DEPOT *depot, int ksiz, int vsiz);
-static int dprecsize(int *head);
-static int dprechead(DEPOT *depot, int off, int *head, char *ebuf, int *eep);
-static char *dpreckey(DEPOT *depot, int off, int *head);
-static char *dprecval(DEPOT *depot, int off, int *head, int start, int max);
-static int dprecvalwb(DEPOT *depot, int off, int *head, int start, int max, char *vbuf);
+static int dprecsize(int large, long long *head);
+static void dprhdecode(int large, const char *buf, long long *head);
+static void dprhencode(int large, const long long *head, char *buf);
+static int dprechead(DEPOT *depot, long long off, long long *head, char *ebuf, int *eep);
+static char *dpreckey(DEPOT *depot, long long off, long long *head);
+static char *dprecval(DEPOT *depot, long long off, long long *head, int start, int max);
+static int dprecvalwb(DEPOT *depot, long long off, long long *head, int start, int max,
+                      char *vbuf);
 static int dpkeycmp(const char *abuf, int asiz, const char *bbuf, int bsiz);
-static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *bip, int *offp,
-                       int *entp, int *head, char *ebuf, int *eep, int delhit);
-static int dprecrewrite(DEPOT *depot, int off, int rsiz, const char *kbuf, int ksiz,
-                        const char *vbuf, int vsiz, int hash, int left, int right);
-static int dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
-                       int hash, int left, int right);
-static int dprecover(DEPOT *depot, int off, int *head, const char *vbuf, int vsiz, int cat);
-static int dprecdelete(DEPOT *depot, int off, int *head, int reusable);
+static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *bip,
+                       long long *offp, long long *entp, long long *head, char *ebuf, int *eep,
+                       int delhit);
+static int dprecrewrite(DEPOT *depot, long long off, int rsiz, const char *kbuf, int ksiz,
+                        const char *vbuf, int vsiz, int hash, long long left, long long right);
+static int dprecfits(DEPOT *depot, long long off, int ksiz, int vsiz);
+static long long dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
+                             int hash, long long left, long long right);
+static int dprecover(DEPOT *depot, long long off, long long *head, const char *kbuf, int ksiz,
+                     const char *vbuf, int vsiz, int cat);
+static int dprecdelete(DEPOT *depot, long long off, long long *head, int reusable);
+static int dpreclive(DEPOT *depot, long long off, long long *head, int *bip, long long *entp);
+static void dpfbpoolout(DEPOT *depot, long long off, long long size);
 static void dpfbpoolcoal(DEPOT *depot);
 static int dpfbpoolcmp(const void *a, const void *b);
+static DPAIO *dpaioopen(int depth, int engine);
+static void dpaioclose(DPAIO *aio);
+#if _qdbm_uring
+static int dpaioringopen(DPAIO *aio);
+static int dpaioring(DEPOT *depot, DPAIORUN *runs, int num, int write);
+#endif
+#if defined(MYPTHREAD)
+static void *dpaiojob(void *arg);
+#endif
+static int dpaiorunio(int fd, DPAIORUN *run, int done, int write);
+static int dpaiosubmit(DEPOT *depot, DPAIORUN *runs, int num, int write);
+static int dpaioreqcmp(const void *a, const void *b);
+static int dpaioflush(DEPOT *depot);
+static int dpaiooverlap(DEPOT *depot, long long off, int size);
+static int dpiowrite(DEPOT *depot, long long off, const void *buf, int size);
+static int dpiowriteoff(DEPOT *depot, long long off, long long num);
+static int dpioread(DEPOT *depot, long long off, void *buf, int size);
 
 
 
@@ -171,11 +305,16 @@ const char *dperrmsg(int ecode){
 /* Get a database handle. */
 DEPOT *dpopen(const char *name, int omode, int bnum){
   char hbuf[DP_HEADSIZ], *map, c, *tname;
-  int i, mode, fd, inode, fsiz, rnum, msiz, *fbpool;
+  int i, mode, fd, inode, rnum, large, bsiz;
+  long long fsiz, msiz, *fbpool;
   struct stat sbuf;
   time_t mtime;
   DEPOT *depot;
   assert(name);
+  if((omode & DP_OLARGE) && !DP_LARGEOK){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return NULL;
+  }
   mode = O_RDONLY;
   if(omode & DP_OWRITER){
     mode = O_RDWR;
@@ -209,19 +348,34 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
   fsiz = sbuf.st_size;
   if((omode & DP_OWRITER) && fsiz == 0){
     memset(hbuf, 0, DP_HEADSIZ);
+    large = omode & DP_OLARGE;
     if(dpbigendian()){
-      memcpy(hbuf, DP_MAGICNUMB, strlen(DP_MAGICNUMB));
+      if(large){
+        memcpy(hbuf, DP_LMAGICNUMB, strlen(DP_LMAGICNUMB));
+      } else {
+        memcpy(hbuf, DP_MAGICNUMB, strlen(DP_MAGICNUMB));
+      }
     } else {
-      memcpy(hbuf, DP_MAGICNUML, strlen(DP_MAGICNUML));
+      if(large){
+        memcpy(hbuf, DP_LMAGICNUML, strlen(DP_LMAGICNUML));
+      } else {
+        memcpy(hbuf, DP_MAGICNUML, strlen(DP_MAGICNUML));
+      }
     }
     sprintf(hbuf + DP_LIBVEROFF, "%d", _QDBM_LIBVER / 100);
     bnum = bnum < 1 ? DP_DEFBNUM : bnum;
     bnum = dpgetprime(bnum);
+    bsiz = DP_BKTSIZ(large);
     memcpy(hbuf + DP_BNUMOFF, &bnum, sizeof(int));
     rnum = 0;
     memcpy(hbuf + DP_RNUMOFF, &rnum, sizeof(int));
-    fsiz = DP_HEADSIZ + bnum * sizeof(int);
-    memcpy(hbuf + DP_FSIZOFF, &fsiz, sizeof(int));
+    fsiz = DP_HEADSIZ + (long long)bnum * bsiz;
+    if(large){
+      memcpy(hbuf + DP_FSIZOFF, &fsiz, sizeof(long long));
+    } else {
+      i = fsiz;
+      memcpy(hbuf + DP_FSIZOFF, &i, sizeof(int));
+    }
     if(!dpseekwrite(fd, 0, hbuf, DP_HEADSIZ)){
       close(fd);
       return NULL;
@@ -233,13 +387,13 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
         return NULL;
       }
     } else {
-      if(!(map = malloc(bnum * sizeof(int)))){
+      if(!(map = malloc(bnum * bsiz))){
         close(fd);
         dpecodeset(DP_EALLOC, __FILE__, __LINE__);
         return NULL;
       }
-      memset(map, 0, bnum * sizeof(int));
-      if(!dpseekwrite(fd, DP_HEADSIZ, map, bnum * sizeof(int))){
+      memset(map, 0, bnum * bsiz);
+      if(!dpseekwrite(fd, DP_HEADSIZ, map, bnum * bsiz)){
         free(map);
         close(fd);
         return NULL;
@@ -252,22 +406,31 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
+  if(!dpcheckmagic(hbuf, &large) && !(omode & DP_ONOLCK)){
+    close(fd);
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return NULL;
+  }
+  if(large && !DP_LARGEOK){
+    close(fd);
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return NULL;
+  }
   if(!(omode & DP_ONOLCK) &&
-     ((dpbigendian() ? memcmp(hbuf, DP_MAGICNUMB, strlen(DP_MAGICNUMB)) != 0 :
-       memcmp(hbuf, DP_MAGICNUML, strlen(DP_MAGICNUML)) != 0) ||
-      *((int *)(hbuf + DP_FSIZOFF)) != fsiz)){
+     (large ? *((long long *)(hbuf + DP_FSIZOFF)) : *((int *)(hbuf + DP_FSIZOFF))) != fsiz){
     close(fd);
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
   bnum = *((int *)(hbuf + DP_BNUMOFF));
   rnum = *((int *)(hbuf + DP_RNUMOFF));
-  if(bnum < 1 || rnum < 0 || fsiz < DP_HEADSIZ + bnum * sizeof(int)){
+  bsiz = DP_BKTSIZ(large);
+  if(bnum < 1 || rnum < 0 || fsiz < DP_HEADSIZ + (long long)bnum * bsiz){
     close(fd);
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
-  msiz = DP_HEADSIZ + bnum * sizeof(int);
+  msiz = DP_HEADSIZ + (long long)bnum * bsiz;
   map = mmap(0, msiz, PROT_READ | ((mode & DP_OWRITER) ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
   if(map == MAP_FAILED){
     close(fd);
@@ -277,7 +440,7 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
   tname = NULL;
   fbpool = NULL;
   if(!(depot = malloc(sizeof(DEPOT))) || !(tname = dpstrdup(name)) ||
-     !(fbpool = malloc(DP_FBPOOLSIZ * 2 * sizeof(int)))){
+     !(fbpool = malloc(DP_FBPOOLSIZ * 2 * sizeof(long long)))){
     free(fbpool);
     free(tname);
     free(depot);
@@ -294,11 +457,14 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
   depot->fsiz = fsiz;
   depot->map = map;
   depot->msiz = msiz;
-  depot->buckets = (int *)(map + DP_HEADSIZ);
+  depot->buckets = map + DP_HEADSIZ;
   depot->bnum = bnum;
   depot->rnum = rnum;
+  depot->large = large;
+  depot->mapall = FALSE;
   depot->fatal = FALSE;
   depot->ioff = 0;
+  depot->coff = 0;
   depot->fbpool = fbpool;
   for(i = 0; i < DP_FBPOOLSIZ * 2; i += 2){
     depot->fbpool[i] = -1;
@@ -307,6 +473,13 @@ DEPOT *dpopen(const char *name, int omode, int bnum){
   depot->fbpsiz = DP_FBPOOLSIZ * 2;
   depot->fbpinc = 0;
   depot->align = 0;
+  depot->aio = NULL;
+  depot->loff = -1;
+  depot->lsiz = 0;
+  if(_qdbm_fullmmap && (omode & DP_OMAPALL)){
+    depot->mapall = TRUE;
+    dpremap(depot);
+  }
   return depot;
 }
 
@@ -317,10 +490,11 @@ int dpclose(DEPOT *depot){
   assert(depot);
   fatal = depot->fatal;
   err = FALSE;
-  if(depot->wmode){
-    *((int *)(depot->map + DP_FSIZOFF)) = depot->fsiz;
-    *((int *)(depot->map + DP_RNUMOFF)) = depot->rnum;
+  if(depot->aio){
+    if(!fatal && !dpaioflush(depot)) err = TRUE;
+    dpaioclose(depot->aio);
   }
+  if(depot->wmode) dpheadsync(depot);
   if(depot->map != MAP_FAILED){
     if(munmap(depot->map, depot->msiz) == -1){
       err = TRUE;
@@ -344,8 +518,8 @@ int dpclose(DEPOT *depot){
 
 /* Store a record. */
 int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz, int dmode){
-  int head[DP_RHNUM], next[DP_RHNUM];
-  int i, hash, bi, off, entoff, ee, newoff, rsiz, nsiz, fdel, mroff, mrsiz, mi, min;
+  long long head[DP_RHNUM], next[DP_RHNUM], off, entoff, newoff, mroff, mrsiz, min;
+  int i, hash, bi, ee, rsiz, nsiz, fdel, mi;
   char ebuf[DP_ENTBUFSIZ], *tval, *swap;
   assert(depot && kbuf && vbuf);
   if(depot->fatal){
@@ -358,6 +532,7 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
   }
   if(ksiz < 0) ksiz = strlen(kbuf);
   if(vsiz < 0) vsiz = strlen(vbuf);
+  depot->loff = -1;
   newoff = -1;
   DP_SECONDHASH(hash, kbuf, ksiz);
   switch(dprecsearch(depot, kbuf, ksiz, hash, &bi, &off, &entoff, head, ebuf, &ee, TRUE)){
@@ -374,11 +549,12 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
       head[DP_RHIPSIZ] += head[DP_RHIVSIZ];
       head[DP_RHIVSIZ] = 0;
     }
-    rsiz = dprecsize(head);
-    nsiz = DP_RHNUM * sizeof(int) + ksiz + vsiz;
+    rsiz = dprecsize(depot->large, head);
+    nsiz = DP_RHSIZ(depot->large) + ksiz + vsiz;
     if(dmode == DP_DCAT) nsiz += head[DP_RHIVSIZ];
     if(off + rsiz >= depot->fsiz){
       if(rsiz < nsiz){
+        if(!dprecfits(depot, off, ksiz, nsiz - DP_RHSIZ(depot->large) - ksiz)) return FALSE;
         head[DP_RHIPSIZ] += nsiz - rsiz;
         rsiz = nsiz;
         depot->fsiz = off + rsiz;
@@ -387,9 +563,10 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
       while(nsiz > rsiz && off + rsiz < depot->fsiz){
         if(!dprechead(depot, off + rsiz, next, NULL, NULL)) return FALSE;
         if(!(next[DP_RHIFLAGS] & DP_RECFREUSE)) break;
-        head[DP_RHIPSIZ] += dprecsize(next);
-        rsiz += dprecsize(next);
+        head[DP_RHIPSIZ] += dprecsize(depot->large, next);
+        rsiz += dprecsize(depot->large, next);
       }
+      if(depot->coff > off && depot->coff < off + rsiz) depot->coff = off;
       for(i = 0; i < depot->fbpsiz; i += 2){
         if(depot->fbpool[i] >= off && depot->fbpool[i] < off + rsiz){
           depot->fbpool[i] = -1;
@@ -398,20 +575,20 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
       }
     }
     if(nsiz <= rsiz){
-      if(!dprecover(depot, off, head, vbuf, vsiz, dmode == DP_DCAT)){
+      if(!dprecover(depot, off, head, kbuf, ksiz, vbuf, vsiz, dmode == DP_DCAT)){
         depot->fatal = TRUE;
         return FALSE;
       }
     } else {
       tval = NULL;
       if(dmode == DP_DCAT){
-        if(ee && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
+        if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
           if(!(tval = malloc(head[DP_RHIVSIZ] + vsiz + 1))){
             dpecodeset(DP_EALLOC, __FILE__, __LINE__);
             depot->fatal = TRUE;
             return FALSE;
           }
-          memcpy(tval, ebuf + (DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ]), head[DP_RHIVSIZ]);
+          memcpy(tval, ebuf + (DP_RHSIZ(depot->large) + head[DP_RHIKSIZ]), head[DP_RHIVSIZ]);
         } else {
           if(!(tval = dprecval(depot, off, head, 0, -1))){
             depot->fatal = TRUE;
@@ -438,6 +615,10 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
           min = depot->fbpool[i+1];
         }
       }
+      if(mi < 0 && !dprecfits(depot, -1, ksiz, vsiz)){
+        free(tval);
+        return FALSE;
+      }
       if(mi >= 0){
         mroff = depot->fbpool[mi];
         mrsiz = depot->fbpool[mi+1];
@@ -453,6 +634,7 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
         return FALSE;
       }
       if(mroff > 0 && nsiz <= mrsiz){
+        if(depot->coff > mroff && depot->coff < mroff + mrsiz) depot->coff = mroff;
         if(!dprecrewrite(depot, mroff, mrsiz, kbuf, ksiz, vbuf, vsiz,
                          hash, head[DP_RHILEFT], head[DP_RHIRIGHT])){
           free(tval);
@@ -473,6 +655,7 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
     if(fdel) depot->rnum++;
     break;
   default:
+    if(!dprecfits(depot, -1, ksiz, vsiz)) return FALSE;
     if((newoff = dprecappend(depot, kbuf, ksiz, vbuf, vsiz, hash, 0, 0)) == -1){
       depot->fatal = TRUE;
       return FALSE;
@@ -482,13 +665,20 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
   }
   if(newoff > 0){
     if(entoff > 0){
-      if(!dpseekwritenum(depot->fd, entoff, newoff)){
+      if(!dpiowriteoff(depot, entoff, newoff)){
         depot->fatal = TRUE;
         return FALSE;
       }
+    } else if(depot->large){
+      ((long long *)depot->buckets)[bi] = newoff;
     } else {
-      depot->buckets[bi] = newoff;
+      ((int *)depot->buckets)[bi] = newoff;
     }
+    depot->loff = newoff;
+    depot->lsiz = DP_RHSIZ(depot->large) + ksiz + vsiz;
+  } else {
+    depot->loff = off;
+    depot->lsiz = DP_RHSIZ(depot->large) + ksiz + head[DP_RHIVSIZ];
   }
   return TRUE;
 }
@@ -496,7 +686,8 @@ int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
 
 /* Delete a record. */
 int dpout(DEPOT *depot, const char *kbuf, int ksiz){
-  int head[DP_RHNUM], hash, bi, off, entoff, ee;
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee;
   char ebuf[DP_ENTBUFSIZ];
   assert(depot && kbuf);
   if(depot->fatal){
@@ -519,6 +710,7 @@ int dpout(DEPOT *depot, const char *kbuf, int ksiz){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
+  depot->loff = -1;
   if(!dprecdelete(depot, off, head, FALSE)){
     depot->fatal = TRUE;
     return FALSE;
@@ -530,7 +722,8 @@ int dpout(DEPOT *depot, const char *kbuf, int ksiz){
 
 /* Retrieve a record. */
 char *dpget(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, int *sp){
-  int head[DP_RHNUM], hash, bi, off, entoff, ee, vsiz;
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee, vsiz;
   char ebuf[DP_ENTBUFSIZ], *vbuf;
   assert(depot && kbuf && start >= 0);
   if(depot->fatal){
@@ -553,7 +746,7 @@ char *dpget(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, int *s
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return NULL;
   }
-  if(ee && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
+  if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
     head[DP_RHIVSIZ] -= start;
     if(max < 0){
       vsiz = head[DP_RHIVSIZ];
@@ -565,7 +758,7 @@ char *dpget(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, int *s
       depot->fatal = TRUE;
       return NULL;
     }
-    memcpy(vbuf, ebuf + (DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + start), vsiz);
+    memcpy(vbuf, ebuf + (DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start), vsiz);
     vbuf[vsiz] = '\0';
   } else {
     if(!(vbuf = dprecval(depot, off, head, start, max))){
@@ -586,7 +779,8 @@ char *dpget(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, int *s
 
 /* Retrieve a record and write the value into a buffer. */
 int dpgetwb(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, char *vbuf){
-  int head[DP_RHNUM], hash, bi, off, entoff, ee, vsiz;
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee, vsiz;
   char ebuf[DP_ENTBUFSIZ];
   assert(depot && kbuf && start >= 0 && max >= 0 && vbuf);
   if(depot->fatal){
@@ -609,10 +803,10 @@ int dpgetwb(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, char *
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return -1;
   }
-  if(ee && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
+  if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
     head[DP_RHIVSIZ] -= start;
     vsiz = max < head[DP_RHIVSIZ] ? max : head[DP_RHIVSIZ];
-    memcpy(vbuf, ebuf + (DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + start), vsiz);
+    memcpy(vbuf, ebuf + (DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start), vsiz);
   } else {
     if((vsiz = dprecvalwb(depot, off, head, start, max, vbuf)) == -1){
       depot->fatal = TRUE;
@@ -625,7 +819,8 @@ int dpgetwb(DEPOT *depot, const char *kbuf, int ksiz, int start, int max, char *
 
 /* Get the size of the value of a record. */
 int dpvsiz(DEPOT *depot, const char *kbuf, int ksiz){
-  int head[DP_RHNUM], hash, bi, off, entoff, ee;
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee;
   char ebuf[DP_ENTBUFSIZ];
   assert(depot && kbuf);
   if(depot->fatal){
@@ -662,14 +857,15 @@ int dpiterinit(DEPOT *depot){
 
 /* Get the next key of the iterator. */
 char *dpiternext(DEPOT *depot, int *sp){
-  int off, head[DP_RHNUM], ee;
+  long long off, head[DP_RHNUM];
+  int ee;
   char ebuf[DP_ENTBUFSIZ], *kbuf;
   assert(depot);
   if(depot->fatal){
     dpecodeset(DP_EFATAL, __FILE__, __LINE__);
     return NULL;
   }
-  off = DP_HEADSIZ + depot->bnum * sizeof(int);
+  off = DP_HBSIZ(depot);
   off = off > depot->ioff ? off : depot->ioff;
   while(off < depot->fsiz){
     if(!dprechead(depot, off, head, ebuf, &ee)){
@@ -677,15 +873,15 @@ char *dpiternext(DEPOT *depot, int *sp){
       return NULL;
     }
     if(head[DP_RHIFLAGS] & DP_RECFDEL){
-      off += dprecsize(head);
+      off += dprecsize(depot->large, head);
     } else {
-      if(ee && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
+      if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
         if(!(kbuf = malloc(head[DP_RHIKSIZ] + 1))){
           dpecodeset(DP_EALLOC, __FILE__, __LINE__);
           depot->fatal = TRUE;
           return NULL;
         }
-        memcpy(kbuf, ebuf + (DP_RHNUM * sizeof(int)), head[DP_RHIKSIZ]);
+        memcpy(kbuf, ebuf + DP_RHSIZ(depot->large), head[DP_RHIKSIZ]);
         kbuf[head[DP_RHIKSIZ]] = '\0';
       } else {
         if(!(kbuf = dpreckey(depot, off, head))){
@@ -693,7 +889,7 @@ char *dpiternext(DEPOT *depot, int *sp){
           return NULL;
         }
       }
-      depot->ioff = off + dprecsize(head);
+      depot->ioff = off + dprecsize(depot->large, head);
       if(sp) *sp = head[DP_RHIKSIZ];
       return kbuf;
     }
@@ -721,7 +917,7 @@ int dpsetalign(DEPOT *depot, int align){
 
 /* Set the size of the free block pool of a database handle. */
 int dpsetfbpsiz(DEPOT *depot, int size){
-  int *fbpool;
+  long long *fbpool;
   int i;
   assert(depot && size >= 0);
   if(depot->fatal){
@@ -733,7 +929,7 @@ int dpsetfbpsiz(DEPOT *depot, int size){
     return FALSE;
   }
   size *= 2;
-  if(!(fbpool = realloc(depot->fbpool, size * sizeof(int) + 1))){
+  if(!(fbpool = realloc(depot->fbpool, size * sizeof(long long) + 1))){
     dpecodeset(DP_EALLOC, __FILE__, __LINE__);
     return FALSE;
   }
@@ -759,9 +955,9 @@ int dpsync(DEPOT *depot){
     dpecodeset(DP_EMODE, __FILE__, __LINE__);
     return FALSE;
   }
-  *((int *)(depot->map + DP_FSIZOFF)) = depot->fsiz;
-  *((int *)(depot->map + DP_RNUMOFF)) = depot->rnum;
-  if(msync(depot->map, depot->msiz, MS_SYNC) == -1){
+  if(!dpaioflush(depot)) return FALSE;
+  dpheadsync(depot);
+  if(msync(depot->map, DP_HBSIZ(depot), MS_SYNC) == -1){
     dpecodeset(DP_EMAP, __FILE__, __LINE__);
     depot->fatal = TRUE;
     return FALSE;
@@ -779,7 +975,8 @@ int dpsync(DEPOT *depot){
 int dpoptimize(DEPOT *depot, int bnum){
   DEPOT *tdepot;
   char *name;
-  int i, err, off, head[DP_RHNUM], ee, ksizs[DP_OPTRUNIT], vsizs[DP_OPTRUNIT], unum;
+  long long off, head[DP_RHNUM];
+  int i, err, ee, ksizs[DP_OPTRUNIT], vsizs[DP_OPTRUNIT], unum;
   char ebuf[DP_ENTBUFSIZ], *kbufs[DP_OPTRUNIT], *vbufs[DP_OPTRUNIT];
   assert(depot);
   if(depot->fatal){
@@ -790,6 +987,8 @@ int dpoptimize(DEPOT *depot, int bnum){
     dpecodeset(DP_EMODE, __FILE__, __LINE__);
     return FALSE;
   }
+  if(!dpaioflush(depot)) return FALSE;
+  depot->loff = -1;
   if(!(name = malloc(strlen(depot->name) + strlen(DP_TMPFSUF) + 1))){
     dpecodeset(DP_EALLOC, __FILE__, __LINE__);
     depot->fatal = FALSE;
@@ -800,7 +999,8 @@ int dpoptimize(DEPOT *depot, int bnum){
     bnum = (int)(depot->rnum * (1.0 / DP_OPTBLOAD)) + 1;
     if(bnum < DP_DEFBNUM / 2) bnum = DP_DEFBNUM / 2;
   }
-  if(!(tdepot = dpopen(name, DP_OWRITER | DP_OCREAT | DP_OTRUNC, bnum))){
+  if(!(tdepot = dpopen(name, DP_OWRITER | DP_OCREAT | DP_OTRUNC |
+                       (depot->large ? DP_OLARGE : 0), bnum))){
     free(name);
     depot->fatal = TRUE;
     return FALSE;
@@ -813,7 +1013,7 @@ int dpoptimize(DEPOT *depot, int bnum){
   }
   tdepot->align = depot->align;
   err = FALSE;
-  off = DP_HEADSIZ + depot->bnum * sizeof(int);
+  off = DP_HBSIZ(depot);
   unum = 0;
   while(off < depot->fsiz){
     if(!dprechead(depot, off, head, ebuf, &ee)){
@@ -821,20 +1021,20 @@ int dpoptimize(DEPOT *depot, int bnum){
       break;
     }
     if(!(head[DP_RHIFLAGS] & DP_RECFDEL)){
-      if(ee && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
+      if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
         if(!(kbufs[unum] = malloc(head[DP_RHIKSIZ] + 1))){
           dpecodeset(DP_EALLOC, __FILE__, __LINE__);
           err = TRUE;
           break;
         }
-        memcpy(kbufs[unum], ebuf + (DP_RHNUM * sizeof(int)), head[DP_RHIKSIZ]);
-        if(DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
+        memcpy(kbufs[unum], ebuf + DP_RHSIZ(depot->large), head[DP_RHIKSIZ]);
+        if(DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] <= DP_ENTBUFSIZ){
           if(!(vbufs[unum] = malloc(head[DP_RHIVSIZ] + 1))){
             dpecodeset(DP_EALLOC, __FILE__, __LINE__);
             err = TRUE;
             break;
           }
-          memcpy(vbufs[unum], ebuf + (DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ]),
+          memcpy(vbufs[unum], ebuf + (DP_RHSIZ(depot->large) + head[DP_RHIKSIZ]),
                  head[DP_RHIVSIZ]);
         } else {
           vbufs[unum] = dprecval(depot, off, head, 0, -1);
@@ -860,7 +1060,7 @@ int dpoptimize(DEPOT *depot, int bnum){
         unum = 0;
       }
     }
-    off += dprecsize(head);
+    off += dprecsize(depot->large, head);
     if(err) break;
   }
   for(i = 0; i < unum; i++){
@@ -903,6 +1103,7 @@ int dpoptimize(DEPOT *depot, int bnum){
   depot->fsiz = tdepot->fsiz;
   depot->bnum = tdepot->bnum;
   depot->ioff = 0;
+  depot->coff = 0;
   for(i = 0; i < depot->fbpsiz; i += 2){
     depot->fbpool[i] = -1;
     depot->fbpool[i+1] = -1;
@@ -914,7 +1115,8 @@ int dpoptimize(DEPOT *depot, int bnum){
     depot->fatal = TRUE;
     return FALSE;
   }
-  depot->buckets = (int *)(depot->map + DP_HEADSIZ);
+  depot->buckets = depot->map + DP_HEADSIZ;
+  if(depot->mapall) dpremap(depot);
   if(!(name = dpname(tdepot))){
     dpclose(tdepot);
     unlink(tdepot->name);
@@ -938,6 +1140,127 @@ int dpoptimize(DEPOT *depot, int bnum){
 }
 
 
+/* Compact a database file incrementally. */
+int dpcompact(DEPOT *depot, int unum){
+  long long head[DP_RHNUM], off, dest, entoff;
+  int i, bi, hsiz, rsiz, nsiz, bsiz;
+  char *rbuf;
+  assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return -1;
+  }
+  if(!depot->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return -1;
+  }
+  if(!dpaioflush(depot)) return -1;
+  depot->loff = -1;
+  if(unum < 1) unum = DP_CMPUNIT;
+  hsiz = DP_RHSIZ(depot->large);
+  off = DP_HBSIZ(depot);
+  if(depot->coff > off) off = depot->coff;
+  dest = off;
+  for(i = 0; i < unum && off < depot->fsiz; i++){
+    if(!dprechead(depot, off, head, NULL, NULL)){
+      depot->fatal = TRUE;
+      return -1;
+    }
+    rsiz = dprecsize(depot->large, head);
+    switch(dpreclive(depot, off, head, &bi, &entoff)){
+    case -1:
+      depot->fatal = TRUE;
+      return -1;
+    case 0:
+      dpfbpoolout(depot, dest, off + rsiz - dest);
+      off += rsiz;
+      continue;
+    }
+    if(dest == off){
+      off += rsiz;
+      dest = off;
+      continue;
+    }
+    bsiz = hsiz + head[DP_RHIKSIZ] + head[DP_RHIVSIZ];
+    if(head[DP_RHIFLAGS] & DP_RECFDEL){
+      bsiz -= head[DP_RHIVSIZ];
+      head[DP_RHIVSIZ] = 0;
+      head[DP_RHIPSIZ] = 0;
+    } else if(head[DP_RHIPSIZ] > bsiz){
+      head[DP_RHIPSIZ] = bsiz;
+    }
+    nsiz = dprecsize(depot->large, head);
+    if(off + rsiz - (dest + nsiz) < hsiz){
+      head[DP_RHIPSIZ] += off + rsiz - (dest + nsiz);
+      nsiz = off + rsiz - dest;
+    }
+    if(!(rbuf = malloc(nsiz))){
+      dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+      depot->fatal = TRUE;
+      return -1;
+    }
+    dprhencode(depot->large, head, rbuf);
+    memset(rbuf + bsiz, 0, nsiz - bsiz);
+    dpfbpoolout(depot, dest, off + rsiz - dest);
+    if(!dpseekread(depot->fd, off + hsiz, rbuf + hsiz, bsiz - hsiz) ||
+       !dpseekwrite(depot->fd, dest, rbuf, nsiz)){
+      free(rbuf);
+      depot->fatal = TRUE;
+      return -1;
+    }
+    free(rbuf);
+    if(entoff > 0){
+      if(!dpseekwriteoff(depot->fd, entoff, dest, depot->large)){
+        depot->fatal = TRUE;
+        return -1;
+      }
+    } else if(depot->large){
+      ((long long *)depot->buckets)[bi] = dest;
+    } else {
+      ((int *)depot->buckets)[bi] = dest;
+    }
+    dest += nsiz;
+    off += rsiz;
+  }
+  if(off >= depot->fsiz){
+    if(dest < depot->fsiz){
+      if(ftruncate(depot->fd, dest) == -1){
+        dpecodeset(DP_ETRUNC, __FILE__, __LINE__);
+        depot->fatal = TRUE;
+        return -1;
+      }
+      dpfbpoolout(depot, dest, depot->fsiz - dest);
+      depot->fsiz = dest;
+    }
+    depot->coff = 0;
+    return 0;
+  }
+  if(dest < off){
+    head[DP_RHIFLAGS] = DP_RECFDEL;
+    head[DP_RHIHASH] = 0;
+    head[DP_RHIKSIZ] = 0;
+    head[DP_RHIVSIZ] = 0;
+    head[DP_RHIPSIZ] = off - dest - hsiz;
+    head[DP_RHILEFT] = 0;
+    head[DP_RHIRIGHT] = 0;
+    if(!(rbuf = malloc(hsiz))){
+      dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+      depot->fatal = TRUE;
+      return -1;
+    }
+    dprhencode(depot->large, head, rbuf);
+    if(!dpseekwrite(depot->fd, dest, rbuf, hsiz)){
+      free(rbuf);
+      depot->fatal = TRUE;
+      return -1;
+    }
+    free(rbuf);
+  }
+  depot->coff = dest;
+  return 1;
+}
+
+
 /* Get the name of a database. */
 char *dpname(DEPOT *depot){
   char *name;
@@ -962,7 +1285,18 @@ int dpfsiz(DEPOT *depot){
     dpecodeset(DP_EFATAL, __FILE__, __LINE__);
     return -1;
   }
-  return depot->fsiz;
+  return depot->fsiz > INT_MAX ? INT_MAX : depot->fsiz;
+}
+
+
+/* Get the size of a database file as double-precision floating-point number. */
+double dpfsizd(DEPOT *depot){
+  assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return -1.0;
+  }
+  return (double)depot->fsiz;
 }
 
 
@@ -987,7 +1321,7 @@ int dpbusenum(DEPOT *depot){
   }
   hits = 0;
   for(i = 0; i < depot->bnum; i++){
-    if(depot->buckets[i]) hits++;
+    if(DP_GETBUCKET(depot->buckets, depot->large, i)) hits++;
   }
   return hits;
 }
@@ -1060,8 +1394,9 @@ int dpremove(const char *name){
 /* Repair a broken database file. */
 int dprepair(const char *name){
   DEPOT *tdepot;
-  char dbhead[DP_HEADSIZ], *tname, *kbuf, *vbuf;
-  int fd, fsiz, flags, bnum, tbnum, err, head[DP_RHNUM], off, rsiz, ksiz, vsiz;
+  char dbhead[DP_HEADSIZ], rhbuf[DP_RHSIZ(TRUE)], *tname, *kbuf, *vbuf;
+  long long fsiz, head[DP_RHNUM], off;
+  int fd, flags, bnum, tbnum, err, large, rhsiz, rsiz, ksiz, vsiz;
   struct stat sbuf;
   assert(name);
   if(lstat(name, &sbuf) == -1){
@@ -1077,6 +1412,8 @@ int dprepair(const char *name){
     close(fd);
     return FALSE;
   }
+  dpcheckmagic(dbhead, &large);
+  rhsiz = DP_RHSIZ(large);
   flags = *(int *)(dbhead + DP_FLAGSOFF);
   bnum = *(int *)(dbhead + DP_BNUMOFF);
   tbnum = *(int *)(dbhead + DP_RNUMOFF) * 2;
@@ -1086,28 +1423,32 @@ int dprepair(const char *name){
     return FALSE;
   }
   sprintf(tname, "%s%s", name, DP_TMPFSUF);
-  if(!(tdepot = dpopen(tname, DP_OWRITER | DP_OCREAT | DP_OTRUNC, tbnum))){
+  if(!(tdepot = dpopen(tname, DP_OWRITER | DP_OCREAT | DP_OTRUNC |
+                        (large ? DP_OLARGE : 0), tbnum))){
     free(tname);
     close(fd);
     return FALSE;
   }
   err = FALSE;
-  off = DP_HEADSIZ + bnum * sizeof(int);
+  off = DP_HEADSIZ + (long long)bnum * DP_BKTSIZ(large);
   while(off < fsiz){
-    if(!dpseekread(fd, off, head, DP_RHNUM * sizeof(int))) break;
+    if(!dpseekread(fd, off, rhbuf, rhsiz)) break;
+    dprhdecode(large, rhbuf, head);
     if(head[DP_RHIFLAGS] & DP_RECFDEL){
-      if((rsiz = dprecsize(head)) < 0) break;
+      if((rsiz = dprecsize(large, head)) < 0) break;
       off += rsiz;
       continue;
     }
     ksiz = head[DP_RHIKSIZ];
     vsiz = head[DP_RHIVSIZ];
+    /* a record cut off by the end of the file was being written when the process died */
+    if(ksiz >= 0 && vsiz >= 0 && off + rhsiz + ksiz + vsiz > fsiz) break;
     if(ksiz >= 0 && vsiz >= 0){
       kbuf = malloc(ksiz + 1);
       vbuf = malloc(vsiz + 1);
       if(kbuf && vbuf){
-        if(dpseekread(fd, off + DP_RHNUM * sizeof(int), kbuf, ksiz) &&
-           dpseekread(fd, off + DP_RHNUM * sizeof(int) + ksiz, vbuf, vsiz)){
+        if(dpseekread(fd, off + rhsiz, kbuf, ksiz) &&
+           dpseekread(fd, off + rhsiz + ksiz, vbuf, vsiz)){
           if(!dpput(tdepot, kbuf, ksiz, vbuf, vsiz, DP_DKEEP)) err = TRUE;
         } else {
           err = TRUE;
@@ -1122,7 +1463,7 @@ int dprepair(const char *name){
       if(!err) dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
       err = TRUE;
     }
-    if((rsiz = dprecsize(head)) < 0) break;
+    if((rsiz = dprecsize(large, head)) < 0) break;
     off += rsiz;
   }
   if(!dpsetflags(tdepot, flags)) err = TRUE;
@@ -1194,7 +1535,8 @@ int dpexportdb(DEPOT *depot, const char *name){
 /* Load all records from endian independent data. */
 int dpimportdb(DEPOT *depot, const char *name){
   char mbuf[DP_IOBUFSIZ], *rbuf;
-  int i, j, fd, err, fsiz, off, msiz, ksiz, vsiz, hlen;
+  long long fsiz, off;
+  int i, j, fd, err, msiz, ksiz, vsiz, hlen;
   struct stat sbuf;
   assert(depot && name);
   if(!depot->wmode){
@@ -1274,8 +1616,9 @@ int dpimportdb(DEPOT *depot, const char *name){
 
 /* Retrieve a record directly from a database file. */
 char *dpsnaffle(const char *name, const char* kbuf, int ksiz, int *sp){
-  char hbuf[DP_HEADSIZ], *map, *vbuf, *tkbuf;
-  int fd, fsiz, bnum, msiz, *buckets, hash, thash, head[DP_RHNUM], err, off, vsiz, tksiz, kcmp;
+  char hbuf[DP_HEADSIZ], rhbuf[DP_RHSIZ(TRUE)], *map, *vbuf, *tkbuf;
+  long long fsiz, msiz, head[DP_RHNUM], off;
+  int fd, bnum, large, rhsiz, hash, thash, err, vsiz, tksiz, kcmp;
   struct stat sbuf;
   assert(name && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
@@ -1294,37 +1637,37 @@ char *dpsnaffle(const char *name, const char* kbuf, int ksiz, int *sp){
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
-  if(dpbigendian() ? memcmp(hbuf, DP_MAGICNUMB, strlen(DP_MAGICNUMB)) != 0 :
-     memcmp(hbuf, DP_MAGICNUML, strlen(DP_MAGICNUML)) != 0){
+  if(!dpcheckmagic(hbuf, &large)){
     close(fd);
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
+  rhsiz = DP_RHSIZ(large);
   bnum = *((int *)(hbuf + DP_BNUMOFF));
-  if(bnum < 1 || fsiz < DP_HEADSIZ + bnum * sizeof(int)){
+  if(bnum < 1 || fsiz < DP_HEADSIZ + (long long)bnum * DP_BKTSIZ(large)){
     close(fd);
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return NULL;
   }
-  msiz = DP_HEADSIZ + bnum * sizeof(int);
+  msiz = DP_HEADSIZ + (long long)bnum * DP_BKTSIZ(large);
   map = mmap(0, msiz, PROT_READ, MAP_SHARED, fd, 0);
   if(map == MAP_FAILED){
     close(fd);
     dpecodeset(DP_EMAP, __FILE__, __LINE__);
     return NULL;
   }
-  buckets = (int *)(map + DP_HEADSIZ);
   err = FALSE;
   vbuf = NULL;
   vsiz = 0;
   DP_SECONDHASH(hash, kbuf, ksiz);
   DP_FIRSTHASH(thash, kbuf, ksiz);
-  off = buckets[thash%bnum];
+  off = DP_GETBUCKET(map + DP_HEADSIZ, large, thash % bnum);
   while(off != 0){
-    if(!dpseekread(fd, off, head, DP_RHNUM * sizeof(int))){
+    if(!dpseekread(fd, off, rhbuf, rhsiz)){
       err = TRUE;
       break;
     }
+    dprhdecode(large, rhbuf, head);
     if(head[DP_RHIKSIZ] < 0 || head[DP_RHIVSIZ] < 0 || head[DP_RHIPSIZ] < 0 ||
        head[DP_RHILEFT] < 0 || head[DP_RHIRIGHT] < 0){
       dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
@@ -1343,7 +1686,7 @@ char *dpsnaffle(const char *name, const char* kbuf, int ksiz, int *sp){
         err = TRUE;
         break;
       }
-      if(!dpseekread(fd, off + DP_RHNUM * sizeof(int), tkbuf, tksiz)){
+      if(!dpseekread(fd, off + rhsiz, tkbuf, tksiz)){
         free(tkbuf);
         err = TRUE;
         break;
@@ -1364,7 +1707,7 @@ char *dpsnaffle(const char *name, const char* kbuf, int ksiz, int *sp){
           err = TRUE;
           break;
         }
-        if(!dpseekread(fd, off + DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ], vbuf, vsiz)){
+        if(!dpseekread(fd, off + rhsiz + head[DP_RHIKSIZ], vbuf, vsiz)){
           free(vbuf);
           vbuf = NULL;
           err = TRUE;
@@ -1427,6 +1770,10 @@ const char *dpsysname = _QDBM_SYSNAME;
 int dpdbgfd = -1;
 
 
+/* Counter of system calls for I/O on database files. */
+int dpsyscnt = -1;
+
+
 /* Whether this build is reentrant. */
 const int dpisreentrant = _qdbm_ptsafe;
 
@@ -1460,125 +1807,527 @@ int *dpecodeptr(void){
 }
 
 
-/* Synchronize updating contents on memory. */
-int dpmemsync(DEPOT *depot){
-  assert(depot);
+/* Retrieve a record as a region in the mapped memory. */
+const char *dpgetmap(DEPOT *depot, const char *kbuf, int ksiz, int *sp){
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee;
+  char ebuf[DP_ENTBUFSIZ];
+  const char *vbuf;
+  assert(depot && kbuf);
   if(depot->fatal){
     dpecodeset(DP_EFATAL, __FILE__, __LINE__);
-    return FALSE;
+    return NULL;
   }
-  if(!depot->wmode){
+  if(!depot->mapall){
     dpecodeset(DP_EMODE, __FILE__, __LINE__);
-    return FALSE;
+    return NULL;
   }
-  *((int *)(depot->map + DP_FSIZOFF)) = depot->fsiz;
-  *((int *)(depot->map + DP_RNUMOFF)) = depot->rnum;
-  if(msync(depot->map, depot->msiz, MS_SYNC) == -1){
-    dpecodeset(DP_EMAP, __FILE__, __LINE__);
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  DP_SECONDHASH(hash, kbuf, ksiz);
+  switch(dprecsearch(depot, kbuf, ksiz, hash, &bi, &off, &entoff, head, ebuf, &ee, FALSE)){
+  case -1:
     depot->fatal = TRUE;
+    return NULL;
+  case 0:
+    break;
+  default:
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+    return NULL;
+  }
+  if(!(vbuf = dpmapptr(depot, off + DP_RHSIZ(depot->large) + head[DP_RHIKSIZ],
+                       head[DP_RHIVSIZ]))){
+    dpecodeset(DP_EMAP, __FILE__, __LINE__);
+    return NULL;
+  }
+  if(sp) *sp = head[DP_RHIVSIZ];
+  return vbuf;
+}
+
+
+/* Advise the system to read a record in advance. */
+int dpprefetch(DEPOT *depot, const char *kbuf, int ksiz, int size){
+  long long off, base, len;
+  int thash;
+  assert(depot && kbuf);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  DP_FIRSTHASH(thash, kbuf, ksiz);
+  off = DP_GETBUCKET(depot->buckets, depot->large, thash % depot->bnum);
+  if(off < 1 || off >= depot->fsiz){
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
+  len = depot->fsiz - off;
+  if(size >= 0 && size < len) len = size;
+  base = off;
+#if defined(MADV_WILLNEED)
+  if(depot->mapall && off + len <= depot->msiz){
+    base -= off % sysconf(_SC_PAGESIZE);
+    madvise(depot->map + base, off + len - base, MADV_WILLNEED);
+    return TRUE;
+  }
+#endif
+#if defined(POSIX_FADV_WILLNEED)
+  DP_SYSCOUNT();
+  posix_fadvise(depot->fd, base, len, POSIX_FADV_WILLNEED);
+#endif
   return TRUE;
 }
 
 
-/* Synchronize updating contents on memory, not physically. */
-int dpmemflush(DEPOT *depot){
+/* Enable the engine of asynchronous I/O of a database handle. */
+int dpsetaio(DEPOT *depot, int depth, int engine){
+  DPAIO *aio;
+  int batch;
   assert(depot);
   if(depot->fatal){
     dpecodeset(DP_EFATAL, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!depot->wmode){
-    dpecodeset(DP_EMODE, __FILE__, __LINE__);
-    return FALSE;
+  batch = 0;
+  if(depot->aio){
+    if(!dpaioflush(depot)) return FALSE;
+    batch = ((DPAIO *)depot->aio)->batch;
+    dpaioclose(depot->aio);
+    depot->aio = NULL;
   }
-  *((int *)(depot->map + DP_FSIZOFF)) = depot->fsiz;
-  *((int *)(depot->map + DP_RNUMOFF)) = depot->rnum;
-  if(mflush(depot->map, depot->msiz, MS_SYNC) == -1){
-    dpecodeset(DP_EMAP, __FILE__, __LINE__);
-    depot->fatal = TRUE;
+  if(depth < 1) return TRUE;
+  if(!(aio = dpaioopen(depth, engine))){
+    dpecodeset(DP_EALLOC, __FILE__, __LINE__);
     return FALSE;
   }
+  aio->batch = batch;
+  depot->aio = aio;
   return TRUE;
 }
 
 
-/* Get flags of a database. */
-int dpgetflags(DEPOT *depot){
-  int flags;
+/* Get the engine of asynchronous I/O of a database handle. */
+int dpaioengine(DEPOT *depot){
   assert(depot);
-  memcpy(&flags, depot->map + DP_FLAGSOFF, sizeof(int));
-  return flags;
+  return depot->aio ? ((DPAIO *)depot->aio)->engine : DP_AIONONE;
 }
 
 
-/* Set flags of a database. */
-int dpsetflags(DEPOT *depot, int flags){
+/* Begin queuing writes of records. */
+int dpaiobegin(DEPOT *depot){
   assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
   if(!depot->wmode){
     dpecodeset(DP_EMODE, __FILE__, __LINE__);
     return FALSE;
   }
-  memcpy(depot->map + DP_FLAGSOFF, &flags, sizeof(int));
+  if(depot->aio) ((DPAIO *)depot->aio)->batch++;
   return TRUE;
 }
 
 
-
-/*************************************************************************************************
- * private objects
- *************************************************************************************************/
+/* End queuing writes of records. */
+int dpaioend(DEPOT *depot){
+  DPAIO *aio;
+  assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!depot->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!(aio = depot->aio) || aio->batch < 1) return TRUE;
+  if(--aio->batch > 0) return TRUE;
+  return dpaioflush(depot);
+}
 
 
-/* Check whether the byte order of the platform is big endian or not.
-   The return value is true if bigendian, else, it is false. */
-static int dpbigendian(void){
-  char buf[sizeof(int)];
-  *(int *)buf = 1;
-  return !buf[0];
+/* Retrieve records in a batch. */
+int dpgetbatch(DEPOT *depot, const char **kbufs, const int *ksizs, int num,
+               char **vbufs, int *vsizs){
+  DPAIOREQ *reqs;
+  DPAIORUN *runs;
+  long long head[DP_RHNUM], off, entoff;
+  int i, ksiz, vsiz, hash, bi, ee, rnum, hnum, err;
+  char ebuf[DP_ENTBUFSIZ], *vbuf;
+  const char *rp;
+  assert(depot && kbufs && ksizs && num >= 0 && vbufs && vsizs);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return -1;
+  }
+  for(i = 0; i < num; i++){
+    vbufs[i] = NULL;
+    vsizs[i] = 0;
+  }
+  if(!(reqs = malloc(num * sizeof(DPAIOREQ) + 1))){
+    dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+    return -1;
+  }
+  if(!(runs = malloc(num * sizeof(DPAIORUN) + 1))){
+    free(reqs);
+    dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+    return -1;
+  }
+  rnum = 0;
+  hnum = 0;
+  err = FALSE;
+  for(i = 0; i < num && !err; i++){
+    ksiz = ksizs[i];
+    if(ksiz < 0) ksiz = strlen(kbufs[i]);
+    DP_SECONDHASH(hash, kbufs[i], ksiz);
+    switch(dprecsearch(depot, kbufs[i], ksiz, hash, &bi, &off, &entoff, head, ebuf, &ee, FALSE)){
+    case -1:
+      depot->fatal = TRUE;
+      err = TRUE;
+      continue;
+    case 0:
+      break;
+    default:
+      continue;
+    }
+    vsiz = head[DP_RHIVSIZ];
+    if(!(vbuf = malloc(vsiz + 1))){
+      dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+      err = TRUE;
+      continue;
+    }
+    vbuf[vsiz] = '\0';
+    vbufs[i] = vbuf;
+    vsizs[i] = vsiz;
+    hnum++;
+    if(ee && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + vsiz <= DP_ENTBUFSIZ){
+      memcpy(vbuf, ebuf + (DP_RHSIZ(depot->large) + head[DP_RHIKSIZ]), vsiz);
+      continue;
+    }
+    off += DP_RHSIZ(depot->large) + head[DP_RHIKSIZ];
+    if((rp = dpmapptr(depot, off, vsiz)) != NULL){
+      memcpy(vbuf, rp, vsiz);
+    } else if(depot->aio && !dpaiooverlap(depot, off, vsiz)){
+      reqs[rnum].off = off;
+      reqs[rnum].buf = vbuf;
+      reqs[rnum].size = vsiz;
+      reqs[rnum].asiz = vsiz;
+      runs[rnum].off = off;
+      runs[rnum].reqs = reqs + rnum;
+      runs[rnum].num = 1;
+      runs[rnum].size = vsiz;
+      rnum++;
+    } else if(!dpioread(depot, off, vbuf, vsiz)){
+      depot->fatal = TRUE;
+      err = TRUE;
+    }
+  }
+  if(!err && rnum > 0 && !dpaiosubmit(depot, runs, rnum, FALSE)){
+    depot->fatal = TRUE;
+    err = TRUE;
+  }
+  free(runs);
+  free(reqs);
+  if(err){
+    for(i = 0; i < num; i++){
+      free(vbufs[i]);
+      vbufs[i] = NULL;
+      vsizs[i] = 0;
+    }
+    return -1;
+  }
+  return hnum;
 }
 
 
-/* Get a copied string.
-   `str' specifies an original string.
-   The return value is a copied string whose region is allocated by `malloc'. */
-static char *dpstrdup(const char *str){
-  int len;
-  char *buf;
-  assert(str);
-  len = strlen(str);
-  if(!(buf = malloc(len + 1))) return NULL;
-  memcpy(buf, str, len + 1);
-  return buf;
+/* Get statistics of the queue of writes of a database handle. */
+void dpaiostat(DEPOT *depot, int *fp, int *wp, int *cp, double *bp, double *lp){
+  DPAIO *aio;
+  assert(depot);
+  aio = depot->aio;
+  if(fp) *fp = aio ? aio->fnum : 0;
+  if(wp) *wp = aio ? aio->wnum : 0;
+  if(cp) *cp = aio ? aio->cnum : 0;
+  if(bp) *bp = aio ? aio->fsum : 0.0;
+  if(lp) *lp = aio ? aio->lsiz : 0.0;
 }
 
 
-/* Lock a file descriptor.
-   `fd' specifies a file descriptor.
-   `ex' specifies whether an exclusive lock or a shared lock is performed.
-   `nb' specifies whether to request with non-blocking.
-   The return value is true if successful, else, it is false. */
-static int dplock(int fd, int ex, int nb){
-  struct flock lock;
-  assert(fd >= 0);
-  memset(&lock, 0, sizeof(struct flock));
-  lock.l_type = ex ? F_WRLCK : F_RDLCK;
-  lock.l_whence = SEEK_SET;
-  lock.l_start = 0;
-  lock.l_len = 0;
-  lock.l_pid = 0;
-  while(fcntl(fd, nb ? F_SETLK : F_SETLKW, &lock) == -1){
-    if(errno != EINTR){
-      dpecodeset(DP_ELOCK, __FILE__, __LINE__);
-      return FALSE;
-    }
+/* Get the location of a record. */
+int dprecloc(DEPOT *depot, const char *kbuf, int ksiz, long long *offp, int *sp){
+  long long head[DP_RHNUM], off, entoff;
+  int hash, bi, ee;
+  char ebuf[DP_ENTBUFSIZ];
+  assert(depot && kbuf && offp && sp);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  DP_SECONDHASH(hash, kbuf, ksiz);
+  switch(dprecsearch(depot, kbuf, ksiz, hash, &bi, &off, &entoff, head, ebuf, &ee, FALSE)){
+  case -1:
+    depot->fatal = TRUE;
+    return FALSE;
+  case 0:
+    break;
+  default:
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+    return FALSE;
   }
+  *offp = off;
+  *sp = DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ];
   return TRUE;
 }
 
 
-/* Write into a file.
+/* Get the location of the record stored last. */
+int dplastloc(DEPOT *depot, long long *offp, int *sp){
+  assert(depot && offp && sp);
+  if(depot->loff < 1){
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+    return FALSE;
+  }
+  *offp = depot->loff;
+  *sp = depot->lsiz;
+  return TRUE;
+}
+
+
+/* Retrieve a record at a location. */
+const char *dpgetat(DEPOT *depot, long long off, int size, const char *kbuf, int ksiz,
+                    char *buf, int *sp){
+  long long head[DP_RHNUM];
+  const char *rp;
+  int hsiz, hash;
+  assert(depot && kbuf && buf);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return NULL;
+  }
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  hsiz = DP_RHSIZ(depot->large);
+  if(off < DP_HBSIZ(depot) || size < hsiz + ksiz || off + size > depot->fsiz){
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+    return NULL;
+  }
+  if((rp = dpmapptr(depot, off, size)) != NULL){
+    memcpy(buf, rp, size);
+  } else if(!dpioread(depot, off, buf, size)){
+    depot->fatal = TRUE;
+    return NULL;
+  }
+  dprhdecode(depot->large, buf, head);
+  DP_SECONDHASH(hash, kbuf, ksiz);
+  if((head[DP_RHIFLAGS] & DP_RECFDEL) || head[DP_RHIHASH] != hash ||
+     head[DP_RHIKSIZ] != ksiz || hsiz + ksiz + head[DP_RHIVSIZ] != size ||
+     memcmp(buf + hsiz, kbuf, ksiz)){
+    dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+    return NULL;
+  }
+  if(sp) *sp = head[DP_RHIVSIZ];
+  return buf + hsiz + ksiz;
+}
+
+
+/* Synchronize updating contents on memory. */
+int dpmemsync(DEPOT *depot){
+  assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!depot->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!dpaioflush(depot)) return FALSE;
+  dpheadsync(depot);
+  if(msync(depot->map, DP_HBSIZ(depot), MS_SYNC) == -1){
+    dpecodeset(DP_EMAP, __FILE__, __LINE__);
+    depot->fatal = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Synchronize updating contents on memory, not physically. */
+int dpmemflush(DEPOT *depot){
+  assert(depot);
+  if(depot->fatal){
+    dpecodeset(DP_EFATAL, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!depot->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!dpaioflush(depot)) return FALSE;
+  dpheadsync(depot);
+  if(mflush(depot->map, DP_HBSIZ(depot), MS_SYNC) == -1){
+    dpecodeset(DP_EMAP, __FILE__, __LINE__);
+    depot->fatal = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Get flags of a database. */
+int dpgetflags(DEPOT *depot){
+  int flags;
+  assert(depot);
+  memcpy(&flags, depot->map + DP_FLAGSOFF, sizeof(int));
+  return flags;
+}
+
+
+/* Set flags of a database. */
+int dpsetflags(DEPOT *depot, int flags){
+  assert(depot);
+  if(!depot->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  memcpy(depot->map + DP_FLAGSOFF, &flags, sizeof(int));
+  return TRUE;
+}
+
+
+
+/*************************************************************************************************
+ * private objects
+ *************************************************************************************************/
+
+
+/* Check whether the byte order of the platform is big endian or not.
+   The return value is true if bigendian, else, it is false. */
+static int dpbigendian(void){
+  char buf[sizeof(int)];
+  *(int *)buf = 1;
+  return !buf[0];
+}
+
+
+/* Check the magic number of a database file.
+   `hbuf' specifies the header of a database file.
+   `largep' specifies the pointer to a variable to which whether the file is large is assigned.
+   The return value is true if the magic number is valid, else, it is false. */
+static int dpcheckmagic(const char *hbuf, int *largep){
+  assert(hbuf && largep);
+  *largep = FALSE;
+  if(dpbigendian()){
+    if(!memcmp(hbuf, DP_MAGICNUMB, strlen(DP_MAGICNUMB))) return TRUE;
+    if(!memcmp(hbuf, DP_LMAGICNUMB, strlen(DP_LMAGICNUMB))){
+      *largep = TRUE;
+      return TRUE;
+    }
+  } else {
+    if(!memcmp(hbuf, DP_MAGICNUML, strlen(DP_MAGICNUML))) return TRUE;
+    if(!memcmp(hbuf, DP_LMAGICNUML, strlen(DP_LMAGICNUML))){
+      *largep = TRUE;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+
+/* Reflect the file size and the number of records into the header on the mapped memory.
+   `depot' specifies a database handle. */
+static void dpheadsync(DEPOT *depot){
+  int fsiz;
+  assert(depot);
+  if(depot->large){
+    memcpy(depot->map + DP_FSIZOFF, &(depot->fsiz), sizeof(long long));
+  } else {
+    fsiz = depot->fsiz;
+    memcpy(depot->map + DP_FSIZOFF, &fsiz, sizeof(int));
+  }
+  memcpy(depot->map + DP_RNUMOFF, &(depot->rnum), sizeof(int));
+}
+
+
+/* Map the whole of a database file into memory again.
+   `depot' specifies a database handle whose whole file should be mapped.
+   The return value is true if successful, else, it is false.
+   A writer maps some room beyond the end of the file so that appended records are covered
+   without remapping each time.  On failure, the current mapping is kept and the whole file is
+   not mapped any longer. */
+static int dpremap(DEPOT *depot){
+  char *map;
+  long long msiz;
+  assert(depot);
+  msiz = depot->fsiz;
+  if(depot->wmode) msiz += msiz / 2;
+  if(msiz < depot->msiz || (long long)(size_t)msiz != msiz ||
+     (map = mmap(0, msiz, PROT_READ | (depot->wmode ? PROT_WRITE : 0), MAP_SHARED,
+                 depot->fd, 0)) == MAP_FAILED){
+    depot->mapall = FALSE;
+    return FALSE;
+  }
+  munmap(depot->map, depot->msiz);
+  depot->map = map;
+  depot->msiz = msiz;
+  depot->buckets = map + DP_HEADSIZ;
+  return TRUE;
+}
+
+
+/* Get the pointer to a region of a database file in the mapped memory.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the region.
+   `size' specifies the size of the region.
+   The return value is the pointer to the region, or, `NULL' if it is not mapped or it overlaps
+   queued writes. */
+static const char *dpmapptr(DEPOT *depot, long long off, int size){
+  assert(depot && off >= 0 && size >= 0);
+  if(!depot->mapall || off + size > depot->fsiz || dpaiooverlap(depot, off, size)) return NULL;
+  if(off + size > depot->msiz && !dpremap(depot)) return NULL;
+  return depot->map + off;
+}
+
+
+/* Get a copied string.
+   `str' specifies an original string.
+   The return value is a copied string whose region is allocated by `malloc'. */
+static char *dpstrdup(const char *str){
+  int len;
+  char *buf;
+  assert(str);
+  len = strlen(str);
+  if(!(buf = malloc(len + 1))) return NULL;
+  memcpy(buf, str, len + 1);
+  return buf;
+}
+
+
+/* Lock a file descriptor.
+   `fd' specifies a file descriptor.
+   `ex' specifies whether an exclusive lock or a shared lock is performed.
+   `nb' specifies whether to request with non-blocking.
+   The return value is true if successful, else, it is false. */
+static int dplock(int fd, int ex, int nb){
+  struct flock lock;
+  assert(fd >= 0);
+  memset(&lock, 0, sizeof(struct flock));
+  lock.l_type = ex ? F_WRLCK : F_RDLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = 0;
+  lock.l_pid = 0;
+  while(fcntl(fd, nb ? F_SETLK : F_SETLKW, &lock) == -1){
+    if(errno != EINTR){
+      dpecodeset(DP_ELOCK, __FILE__, __LINE__);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/* Write into a file.
    `fd' specifies a file descriptor.
    `buf' specifies a buffer to write.
    `size' specifies the size of the buffer.
@@ -1611,23 +2360,30 @@ static int dpwrite(int fd, const void *buf, int size){
    `buf' specifies a buffer to write.
    `size' specifies the size of the buffer.
    The return value is true if successful, else, it is false. */
-static int dpseekwrite(int fd, int off, const void *buf, int size){
+static int dpseekwrite(int fd, long long off, const void *buf, int size){
+  const char *lbuf;
+  int wb;
   assert(fd >= 0 && buf && size >= 0);
   if(size < 1) return TRUE;
   if(off < 0){
-    if(lseek(fd, 0, SEEK_END) == -1){
+    DP_SYSCOUNT();
+    if((off = lseek(fd, 0, SEEK_END)) == -1){
       dpecodeset(DP_ESEEK, __FILE__, __LINE__);
       return FALSE;
     }
-  } else {
-    if(lseek(fd, off, SEEK_SET) != off){
-      dpecodeset(DP_ESEEK, __FILE__, __LINE__);
+  }
+  lbuf = buf;
+  while(size > 0){
+    DP_SYSCOUNT();
+    wb = pwrite(fd, lbuf, size, off);
+    if(wb == -1){
+      if(errno == EINTR) continue;
+      dpecodeset(DP_EWRITE, __FILE__, __LINE__);
       return FALSE;
     }
-  }
-  if(dpwrite(fd, buf, size) != size){
-    dpecodeset(DP_EWRITE, __FILE__, __LINE__);
-    return FALSE;
+    lbuf += wb;
+    size -= wb;
+    off += wb;
   }
   return TRUE;
 }
@@ -1638,26 +2394,22 @@ static int dpseekwrite(int fd, int off, const void *buf, int size){
    `off' specifies an offset of the file.
    `num' specifies an integer.
    The return value is true if successful, else, it is false. */
-static int dpseekwritenum(int fd, int off, int num){
+static int dpseekwritenum(int fd, long long off, int num){
   assert(fd >= 0);
   return dpseekwrite(fd, off, &num, sizeof(int));
 }
 
 
-/* Read from a file and store the data into a buffer.
+/* Write an offset into a file at an offset.
    `fd' specifies a file descriptor.
-   `buffer' specifies a buffer to store into.
-   `size' specifies the size to read with.
-   The return value is the size read with, or, -1 on failure. */
-static int dpread(int fd, void *buf, int size){
-  char *lbuf;
-  int i, bs;
-  assert(fd >= 0 && buf && size >= 0);
-  lbuf = buf;
-  for(i = 0; i < size && (bs = read(fd, lbuf + i, size - i)) != 0; i += bs){
-    if(bs == -1 && errno != EINTR) return -1;
-  }
-  return i;
+   `off' specifies an offset of the file.
+   `num' specifies an offset to be written.
+   `large' specifies whether the offset is written as 64 bits or 32 bits.
+   The return value is true if successful, else, it is false. */
+static int dpseekwriteoff(int fd, long long off, long long num, int large){
+  assert(fd >= 0);
+  if(large) return dpseekwrite(fd, off, &num, sizeof(long long));
+  return dpseekwritenum(fd, off, num);
 }
 
 
@@ -1667,17 +2419,22 @@ static int dpread(int fd, void *buf, int size){
    `buffer' specifies a buffer to store into.
    `size' specifies the size to read with.
    The return value is true if successful, else, it is false. */
-static int dpseekread(int fd, int off, void *buf, int size){
+static int dpseekread(int fd, long long off, void *buf, int size){
   char *lbuf;
+  int rb;
   assert(fd >= 0 && off >= 0 && buf && size >= 0);
   lbuf = (char *)buf;
-  if(lseek(fd, off, SEEK_SET) != off){
-    dpecodeset(DP_ESEEK, __FILE__, __LINE__);
-    return FALSE;
-  }
-  if(dpread(fd, lbuf, size) != size){
-    dpecodeset(DP_EREAD, __FILE__, __LINE__);
-    return FALSE;
+  while(size > 0){
+    DP_SYSCOUNT();
+    rb = pread(fd, lbuf, size, off);
+    if(rb == -1 && errno == EINTR) continue;
+    if(rb < 1){
+      dpecodeset(DP_EREAD, __FILE__, __LINE__);
+      return FALSE;
+    }
+    lbuf += rb;
+    size -= rb;
+    off += rb;
   }
   return TRUE;
 }
@@ -1689,25 +2446,22 @@ static int dpseekread(int fd, int off, void *buf, int size){
    `srcfd' specifies a file descriptor of a source file.
    `srcoff' specifies an offset of the source file.
    The return value is the size copied with, or, -1 on failure. */
-static int dpfcopy(int destfd, int destoff, int srcfd, int srcoff){
+static long long dpfcopy(int destfd, long long destoff, int srcfd, long long srcoff){
   char iobuf[DP_IOBUFSIZ];
-  int sum, iosiz;
-  if(lseek(srcfd, srcoff, SEEK_SET) == -1 || lseek(destfd, destoff, SEEK_SET) == -1){
-    dpecodeset(DP_ESEEK, __FILE__, __LINE__);
-    return -1;
-  }
+  long long sum;
+  int iosiz;
   sum = 0;
-  while((iosiz = dpread(srcfd, iobuf, DP_IOBUFSIZ)) > 0){
-    if(dpwrite(destfd, iobuf, iosiz) == -1){
-      dpecodeset(DP_EWRITE, __FILE__, __LINE__);
+  while(TRUE){
+    DP_SYSCOUNT();
+    if((iosiz = pread(srcfd, iobuf, DP_IOBUFSIZ, srcoff + sum)) == -1){
+      if(errno == EINTR) continue;
+      dpecodeset(DP_EREAD, __FILE__, __LINE__);
       return -1;
     }
+    if(iosiz == 0) break;
+    if(!dpseekwrite(destfd, destoff + sum, iobuf, iosiz)) return -1;
     sum += iosiz;
   }
-  if(iosiz < 0){
-    dpecodeset(DP_EREAD, __FILE__, __LINE__);
-    return -1;
-  }
   return sum;
 }
 
@@ -1756,20 +2510,20 @@ static int dppadsize(DEPOT *depot, int ksiz, int vsiz){
   int pad;
   assert(depot && vsiz >= 0);
   if(depot->align > 0){
-    return depot->align - (depot->fsiz + DP_RHNUM * sizeof(int) + ksiz + vsiz) % depot->align;
+    return depot->align - (depot->fsiz + DP_RHSIZ(depot->large) + ksiz + vsiz) % depot->align;
   } else if(depot->align < 0){
     pad = (int)(vsiz * (2.0 / (1 << -(depot->align))));
     if(vsiz + pad >= DP_FSBLKSIZ){
       if(vsiz <= DP_FSBLKSIZ) pad = 0;
       if(depot->fsiz % DP_FSBLKSIZ == 0){
         return (pad / DP_FSBLKSIZ) * DP_FSBLKSIZ + DP_FSBLKSIZ -
-          (depot->fsiz + DP_RHNUM * sizeof(int) + ksiz + vsiz) % DP_FSBLKSIZ;
+          (depot->fsiz + DP_RHSIZ(depot->large) + ksiz + vsiz) % DP_FSBLKSIZ;
       } else {
         return (pad / (DP_FSBLKSIZ / 2)) * (DP_FSBLKSIZ / 2) + (DP_FSBLKSIZ / 2) -
-          (depot->fsiz + DP_RHNUM * sizeof(int) + ksiz + vsiz) % (DP_FSBLKSIZ / 2);
+          (depot->fsiz + DP_RHSIZ(depot->large) + ksiz + vsiz) % (DP_FSBLKSIZ / 2);
       }
     } else {
-      return pad >= DP_RHNUM * sizeof(int) ? pad : DP_RHNUM * sizeof(int);
+      return pad >= DP_RHSIZ(depot->large) ? pad : DP_RHSIZ(depot->large);
     }
   }
   return 0;
@@ -1777,11 +2531,48 @@ static int dppadsize(DEPOT *depot, int ksiz, int vsiz){
 
 
 /* Get the size of a record in a database file.
+   `large' specifies whether the database file is large or not.
    `head' specifies the header of  a record.
    The return value is the size of a record in a database file. */
-static int dprecsize(int *head){
+static int dprecsize(int large, long long *head){
   assert(head);
-  return DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] + head[DP_RHIPSIZ];
+  return DP_RHSIZ(large) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] + head[DP_RHIPSIZ];
+}
+
+
+/* Decode the header of a record from the format in a database file.
+   `large' specifies whether the database file is large or not.
+   `buf' specifies the pointer to the region of the header in a database file.
+   `head' specifies a buffer for the header. */
+static void dprhdecode(int large, const char *buf, long long *head){
+  int i, num;
+  assert(buf && head);
+  for(i = 0; i < DP_RHNUM; i++){
+    if(large && i >= DP_RHILEFT){
+      memcpy(head + i, buf + DP_RHOFF(large, i), sizeof(long long));
+    } else {
+      memcpy(&num, buf + DP_RHOFF(large, i), sizeof(int));
+      head[i] = num;
+    }
+  }
+}
+
+
+/* Encode the header of a record into the format in a database file.
+   `large' specifies whether the database file is large or not.
+   `head' specifies the header of a record.
+   `buf' specifies a buffer whose size is `DP_RHSIZ(large)' or more. */
+static void dprhencode(int large, const long long *head, char *buf){
+  int i, num;
+  assert(head && buf);
+  for(i = 0; i < DP_RHNUM; i++){
+    if(large && i >= DP_RHILEFT){
+      memcpy(buf + DP_RHOFF(large, i), head + i, sizeof(long long));
+    } else {
+      num = head[i];
+      memcpy(buf + DP_RHOFF(large, i), &num, sizeof(int));
+    }
+  }
 }
 
 
@@ -1791,28 +2582,27 @@ static int dprecsize(int *head){
    `head' specifies a buffer for the header.
    `ebuf' specifies the pointer to the entity buffer.
    `eep' specifies the pointer to a variable to which whether ebuf was used is assigned.
-   The return value is true if successful, else, it is false. */
-static int dprechead(DEPOT *depot, int off, int *head, char *ebuf, int *eep){
+   The return value is true if successful, else, it is false.
+   If the whole file is mapped, the header is read from the mapping and ebuf is not used. */
+static int dprechead(DEPOT *depot, long long off, long long *head, char *ebuf, int *eep){
+  char rhbuf[DP_RHSIZ(TRUE)];
+  const char *rp;
   assert(depot && off >= 0 && head);
   if(off > depot->fsiz){
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
     return FALSE;
   }
-  if(ebuf){
-    *eep = FALSE;
-    if(off < depot->fsiz - DP_ENTBUFSIZ){
-      *eep = TRUE;
-      if(!dpseekread(depot->fd, off, ebuf, DP_ENTBUFSIZ)) return FALSE;
-      memcpy(head, ebuf, DP_RHNUM * sizeof(int));
-      if(head[DP_RHIKSIZ] < 0 || head[DP_RHIVSIZ] < 0 || head[DP_RHIPSIZ] < 0 ||
-         head[DP_RHILEFT] < 0 || head[DP_RHIRIGHT] < 0){
-        dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-        return FALSE;
-      }
-      return TRUE;
-    }
+  if(ebuf) *eep = FALSE;
+  if((rp = dpmapptr(depot, off, DP_RHSIZ(depot->large))) != NULL){
+    dprhdecode(depot->large, rp, head);
+  } else if(ebuf && off < depot->fsiz - DP_ENTBUFSIZ){
+    *eep = TRUE;
+    if(!dpioread(depot, off, ebuf, DP_ENTBUFSIZ)) return FALSE;
+    dprhdecode(depot->large, ebuf, head);
+  } else {
+    if(!dpioread(depot, off, rhbuf, DP_RHSIZ(depot->large))) return FALSE;
+    dprhdecode(depot->large, rhbuf, head);
   }
-  if(!dpseekread(depot->fd, off, head, DP_RHNUM * sizeof(int))) return FALSE;
   if(head[DP_RHIKSIZ] < 0 || head[DP_RHIVSIZ] < 0 || head[DP_RHIPSIZ] < 0 ||
      head[DP_RHILEFT] < 0 || head[DP_RHIRIGHT] < 0){
     dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
@@ -1827,7 +2617,8 @@ static int dprechead(DEPOT *depot, int off, int *head, char *ebuf, int *eep){
    `off' specifies an offset of the database file.
    `head' specifies the header of a record.
    The return value is a key data whose region is allocated by `malloc', or NULL on failure. */
-static char *dpreckey(DEPOT *depot, int off, int *head){
+static char *dpreckey(DEPOT *depot, long long off, long long *head){
+  const char *rp;
   char *kbuf;
   int ksiz;
   assert(depot && off >= 0);
@@ -1836,7 +2627,9 @@ static char *dpreckey(DEPOT *depot, int off, int *head){
     dpecodeset(DP_EALLOC, __FILE__, __LINE__);
     return NULL;
   }
-  if(!dpseekread(depot->fd, off + DP_RHNUM * sizeof(int), kbuf, ksiz)){
+  if((rp = dpmapptr(depot, off + DP_RHSIZ(depot->large), ksiz)) != NULL){
+    memcpy(kbuf, rp, ksiz);
+  } else if(!dpioread(depot, off + DP_RHSIZ(depot->large), kbuf, ksiz)){
     free(kbuf);
     return NULL;
   }
@@ -1852,7 +2645,8 @@ static char *dpreckey(DEPOT *depot, int off, int *head){
    `start' specifies the offset address of the beginning of the region of the value to be read.
    `max' specifies the max size to be read.  If it is negative, the size to read is unlimited.
    The return value is a value data whose region is allocated by `malloc', or NULL on failure. */
-static char *dprecval(DEPOT *depot, int off, int *head, int start, int max){
+static char *dprecval(DEPOT *depot, long long off, long long *head, int start, int max){
+  const char *rp;
   char *vbuf;
   int vsiz;
   assert(depot && off >= 0 && start >= 0);
@@ -1866,7 +2660,11 @@ static char *dprecval(DEPOT *depot, int off, int *head, int start, int max){
     dpecodeset(DP_EALLOC, __FILE__, __LINE__);
     return NULL;
   }
-  if(!dpseekread(depot->fd, off + DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + start, vbuf, vsiz)){
+  if((rp = dpmapptr(depot, off + DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start,
+                    vsiz)) != NULL){
+    memcpy(vbuf, rp, vsiz);
+  } else if(!dpioread(depot, off + DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start,
+                        vbuf, vsiz)){
     free(vbuf);
     return NULL;
   }
@@ -1882,13 +2680,20 @@ static char *dprecval(DEPOT *depot, int off, int *head, int start, int max){
    `start' specifies the offset address of the beginning of the region of the value to be read.
    `max' specifies the max size to be read.  It shuld be less than the size of the writing buffer.
    If successful, the return value is the size of the written data, else, it is -1. */
-static int dprecvalwb(DEPOT *depot, int off, int *head, int start, int max, char *vbuf){
+static int dprecvalwb(DEPOT *depot, long long off, long long *head, int start, int max,
+                      char *vbuf){
+  const char *rp;
   int vsiz;
   assert(depot && off >= 0 && start >= 0 && max >= 0 && vbuf);
   head[DP_RHIVSIZ] -= start;
   vsiz = max < head[DP_RHIVSIZ] ? max : head[DP_RHIVSIZ];
-  if(!dpseekread(depot->fd, off + DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + start, vbuf, vsiz))
+  if((rp = dpmapptr(depot, off + DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start,
+                    vsiz)) != NULL){
+    memcpy(vbuf, rp, vsiz);
+  } else if(!dpioread(depot, off + DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] + start,
+                        vbuf, vsiz)){
     return -1;
+  }
   return vsiz;
 }
 
@@ -1921,14 +2726,17 @@ static int dpkeycmp(const char *abuf, int asiz, const char *bbuf, int bsiz){
    `eep' specifies the pointer to a variable to which whether ebuf was used is assigned.
    `delhit' specifies whether a deleted record corresponds or not.
    The return value is 0 if successful, 1 if there is no corresponding record, -1 on error. */
-static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *bip, int *offp,
-                       int *entp, int *head, char *ebuf, int *eep, int delhit){
-  int off, entoff, thash, kcmp;
+static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *bip,
+                       long long *offp, long long *entp, long long *head, char *ebuf, int *eep,
+                       int delhit){
+  long long off, entoff;
+  int thash, kcmp;
   char stkey[DP_STKBUFSIZ], *tkey;
+  const char *rp;
   assert(depot && kbuf && ksiz >= 0 && hash >= 0 && bip && offp && entp && head && ebuf && eep);
   DP_FIRSTHASH(thash, kbuf, ksiz);
   *bip = thash % depot->bnum;
-  off = depot->buckets[*bip];
+  off = DP_GETBUCKET(depot->buckets, depot->large, *bip);
   *offp = -1;
   *entp = -1;
   entoff = -1;
@@ -1937,32 +2745,34 @@ static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *
     if(!dprechead(depot, off, head, ebuf, eep)) return -1;
     thash = head[DP_RHIHASH];
     if(hash > thash){
-      entoff = off + DP_RHILEFT * sizeof(int);
+      entoff = off + DP_RHOFF(depot->large, DP_RHILEFT);
       off = head[DP_RHILEFT];
     } else if(hash < thash){
-      entoff = off + DP_RHIRIGHT * sizeof(int);
+      entoff = off + DP_RHOFF(depot->large, DP_RHIRIGHT);
       off = head[DP_RHIRIGHT];
     } else {
-      if(*eep && DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
-        kcmp = dpkeycmp(kbuf, ksiz, ebuf + (DP_RHNUM * sizeof(int)), head[DP_RHIKSIZ]);
+      if(*eep && DP_RHSIZ(depot->large) + head[DP_RHIKSIZ] <= DP_ENTBUFSIZ){
+        kcmp = dpkeycmp(kbuf, ksiz, ebuf + DP_RHSIZ(depot->large), head[DP_RHIKSIZ]);
+      } else if((rp = dpmapptr(depot, off + DP_RHSIZ(depot->large), head[DP_RHIKSIZ])) != NULL){
+        kcmp = dpkeycmp(kbuf, ksiz, rp, head[DP_RHIKSIZ]);
       } else if(head[DP_RHIKSIZ] > DP_STKBUFSIZ){
         if(!(tkey = dpreckey(depot, off, head))) return -1;
         kcmp = dpkeycmp(kbuf, ksiz, tkey, head[DP_RHIKSIZ]);
         free(tkey);
       } else {
-        if(!dpseekread(depot->fd, off + DP_RHNUM * sizeof(int), stkey, head[DP_RHIKSIZ]))
+        if(!dpioread(depot, off + DP_RHSIZ(depot->large), stkey, head[DP_RHIKSIZ]))
           return -1;
         kcmp = dpkeycmp(kbuf, ksiz, stkey, head[DP_RHIKSIZ]);
       }
       if(kcmp > 0){
-        entoff = off + DP_RHILEFT * sizeof(int);
+        entoff = off + DP_RHOFF(depot->large, DP_RHILEFT);
         off = head[DP_RHILEFT];
       } else if(kcmp < 0){
-        entoff = off + DP_RHIRIGHT * sizeof(int);
+        entoff = off + DP_RHOFF(depot->large, DP_RHIRIGHT);
         off = head[DP_RHIRIGHT];
       } else {
         if(!delhit && (head[DP_RHIFLAGS] & DP_RECFDEL)){
-          entoff = off + DP_RHILEFT * sizeof(int);
+          entoff = off + DP_RHOFF(depot->large, DP_RHILEFT);
           off = head[DP_RHILEFT];
         } else {
           *offp = off;
@@ -1990,19 +2800,21 @@ static int dprecsearch(DEPOT *depot, const char *kbuf, int ksiz, int hash, int *
    `left' specifies the offset of the left child.
    `right' specifies the offset of the right child.
    The return value is true if successful, or, false on failure. */
-static int dprecrewrite(DEPOT *depot, int off, int rsiz, const char *kbuf, int ksiz,
-                        const char *vbuf, int vsiz, int hash, int left, int right){
-  char ebuf[DP_WRTBUFSIZ];
-  int i, head[DP_RHNUM], asiz, hoff, koff, voff, mi, min, size;
+static int dprecrewrite(DEPOT *depot, long long off, int rsiz, const char *kbuf, int ksiz,
+                        const char *vbuf, int vsiz, int hash, long long left, long long right){
+  char ebuf[DP_WRTBUFSIZ], rhbuf[DP_RHSIZ(TRUE)];
+  long long head[DP_RHNUM], hoff, koff, voff, min;
+  int i, hsiz, asiz, mi, size;
   assert(depot && off >= 1 && rsiz > 0 && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  hsiz = DP_RHSIZ(depot->large);
   head[DP_RHIFLAGS] = 0;
   head[DP_RHIHASH] = hash;
   head[DP_RHIKSIZ] = ksiz;
   head[DP_RHIVSIZ] = vsiz;
-  head[DP_RHIPSIZ] = rsiz - sizeof(head) - ksiz - vsiz;
+  head[DP_RHIPSIZ] = rsiz - hsiz - ksiz - vsiz;
   head[DP_RHILEFT] = left;
   head[DP_RHIRIGHT] = right;
-  asiz = sizeof(head) + ksiz + vsiz;
+  asiz = hsiz + ksiz + vsiz;
   if(depot->fbpsiz > DP_FBPOOLSIZ * 4 && head[DP_RHIPSIZ] > asiz){
     rsiz = (head[DP_RHIPSIZ] - asiz) / 2 + asiz;
     head[DP_RHIPSIZ] -= rsiz;
@@ -2010,29 +2822,31 @@ static int dprecrewrite(DEPOT *depot, int off, int rsiz, const char *kbuf, int k
     rsiz = 0;
   }
   if(asiz <= DP_WRTBUFSIZ){
-    memcpy(ebuf, head, sizeof(head));
-    memcpy(ebuf + sizeof(head), kbuf, ksiz);
-    memcpy(ebuf + sizeof(head) + ksiz, vbuf, vsiz);
-    if(!dpseekwrite(depot->fd, off, ebuf, asiz)) return FALSE;
+    dprhencode(depot->large, head, ebuf);
+    memcpy(ebuf + hsiz, kbuf, ksiz);
+    memcpy(ebuf + hsiz + ksiz, vbuf, vsiz);
+    if(!dpiowrite(depot, off, ebuf, asiz)) return FALSE;
   } else {
+    dprhencode(depot->large, head, rhbuf);
     hoff = off;
-    koff = hoff + sizeof(head);
+    koff = hoff + hsiz;
     voff = koff + ksiz;
-    if(!dpseekwrite(depot->fd, hoff, head, sizeof(head)) ||
-       !dpseekwrite(depot->fd, koff, kbuf, ksiz) || !dpseekwrite(depot->fd, voff, vbuf, vsiz))
+    if(!dpiowrite(depot, hoff, rhbuf, hsiz) ||
+       !dpiowrite(depot, koff, kbuf, ksiz) || !dpiowrite(depot, voff, vbuf, vsiz))
       return FALSE;
   }
   if(rsiz > 0){
-    off += sizeof(head) + ksiz + vsiz + head[DP_RHIPSIZ];
+    off += hsiz + ksiz + vsiz + head[DP_RHIPSIZ];
     head[DP_RHIFLAGS] = DP_RECFDEL | DP_RECFREUSE;
     head[DP_RHIHASH] = hash;
     head[DP_RHIKSIZ] = ksiz;
     head[DP_RHIVSIZ] = vsiz;
-    head[DP_RHIPSIZ] = rsiz - sizeof(head) - ksiz - vsiz;
+    head[DP_RHIPSIZ] = rsiz - hsiz - ksiz - vsiz;
     head[DP_RHILEFT] = 0;
     head[DP_RHIRIGHT] = 0;
-    if(!dpseekwrite(depot->fd, off, head, sizeof(head))) return FALSE;
-    size = dprecsize(head);
+    dprhencode(depot->large, head, rhbuf);
+    if(!dpiowrite(depot, off, rhbuf, hsiz)) return FALSE;
+    size = dprecsize(depot->large, head);
     mi = -1;
     min = -1;
     for(i = 0; i < depot->fbpsiz; i += 2){
@@ -2058,6 +2872,28 @@ static int dprecrewrite(DEPOT *depot, int off, int rsiz, const char *kbuf, int k
 }
 
 
+/* Check whether a record can be written at the end of a database file.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the record to be extended, or -1 to append a new one.
+   `ksiz' specifies the size of the key.
+   `vsiz' specifies the size of the value.
+   The return value is true if the record fits, else, it is false.
+   A file which is not large can not grow beyond the range of 32-bit offsets.  This is checked
+   before anything is modified, so the handle is still usable when the record does not fit. */
+static int dprecfits(DEPOT *depot, long long off, int ksiz, int vsiz){
+  long long end;
+  assert(depot && ksiz >= 0 && vsiz >= 0);
+  if(depot->large) return TRUE;
+  end = DP_RHSIZ(depot->large) + ksiz + vsiz;
+  end += off >= 0 ? off : depot->fsiz + dppadsize(depot, ksiz, vsiz);
+  if(end > INT_MAX){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
 /* Write a record at the end of a database file.
    `depot' specifies a database handle.
    `kbuf' specifies the pointer to the region of a key.
@@ -2067,12 +2903,15 @@ static int dprecrewrite(DEPOT *depot, int off, int rsiz, const char *kbuf, int k
    `hash' specifies the second hash value of the key.
    `left' specifies the offset of the left child.
    `right' specifies the offset of the right child.
-   The return value is the offset of the record, or, -1 on failure. */
-static int dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
-                       int hash, int left, int right){
+   The return value is the offset of the record, or, -1 on failure.
+   A file which is not large can not grow beyond the range of 32-bit offsets. */
+static long long dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
+                             int hash, long long left, long long right){
   char ebuf[DP_WRTBUFSIZ], *hbuf;
-  int head[DP_RHNUM], asiz, psiz, off;
+  long long head[DP_RHNUM], off;
+  int hsiz, asiz, psiz;
   assert(depot && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  hsiz = DP_RHSIZ(depot->large);
   psiz = dppadsize(depot, ksiz, vsiz);
   head[DP_RHIFLAGS] = 0;
   head[DP_RHIHASH] = hash;
@@ -2081,24 +2920,28 @@ static int dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbu
   head[DP_RHIPSIZ] = psiz;
   head[DP_RHILEFT] = left;
   head[DP_RHIRIGHT] = right;
-  asiz = sizeof(head) + ksiz + vsiz + psiz;
+  asiz = hsiz + ksiz + vsiz + psiz;
   off = depot->fsiz;
+  if(!depot->large && off + asiz > INT_MAX){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return -1;
+  }
   if(asiz <= DP_WRTBUFSIZ){
-    memcpy(ebuf, head, sizeof(head));
-    memcpy(ebuf + sizeof(head), kbuf, ksiz);
-    memcpy(ebuf + sizeof(head) + ksiz, vbuf, vsiz);
-    memset(ebuf + sizeof(head) + ksiz + vsiz, 0, psiz);
-    if(!dpseekwrite(depot->fd, off, ebuf, asiz)) return -1;
+    dprhencode(depot->large, head, ebuf);
+    memcpy(ebuf + hsiz, kbuf, ksiz);
+    memcpy(ebuf + hsiz + ksiz, vbuf, vsiz);
+    memset(ebuf + hsiz + ksiz + vsiz, 0, psiz);
+    if(!dpiowrite(depot, off, ebuf, asiz)) return -1;
   } else {
     if(!(hbuf = malloc(asiz))){
       dpecodeset(DP_EALLOC, __FILE__, __LINE__);
       return -1;
     }
-    memcpy(hbuf, head, sizeof(head));
-    memcpy(hbuf + sizeof(head), kbuf, ksiz);
-    memcpy(hbuf + sizeof(head) + ksiz, vbuf, vsiz);
-    memset(hbuf + sizeof(head) + ksiz + vsiz, 0, psiz);
-    if(!dpseekwrite(depot->fd, off, hbuf, asiz)){
+    dprhencode(depot->large, head, hbuf);
+    memcpy(hbuf + hsiz, kbuf, ksiz);
+    memcpy(hbuf + hsiz + ksiz, vbuf, vsiz);
+    memset(hbuf + hsiz + ksiz + vsiz, 0, psiz);
+    if(!dpiowrite(depot, off, hbuf, asiz)){
       free(hbuf);
       return -1;
     }
@@ -2113,13 +2956,22 @@ static int dprecappend(DEPOT *depot, const char *kbuf, int ksiz, const char *vbu
    `depot' specifies a database handle.
    `off' specifies the offset of the database file.
    `head' specifies the header of the record.
+   `kbuf' specifies the pointer to the region of the key of the record.
+   `ksiz' specifies the size of the region.
    `vbuf' specifies the pointer to the region of a value.
    `vsiz' specifies the size of the region.
    `cat' specifies whether it is concatenate mode or not.
-   The return value is true if successful, or, false on failure. */
-static int dprecover(DEPOT *depot, int off, int *head, const char *vbuf, int vsiz, int cat){
-  int i, hsiz, hoff, voff;
-  assert(depot && off >= 0 && head && vbuf && vsiz >= 0);
+   The return value is true if successful, or, false on failure.
+   Unless concatenating, the header, the key and the value are written as one region.  While
+   writes are queued, the padding is cleared in the same region, so that records overwritten
+   side by side are gathered into one run when the queue is submitted. */
+static int dprecover(DEPOT *depot, long long off, long long *head, const char *kbuf, int ksiz,
+                     const char *vbuf, int vsiz, int cat){
+  char ebuf[DP_WRTBUFSIZ], rhbuf[DP_RHSIZ(TRUE)];
+  long long hoff, voff;
+  int i, hsiz, asiz, psiz;
+  assert(depot && off >= 0 && head && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  hsiz = DP_RHSIZ(depot->large);
   for(i = 0; i < depot->fbpsiz; i += 2){
     if(depot->fbpool[i] == off){
       depot->fbpool[i] = -1;
@@ -2131,19 +2983,28 @@ static int dprecover(DEPOT *depot, int off, int *head, const char *vbuf, int vsi
     head[DP_RHIFLAGS] = 0;
     head[DP_RHIPSIZ] -= vsiz;
     head[DP_RHIVSIZ] += vsiz;
-    hsiz = DP_RHNUM * sizeof(int);
     hoff = off;
-    voff = hoff + DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] - vsiz;
+    voff = hoff + hsiz + head[DP_RHIKSIZ] + head[DP_RHIVSIZ] - vsiz;
   } else {
     head[DP_RHIFLAGS] = 0;
     head[DP_RHIPSIZ] += head[DP_RHIVSIZ] - vsiz;
     head[DP_RHIVSIZ] = vsiz;
-    hsiz = DP_RHNUM * sizeof(int);
     hoff = off;
-    voff = hoff + DP_RHNUM * sizeof(int) + head[DP_RHIKSIZ];
+    voff = hoff + hsiz + head[DP_RHIKSIZ];
+    asiz = hsiz + ksiz + vsiz;
+    psiz = depot->aio && ((DPAIO *)depot->aio)->batch > 0 ? head[DP_RHIPSIZ] : 0;
+    if(asiz + psiz > DP_WRTBUFSIZ) psiz = 0;
+    if(asiz + psiz <= DP_WRTBUFSIZ){
+      dprhencode(depot->large, head, ebuf);
+      memcpy(ebuf + hsiz, kbuf, ksiz);
+      memcpy(ebuf + hsiz + ksiz, vbuf, vsiz);
+      memset(ebuf + asiz, 0, psiz);
+      return dpiowrite(depot, off, ebuf, asiz + psiz);
+    }
   }
-  if(!dpseekwrite(depot->fd, hoff, head, hsiz) ||
-     !dpseekwrite(depot->fd, voff, vbuf, vsiz)) return FALSE;
+  dprhencode(depot->large, head, rhbuf);
+  if(!dpiowrite(depot, hoff, rhbuf, hsiz) ||
+     !dpiowrite(depot, voff, vbuf, vsiz)) return FALSE;
   return TRUE;
 }
 
@@ -2154,11 +3015,12 @@ static int dprecover(DEPOT *depot, int off, int *head, const char *vbuf, int vsi
    `head' specifies the header of the record.
    `reusable' specifies whether the region is reusable or not.
    The return value is true if successful, or, false on failure. */
-static int dprecdelete(DEPOT *depot, int off, int *head, int reusable){
-  int i, mi, min, size;
+static int dprecdelete(DEPOT *depot, long long off, long long *head, int reusable){
+  long long min;
+  int i, mi, size, flags;
   assert(depot && off >= 0 && head);
   if(reusable){
-    size = dprecsize(head);
+    size = dprecsize(depot->large, head);
     mi = -1;
     min = -1;
     for(i = 0; i < depot->fbpsiz; i += 2){
@@ -2180,8 +3042,49 @@ static int dprecdelete(DEPOT *depot, int off, int *head, int reusable){
       dpfbpoolcoal(depot);
     }
   }
-  return dpseekwritenum(depot->fd, off + DP_RHIFLAGS * sizeof(int),
-                        DP_RECFDEL | (reusable ? DP_RECFREUSE : 0));
+  flags = DP_RECFDEL | (reusable ? DP_RECFREUSE : 0);
+  return dpiowrite(depot, off + DP_RHOFF(depot->large, DP_RHIFLAGS), &flags, sizeof(int));
+}
+
+
+/* Check whether a record is linked from the hash chain.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the record.
+   `head' specifies the header of the record.
+   `bip' specifies the pointer to the region to assign the index of the bucket.
+   `entp' specifies the pointer to the region to assign the offset of the joint referring to the
+   record, or, -1 if the bucket refers to it.
+   The return value is 1 if the record is linked, 0 if it is a dispensable region, or -1 on
+   error.  A deleted record which has not been reused is still linked and should be kept. */
+static int dpreclive(DEPOT *depot, long long off, long long *head, int *bip, long long *entp){
+  long long thead[DP_RHNUM], toff;
+  int hash, ee, rv;
+  char ebuf[DP_ENTBUFSIZ], *kbuf;
+  assert(depot && off >= 0 && head && bip && entp);
+  if(head[DP_RHIFLAGS] & DP_RECFREUSE) return 0;
+  if(!(kbuf = dpreckey(depot, off, head))) return -1;
+  DP_SECONDHASH(hash, kbuf, head[DP_RHIKSIZ]);
+  rv = dprecsearch(depot, kbuf, head[DP_RHIKSIZ], hash, bip, &toff, entp, thead, ebuf, &ee, TRUE);
+  free(kbuf);
+  if(rv == -1) return -1;
+  return rv == 0 && toff == off;
+}
+
+
+/* Remove the records of the free block pool overlapping a region.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the region.
+   `size' specifies the size of the region. */
+static void dpfbpoolout(DEPOT *depot, long long off, long long size){
+  int i;
+  assert(depot && off >= 0 && size >= 0);
+  for(i = 0; i < depot->fbpsiz; i += 2){
+    if(depot->fbpool[i] != -1 && depot->fbpool[i] < off + size &&
+       depot->fbpool[i] + depot->fbpool[i+1] > off){
+      depot->fbpool[i] = -1;
+      depot->fbpool[i+1] = -1;
+    }
+  }
 }
 
 
@@ -2192,7 +3095,7 @@ static void dpfbpoolcoal(DEPOT *depot){
   assert(depot);
   if(depot->fbpinc++ <= depot->fbpsiz / 4) return;
   depot->fbpinc = 0;
-  qsort(depot->fbpool, depot->fbpsiz / 2, sizeof(int) * 2, dpfbpoolcmp);
+  qsort(depot->fbpool, depot->fbpsiz / 2, sizeof(long long) * 2, dpfbpoolcmp);
   for(i = 2; i < depot->fbpsiz; i += 2){
     if(depot->fbpool[i-2] > 0 &&
        depot->fbpool[i-2] + depot->fbpool[i-1] - depot->fbpool[i] == 0){
@@ -2211,7 +3114,592 @@ static void dpfbpoolcoal(DEPOT *depot){
    The return value is 0 if two equals, positive if the formar is big, else, negative. */
 static int dpfbpoolcmp(const void *a, const void *b){
   assert(a && b);
-  return *(int *)a - *(int *)b;
+  if(*(long long *)a < *(long long *)b) return -1;
+  return *(long long *)a > *(long long *)b;
+}
+
+
+/* Create an engine of asynchronous I/O.
+   `depth' specifies the max number of requests submitted at once.
+   `engine' specifies the preferred engine.
+   The return value is the engine, or, `NULL' on failure.
+   An engine which is not available is replaced with the next one. */
+static DPAIO *dpaioopen(int depth, int engine){
+  DPAIO *aio;
+  assert(depth > 0);
+  if(!(aio = malloc(sizeof(DPAIO)))) return NULL;
+  if(!(aio->reqs = malloc(depth * sizeof(DPAIOREQ)))){
+    free(aio);
+    return NULL;
+  }
+  aio->depth = depth;
+  aio->batch = 0;
+  aio->num = 0;
+  aio->cap = depth;
+  aio->qsiz = 0;
+  aio->lo = 0;
+  aio->hi = 0;
+  aio->fend = 0;
+  aio->mutex = NULL;
+  aio->fnum = 0;
+  aio->wnum = 0;
+  aio->cnum = 0;
+  aio->fsum = 0.0;
+  aio->lsiz = 0;
+  if(engine == DP_AIOURING){
+#if _qdbm_uring
+    if(!dpaioringopen(aio)) engine = DP_AIOTHREAD;
+#else
+    engine = DP_AIOTHREAD;
+#endif
+  }
+  if(engine == DP_AIOTHREAD && !_qdbm_ptsafe) engine = DP_AIOSYNC;
+  if(engine != DP_AIOURING && engine != DP_AIOTHREAD) engine = DP_AIOSYNC;
+  aio->engine = engine;
+  return aio;
+}
+
+
+/* Release an engine of asynchronous I/O.
+   `aio' specifies an engine whose queue is empty. */
+static void dpaioclose(DPAIO *aio){
+  assert(aio);
+#if _qdbm_uring
+  if(aio->engine == DP_AIOURING){
+    munmap(aio->sqes, aio->sqesiz);
+    if(aio->cqmap != aio->sqmap) munmap(aio->cqmap, aio->cqmsiz);
+    munmap(aio->sqmap, aio->sqmsiz);
+    close(aio->rfd);
+  }
+#endif
+#if defined(MYPTHREAD)
+  if(aio->mutex){
+    pthread_mutex_destroy(aio->mutex);
+    free(aio->mutex);
+  }
+#endif
+  free(aio->reqs);
+  free(aio);
+}
+
+
+#if _qdbm_uring
+
+/* Set up a ring of io_uring for an engine of asynchronous I/O.
+   `aio' specifies an engine.
+   The return value is true if successful, else, it is false.
+   The ring is driven with raw system calls so that no helper library is required. */
+static int dpaioringopen(DPAIO *aio){
+  struct io_uring_params params;
+  char *sqmap, *cqmap, *sqes;
+  int rfd, single;
+  assert(aio);
+  memset(&params, 0, sizeof(params));
+  if((rfd = syscall(__NR_io_uring_setup, aio->depth < DP_AIORINGMAX ? aio->depth : DP_AIORINGMAX,
+                    &params)) == -1) return FALSE;
+  aio->sqmsiz = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  aio->cqmsiz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  single = FALSE;
+#if defined(IORING_FEAT_SINGLE_MMAP)
+  if(params.features & IORING_FEAT_SINGLE_MMAP){
+    single = TRUE;
+    if(aio->cqmsiz > aio->sqmsiz) aio->sqmsiz = aio->cqmsiz;
+    aio->cqmsiz = aio->sqmsiz;
+  }
+#endif
+  if((sqmap = mmap(0, aio->sqmsiz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   rfd, IORING_OFF_SQ_RING)) == MAP_FAILED){
+    close(rfd);
+    return FALSE;
+  }
+  if(single){
+    cqmap = sqmap;
+  } else if((cqmap = mmap(0, aio->cqmsiz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          rfd, IORING_OFF_CQ_RING)) == MAP_FAILED){
+    munmap(sqmap, aio->sqmsiz);
+    close(rfd);
+    return FALSE;
+  }
+  aio->sqesiz = params.sq_entries * sizeof(struct io_uring_sqe);
+  if((sqes = mmap(0, aio->sqesiz, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  rfd, IORING_OFF_SQES)) == MAP_FAILED){
+    if(cqmap != sqmap) munmap(cqmap, aio->cqmsiz);
+    munmap(sqmap, aio->sqmsiz);
+    close(rfd);
+    return FALSE;
+  }
+#if defined(MYPTHREAD)
+  if(!(aio->mutex = malloc(sizeof(pthread_mutex_t))) ||
+     pthread_mutex_init(aio->mutex, NULL) != 0){
+    free(aio->mutex);
+    aio->mutex = NULL;
+    munmap(sqes, aio->sqesiz);
+    if(cqmap != sqmap) munmap(cqmap, aio->cqmsiz);
+    munmap(sqmap, aio->sqmsiz);
+    close(rfd);
+    return FALSE;
+  }
+#endif
+  aio->rfd = rfd;
+  aio->rnum = params.sq_entries;
+  aio->sqhead = (unsigned int *)(sqmap + params.sq_off.head);
+  aio->sqtail = (unsigned int *)(sqmap + params.sq_off.tail);
+  aio->sqmask = (unsigned int *)(sqmap + params.sq_off.ring_mask);
+  aio->sqarray = (unsigned int *)(sqmap + params.sq_off.array);
+  aio->cqhead = (unsigned int *)(cqmap + params.cq_off.head);
+  aio->cqtail = (unsigned int *)(cqmap + params.cq_off.tail);
+  aio->cqmask = (unsigned int *)(cqmap + params.cq_off.ring_mask);
+  aio->sqes = (struct io_uring_sqe *)sqes;
+  aio->cqes = (struct io_uring_cqe *)(cqmap + params.cq_off.cqes);
+  aio->sqmap = sqmap;
+  aio->cqmap = cqmap;
+  return TRUE;
+}
+
+
+/* Perform requests of asynchronous I/O with io_uring.
+   `depot' specifies a database handle.
+   `runs' specifies an array of runs of requests.
+   `num' specifies the number of the runs.
+   `write' specifies whether to write or to read.
+   The return value is true if successful, else, it is false.
+   Each run is submitted as one vectored request.  Runs are submitted by the chunk of the size of
+   the ring and each chunk is waited for.  A run completed partly is completed with blocking
+   calls.  If the kernel refuses a submission, the entries it did not consume are taken back, the
+   requests in flight are reaped, and the rest of the runs are performed with blocking calls.  If
+   the requests in flight can not be reaped, the ring is not used any longer. */
+static int dpaioring(DEPOT *depot, DPAIORUN *runs, int num, int write){
+  DPAIO *aio;
+  DPAIORUN *run;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+  struct iovec *iovs, *iov;
+  unsigned int tail, head, idx;
+  int i, j, k, cnum, sub, done, rv, res, fb, err, dead;
+  assert(depot && runs && num >= 0);
+  aio = depot->aio;
+  for(i = 0, k = 0; i < num; i++){
+    k += runs[i].num;
+  }
+  if(!(iovs = malloc(k * sizeof(struct iovec) + 1))){
+    dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+    return FALSE;
+  }
+#if defined(MYPTHREAD)
+  pthread_mutex_lock(aio->mutex);
+#endif
+  err = FALSE;
+  dead = FALSE;
+  fb = aio->rnum > 0 ? num : 0;
+  iov = iovs;
+  for(i = 0; i < fb && !err; i += cnum){
+    cnum = num - i < (int)aio->rnum ? num - i : (int)aio->rnum;
+    tail = *aio->sqtail;
+    for(j = 0; j < cnum; j++){
+      run = runs + i + j;
+      idx = (tail + j) & *aio->sqmask;
+      sqe = aio->sqes + idx;
+      memset(sqe, 0, sizeof(struct io_uring_sqe));
+      sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe->fd = depot->fd;
+      sqe->off = run->off;
+      for(k = 0; k < run->num; k++){
+        iov[k].iov_base = run->reqs[k].buf;
+        iov[k].iov_len = run->reqs[k].size;
+      }
+      sqe->addr = (unsigned long)iov;
+      sqe->len = run->num;
+      sqe->user_data = i + j;
+      aio->sqarray[idx] = idx;
+      iov += run->num;
+    }
+    __atomic_store_n(aio->sqtail, tail + cnum, __ATOMIC_RELEASE);
+    sub = 0;
+    done = 0;
+    while(done < cnum){
+      DP_SYSCOUNT();
+      rv = syscall(__NR_io_uring_enter, aio->rfd, cnum - sub, cnum - done,
+                   IORING_ENTER_GETEVENTS, NULL, 0);
+      if(rv == -1){
+        if(errno == EINTR) continue;
+        if(sub < cnum){
+          /* take back the entries not consumed and leave them to blocking calls */
+          sub = __atomic_load_n(aio->sqhead, __ATOMIC_ACQUIRE) - tail;
+          __atomic_store_n(aio->sqtail, tail + sub, __ATOMIC_RELEASE);
+          fb = i + sub;
+          cnum = sub;
+          continue;
+        }
+        /* the vectors of the requests in flight are kept as the kernel may still refer them */
+        dpecodeset(write ? DP_EWRITE : DP_EREAD, __FILE__, __LINE__);
+        aio->rnum = 0;
+        dead = TRUE;
+        err = TRUE;
+        break;
+      }
+      sub += rv;
+      head = *aio->cqhead;
+      while(head != __atomic_load_n(aio->cqtail, __ATOMIC_ACQUIRE)){
+        cqe = aio->cqes + (head & *aio->cqmask);
+        run = runs + cqe->user_data;
+        res = cqe->res;
+        if(res < 0){
+          dpecodeset(write ? DP_EWRITE : DP_EREAD, __FILE__, __LINE__);
+          err = TRUE;
+        } else if(res < run->size){
+          if(!dpaiorunio(depot->fd, run, res, write)) err = TRUE;
+        }
+        head++;
+        done++;
+      }
+      __atomic_store_n(aio->cqhead, head, __ATOMIC_RELEASE);
+    }
+  }
+  for(i = fb; i < num && !err; i++){
+    if(!dpaiorunio(depot->fd, runs + i, 0, write)) err = TRUE;
+  }
+#if defined(MYPTHREAD)
+  pthread_mutex_unlock(aio->mutex);
+#endif
+  if(!dead) free(iovs);
+  return err ? FALSE : TRUE;
+}
+
+#endif
+
+
+#if defined(MYPTHREAD)
+
+/* Perform a job of a helper thread.
+   `arg' specifies the job.
+   The return value is always `NULL'. */
+static void *dpaiojob(void *arg){
+  DPAIOJOB *job;
+  int i;
+  assert(arg);
+  job = arg;
+  for(i = job->first; i < job->num; i += job->step){
+    if(!dpaiorunio(job->fd, job->runs + i, 0, job->write)){
+      job->err = TRUE;
+      break;
+    }
+  }
+  return NULL;
+}
+
+#endif
+
+
+/* Perform a run of requests with blocking calls.
+   `fd' specifies a file descriptor.
+   `run' specifies a run of requests.
+   `done' specifies the size of the leading part of the run already performed.
+   `write' specifies whether to write or to read.
+   The return value is true if successful, else, it is false.
+   A whole run of more than one request is performed with one vectored call if available. */
+static int dpaiorunio(int fd, DPAIORUN *run, int done, int write){
+#if _qdbm_vecio
+  struct iovec iovs[DP_AIOIOVMAX];
+  int rv;
+#endif
+  DPAIOREQ *req;
+  long long off;
+  int i;
+  assert(fd >= 0 && run && done >= 0);
+#if _qdbm_vecio
+  if(done < 1 && run->num > 1 && run->num <= DP_AIOIOVMAX){
+    for(i = 0; i < run->num; i++){
+      iovs[i].iov_base = run->reqs[i].buf;
+      iovs[i].iov_len = run->reqs[i].size;
+    }
+    do {
+      DP_SYSCOUNT();
+      rv = write ? pwritev(fd, iovs, run->num, run->off) : preadv(fd, iovs, run->num, run->off);
+    } while(rv == -1 && errno == EINTR);
+    if(rv == -1){
+      dpecodeset(write ? DP_EWRITE : DP_EREAD, __FILE__, __LINE__);
+      return FALSE;
+    }
+    done = rv;
+  }
+#endif
+  off = run->off;
+  for(i = 0; i < run->num; i++){
+    req = run->reqs + i;
+    if(done >= req->size){
+      done -= req->size;
+      off += req->size;
+      continue;
+    }
+    if(write ? !dpseekwrite(fd, off + done, req->buf + done, req->size - done) :
+       !dpseekread(fd, off + done, req->buf + done, req->size - done)) return FALSE;
+    off += req->size;
+    done = 0;
+  }
+  return TRUE;
+}
+
+
+/* Perform requests of asynchronous I/O and wait for them.
+   `depot' specifies a database handle whose engine is enabled.
+   `runs' specifies an array of runs of requests.
+   `num' specifies the number of the runs.
+   `write' specifies whether to write or to read.
+   The return value is true if successful, else, it is false. */
+static int dpaiosubmit(DEPOT *depot, DPAIORUN *runs, int num, int write){
+#if defined(MYPTHREAD)
+  DPAIOJOB jobs[DP_AIOTHNUM];
+  pthread_t ths[DP_AIOTHNUM];
+  int created[DP_AIOTHNUM], tnum, err;
+#endif
+  int i;
+  assert(depot && depot->aio && runs && num >= 0);
+  switch(((DPAIO *)depot->aio)->engine){
+#if _qdbm_uring
+  case DP_AIOURING:
+    return dpaioring(depot, runs, num, write);
+#endif
+#if defined(MYPTHREAD)
+  case DP_AIOTHREAD:
+    if(num < 2) break;
+    tnum = num < DP_AIOTHNUM ? num : DP_AIOTHNUM;
+    for(i = 0; i < tnum; i++){
+      jobs[i].fd = depot->fd;
+      jobs[i].runs = runs;
+      jobs[i].num = num;
+      jobs[i].first = i;
+      jobs[i].step = tnum;
+      jobs[i].write = write;
+      jobs[i].err = FALSE;
+      created[i] = pthread_create(ths + i, NULL, dpaiojob, jobs + i) == 0;
+      if(!created[i]) dpaiojob(jobs + i);
+    }
+    err = FALSE;
+    for(i = 0; i < tnum; i++){
+      if(created[i]) pthread_join(ths[i], NULL);
+      if(jobs[i].err) err = TRUE;
+    }
+    if(err){
+      dpecodeset(write ? DP_EWRITE : DP_EREAD, __FILE__, __LINE__);
+      return FALSE;
+    }
+    return TRUE;
+#endif
+  default:
+    break;
+  }
+  for(i = 0; i < num; i++){
+    if(!dpaiorunio(depot->fd, runs + i, 0, write)) return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Compare two requests of asynchronous I/O by the offset.
+   `a' specifies the pointer to one request.
+   `b' specifies the pointer to the other request.
+   The return value is positive if the former is big, negative if the latter is big, 0 if both
+   are equivalent. */
+static int dpaioreqcmp(const void *a, const void *b){
+  long long aoff, boff;
+  assert(a && b);
+  aoff = ((DPAIOREQ *)a)->off;
+  boff = ((DPAIOREQ *)b)->off;
+  return aoff > boff ? 1 : (aoff < boff ? -1 : 0);
+}
+
+
+/* Submit the queued writes of a database handle.
+   `depot' specifies a database handle.
+   The return value is true if successful, else, it is false.
+   The queued writes are sorted by the offset and adjacent ones are gathered into a run, so that
+   the file is written sequentially with as few calls as possible. */
+static int dpaioflush(DEPOT *depot){
+  DPAIO *aio;
+  DPAIORUN *runs, *run;
+  DPAIOREQ *req;
+  int i, rnum, err;
+  assert(depot);
+  aio = depot->aio;
+  if(!aio || aio->num < 1) return TRUE;
+  err = FALSE;
+  if(aio->num > 1) qsort(aio->reqs, aio->num, sizeof(DPAIOREQ), dpaioreqcmp);
+  if((runs = malloc(aio->num * sizeof(DPAIORUN))) != NULL){
+    rnum = 0;
+    run = NULL;
+    for(i = 0; i < aio->num; i++){
+      req = aio->reqs + i;
+      if(run && run->off + run->size == req->off && run->num < DP_AIOIOVMAX){
+        run->num++;
+        run->size += req->size;
+      } else {
+        run = runs + rnum++;
+        run->off = req->off;
+        run->reqs = req;
+        run->num = 1;
+        run->size = req->size;
+      }
+    }
+    err = !dpaiosubmit(depot, runs, rnum, TRUE);
+    free(runs);
+    aio->fnum++;
+    aio->wnum += aio->num;
+    aio->cnum += rnum;
+    aio->fsum += aio->qsiz;
+    aio->lsiz = aio->qsiz;
+  } else {
+    dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+    err = TRUE;
+  }
+  for(i = 0; i < aio->num; i++){
+    free(aio->reqs[i].buf);
+  }
+  aio->num = 0;
+  aio->qsiz = 0;
+  if(err){
+    depot->fatal = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Check whether a region of a database file overlaps the queued writes.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the region.
+   `size' specifies the size of the region.
+   The return value is true if it overlaps, else, it is false. */
+static int dpaiooverlap(DEPOT *depot, long long off, int size){
+  DPAIO *aio;
+  assert(depot && off >= 0 && size >= 0);
+  aio = depot->aio;
+  return aio && aio->num > 0 && off < aio->hi && off + size > aio->lo;
+}
+
+
+/* Write into a database file at an offset through the queue of writes.
+   `depot' specifies a database handle.
+   `off' specifies an offset of the file.
+   `buf' specifies a buffer to write.
+   `size' specifies the size of the buffer.
+   The return value is true if successful, else, it is false.
+   Unless queuing is begun, the region is written at once. */
+static int dpiowrite(DEPOT *depot, long long off, const void *buf, int size){
+  DPAIO *aio;
+  DPAIOREQ *req;
+  char *tbuf;
+  int i, hit, asiz;
+  assert(depot && off >= 0 && buf && size >= 0);
+  aio = depot->aio;
+  if(!aio || aio->batch < 1) return dpseekwrite(depot->fd, off, buf, size);
+  if(size < 1) return TRUE;
+  if(dpaiooverlap(depot, off, size)){
+    hit = FALSE;
+    for(i = aio->num - 1; i >= 0; i--){
+      req = aio->reqs + i;
+      if(off >= req->off && off + size <= req->off + req->size){
+        memcpy(req->buf + (off - req->off), buf, size);
+        return TRUE;
+      }
+      if(off < req->off + req->size && off + size > req->off){
+        hit = TRUE;
+        break;
+      }
+    }
+    if(hit && !dpaioflush(depot)) return FALSE;
+  }
+  req = aio->num > 0 ? aio->reqs + aio->num - 1 : NULL;
+  if(req && req->off + req->size == off && req->size + size <= DP_AIOREQMAX){
+    if(req->size + size > req->asiz){
+      asiz = (req->size + size) * 2;
+      if(asiz > DP_AIOREQMAX) asiz = DP_AIOREQMAX;
+      if(!(tbuf = realloc(req->buf, asiz))){
+        dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+        return FALSE;
+      }
+      req->buf = tbuf;
+      req->asiz = asiz;
+    }
+    memcpy(req->buf + req->size, buf, size);
+    req->size += size;
+  } else {
+    if(aio->num >= aio->cap){
+      if(aio->cap < DP_AIOQUEMAX){
+        asiz = aio->cap * 2 < DP_AIOQUEMAX ? aio->cap * 2 : DP_AIOQUEMAX;
+        if(!(req = realloc(aio->reqs, asiz * sizeof(DPAIOREQ)))){
+          dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+          return FALSE;
+        }
+        aio->reqs = req;
+        aio->cap = asiz;
+      } else if(!dpaioflush(depot)){
+        return FALSE;
+      }
+    }
+    if(!(tbuf = malloc(size))){
+      dpecodeset(DP_EALLOC, __FILE__, __LINE__);
+      return FALSE;
+    }
+    memcpy(tbuf, buf, size);
+    if(aio->num < 1){
+      aio->lo = off;
+      aio->hi = off + size;
+      aio->fend = depot->fsiz;
+    }
+    req = aio->reqs + aio->num++;
+    req->off = off;
+    req->buf = tbuf;
+    req->size = size;
+    req->asiz = size;
+  }
+  if(off < aio->lo) aio->lo = off;
+  if(off + size > aio->hi) aio->hi = off + size;
+  aio->qsiz += size;
+  if(aio->qsiz >= DP_AIOBUFMAX) return dpaioflush(depot);
+  return TRUE;
+}
+
+
+/* Write an offset into a database file through the queue of writes.
+   `depot' specifies a database handle.
+   `off' specifies an offset of the file.
+   `num' specifies an offset to be written.
+   The return value is true if successful, else, it is false. */
+static int dpiowriteoff(DEPOT *depot, long long off, long long num){
+  int lnum;
+  assert(depot && off >= 0);
+  if(depot->large) return dpiowrite(depot, off, &num, sizeof(long long));
+  lnum = num;
+  return dpiowrite(depot, off, &lnum, sizeof(int));
+}
+
+
+/* Read from a database file at an offset seeing the queued writes.
+   `depot' specifies a database handle.
+   `off' specifies an offset of the file.
+   `buf' specifies a buffer to store into.
+   `size' specifies the size to read with.
+   The return value is true if successful, else, it is false.
+   The part of the region beyond the end of the file is not read but filled by the queued
+   writes. */
+static int dpioread(DEPOT *depot, long long off, void *buf, int size){
+  DPAIO *aio;
+  DPAIOREQ *req;
+  long long beg, end;
+  int i, rsiz;
+  assert(depot && off >= 0 && buf && size >= 0);
+  if(!dpaiooverlap(depot, off, size)) return dpseekread(depot->fd, off, buf, size);
+  aio = depot->aio;
+  rsiz = off < aio->fend ? (aio->fend - off < size ? aio->fend - off : size) : 0;
+  if(rsiz > 0 && !dpseekread(depot->fd, off, buf, rsiz)) return FALSE;
+  if(rsiz < size) memset((char *)buf + rsiz, 0, size - rsiz);
+  for(i = 0; i < aio->num; i++){
+    req = aio->reqs + i;
+    beg = req->off > off ? req->off : off;
+    end = req->off + req->size < off + size ? req->off + req->size : off + size;
+    if(beg < end) memcpy((char *)buf + (beg - off), req->buf + (beg - req->off), end - beg);
+  }
+  return TRUE;
 }
 
 
@@ -45,18 +45,24 @@ typedef struct {                         /* type of structure for a database han
   int inode;                             /* inode of the database file */
   time_t mtime;                          /* last modified time of the database */
   int fd;                                /* file descriptor of the database file */
-  int fsiz;                              /* size of the database file */
+  long long fsiz;                        /* size of the database file */
   char *map;                             /* pointer to the mapped memory */
-  int msiz;                              /* size of the mapped memory */
-  int *buckets;                          /* pointer to the bucket array */
+  long long msiz;                        /* size of the mapped memory */
+  void *buckets;                         /* pointer to the bucket array */
   int bnum;                              /* number of the bucket array */
   int rnum;                              /* number of records */
+  int large;                             /* whether offsets are of 64 bits */
+  int mapall;                            /* whether the whole file is mapped */
   int fatal;                             /* whether a fatal error occured */
-  int ioff;                              /* offset of the iterator */
-  int *fbpool;                           /* free block pool */
+  long long ioff;                        /* offset of the iterator */
+  long long coff;                        /* offset of the cursor of incremental compaction */
+  long long *fbpool;                     /* free block pool */
   int fbpsiz;                            /* size of the free block pool */
   int fbpinc;                            /* incrementor of update of the free block pool */
   int align;                             /* basic size of alignment */
+  void *aio;                             /* engine of asynchronous I/O or `NULL' */
+  long long loff;                        /* offset of the record stored last or -1 */
+  int lsiz;                              /* size of the record stored last */
 } DEPOT;
 
 enum {                                   /* enumeration for error codes */
@@ -90,7 +96,9 @@ enum {                                   /* enumeration for open modes */
   DP_OTRUNC = 1 << 3,                    /* a writer truncating */
   DP_ONOLCK = 1 << 4,                    /* open without locking */
   DP_OLCKNB = 1 << 5,                    /* lock without blocking */
-  DP_OSPARSE = 1 << 6                    /* create as a sparse file */
+  DP_OSPARSE = 1 << 6,                   /* create as a sparse file */
+  DP_OLARGE = 1 << 7,                    /* create as a large file */
+  DP_OMAPALL = 1 << 8                    /* map the whole file */
 };
 
 enum {                                   /* enumeration for write modes */
@@ -99,6 +107,13 @@ enum {                                   /* enumeration for write modes */
   DP_DCAT                                /* concatenate values */
 };
 
+enum {                                   /* enumeration for engines of asynchronous I/O */
+  DP_AIONONE,                            /* not enabled */
+  DP_AIOSYNC,                            /* blocking calls one by one */
+  DP_AIOTHREAD,                          /* blocking calls on helper threads */
+  DP_AIOURING                            /* io_uring of Linux */
+};
+
 
 /* String containing the version information. */
 MYEXTERN const char *dpversion;
@@ -122,8 +137,12 @@ const char *dperrmsg(int ecode);
    means it creates a new database if not exist, `DP_OTRUNC', which means it creates a new
    database regardless if one exists.  Both of `DP_OREADER' and `DP_OWRITER' can be added to by
    bitwise or: `DP_ONOLCK', which means it opens a database file without file locking, or
-   `DP_OLCKNB', which means locking is performed without blocking.  `DP_OCREAT' can be added to
-   by bitwise or: `DP_OSPARSE', which means it creates a database file as a sparse file.
+   `DP_OLCKNB', which means locking is performed without blocking, or `DP_OMAPALL', which means
+   the whole of the database file is mapped into memory and records are read from the mapping
+   without system calls.  `DP_OCREAT' can be added to
+   by bitwise or: `DP_OSPARSE', which means it creates a database file as a sparse file, or
+   `DP_OLARGE', which means it creates a database file whose offsets are of 64 bits so that it
+   can grow beyond 2GB.
    `bnum' specifies the number of elements of the bucket array.  If it is not more than 0,
    the default value is specified.  The size of a bucket array is determined on creating,
    and can not be changed except for by optimization of the database.  Suggested size of a
@@ -132,7 +151,13 @@ const char *dperrmsg(int ecode);
    While connecting as a writer, an exclusive lock is invoked to the database file.
    While connecting as a reader, a shared lock is invoked to the database file.  The thread
    blocks until the lock is achieved.  If `DP_ONOLCK' is used, the application is responsible
-   for exclusion control. */
+   for exclusion control.  Whether an existing database file is a large file or not is detected
+   from its header, so `DP_OLARGE' is only meaningful when a database is created.  Files are not
+   large unless it is specified, because earlier versions can not read large files.  A large file
+   is neither created nor opened if the offsets of system calls of the platform are 32-bit even
+   with `_FILE_OFFSET_BITS' defined as 64 as this library does.  `DP_OMAPALL'
+   is ignored on platforms without genuine `mmap', and the mapping of the header only is used if
+   the whole file can not be mapped. */
 DEPOT *dpopen(const char *name, int omode, int bnum);
 
 
@@ -157,7 +182,9 @@ int dpclose(DEPOT *depot);
    which means the specified value overwrites the existing one, `DP_DKEEP', which means the
    existing value is kept, `DP_DCAT', which means the specified value is concatenated at the
    end of the existing value.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   If the record would make a file which is not large grow beyond 2GB, it is not stored, the
+   error code is `DP_EMISC', and the handle is still usable. */
 int dpput(DEPOT *depot, const char *kbuf, int ksiz, const char *vbuf, int vsiz, int dmode);
 
 
@@ -280,6 +307,20 @@ int dpsync(DEPOT *depot);
 int dpoptimize(DEPOT *depot, int bnum);
 
 
+/* Compact a database file incrementally.
+   `depot' specifies a database handle connected as a writer.
+   `unum' specifies the max number of records visited in this call.  If it is not more than 0,
+   the default value is specified.
+   The return value is 1 if the compaction is in progress, 0 if it has reached the end of the
+   file, or -1 on failure.
+   Live records are moved toward the front of the file over dispensable regions, and the file
+   is truncated when the end is reached.  Because each call does a bounded amount of work and
+   the position is kept in the handle, calling this function repeatedly between other
+   operations compacts the file without blocking them for long.  The iterator should not be
+   used across calls of this function. */
+int dpcompact(DEPOT *depot, int unum);
+
+
 /* Get the name of a database.
    `depot' specifies a database handle.
    If successful, the return value is the pointer to the region of the name of the database,
@@ -291,10 +332,18 @@ char *dpname(DEPOT *depot);
 
 /* Get the size of a database file.
    `depot' specifies a database handle.
-   If successful, the return value is the size of the database file, else, it is -1. */
+   If successful, the return value is the size of the database file, else, it is -1.
+   If the size is more than 2GB, the return value is `INT_MAX'. */
 int dpfsiz(DEPOT *depot);
 
 
+/* Get the size of a database file as double-precision floating-point number.
+   `depot' specifies a database handle.
+   If successful, the return value is the size of the database file, else, it is -1.0.
+   This function is useful for large files whose size is more than 2GB. */
+double dpfsizd(DEPOT *depot);
+
+
 /* Get the number of the elements of the bucket array.
    `depot' specifies a database handle.
    If successful, the return value is the number of the elements of the bucket array, else, it
@@ -358,7 +407,8 @@ int dpremove(const char *name);
    `name' specifies the name of a database file.
    If successful, the return value is true, else, it is false.
    There is no guarantee that all records in a repaired database file correspond to the original
-   or expected state. */
+   or expected state.  A record cut off by the end of the file, which a crash while appending it
+   leaves, is dropped. */
 int dprepair(const char *name);
 
 
@@ -439,6 +489,14 @@ MYEXTERN const char *dpsysname;
 MYEXTERN int dpdbgfd;
 
 
+/* Counter of system calls for I/O on database files.
+   It is negative by default, which means counting is disabled.  If it is set to zero or more, it
+   is incremented by every system call reading or writing a database file, so that the cost of a
+   retrieval function such as `dpget' can be measured by the difference before and after it.
+   Because it is not protected by any lock, it is not accurate on multiple threads. */
+MYEXTERN int dpsyscnt;
+
+
 /* Whether this build is reentrant. */
 MYEXTERN const int dpisreentrant;
 
@@ -454,6 +512,168 @@ void dpecodeset(int ecode, const char *file, int line);
 int *dpecodeptr(void);
 
 
+/* Retrieve a record as a region in the mapped memory.
+   `depot' specifies a database handle opened with `DP_OMAPALL'.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `sp' specifies the pointer to a variable to which the size of the region of the return
+   value is assigned.  If it is `NULL', it is not used.
+   If successful, the return value is the pointer to the region of the value of the
+   corresponding record, else, it is `NULL'.  `NULL' is returned when no record corresponds to
+   the specified key or the whole file is not mapped.
+   Because the region of the return value is a part of the mapping, it is not terminated by
+   zero and it must not be modified.  The region is valid until the handle is updated or
+   closed. */
+const char *dpgetmap(DEPOT *depot, const char *kbuf, int ksiz, int *sp);
+
+
+/* Advise the system to read a record in advance.
+   `depot' specifies a database handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `size' specifies the size of the region to be read.  If it is negative, the region is not
+   limited.
+   If successful, the return value is true, else, it is false.  False is returned when the hash
+   chain of the key is empty.
+   This function does not wait for reading and does not read any record by itself.  The region
+   advised begins at the first record of the hash chain of the key, which is the corresponding
+   record unless another key collides with it.  If the whole file is mapped, the mapping is
+   advised with `madvise', else, the file is advised with `posix_fadvise'.  This function does
+   nothing on platforms without either call. */
+int dpprefetch(DEPOT *depot, const char *kbuf, int ksiz, int size);
+
+
+/* Enable the engine of asynchronous I/O of a database handle.
+   `depot' specifies a database handle.
+   `depth' specifies the max number of requests submitted at once.  If it is not more than 0,
+   the engine is disabled.
+   `engine' specifies the preferred engine: `DP_AIOURING' for io_uring, `DP_AIOTHREAD' for
+   helper threads, or `DP_AIOSYNC' for blocking calls.
+   If successful, the return value is true, else, it is false.
+   An engine which is not available is replaced with the next one in the order above.  io_uring
+   is available on Linux since 5.1 unless it is built with `MYNOURING', and helper threads are
+   available if it is built with `MYPTHREAD'.  The engine is used by `dpgetbatch' and for
+   writes between `dpaiobegin' and `dpaioend'.  Even `DP_AIOSYNC' gathers the queued writes
+   into sequential calls when they are submitted. */
+int dpsetaio(DEPOT *depot, int depth, int engine);
+
+
+/* Get the engine of asynchronous I/O of a database handle.
+   `depot' specifies a database handle.
+   The return value is `DP_AIONONE' if the engine is not enabled, else one of `DP_AIOSYNC',
+   `DP_AIOTHREAD' and `DP_AIOURING'. */
+int dpaioengine(DEPOT *depot);
+
+
+/* Begin queuing writes of records.
+   `depot' specifies a database handle connected as a writer.
+   If successful, the return value is true, else, it is false.
+   Until `dpaioend' is called as many times as this function, the regions written by storing
+   and deleting records are queued instead of being written one by one.  A region adjacent to
+   the last queued one is merged into it, and a region inside a queued one is copied over it.
+   The queue is submitted at once when it is full or a region overlaps it partly.  When it is
+   submitted, the regions are sorted by the offset and adjacent ones are written with one
+   vectored call, so that the writes become sequential as far as possible.  Reading a
+   queued region through the handle sees the queued data, but other handles and processes do
+   not see it until it is submitted.  This function does nothing if the engine is not enabled. */
+int dpaiobegin(DEPOT *depot);
+
+
+/* End queuing writes of records.
+   `depot' specifies a database handle connected as a writer.
+   If successful, the return value is true, else, it is false.
+   When the queuing is ended as many times as it was begun, the queued writes are submitted and
+   this function waits for them.  `dpsync', `dpmemsync', `dpoptimize', `dpcompact' and `dpclose'
+   also submit the queued writes. */
+int dpaioend(DEPOT *depot);
+
+
+/* Retrieve records in a batch.
+   `depot' specifies a database handle.
+   `kbufs' specifies an array of the pointers to the regions of keys.
+   `ksizs' specifies an array of the sizes of the regions of the keys.  If a size is negative, it
+   is assigned with `strlen' of the key.
+   `num' specifies the number of the keys.
+   `vbufs' specifies an array to which the pointers to the regions of the values are assigned.
+   `NULL' is assigned for keys without records.
+   `vsizs' specifies an array to which the sizes of the regions of the values are assigned.
+   The return value is the number of the retrieved records, or -1 on failure.
+   The headers of the records are read one by one, but the values not read with the headers are
+   read with the engine of asynchronous I/O at once.  Without the engine, they are read one by
+   one.  Because the regions of the values are allocated with the `malloc' call and terminated
+   with zero, they should be released with the `free' call if they are no longer in use.  On
+   failure, no region is left allocated. */
+int dpgetbatch(DEPOT *depot, const char **kbufs, const int *ksizs, int num,
+               char **vbufs, int *vsizs);
+
+
+/* Get statistics of the queue of writes of a database handle.
+   `depot' specifies a database handle.
+   `fp' specifies the pointer to a variable to which the number of times the queue was submitted
+   is assigned.  If it is `NULL', it is not used.
+   `wp' specifies the pointer to a variable to which the number of queued regions submitted is
+   assigned.  If it is `NULL', it is not used.
+   `cp' specifies the pointer to a variable to which the number of calls of writing them is
+   assigned.  If it is `NULL', it is not used.
+   `bp' specifies the pointer to a variable to which the total size of them is assigned.  If it
+   is `NULL', it is not used.
+   `lp' specifies the pointer to a variable to which the size written by the last submission is
+   assigned.  If it is `NULL', it is not used.
+   The statistics are counted since the engine of asynchronous I/O was enabled.  All of them
+   are 0 if the engine is not enabled. */
+void dpaiostat(DEPOT *depot, int *fp, int *wp, int *cp, double *bp, double *lp);
+
+
+/* Get the location of a record.
+   `depot' specifies a database handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `offp' specifies the pointer to a variable to which the offset of the record is assigned.
+   `sp' specifies the pointer to a variable to which the size of the header, the key and the
+   value of the record is assigned.
+   If successful, the return value is true, else, it is false.  False is returned when no
+   record corresponds to the specified key.
+   The location is valid until the record is overwritten or deleted, or the database is
+   optimized or compacted.  The record can be retrieved by `dpgetat' with it. */
+int dprecloc(DEPOT *depot, const char *kbuf, int ksiz, long long *offp, int *sp);
+
+
+/* Get the location of the record stored last.
+   `depot' specifies a database handle connected as a writer.
+   `offp' specifies the pointer to a variable to which the offset of the record is assigned.
+   `sp' specifies the pointer to a variable to which the size of the header, the key and the
+   value of the record is assigned.
+   If successful, the return value is true, else, it is false.  False is returned unless the
+   last operation of updating was storing a record successfully.
+   This function is the same as `dprecloc' for the key stored last, but no record is
+   searched for. */
+int dplastloc(DEPOT *depot, long long *offp, int *sp);
+
+
+/* Retrieve a record at a location.
+   `depot' specifies a database handle.
+   `off' specifies the offset of the record got by `dprecloc' or `dplastloc'.
+   `size' specifies the size of the record got with the offset.
+   `kbuf' specifies the pointer to the region of the key of the record.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `buf' specifies the pointer to a buffer whose size is `size' at least, into which the record
+   is read.
+   `sp' specifies the pointer to a variable to which the size of the region of the return
+   value is assigned.  If it is `NULL', it is not used.
+   If successful, the return value is the pointer to the region of the value in the buffer,
+   else, it is `NULL'.  `NULL' is returned when the location does not hold a live record of
+   the key with the size any longer.
+   The record is read with one call without searching the hash chain, and the header read with
+   it is checked against the key, so a location which is out of date is detected instead of
+   being trusted.  The region of the return value is not terminated by zero. */
+const char *dpgetat(DEPOT *depot, long long off, int size, const char *kbuf, int ksiz,
+                    char *buf, int *sp);
+
+
 /* Synchronize updating contents on memory.
    `depot' specifies a database handle connected as a writer.
    If successful, the return value is true, else, it is false. */
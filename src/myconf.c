@@ -321,6 +321,30 @@ int _qdbm_msync(const void *start, size_t length, int flags){
 
 
 
+/*************************************************************************************************
+ * for systems without positional I/O
+ *************************************************************************************************/
+
+
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || defined(_SYS_RISCOS_) || defined(MYNOPIO)
+
+
+int _qdbm_pread(int fd, void *buf, size_t count, off_t offset){
+  if(lseek(fd, offset, SEEK_SET) == -1) return -1;
+  return read(fd, buf, count);
+}
+
+
+int _qdbm_pwrite(int fd, const void *buf, size_t count, off_t offset){
+  if(lseek(fd, offset, SEEK_SET) == -1) return -1;
+  return write(fd, buf, count);
+}
+
+
+#endif
+
+
+
 /*************************************************************************************************
  * for reentrant time routines
  *************************************************************************************************/
@@ -944,6 +968,205 @@ char *(*_qdbm_bzdecode)(const char *, int, int *) = NULL;
 
 
 
+/*************************************************************************************************
+ * for LZF
+ *************************************************************************************************/
+
+
+#define LZFHASHBITS    13
+#define LZFMINMATCH    4
+#define LZFMAXOFF      65535
+
+
+static unsigned int _qdbm_lzfhash(const unsigned char *ptr);
+static void _qdbm_lzfputlen(unsigned char **wpp, int len);
+static int _qdbm_lzfgetlen(const unsigned char **rpp, const unsigned char *ep, int *lp);
+static char *_qdbm_lzfencode_impl(const char *ptr, int size, int *sp, const char *dbuf, int dsiz);
+static char *_qdbm_lzfdecode_impl(const char *ptr, int size, int *sp, const char *dbuf, int dsiz);
+
+
+char *(*_qdbm_lzfencode)(const char *, int, int *, const char *, int) = _qdbm_lzfencode_impl;
+char *(*_qdbm_lzfdecode)(const char *, int, int *, const char *, int) = _qdbm_lzfdecode_impl;
+
+
+static unsigned int _qdbm_lzfhash(const unsigned char *ptr){
+  unsigned int sum;
+  sum = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+  return (sum * 2654435761U) >> (32 - LZFHASHBITS);
+}
+
+
+static void _qdbm_lzfputlen(unsigned char **wpp, int len){
+  while(len >= 255){
+    *((*wpp)++) = 255;
+    len -= 255;
+  }
+  *((*wpp)++) = len;
+}
+
+
+static int _qdbm_lzfgetlen(const unsigned char **rpp, const unsigned char *ep, int *lp){
+  int c;
+  do {
+    if(*rpp >= ep) return FALSE;
+    c = *((*rpp)++);
+    *lp += c;
+    if(*lp > (1 << 30)) return FALSE;
+  } while(c == 255);
+  return TRUE;
+}
+
+
+static char *_qdbm_lzfencode_impl(const char *ptr, int size, int *sp, const char *dbuf, int dsiz){
+  int table[1<<LZFHASHBITS];
+  const unsigned char *base;
+  unsigned char *buf, *wp, *tp;
+  char *tmp;
+  int i, end, ip, anchor, ref, len, lit;
+  unsigned int hash;
+  if(size < 0) size = strlen(ptr);
+  if(!dbuf || dsiz < 0) dsiz = 0;
+  if(dsiz > LZFMAXOFF) {
+    dbuf += dsiz - LZFMAXOFF;
+    dsiz = LZFMAXOFF;
+  }
+  tmp = NULL;
+  if(dsiz > 0){
+    if(!(tmp = malloc(dsiz + size + 1))) return NULL;
+    memcpy(tmp, dbuf, dsiz);
+    memcpy(tmp + dsiz, ptr, size);
+    base = (unsigned char *)tmp;
+  } else {
+    base = (unsigned char *)ptr;
+  }
+  if(!(buf = malloc(size + size / 128 + 32))){
+    free(tmp);
+    return NULL;
+  }
+  wp = buf;
+  len = size;
+  while(len >= 0x80){
+    *(wp++) = (len & 0x7f) | 0x80;
+    len >>= 7;
+  }
+  *(wp++) = len;
+  for(i = 0; i < (1 << LZFHASHBITS); i++){
+    table[i] = -1;
+  }
+  for(i = 0; i + LZFMINMATCH <= dsiz; i++){
+    table[_qdbm_lzfhash(base + i)] = i;
+  }
+  end = dsiz + size;
+  ip = dsiz;
+  anchor = dsiz;
+  while(ip + LZFMINMATCH <= end){
+    hash = _qdbm_lzfhash(base + ip);
+    ref = table[hash];
+    table[hash] = ip;
+    if(ref < 0 || ip - ref > LZFMAXOFF || memcmp(base + ref, base + ip, LZFMINMATCH)){
+      ip += 1 + ((ip - anchor) >> 6);
+      continue;
+    }
+    len = LZFMINMATCH;
+    while(ip + len < end && base[ref+len] == base[ip+len]){
+      len++;
+    }
+    lit = ip - anchor;
+    tp = wp++;
+    *tp = (lit < 15 ? lit : 15) << 4;
+    if(lit >= 15) _qdbm_lzfputlen(&wp, lit - 15);
+    memcpy(wp, base + anchor, lit);
+    wp += lit;
+    *(wp++) = (ip - ref) & 0xff;
+    *(wp++) = (ip - ref) >> 8;
+    len -= LZFMINMATCH;
+    *tp |= len < 15 ? len : 15;
+    if(len >= 15) _qdbm_lzfputlen(&wp, len - 15);
+    ip += len + LZFMINMATCH;
+    anchor = ip;
+    if(ip + LZFMINMATCH <= end) table[_qdbm_lzfhash(base + ip - 2)] = ip - 2;
+  }
+  lit = end - anchor;
+  tp = wp++;
+  *tp = (lit < 15 ? lit : 15) << 4;
+  if(lit >= 15) _qdbm_lzfputlen(&wp, lit - 15);
+  memcpy(wp, base + anchor, lit);
+  wp += lit;
+  *wp = '\0';
+  free(tmp);
+  *sp = wp - buf;
+  return (char *)buf;
+}
+
+
+static char *_qdbm_lzfdecode_impl(const char *ptr, int size, int *sp, const char *dbuf, int dsiz){
+  const unsigned char *rp, *ep;
+  char *buf;
+  unsigned int usiz;
+  int i, rsiz, op, lit, off, len, dlen, shift;
+  if(!dbuf || dsiz < 0) dsiz = 0;
+  if(dsiz > LZFMAXOFF) {
+    dbuf += dsiz - LZFMAXOFF;
+    dsiz = LZFMAXOFF;
+  }
+  rp = (unsigned char *)ptr;
+  ep = rp + size;
+  usiz = 0;
+  shift = 0;
+  do {
+    if(rp >= ep || shift > 28 || (shift == 28 && (*rp & 0x7f) > 0x07)) return NULL;
+    usiz |= (unsigned int)(*rp & 0x7f) << shift;
+    shift += 7;
+  } while(*(rp++) & 0x80);
+  /* no sequence expands to more than 255 bytes per byte of input */
+  if(usiz / 255 > (unsigned int)(ep - rp)) return NULL;
+  rsiz = usiz;
+  if(!(buf = malloc(rsiz + 1))) return NULL;
+  op = 0;
+  while(rp < ep){
+    lit = *rp >> 4;
+    len = *(rp++) & 0x0f;
+    if(lit == 15 && !_qdbm_lzfgetlen(&rp, ep, &lit)) break;
+    if(lit > ep - rp || lit > rsiz - op) break;
+    memcpy(buf + op, rp, lit);
+    rp += lit;
+    op += lit;
+    if(rp >= ep){
+      if(op != rsiz) break;
+      buf[op] = '\0';
+      if(sp) *sp = op;
+      return buf;
+    }
+    if(ep - rp < 2) break;
+    off = rp[0] | (rp[1] << 8);
+    rp += 2;
+    if(len == 15 && !_qdbm_lzfgetlen(&rp, ep, &len)) break;
+    len += LZFMINMATCH;
+    if(off < 1 || off > op + dsiz || len > rsiz - op) break;
+    if(off > op){
+      dlen = off - op;
+      if(dlen > len) dlen = len;
+      memcpy(buf + op, dbuf + dsiz - (off - op), dlen);
+      op += dlen;
+      len -= dlen;
+      if(len < 1) continue;
+    }
+    if(off >= len){
+      memcpy(buf + op, buf + op - off, len);
+      op += len;
+    } else {
+      for(i = 0; i < len; i++){
+        buf[op] = buf[op-off];
+        op++;
+      }
+    }
+  }
+  free(buf);
+  return NULL;
+}
+
+
+
 /*************************************************************************************************
  * for ICONV
  *************************************************************************************************/
@@ -264,6 +264,8 @@ int _qdbm_win32_lstat(const char *pathname, struct stat *buf);
 
 #if defined(MYPTHREAD)
 
+#include <pthread.h>
+
 #define _qdbm_ptsafe       TRUE
 
 void *_qdbm_settsd(void *ptr, int size, const void *initval);
@@ -354,6 +356,8 @@ void *_qdbm_mmap(void *start, size_t length, int prot, int flags, int fd, off_t
 int _qdbm_munmap(void *start, size_t length);
 int _qdbm_msync(const void *start, size_t length, int flags);
 
+#define _qdbm_fullmmap     FALSE
+
 #else
 
 #undef mflush
@@ -361,6 +365,80 @@ int _qdbm_msync(const void *start, size_t length, int flags);
   mflush(start, length, flags) \
   (0)
 
+#define _qdbm_fullmmap     TRUE
+
+#endif
+
+
+
+/*************************************************************************************************
+ * for systems without positional I/O
+ *************************************************************************************************/
+
+
+#if defined(_SYS_MSVC_) || defined(_SYS_MINGW_) || defined(_SYS_RISCOS_) || defined(MYNOPIO)
+
+#undef pread
+#undef pwrite
+
+#define \
+  pread(fd, buf, count, offset) \
+  _qdbm_pread(fd, buf, count, offset)
+
+#define \
+  pwrite(fd, buf, count, offset) \
+  _qdbm_pwrite(fd, buf, count, offset)
+
+int _qdbm_pread(int fd, void *buf, size_t count, off_t offset);
+int _qdbm_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+#endif
+
+
+
+/*************************************************************************************************
+ * for asynchronous I/O
+ *************************************************************************************************/
+
+
+#if defined(_SYS_LINUX_) && !defined(MYNOURING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#endif
+#endif
+
+#if defined(IORING_OFF_SQES) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+#define _qdbm_uring        TRUE
+
+#else
+
+#define _qdbm_uring        FALSE
+
+#endif
+
+
+
+/*************************************************************************************************
+ * for vectored I/O
+ *************************************************************************************************/
+
+
+#if (defined(_SYS_LINUX_) || defined(_SYS_FREEBSD_) || defined(_SYS_NETBSD_) || \
+  defined(_SYS_OPENBSD_)) && !defined(MYNOPIO)
+
+#include <sys/uio.h>
+
+#define _qdbm_vecio        TRUE
+
+#else
+
+#define _qdbm_vecio        FALSE
+
 #endif
 
 
@@ -556,6 +634,17 @@ extern char *(*_qdbm_bzdecode)(const char *, int, int *);
 
 
 
+/*************************************************************************************************
+ * for LZF
+ *************************************************************************************************/
+
+
+extern char *(*_qdbm_lzfencode)(const char *, int, int *, const char *, int);
+
+extern char *(*_qdbm_lzfdecode)(const char *, int, int *, const char *, int);
+
+
+
 /*************************************************************************************************
  * for ICONV
  *************************************************************************************************/
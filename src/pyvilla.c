@@ -19,6 +19,9 @@ typedef struct {
     VILLA *villa;
     char *prefix;
     int jmode;
+    PyObject *base; /* database of a snapshot or NULL */
+    int snaps; /* number of open snapshots */
+    int tmode; /* whether the handle is shared by threads */
 } villaobject;
 
 static PyTypeObject VillaType;
@@ -30,6 +33,16 @@ static PyTypeObject VillaType;
         return NULL;                                                         \
     }
 
+/* release the interpreter lock around a call if the handle is shared by threads */
+#define villa_begin_threads(v)                                               \
+    {                                                                        \
+        PyThreadState *_save = (v)->tmode ? PyEval_SaveThread() : NULL;
+#define villa_end_threads()                                                  \
+        if (_save) {                                                         \
+            PyEval_RestoreThread(_save);                                     \
+        }                                                                    \
+    }
+
 typedef int (*vlcurpos)(VILLA *villa);
 static PyObject *VillaError;
 
@@ -50,6 +63,10 @@ new_villa_object(char *file, int flags, int size)
         return NULL;
     }
 
+    dp->base = NULL;
+    dp->snaps = 0;
+    dp->tmode = (flags & VL_OTHREAD) != 0;
+
     if (!(dp->villa = vlopen(file, flags, VL_CMPLEX))) {
         PyErr_SetString(VillaError, dperrmsg(dpecode));
         Py_DECREF(dp);
@@ -67,6 +84,10 @@ void _villa_close(villaobject *self)
         vlclose(self->villa);
         self->villa = NULL;
     }
+    if (self->base) {
+        ((villaobject *)self->base)->snaps--;
+        Py_CLEAR(self->base);
+    }
 }
 
 static void
@@ -101,7 +122,9 @@ villa_subscript(villaobject *dp, register PyObject *key)
 
     krec.dsize = tmp_size;
     check_villaobject_open(dp);
+    villa_begin_threads(dp);
     drec.dptr = vlget(dp->villa, krec.dptr, krec.dsize, &tmp_size);
+    villa_end_threads();
     drec.dsize = tmp_size;
     if (!drec.dptr) {
         if (dpecode == DP_ENOITEM) {
@@ -123,7 +146,7 @@ static int
 villa_ass_sub(villaobject *dp, PyObject *v, PyObject *w)
 {
     datum krec, drec;
-    int tmp_size;
+    int tmp_size, rv;
 
     if (!PyArg_Parse(v, "s#", &krec.dptr, &tmp_size)) {
         PyErr_SetString(PyExc_TypeError,
@@ -136,7 +159,10 @@ villa_ass_sub(villaobject *dp, PyObject *v, PyObject *w)
         return -1;
     }
     if (w == NULL) {
-        if (vlout(dp->villa, krec.dptr, krec.dsize) == 0) {
+        villa_begin_threads(dp);
+        rv = vlout(dp->villa, krec.dptr, krec.dsize);
+        villa_end_threads();
+        if (rv == 0) {
             if (dpecode == DP_ENOITEM) {
                 PyErr_SetString(PyExc_KeyError,
                     PyString_AS_STRING((PyStringObject *)v));
@@ -154,7 +180,10 @@ villa_ass_sub(villaobject *dp, PyObject *v, PyObject *w)
             return -1;
         }
         drec.dsize = tmp_size;
-        if (vlput(dp->villa, krec.dptr, krec.dsize, drec.dptr, drec.dsize, VL_DDUP) == 0) {
+        villa_begin_threads(dp);
+        rv = vlput(dp->villa, krec.dptr, krec.dsize, drec.dptr, drec.dsize, VL_DDUP);
+        villa_end_threads();
+        if (rv == 0) {
             PyErr_SetString(VillaError, dperrmsg(dpecode));
             return -1;
         }
@@ -174,6 +203,10 @@ villa__close(register villaobject *dp, PyObject *args)
     if (!PyArg_ParseTuple(args, ":close")) {
         return NULL;
     }
+    if (dp->snaps > 0) {
+        PyErr_SetString(VillaError, "snapshots of the database are open");
+        return NULL;
+    }
     _villa_close(dp);
     Py_INCREF(Py_None);
     return Py_None;
@@ -193,7 +226,7 @@ villa__info(register villaobject *dp, PyObject *args)
     PyDict_SetItemString(info, "name",  o);
     free(name);
 
-    o = PyInt_FromLong(vlfsiz(dp->villa));
+    o = PyInt_FromLong((long)vlfsizd(dp->villa));
     PyDict_SetItemString(info, "file_size", o);
 
     o = PyInt_FromLong(vllnum(dp->villa));
@@ -211,6 +244,63 @@ villa__info(register villaobject *dp, PyObject *args)
     o = PyFloat_FromDouble(vlmtime(dp->villa));
     PyDict_SetItemString(info, "modified_time", o);
 
+    int lcsiz, lcpeak, ncsiz, ncpeak;
+    vlcachestat(dp->villa, &lcsiz, &lcpeak, &ncsiz, &ncpeak);
+    o = PyInt_FromLong(lcsiz);
+    PyDict_SetItemString(info, "leaf_cache_size", o);
+    o = PyInt_FromLong(lcpeak);
+    PyDict_SetItemString(info, "leaf_cache_peak", o);
+    o = PyInt_FromLong(ncsiz);
+    PyDict_SetItemString(info, "node_cache_size", o);
+    o = PyInt_FromLong(ncpeak);
+    PyDict_SetItemString(info, "node_cache_peak", o);
+
+    int pnum, psiz;
+    vlpinstat(dp->villa, &pnum, &psiz);
+    o = PyInt_FromLong(pnum);
+    PyDict_SetItemString(info, "pinned_nodes", o);
+    o = PyInt_FromLong(psiz);
+    PyDict_SetItemString(info, "pinned_node_size", o);
+
+    int fnum, wnum, cnum;
+    double fsum, lsiz;
+    vlflushstat(dp->villa, &fnum, &wnum, &cnum, &fsum, &lsiz);
+    o = PyInt_FromLong(fnum);
+    PyDict_SetItemString(info, "flushes", o);
+    o = PyInt_FromLong(wnum);
+    PyDict_SetItemString(info, "flush_writes", o);
+    o = PyInt_FromLong(cnum);
+    PyDict_SetItemString(info, "flush_calls", o);
+    o = PyFloat_FromDouble(fsum);
+    PyDict_SetItemString(info, "flush_bytes", o);
+    o = PyFloat_FromDouble(lsiz);
+    PyDict_SetItemString(info, "last_flush_bytes", o);
+
+    int tnum, thits, tmisses;
+    vlptabstat(dp->villa, &tnum, &thits, &tmisses);
+    o = PyInt_FromLong(tnum);
+    PyDict_SetItemString(info, "page_table_entries", o);
+    o = PyInt_FromLong(thits);
+    PyDict_SetItemString(info, "page_table_hits", o);
+    o = PyInt_FromLong(tmisses);
+    PyDict_SetItemString(info, "page_table_misses", o);
+
+    switch (vlaioengine(dp->villa)) {
+    case DP_AIOURING:
+        o = PyString_FromString("uring");
+        break;
+    case DP_AIOTHREAD:
+        o = PyString_FromString("thread");
+        break;
+    case DP_AIOSYNC:
+        o = PyString_FromString("sync");
+        break;
+    default:
+        o = PyString_FromString("none");
+        break;
+    }
+    PyDict_SetItemString(info, "aio_engine", o);
+
     Py_INCREF(info);
     return info;
 }
@@ -227,6 +317,103 @@ villa__sync(register villaobject *dp, PyObject *args)
     Py_RETURN_FALSE;
 }
 
+static PyObject *
+villa__tranbegin(register villaobject *dp, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":tranbegin")) {
+        return NULL;
+    }
+    if (vltranbegin(dp->villa)){
+        Py_RETURN_TRUE;
+    };
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+villa__trancommit(register villaobject *dp, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":trancommit")) {
+        return NULL;
+    }
+    if (vltrancommit(dp->villa)){
+        Py_RETURN_TRUE;
+    };
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+villa__tranabort(register villaobject *dp, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":tranabort")) {
+        return NULL;
+    }
+    if (vltranabort(dp->villa)){
+        Py_RETURN_TRUE;
+    };
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+villa__settuning(register villaobject *dp, PyObject *args)
+{
+    int lrecmax, nidxmax, lcnum = 0, ncnum = 0;
+    if (!PyArg_ParseTuple(args, "ii|ii:settuning", &lrecmax, &nidxmax, &lcnum, &ncnum)) {
+        return NULL;
+    }
+    vlsettuning(dp->villa, lrecmax, nidxmax, lcnum, ncnum);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+villa__setcache(register villaobject *dp, PyObject *args)
+{
+    int lcsiz, ncsiz = 0;
+    if (!PyArg_ParseTuple(args, "i|i:setcache", &lcsiz, &ncsiz)) {
+        return NULL;
+    }
+    vlsetcachesiz(dp->villa, lcsiz, ncsiz);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+villa__setcachepolicy(register villaobject *dp, PyObject *args)
+{
+    int lpolicy, npolicy = VL_CRLRU;
+    if (!PyArg_ParseTuple(args, "i|i:setcachepolicy", &lpolicy, &npolicy)) {
+        return NULL;
+    }
+    vlsetcachepolicy(dp->villa, lpolicy, npolicy);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+villa__setpinlevel(register villaobject *dp, PyObject *args)
+{
+    int level;
+    if (!PyArg_ParseTuple(args, "i:setpinlevel", &level)) {
+        return NULL;
+    }
+    if (vlsetpinlevel(dp->villa, level)){
+        Py_RETURN_TRUE;
+    };
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+villa__setreadahead(register villaobject *dp, PyObject *args)
+{
+    int max;
+    if (!PyArg_ParseTuple(args, "i:setreadahead", &max)) {
+        return NULL;
+    }
+    vlsetreadahead(dp->villa, max);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyObject *
 villa__optimize(register villaobject *dp, PyObject *args)
 {
@@ -239,6 +426,56 @@ villa__optimize(register villaobject *dp, PyObject *args)
     Py_RETURN_FALSE;
 }
 
+static PyObject *
+villa__compact(register villaobject *dp, PyObject *args)
+{
+    int unum = 0;
+    int rv;
+    if (!PyArg_ParseTuple(args, "|i:compact", &unum)) {
+        return NULL;
+    }
+    rv = vlcompact(dp->villa, unum);
+    if (rv < 0) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        return NULL;
+    }
+    if (rv > 0) {
+        Py_RETURN_TRUE;
+    }
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+villa__snapshot(register villaobject *dp, PyObject *args)
+{
+    villaobject *sp;
+
+    if (!PyArg_ParseTuple(args, ":snapshot")) {
+        return NULL;
+    }
+    check_villaobject_open(dp);
+
+    sp = PyObject_New(villaobject, &VillaType);
+    if (sp == NULL) {
+        return NULL;
+    }
+    sp->jmode = -1;
+    sp->base = NULL;
+    sp->snaps = 0;
+    sp->tmode = 0;
+
+    if (!(sp->villa = vlsnapshotopen(dp->villa))) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        Py_DECREF(sp);
+        return NULL;
+    }
+    Py_INCREF(dp);
+    sp->base = (PyObject *)dp;
+    dp->snaps++;
+
+    return (PyObject *)sp;
+}
+
 static PyObject *
 villa__writable(register villaobject *dp, PyObject *args)
 {
@@ -351,7 +588,9 @@ villa_get(register villaobject *dp, PyObject *args)
 
     key.dsize = tmp_size;
     check_villaobject_open(dp);
+    villa_begin_threads(dp);
     val.dptr = vlget(dp->villa, key.dptr, key.dsize, &tmp_size);
+    villa_end_threads();
     val.dsize = tmp_size;
 
     if (val.dptr != NULL) {
@@ -417,7 +656,7 @@ villa_put(register villaobject *dp, PyObject *args)
 {
     datum key, val;
     PyObject *value = NULL;
-    int tmp_size, mode;
+    int tmp_size, mode, rv;
 
     if (!PyArg_ParseTuple(args, "s#|Si:put",
             &key.dptr, &tmp_size, &value, &mode)) {
@@ -439,7 +678,10 @@ villa_put(register villaobject *dp, PyObject *args)
 
     val.dptr = PyString_AS_STRING(value);
     val.dsize = PyString_GET_SIZE(value);
-    if (!vlput(dp->villa, key.dptr, key.dsize, val.dptr, val.dsize, mode)) {
+    villa_begin_threads(dp);
+    rv = vlput(dp->villa, key.dptr, key.dsize, val.dptr, val.dsize, mode);
+    villa_end_threads();
+    if (!rv) {
         PyErr_SetString(VillaError, dperrmsg(dpecode));
         return NULL;
     }
@@ -447,6 +689,139 @@ villa_put(register villaobject *dp, PyObject *args)
     return value;
 }
 
+static PyObject *
+villa_put_many(register villaobject *dp, PyObject *args)
+{
+    PyObject *seq, *it, *item;
+    CBLIST *keys, *vals;
+    char *kbuf, *vbuf;
+    int ksiz, vsiz, mode = VL_DOVER, err = 0;
+
+    if (!PyArg_ParseTuple(args, "O|i:put_many", &seq, &mode)) {
+        return NULL;
+    }
+
+    check_villaobject_open(dp);
+    if (PyDict_Check(seq)) {
+        it = PyObject_CallMethod(seq, "iteritems", NULL);
+    }
+    else {
+        it = PyObject_GetIter(seq);
+    }
+    if (it == NULL) {
+        return NULL;
+    }
+
+    keys = cblistopen();
+    vals = cblistopen();
+    while (!err && (item = PyIter_Next(it)) != NULL) {
+        if (!PyArg_ParseTuple(item, "s#s#:put_many", &kbuf, &ksiz, &vbuf, &vsiz)) {
+            err = 2;
+        }
+        else {
+            cblistpush(keys, kbuf, ksiz);
+            cblistpush(vals, vbuf, vsiz);
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(it);
+    if (!err && PyErr_Occurred()) {
+        err = 2;
+    }
+    if (!err) {
+        villa_begin_threads(dp);
+        if (!vlputbatch(dp->villa, keys, vals, mode)) {
+            err = 1;
+        }
+        villa_end_threads();
+        if (err) {
+            PyErr_SetString(VillaError, dperrmsg(dpecode));
+        }
+    }
+    cblistclose(vals);
+    cblistclose(keys);
+    if (err) {
+        return NULL;
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+villa_get_many(register villaobject *dp, PyObject *args)
+{
+    PyObject *seq, *it, *item, *v, *val;
+    CBLIST *keys;
+    CBMAP *map;
+    const char *kbuf, *vbuf;
+    int ksiz, vsiz, err = 0;
+
+    if (!PyArg_ParseTuple(args, "O:get_many", &seq)) {
+        return NULL;
+    }
+
+    check_villaobject_open(dp);
+    if (!(it = PyObject_GetIter(seq))) {
+        return NULL;
+    }
+
+    keys = cblistopen();
+    while (!err && (item = PyIter_Next(it)) != NULL) {
+        if (!PyString_Check(item)) {
+            PyErr_SetString(PyExc_TypeError, "villa keys must be strings");
+            err = 1;
+        }
+        else {
+            cblistpush(keys, PyString_AS_STRING(item), PyString_GET_SIZE(item));
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(it);
+    if (err || PyErr_Occurred()) {
+        cblistclose(keys);
+        return NULL;
+    }
+    villa_begin_threads(dp);
+    map = vlgetbatch(dp->villa, keys);
+    villa_end_threads();
+    cblistclose(keys);
+    if (!map) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        return NULL;
+    }
+
+    if (!(v = PyDict_New())) {
+        cbmapclose(map);
+        return NULL;
+    }
+    cbmapiterinit(map);
+    while ((kbuf = cbmapiternext(map, &ksiz)) != NULL) {
+        vbuf = cbmapiterval(kbuf, &vsiz);
+        if (!(item = PyString_FromStringAndSize(kbuf, ksiz))) {
+            err = 1;
+            break;
+        }
+        if (!(val = PyString_FromStringAndSize(vbuf, vsiz))) {
+            Py_DECREF(item);
+            err = 1;
+            break;
+        }
+        if (PyDict_SetItem(v, item, val) != 0) {
+            err = 1;
+        }
+        Py_DECREF(val);
+        Py_DECREF(item);
+        if (err) {
+            break;
+        }
+    }
+    cbmapclose(map);
+    if (err) {
+        Py_DECREF(v);
+        return NULL;
+    }
+    return v;
+}
+
 static PyObject *
 villa_iterprefix(register villaobject *dp, PyObject *args)
 {
@@ -474,9 +849,9 @@ static PyObject *
 villa_trunprefix(register villaobject *dp, PyObject *args)
 {
     datum prefix;
-    char *key;
-    int tmp_size, mode;
+    int tmp_size, mode, num;
 
+    /* the jump mode of the former cursor loop is still accepted but has no effect */
     if (!PyArg_ParseTuple(args, "s#|i:trunprefix",
             &prefix.dptr, &tmp_size, &mode)) {
         return NULL;
@@ -485,22 +860,12 @@ villa_trunprefix(register villaobject *dp, PyObject *args)
     prefix.dsize = tmp_size;
     check_villaobject_open(dp);
 
-    if (!vlcurjump(dp->villa, prefix.dptr, prefix.dsize, mode)) {
-        Py_RETURN_FALSE;
+    if ((num = vloutprefix(dp->villa, prefix.dptr, prefix.dsize)) == -1) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        return NULL;
     }
-
-    for(;;){
-        key = vlcurkey(dp->villa, NULL);
-        if (key){
-            if (strncmp(prefix.dptr, key, prefix.dsize)) {
-                free(key);
-                break;
-            }
-            vlcurout(dp->villa);
-            free(key);
-        } else {
-            break;
-        }
+    if (num < 1) {
+        Py_RETURN_FALSE;
     }
 
     Py_RETURN_TRUE;
@@ -532,10 +897,30 @@ static PyMethodDef villa_methods[] = {
         "close()\nClose the database." },
     { "info", (PyCFunction)villa__info, METH_VARARGS,
         "info()\noutput miscellaneous information to the standard output.." },
+    { "tranbegin", (PyCFunction)villa__tranbegin, METH_VARARGS,
+        "tranbegin()\nBegin a transaction.  Returns False if one is already in progress." },
+    { "trancommit", (PyCFunction)villa__trancommit, METH_VARARGS,
+        "trancommit()\nCommit the transaction." },
+    { "tranabort", (PyCFunction)villa__tranabort, METH_VARARGS,
+        "tranabort()\nAbort the transaction and restore the state at its beginning." },
+    { "settuning", (PyCFunction)villa__settuning, METH_VARARGS,
+        "settuning(leaf_records, node_indexes[, leaf_cache, node_cache])\nSet the maximum numbers of records in a leaf and indexes in a node, and the numbers of\nleaves and nodes cached.  0 means the default." },
+    { "setcache", (PyCFunction)villa__setcache, METH_VARARGS,
+        "setcache(leaf_bytes[, node_bytes])\nLimit the memory of the page caches in bytes.  0 means no limit." },
+    { "setcachepolicy", (PyCFunction)villa__setcachepolicy, METH_VARARGS,
+        "setcachepolicy(leaf_policy[, node_policy])\nSelect VL_CRLRU or VL_CR2Q as the replacement policy of the page caches." },
+    { "setpinlevel", (PyCFunction)villa__setpinlevel, METH_VARARGS,
+        "setpinlevel(level)\nPin the top `level' levels of non-leaf nodes in memory.  A negative level pins all of them." },
+    { "setreadahead", (PyCFunction)villa__setreadahead, METH_VARARGS,
+        "setreadahead(max)\nRead at most `max' leaves ahead of cursors moving forward.  0 disables it and a negative value restores the default." },
     { "optimize", (PyCFunction)villa__optimize, METH_VARARGS,
         "optimize()\nOptimize the database." },
+    { "compact", (PyCFunction)villa__compact, METH_VARARGS,
+        "compact([unum])\nMove up to unum pages toward the front of the file and truncate it at the end.  Returns True while the compaction is in progress." },
     { "sync", (PyCFunction)villa__sync, METH_VARARGS,
         "optimize()\n If successful, the return value is true, else, it is false. This function is useful when another process uses the connected database file." },
+    { "snapshot", (PyCFunction)villa__snapshot, METH_VARARGS,
+        "snapshot() -> villa\nReturn a read-only view of the database as of now, unaffected by later updates.  Close it before the database." },
     { "writable", (PyCFunction)villa__writable, METH_VARARGS,
         "writable()\nThe return value is true if the handle is a writer, false if not." },
     { "rnum", (PyCFunction)villa__rnum, METH_VARARGS,
@@ -547,10 +932,18 @@ static PyMethodDef villa_methods[] = {
     { "put", (PyCFunction)villa_put, METH_VARARGS,
         "put(key, value, mode) -> value\n"
         "Return the value for key if present, otherwie null" },
+    { "put_many", (PyCFunction)villa_put_many, METH_VARARGS,
+        "put_many(items[, mode]) -> True\n"
+        "Store (key, value) pairs or the items of a dict in one sorted pass over the tree" },
+    { "get_many", (PyCFunction)villa_get_many, METH_VARARGS,
+        "get_many(keys) -> dict\n"
+        "Return a dict of the keys present in the database and their values" },
     { "iterprefix", (PyCFunction)villa_iterprefix, METH_VARARGS,
         "D.iterprefix(prefix, mode) -> an iterator over the (key, value) items of D" },
     { "trunprefix", (PyCFunction)villa_trunprefix, METH_VARARGS,
-        "trunprefix(prefix, mode) -> remove all values key has prefix" },
+        "trunprefix(prefix[, mode]) -> remove all values key has prefix.\n"
+        "Leaves holding only such keys are dropped at once.  Returns False if\n"
+        "nothing was removed.  mode is ignored." },
     { "getlist", (PyCFunction)villa_getlist, METH_VARARGS,
         "getlist(key) -> list\n"
         "Return the list for key" },
@@ -686,40 +1079,33 @@ static PyObject *villaiter_iternextitem(villaiterobject *di)
     }
 
     assert(is_villaobject(d));
-    if (d->jmode == VL_JFORWARD){
-        key.dptr = vlcurkey(d->villa, &tmp_size);
-        if (key.dptr) {
-            vlcurnext(d->villa);
-        }
-        else {
-            if (dpecode != DP_ENOITEM) {
-                PyErr_SetString(VillaError, dperrmsg(dpecode));
-            }
-            goto fail;
+    if (d->jmode != VL_JFORWARD && !vlcurnext(d->villa)) {
+        if (dpecode != DP_ENOITEM) {
+            PyErr_SetString(VillaError, dperrmsg(dpecode));
         }
+        goto fail;
     }
-    else{
-        if (vlcurnext(d->villa)) {
-            key.dptr = vlcurkey(d->villa, &tmp_size);
-        }
-        else {
-            if (dpecode != DP_ENOITEM) {
-                PyErr_SetString(VillaError, dperrmsg(dpecode));
-            }
-            goto fail;
+    key.dptr = vlcurkey(d->villa, &tmp_size);
+    if (!key.dptr) {
+        if (dpecode != DP_ENOITEM) {
+            PyErr_SetString(VillaError, dperrmsg(dpecode));
         }
+        goto fail;
     }
-
     key.dsize = tmp_size;
-    pykey = PyString_FromStringAndSize(key.dptr, key.dsize);
 
-    if (!(val.dptr = vlget(d->villa, key.dptr, key.dsize, &tmp_size))) {
+    /* the value is read by the cursor, so that a scan does not count as lookups of the leaves */
+    if (!(val.dptr = vlcurval(d->villa, &tmp_size))) {
         PyErr_SetString(VillaError, dperrmsg(dpecode));
         free(key.dptr);
-        Py_DECREF(pykey);
         goto fail;
     }
     val.dsize = tmp_size;
+    if (d->jmode == VL_JFORWARD) {
+        vlcurnext(d->villa);
+    }
+
+    pykey = PyString_FromStringAndSize(key.dptr, key.dsize);
     pyval = PyString_FromStringAndSize(val.dptr, val.dsize);
     free(key.dptr);
     free(val.dptr);
@@ -748,7 +1134,7 @@ fail:
 
 static PyObject *villaiter_iternextvalue(villaiterobject *di)
 {
-    datum key, val;
+    datum val;
     PyObject *pyval;
     int tmp_size;
     villaobject *d = di->villa;
@@ -758,25 +1144,19 @@ static PyObject *villaiter_iternextvalue(villaiterobject *di)
     }
     assert(is_villaobject(d));
 
-    if (vlcurnext(d->villa)) {
-        key.dptr = vlcurkey(d->villa, &tmp_size);
-    }
-    else {
+    if (!vlcurnext(d->villa)) {
         if (dpecode != DP_ENOITEM) {
             PyErr_SetString(VillaError, dperrmsg(dpecode));
         }
         goto fail;
     }
-    key.dsize = tmp_size;
 
-    if (!(val.dptr = vlget(d->villa, key.dptr, key.dsize, &tmp_size))) {
+    if (!(val.dptr = vlcurval(d->villa, &tmp_size))) {
         PyErr_SetString(VillaError, dperrmsg(dpecode));
-        free(key.dptr);
         goto fail;
     }
     val.dsize = tmp_size;
     pyval = PyString_FromStringAndSize(val.dptr, val.dsize);
-    free(key.dptr);
     free(val.dptr);
 
     return pyval;
@@ -914,13 +1294,232 @@ villaopen(PyObject *self, PyObject *args)
             "arg 2 to open should be 'r', 'w', 'c', or 'n'");
         return NULL;
     }
+    if (flags[0] != '\0' && strchr(flags + 1, 'l')) {
+        iflags |= VL_OLARGE;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'm')) {
+        iflags |= VL_OMAPALL;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'j')) {
+        iflags |= VL_OWAL;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'd')) {
+        iflags |= VL_ODWRITE;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'a')) {
+        iflags |= VL_OAIO;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'p')) {
+        iflags |= VL_OPTAB;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 's')) {
+        iflags |= VL_OTHREAD;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 'f')) {
+        iflags = (iflags & ~VL_OYCOMP) | VL_OFCOMP;
+    }
+    if (flags[0] != '\0' && strchr(flags + 1, 't')) {
+        iflags = (iflags & ~(VL_OYCOMP | VL_OFCOMP)) | VL_ODCOMP;
+    }
     return new_villa_object(name, iflags, size);
 }
 
+static PyObject *
+villabulkload(PyObject *self, PyObject *args)
+{
+    char *name, *kbuf, *vbuf;
+    int ksiz, vsiz, fill = 100, err = 0;
+    PyObject *seq, *it, *item;
+    VILLA *villa;
+
+    if (!PyArg_ParseTuple(args, "sO|i:bulkload", &name, &seq, &fill)) {
+        return NULL;
+    }
+    if (!(it = PyObject_GetIter(seq))) {
+        return NULL;
+    }
+    if (!(villa = vlopen(name, VL_OWRITER | VL_OCREAT | VL_OTRUNC | VL_OYCOMP, VL_CMPLEX))) {
+        Py_DECREF(it);
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        return NULL;
+    }
+    if (!vlbulkbegin(villa, fill)) {
+        err = 1;
+    }
+    while (!err && (item = PyIter_Next(it)) != NULL) {
+        if (!PyArg_ParseTuple(item, "s#s#:bulkload", &kbuf, &ksiz, &vbuf, &vsiz)) {
+            err = 2;
+        } else if (!vlbulkput(villa, kbuf, ksiz, vbuf, vsiz)) {
+            err = 1;
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(it);
+    if (!err && PyErr_Occurred()) {
+        err = 2;
+    }
+    if (!err && !vlbulkend(villa)) {
+        err = 1;
+    }
+    if (err == 1) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+    }
+    if (!vlclose(villa) && !err) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        err = 1;
+    }
+    if (err) {
+        return NULL;
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+villasortload(PyObject *self, PyObject *args)
+{
+    char *name, *kbuf, *vbuf;
+    int ksiz, vsiz, fill = 100, max = 0, thnum = 1, err = 0;
+    PyObject *seq, *it, *item;
+    VILLA *villa;
+    VLSORT *sort;
+
+    if (!PyArg_ParseTuple(args, "sO|iii:sortload", &name, &seq, &fill, &max, &thnum)) {
+        return NULL;
+    }
+    if (!(it = PyObject_GetIter(seq))) {
+        return NULL;
+    }
+    if (!(villa = vlopen(name, VL_OWRITER | VL_OCREAT | VL_OTRUNC | VL_OYCOMP, VL_CMPLEX))) {
+        Py_DECREF(it);
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        return NULL;
+    }
+    if (!(sort = vlsortopen(villa, max, thnum))) {
+        err = 1;
+    }
+    while (!err && (item = PyIter_Next(it)) != NULL) {
+        if (!PyArg_ParseTuple(item, "s#s#:sortload", &kbuf, &ksiz, &vbuf, &vsiz)) {
+            err = 2;
+        } else if (!vlsortput(sort, kbuf, ksiz, vbuf, vsiz)) {
+            err = 1;
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(it);
+    if (!err && PyErr_Occurred()) {
+        err = 2;
+    }
+    if (!err) {
+        Py_BEGIN_ALLOW_THREADS
+        if (!vlsortload(sort, fill)) {
+            err = 1;
+        }
+        Py_END_ALLOW_THREADS
+    }
+    if (sort && !vlsortclose(sort) && !err) {
+        err = 1;
+    }
+    if (err == 1) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+    }
+    if (!vlclose(villa) && !err) {
+        PyErr_SetString(VillaError, dperrmsg(dpecode));
+        err = 1;
+    }
+    if (err) {
+        return NULL;
+    }
+    Py_RETURN_TRUE;
+}
+
+static PyObject *
+villalzfencode(PyObject *self, PyObject *args)
+{
+    char *ptr, *dbuf = NULL, *buf;
+    int size, dsiz = 0, bsiz;
+    PyObject *res;
+
+    if (!PyArg_ParseTuple(args, "s#|s#:lzfencode", &ptr, &size, &dbuf, &dsiz)) {
+        return NULL;
+    }
+    if (!(buf = cblzfencode(ptr, size, &bsiz, dbuf, dsiz))) {
+        PyErr_SetString(VillaError, "compression failed");
+        return NULL;
+    }
+    res = PyString_FromStringAndSize(buf, bsiz);
+    free(buf);
+    return res;
+}
+
+static PyObject *
+villalzfdecode(PyObject *self, PyObject *args)
+{
+    char *ptr, *dbuf = NULL, *buf;
+    int size, dsiz = 0, bsiz;
+    PyObject *res;
+
+    if (!PyArg_ParseTuple(args, "s#|s#:lzfdecode", &ptr, &size, &dbuf, &dsiz)) {
+        return NULL;
+    }
+    if (!(buf = cblzfdecode(ptr, size, &bsiz, dbuf, dsiz))) {
+        PyErr_SetString(VillaError, "broken compressed data");
+        return NULL;
+    }
+    res = PyString_FromStringAndSize(buf, bsiz);
+    free(buf);
+    return res;
+}
+
+static PyObject *
+villasyscount(PyObject *self, PyObject *args)
+{
+    int cnt = dpsyscnt, set = dpsyscnt;
+
+    if (!PyArg_ParseTuple(args, "|i:syscount", &set)) {
+        return NULL;
+    }
+    dpsyscnt = set;
+    return PyInt_FromLong((long)cnt);
+}
+
 static PyMethodDef villamodule_methods[] = {
     { "open", (PyCFunction)villaopen, METH_VARARGS,
         "open(path[, flag[, size]]) -> mapping\n"
-        "Return a database object." },
+        "Return a database object.  Append 'l' to flag ('cl' or 'nl') to\n"
+        "create a large file which can grow beyond 2GB, 'm' to map the\n"
+        "whole file into memory, 'j' to log updates ahead so that a\n"
+        "commit only appends to the log and a crash is recovered, 'd'\n"
+        "to write pages back through a double write log so that a crash\n"
+        "leaves the state of the last commit or sync, 'a' to read and\n"
+        "write pages with asynchronous I/O, 'p' to look up pages\n"
+        "through a table of their locations kept beside the file, 's' to\n"
+        "share the handle among threads, which run while it reads or\n"
+        "writes, 'f' to compress leaves with the fast LZ codec, and 't'\n"
+        "to compress them with the fast LZ codec and a dictionary trained\n"
+        "from the first leaves.  Files created with 'f' or 't' are not\n"
+        "readable by versions without the codec." },
+    { "bulkload", (PyCFunction)villabulkload, METH_VARARGS,
+        "bulkload(path, iterable[, fill])\n"
+        "Create a database from (key, value) pairs sorted by key.  Leaves\n"
+        "and nodes are filled up to `fill' percent and written in order." },
+    { "sortload", (PyCFunction)villasortload, METH_VARARGS,
+        "sortload(path, iterable[, fill[, memory[, threads]]])\n"
+        "Create a database from (key, value) pairs in any order.  Pairs are\n"
+        "sorted within `memory' bytes by `threads' threads, spilling sorted\n"
+        "runs to temporary files, and merged into bulk loading." },
+    { "lzfencode", (PyCFunction)villalzfencode, METH_VARARGS,
+        "lzfencode(data[, dict]) -> string\n"
+        "Compress data with the fast LZ codec used for leaves.  Matches may\n"
+        "refer to the last 65535 bytes of `dict' as if they preceded data." },
+    { "lzfdecode", (PyCFunction)villalzfdecode, METH_VARARGS,
+        "lzfdecode(data[, dict]) -> string\n"
+        "Decompress data compressed by lzfencode with the same `dict'.\n"
+        "Raise error if data is truncated or broken." },
+    { "syscount", (PyCFunction)villasyscount, METH_VARARGS,
+        "syscount([count]) -> int\n"
+        "Return the number of system calls made to read or write database\n"
+        "files, or -1 if they are not counted, and set it to `count' if it\n"
+        "is given.  Counting starts at 0 and stops at -1." },
     { 0, 0 },
 };
 
@@ -946,6 +1545,8 @@ initvilla(void)
     PyModule_AddIntMacro(m, VL_DKEEP);
     PyModule_AddIntMacro(m, VL_DCAT);
     PyModule_AddIntMacro(m, VL_DDUP);
+    PyModule_AddIntMacro(m, VL_CRLRU);
+    PyModule_AddIntMacro(m, VL_CR2Q);
     PyModule_AddIntMacro(m, VL_DDUPR);
     PyModule_AddIntMacro(m, VL_JFORWARD);
     PyModule_AddIntMacro(m, VL_JBACKWARD);
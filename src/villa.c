@@ -35,12 +35,44 @@
 #define VL_FBPOOLSIZ   128               /* size of free block pool */
 #define VL_PATHBUFSIZ  1024              /* size of a path buffer */
 #define VL_TMPFSUF     MYEXTSTR "vltmp"  /* suffix of a temporary file */
+#define VL_WALSUF      MYEXTSTR "vlwal"  /* suffix of a write ahead log */
+#define VL_PTSUF       MYEXTSTR "vlpt"   /* suffix of a table of the locations of pages */
+#define VL_PTMAGIC     "[VLPT]\n\f"      /* magic data of a table of locations */
+#define VL_PTMAGSIZ    8                 /* size of the magic data of a table of locations */
+#define VL_PTHEADSIZ   32                /* size of the header of a table of locations */
+#define VL_PTINITNUM   1024              /* initial number of entries of each kind of pages */
+#define VL_WALHEAD     9                 /* size of the header of each frame of a log */
+#define VL_WALBUFSIZ   65536             /* size of operations buffered out of the transaction */
+#define VL_DEFWALMAX   16777216          /* default size of a log invoking a checkpoint */
+#define VL_DEFRAMAX    32                /* default max number of leaves read ahead */
+#define VL_RAWINMIN    2                 /* initial window of leaves read ahead */
+#define VL_AIODEPTH    64                /* max number of pages submitted at once */
 #define VL_ROOTKEY     -1                /* key of the root key */
 #define VL_LASTKEY     -2                /* key of the last key */
 #define VL_LNUMKEY     -3                /* key of the number of leaves */
 #define VL_NNUMKEY     -4                /* key of the number of nodes */
 #define VL_RNUMKEY     -5                /* key of the number of records */
+#define VL_FREEKEY     -6                /* key of the IDs of freed pages */
+#define VL_DICTKEY     -7                /* key of the dictionary for leaves */
+#define VL_SNAPKEY     -8                /* key of the mark of pages kept for snapshots */
+#define VL_PTABKEY     -9                /* key of the stamp of the table of locations */
+#define VL_DICTMAX     4096              /* max size of the dictionary for leaves */
+#define VL_DICTSMPMAX  131072            /* size of samples to train the dictionary */
+#define VL_DICTSMPUNIT 8192              /* max size of samples taken from each leaf */
+#define VL_DICTSEGSIZ  64                /* size of each segment of the dictionary */
+#define VL_DICTGRAM    6                 /* size of each substring counted by the trainer */
+#define VL_DICTHBITS   16                /* number of bits of hash values of the trainer */
+#define VL_LEAFUNDER   4                 /* divisor of the capacity of an underflowing leaf */
+#define VL_KEYRESTART  16                /* interval of keys written in full in a page */
 #define VL_CRDNUM      7                 /* default division number for Vista */
+#define VL_CHUNKMIN    1024              /* size of the smallest chunk of arenas */
+#define VL_CHUNKPOOL   64                /* max number of pooled chunks of each class */
+#define VL_DEFSORTMAX  (1<<26)           /* default max size of memory of a sorter */
+#define VL_SORTMINBUF  65536             /* minimum size of a buffer to read a run */
+#define VL_SORTFANIN   256               /* max number of runs merged at once */
+#define VL_SORTTHMAX   16                /* max number of threads to sort records */
+#define VL_SORTTHMIN   4096              /* minimum number of records sorted by a thread */
+#define VL_SORTINSMAX  16                /* max number of records sorted by insertion */
 
 /* set a buffer for a variable length number */
 #define VL_SETVNUMBUF(VL_len, VL_buf, VL_num) \
@@ -87,13 +119,299 @@
     } \
   } while(FALSE)
 
+/* set a datum referring to a region of the page of a leaf */
+#define VL_SETSLICE(VL_datum, VL_ptr, VL_size) \
+  do { \
+    (VL_datum)->dptr = (VL_ptr); \
+    (VL_datum)->dsize = (VL_size); \
+    (VL_datum)->asize = 0; \
+  } while(FALSE)
+
+/* get the pointer to the variable accounting the memory of a node */
+#define VL_NODESUMP(VL_villa, VL_node) \
+  ((VL_node)->pin ? &((VL_villa)->pinsiz) : &((VL_villa)->nodecsiz))
+
+/* check whether the memory of a cache exceeds the limit */
+#define VL_CACHEOVER(VL_siz, VL_max) \
+  ((VL_max) > 0 && (VL_siz) > (VL_max))
+
+#if defined(MYPTHREAD)
+
+/* lock the caches of a handle shared by threads */
+#define VL_CACHELOCK(VL_villa) \
+  do { \
+    if((VL_villa)->mutex) pthread_mutex_lock((pthread_mutex_t *)(VL_villa)->mutex); \
+  } while(FALSE)
+
+/* unlock the caches of a handle shared by threads */
+#define VL_CACHEUNLOCK(VL_villa) \
+  do { \
+    if((VL_villa)->mutex) pthread_mutex_unlock((pthread_mutex_t *)(VL_villa)->mutex); \
+  } while(FALSE)
+
+/* add a holder to a page in the caches of a handle shared by threads */
+#define VL_PAGEHOLD(VL_villa, VL_page) \
+  do { \
+    if((VL_villa)->mutex) __sync_fetch_and_add(&((VL_page)->refs), 1); \
+  } while(FALSE)
+
+/* remove a holder from a page in the caches of a handle shared by threads */
+#define VL_PAGERELEASE(VL_villa, VL_page) \
+  do { \
+    if((VL_villa)->mutex) __sync_fetch_and_sub(&((VL_page)->refs), 1); \
+  } while(FALSE)
+
+/* check whether a page in the caches of a handle shared by threads is held */
+#define VL_PAGEBUSY(VL_villa, VL_page) \
+  ((VL_villa)->mutex && __sync_fetch_and_add(&((VL_page)->refs), 0) > 0)
+
+/* latch a page shared by a writer and readers */
+#define VL_LATCHLOCK(VL_page, VL_ex) \
+  do { \
+    if((VL_page)->latch){ \
+      if(VL_ex){ \
+        pthread_rwlock_wrlock((pthread_rwlock_t *)(VL_page)->latch); \
+      } else { \
+        pthread_rwlock_rdlock((pthread_rwlock_t *)(VL_page)->latch); \
+      } \
+    } \
+  } while(FALSE)
+
+/* unlatch a page shared by a writer and readers */
+#define VL_LATCHUNLOCK(VL_page) \
+  do { \
+    if((VL_page)->latch) pthread_rwlock_unlock((pthread_rwlock_t *)(VL_page)->latch); \
+  } while(FALSE)
+
+/* latch the tree of a handle shared by a writer and readers */
+#define VL_TREELOCK(VL_villa, VL_ex) \
+  do { \
+    if((VL_villa)->tlatch){ \
+      pthread_mutex_lock(&(((VLTLATCH *)(VL_villa)->tlatch)->gate)); \
+      if(VL_ex){ \
+        pthread_rwlock_wrlock(&(((VLTLATCH *)(VL_villa)->tlatch)->rwlock)); \
+      } else { \
+        pthread_rwlock_rdlock(&(((VLTLATCH *)(VL_villa)->tlatch)->rwlock)); \
+      } \
+      pthread_mutex_unlock(&(((VLTLATCH *)(VL_villa)->tlatch)->gate)); \
+    } \
+  } while(FALSE)
+
+/* unlatch the tree of a handle shared by a writer and readers */
+#define VL_TREEUNLOCK(VL_villa) \
+  do { \
+    if((VL_villa)->tlatch) \
+      pthread_rwlock_unlock(&(((VLTLATCH *)(VL_villa)->tlatch)->rwlock)); \
+  } while(FALSE)
+
+/* latch the internal database of a handle shared by a writer and readers */
+#define VL_DEPOTLOCK(VL_villa, VL_ex) \
+  do { \
+    if((VL_villa)->dlatch){ \
+      if(VL_ex){ \
+        pthread_rwlock_wrlock((pthread_rwlock_t *)(VL_villa)->dlatch); \
+      } else { \
+        pthread_rwlock_rdlock((pthread_rwlock_t *)(VL_villa)->dlatch); \
+      } \
+    } \
+  } while(FALSE)
+
+/* unlatch the internal database of a handle shared by a writer and readers */
+#define VL_DEPOTUNLOCK(VL_villa) \
+  do { \
+    if((VL_villa)->dlatch) pthread_rwlock_unlock((pthread_rwlock_t *)(VL_villa)->dlatch); \
+  } while(FALSE)
+
+/* get the value of a variable shared by threads */
+#define VL_ATOMICGET(VL_var) \
+  (__sync_fetch_and_add(&(VL_var), 0))
+
+/* set the value of a variable shared by threads */
+#define VL_ATOMICSET(VL_var, VL_val) \
+  do { \
+    int _VL_old; \
+    do { \
+      _VL_old = VL_ATOMICGET(VL_var); \
+    } while(!__sync_bool_compare_and_swap(&(VL_var), _VL_old, (VL_val))); \
+  } while(FALSE)
+
+/* increment the value of a variable shared by threads */
+#define VL_ATOMICINC(VL_var) \
+  do { \
+    __sync_fetch_and_add(&(VL_var), 1); \
+  } while(FALSE)
+
+#else
+
+#define VL_CACHELOCK(VL_villa) \
+  do { } while(FALSE)
+#define VL_CACHEUNLOCK(VL_villa) \
+  do { } while(FALSE)
+#define VL_PAGEHOLD(VL_villa, VL_page) \
+  do { } while(FALSE)
+#define VL_PAGERELEASE(VL_villa, VL_page) \
+  do { } while(FALSE)
+#define VL_PAGEBUSY(VL_villa, VL_page) \
+  (FALSE)
+#define VL_LATCHLOCK(VL_page, VL_ex) \
+  do { } while(FALSE)
+#define VL_LATCHUNLOCK(VL_page) \
+  do { } while(FALSE)
+#define VL_TREELOCK(VL_villa, VL_ex) \
+  do { } while(FALSE)
+#define VL_TREEUNLOCK(VL_villa) \
+  do { } while(FALSE)
+#define VL_DEPOTLOCK(VL_villa, VL_ex) \
+  do { } while(FALSE)
+#define VL_DEPOTUNLOCK(VL_villa) \
+  do { } while(FALSE)
+#define VL_ATOMICGET(VL_var) \
+  (VL_var)
+#define VL_ATOMICSET(VL_var, VL_val) \
+  do { (VL_var) = (VL_val); } while(FALSE)
+#define VL_ATOMICINC(VL_var) \
+  do { (VL_var)++; } while(FALSE)
+
+#endif
+
+/* round up a size to the alignment of regions in arenas */
+#define VL_ARENAPAD(VL_size) \
+  (((VL_size) + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *))
+
+/* get the pointer to the unused region of a chunk */
+#define VL_CHUNKTOP(VL_chunk) \
+  ((char *)(VL_chunk) + sizeof(VLCHUNK) + (VL_chunk)->used)
+
+/* insert an element allocated in an arena into a list */
+#define VL_LISTINSERTBUF(VL_list, VL_index, VL_ptr, VL_size) \
+  do { \
+    CBLISTDATUM _VL_elem; \
+    int _VL_index, _VL_last; \
+    _VL_index = (VL_list)->start + (VL_index); \
+    _VL_last = (VL_list)->start + (VL_list)->num; \
+    CB_LISTPUSHBUF((VL_list), (VL_ptr), (VL_size)); \
+    _VL_elem = (VL_list)->array[_VL_last]; \
+    memmove((VL_list)->array + _VL_index + 1, (VL_list)->array + _VL_index, \
+            sizeof((VL_list)->array[0]) * (_VL_last - _VL_index)); \
+    (VL_list)->array[_VL_index] = _VL_elem; \
+  } while(FALSE)
+
+/* close a list whose elements are allocated in an arena */
+#define VL_LISTCLOSEBUF(VL_list) \
+  do { \
+    free((VL_list)->array); \
+    free((VL_list)); \
+  } while(FALSE)
+
+#if defined(MYPTHREAD)
+
+typedef struct {                         /* type of structure for the latch of a tree */
+  pthread_rwlock_t rwlock;               /* latch shared by readers and taken by the writer */
+  pthread_mutex_t gate;                  /* gate holding back readers while the writer waits */
+} VLTLATCH;
+
+#endif
+
+enum {                                   /* enumeration for the header of a table of locations */
+  VL_PTCLEANOFF = 8,                     /* offset of the flag of a table closed cleanly */
+  VL_PTSTAMPOFF = 12,                    /* offset of the stamp shared with the database */
+  VL_PTLCAPOFF = 16,                     /* offset of the number of entries of leaves */
+  VL_PTNCAPOFF = 20,                     /* offset of the number of entries of nodes */
+  VL_PTFSIZOFF = 24                      /* offset of the size of the database file */
+};
+
+typedef struct {                         /* type of structure for an entry of a table of locations */
+  long long off;                         /* offset of the record of the page or 0 if unknown */
+  int size;                              /* size of the record */
+  int pad;                               /* padding for alignment */
+} VLPTENT;
+
+typedef struct {                         /* type of structure for a table of locations of pages */
+  int fd;                                /* file descriptor of the table */
+  int wmode;                             /* whether the table is updated */
+  char *map;                             /* mapped region of the table */
+  int msiz;                              /* size of the mapped region */
+  int lcap;                              /* number of entries of leaves */
+  int ncap;                              /* number of entries of nodes */
+  int stamp;                             /* stamp shared with the database */
+  int hits;                              /* number of pages read through the table */
+  int misses;                            /* number of pages not found in the table */
+} VLPTAB;
+
+typedef struct {                         /* type of structure for a job to sort records */
+  VLCFUNC cmp;                           /* comparing function */
+  char **recs;                           /* array of records */
+  char **tmp;                            /* working array */
+  int num;                               /* number of records */
+  char path[VL_PATHBUFSIZ];              /* name of the file of the run or empty */
+  int err;                               /* whether an error occurred */
+} VLSORTJOB;
+
+typedef struct {                         /* type of structure for a source of a merge */
+  FILE *ifp;                             /* stream of the file of a run or `NULL' */
+  char *rbuf;                            /* buffer of the stream */
+  char **recs;                           /* array of records on memory */
+  int num;                               /* number of records on memory */
+  int idx;                               /* index of the next record on memory */
+  char *bufs[2];                         /* buffers of the current and previous records */
+  int bsizs[2];                          /* sizes of the buffers */
+  int cur;                               /* index of the buffer of the current record */
+} VLSORTSRC;
+
+typedef struct {                         /* type of structure for an entry of a merge heap */
+  VLCFUNC cmp;                           /* comparing function */
+  const char *rec;                       /* current record or `NULL' if exhausted */
+  int src;                               /* index of the source */
+} VLSORTENT;
+
+enum {                                   /* enumeration for states of cached pages */
+  VL_HSCAN = -1,                         /* on probation and read by cursors */
+  VL_HCOLD,                              /* on probation */
+  VL_HHOT                                /* protected */
+};
+
 enum {                                   /* enumeration for flags */
   VL_FLISVILLA = 1 << 0,                 /* whether for Villa */
   VL_FLISZLIB = 1 << 1,                  /* whether with ZLIB */
   VL_FLISLZO = 1 << 2,                   /* whether with LZO */
-  VL_FLISBZIP = 1 << 3                   /* whether with BZIP2 */
+  VL_FLISBZIP = 1 << 3,                  /* whether with BZIP2 */
+  VL_FLISFRONT = 1 << 4,                 /* whether keys are front-coded */
+  VL_FLISLZF = 1 << 5,                   /* whether with the fast LZ codec */
+  VL_FLISDICT = 1 << 6,                  /* whether with a trained dictionary */
+  VL_FLISCODEC = 1 << 7                  /* whether each leaf is tagged with its codec */
+};
+
+enum {                                   /* enumeration for codecs of leaves */
+  VL_CDNONE,                             /* not compressed */
+  VL_CDZLIB,                             /* ZLIB */
+  VL_CDLZO,                              /* LZO */
+  VL_CDBZIP,                             /* BZIP2 */
+  VL_CDLZF,                              /* fast LZ */
+  VL_CDDICT,                             /* fast LZ with a trained dictionary */
+  VL_CDNUM                               /* number of codecs */
+};
+
+enum {                                   /* enumeration for frames of a write ahead log */
+  VL_WFOPS = 'O',                        /* records of operations */
+  VL_WFPAGE = 'P',                       /* image of a page written by a checkpoint */
+  VL_WFCKPT = 'C'                        /* end of a checkpoint */
+};
+
+enum {                                   /* enumeration for operations in a write ahead log */
+  VL_WOPUT,                              /* storing a record */
+  VL_WOOUT,                              /* deleting a record */
+  VL_WOCURPUT,                           /* storing a value at the cursor */
+  VL_WOCUROUT,                           /* deleting the value at the cursor */
+  VL_WORANGE                             /* deleting records in a range of keys */
 };
 
+typedef struct {                         /* type of structure for a codec of leaves */
+  int omode;                             /* open mode selecting the codec */
+  int flag;                              /* flag of a database written with the codec */
+  char *(*encode)(const char *, int, int *, const CBDATUM *);  /* compressing function */
+  char *(*decode)(const char *, int, int *, const CBDATUM *);  /* decompressing function */
+} VLCODEC;
+
 
 /* private function prototypes */
 static int vllexcompare(const char *aptr, int asiz, const char *bptr, int bsiz);
@@ -102,24 +420,145 @@ static int vlnumcompare(const char *aptr, int asiz, const char *bptr, int bsiz);
 static int vldeccompare(const char *aptr, int asiz, const char *bptr, int bsiz);
 static int vldpputnum(DEPOT *depot, int knum, int vnum);
 static int vldpgetnum(DEPOT *depot, int knum, int *vnp);
+static int vldpputfree(VILLA *villa);
+static int vldpgetfree(VILLA *villa);
+static int vlsnapkeep(VILLA *villa, int id);
+static int vlsnapkey(VILLA *villa, int id, int *dkey);
+static int vlsnapdrop(VILLA *snap);
+static int vlsnapsweep(DEPOT *depot);
+static int vlptabopen(VILLA *villa);
+static int vlptabclose(VILLA *villa, int clean, double fsiz);
+static int vlptabdrop(DEPOT *depot);
+static VLPTENT *vlptabent(VLPTAB *ptab, int id);
+static int vlptabgrow(VLPTAB *ptab, int id);
+static void vlptabset(VILLA *villa, int id, long long off, int size, int grow);
+static void vlptabupdate(VILLA *villa, int id, int last);
+static void vlptabclear(VILLA *villa);
+static const char *vlptabread(VILLA *villa, int id, char *wbuf, char **bufp, int *sp);
+static int vlwalopen(VILLA *villa, int wal);
+static int vlwallog(VILLA *villa, int op, int num, int vidx,
+                    const char *kbuf, int ksiz, const char *vbuf, int vsiz);
+static int vlwalflush(VILLA *villa, int sync);
+static int vlwalcheckpoint(VILLA *villa);
+static int vlwalapply(DEPOT *depot, VILLA *villa, const char *ptr, int size);
+static int vlwalrecover(VILLA *villa);
+static int vlwalredo(const char *name, DEPOT *depot);
+static char *vlwalread(int fd, int *sp);
+static int vlwalscan(const char *buf, int size, int *ckbp, int *ckep);
+static int vlwalreplay(VILLA *villa, const char *ptr, int size);
+static int vlwalseek(VILLA *villa, const char *kbuf, int ksiz, int vidx);
+static void vlwalseal(char *ptr, int type, int size);
+static unsigned int vlwalsum(const char *ptr, int size);
+static int vlwalwrite(int fd, const char *buf, int size);
+static void vlcachedrop(VILLA *villa);
+static int vlkeyshared(const char *abuf, int asiz, const char *bbuf, int bsiz);
+static int vlsepsize(VILLA *villa, const CBDATUM *lkey, const char *rbuf, int rsiz);
+static int vlpagenewid(VILLA *villa, int node);
+static int vlpagefree(VILLA *villa, int id);
 static VLLEAF *vlleafnew(VILLA *villa, int prev, int next);
 static int vlleafcacheout(VILLA *villa, int id);
+static void vlleafclose(VILLA *villa, VLLEAF *leaf);
 static int vlleafsave(VILLA *villa, VLLEAF *leaf);
-static VLLEAF *vlleafload(VILLA *villa, int id);
+static char *vlleafencode(VILLA *villa, VLLEAF *leaf, int *sp);
+static VLLEAF *vlleafload(VILLA *villa, int id, int seq);
+static VLLEAF *vlleafcachein(VILLA *villa, int id, int seq, int hold);
+static VLLEAF *vlleafcacheimage(VILLA *villa, int id, int seq, int hold, char *buf,
+                                const char *pbuf, int size, const CBDATUM *dict, int saves);
+static int vlleafstage(VILLA *villa, const int *ids, int num, int seq);
+static int vlleafstagekeys(VILLA *villa, const CBLIST *keys, const int *idxs, int num, int start);
+static VLLEAF *vlkeyleaf(VILLA *villa, const char *kbuf, int ksiz);
+static int vlkeyleafrelease(VILLA *villa, VLLEAF *leaf);
+static VLLEAF *vlcrableaf(VILLA *villa, const char *kbuf, int ksiz, int ex);
+static int vlputlatch(VILLA *villa, const char *kbuf, int ksiz,
+                      const char *vbuf, int vsiz, int dmode);
+static void vlleafcompact(VILLA *villa, VLLEAF *leaf);
 static VLLEAF *vlgethistleaf(VILLA *villa, const char *kbuf, int ksiz);
 static int vlleafaddrec(VILLA *villa, VLLEAF *leaf, int dmode,
                         const char *kbuf, int ksiz, const char *vbuf, int vsiz);
-static int vlleafdatasize(VLLEAF *leaf);
+static int vlleafdatasize(VILLA *villa, VLLEAF *leaf);
+static int vlleafover(VILLA *villa, VLLEAF *leaf);
+static int vlleafunder(VILLA *villa, VLLEAF *leaf);
 static VLLEAF *vlleafdivide(VILLA *villa, VLLEAF *leaf);
+static int vlleafmove(VILLA *villa, VLLEAF *src, VLLEAF *dest, int front, int num);
+static int vlleafmerge(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz);
+static int vlleafcut(VILLA *villa, VLLEAF *leaf, int beg, int end);
+static int vlleafunlink(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz);
+static int vlleafsplit(VILLA *villa, VLLEAF *leaf);
+static int vlleafbound(VILLA *villa, const int *hist, int hnum, int id, CBDATUM **boundp);
+static void vlbatchsort(VLCFUNC cmp, const CBLIST *keys, int *idxs, int *tmp, int num);
 static VLNODE *vlnodenew(VILLA *villa, int heir);
 static int vlnodecacheout(VILLA *villa, int id);
 static int vlnodesave(VILLA *villa, VLNODE *node);
+static char *vlnodeencode(VILLA *villa, VLNODE *node, int *sp);
 static VLNODE *vlnodeload(VILLA *villa, int id);
+static VLNODE *vlnodecachein(VILLA *villa, int id, int hold, int pin);
+static void vlnodecompact(VILLA *villa, VLNODE *node);
+static void vlnodepin(VILLA *villa, VLNODE *node, int pin);
+static int vlnodechild(VLNODE *node, int pid);
+static void vlnodesetidx(VILLA *villa, VLNODE *node, int index, const CBDATUM *key);
+static int vlnodemerge(VILLA *villa, int level);
+static int vlnodepinload(VILLA *villa, int id, int level);
+static int vlbulkaddidx(VILLA *villa, int level, int prev, int pid, const char *kbuf, int ksiz);
+static void *vlsortjob(void *arg);
+static int vlsortrun(VLSORT *sort, VLSORTJOB *jobs, int spill);
+static int vlsortspill(VLSORT *sort);
+static void vlsortrecs(VLCFUNC cmp, char **recs, char **tmp, int num);
+static int vlsortcmp(VLCFUNC cmp, const char *arec, const char *brec);
+static int vlsortentcmp(const void *a, const void *b);
+static const char *vlsortnext(VLSORTSRC *src, int *errp);
+static int vlsortmerge(VLSORT *sort, VLSORTSRC *srcs, int num, FILE *ofp);
 static void vlnodeaddidx(VILLA *villa, VLNODE *node, int order,
                          int pid, const char *kbuf, int ksiz);
 static int vlsearchleaf(VILLA *villa, const char *kbuf, int ksiz);
+static int vlsearchpath(VILLA *villa, const char *kbuf, int ksiz, int *hist, int *hnp);
+static int vlnoderoute(VILLA *villa, VLNODE *node, const char *kbuf, int ksiz);
 static int vlcacheadjust(VILLA *villa);
+static int vlcacheshrink(VILLA *villa);
+static int vlcachetrim(VILLA *villa, int clean);
+static int vlcachetake(VILLA *villa, int node, int id, CBDATUM *imgs);
+static int vlcachewrite(VILLA *villa, CBDATUM *imgs);
+static int vlcacheheat(VILLA *villa, int node, int id, int seq);
+static void vlcachehit(VILLA *villa, int node, int id, int *heatp, int seq);
+static int vlcachevictim(VILLA *villa, int node, int clean);
+static VLLEAF *vlmulcurseek(VLMULCUR *mulcur, int id, int back);
+static void vlmulcurrelease(VLMULCUR *mulcur);
+static void vlreadahead(VILLA *villa, VLLEAF *leaf, int *winp, int *leftp);
 static VLREC *vlrecsearch(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz, int *ip);
+static VLREC *vlrecnew(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz,
+                       const char *vbuf, int vsiz, int copy);
+static void vlrecsetfirst(VILLA *villa, VLLEAF *leaf, VLREC *recp,
+                          const char *vbuf, int vsiz, int cat);
+static VLIDX *vlidxnew(VILLA *villa, VLNODE *node, int pid, const char *kbuf, int ksiz, int copy);
+static int vlchunkclass(int size);
+static char *vlarenaalloc(VILLA *villa, VLCHUNK **arenap, int size, int *sump);
+static void vlarenaclose(VILLA *villa, VLCHUNK *arena, int *sump);
+static void *vllatchopen(VILLA *villa);
+static void vllatchclose(void *latch);
+static void vldepotlatch(VILLA *villa);
+static void vlaiobegin(VILLA *villa);
+static int vlaioend(VILLA *villa);
+static char *vlzlibencode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vlzlibdecode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vllzoencode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vllzodecode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vlbzipencode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vlbzipdecode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vllzfencode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static char *vllzfdecode(const char *ptr, int size, int *sp, const CBDATUM *dict);
+static int vlcodecid(int cmode);
+static int vldictfeed(VILLA *villa, const char *ptr, int size);
+static CBDATUM *vldicttrain(const char *ptr, int size, int max);
+
+
+/* table of codecs of leaves indexed by their IDs */
+static const VLCODEC vlcodecs[VL_CDNUM] = {
+  { 0, 0, NULL, NULL },
+  { VL_OZCOMP, VL_FLISZLIB, vlzlibencode, vlzlibdecode },
+  { VL_OYCOMP, VL_FLISLZO, vllzoencode, vllzodecode },
+  { VL_OXCOMP, VL_FLISBZIP, vlbzipencode, vlbzipdecode },
+  { VL_OFCOMP, VL_FLISLZF, vllzfencode, vllzfdecode },
+  { VL_ODCOMP, VL_FLISDICT, vllzfencode, vllzfdecode }
+};
 
 
 
@@ -138,10 +577,18 @@ VLCFUNC VL_CMPDEC = vldeccompare;
 /* Get a database handle. */
 VILLA *vlopen(const char *name, int omode, VLCFUNC cmp){
   DEPOT *depot;
-  int dpomode, flags, cmode, root, last, lnum, nnum, rnum;
+  int i, dpomode, flags, cmode, ocmode, fcode, pcodec, root, last, lnum, nnum, rnum, knum, vsiz;
+  CBDATUM *dict;
+  char *vbuf;
   VILLA *villa;
   VLLEAF *leaf;
   assert(name && cmp);
+#if !defined(MYPTHREAD)
+  if(omode & VL_OTHREAD){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return NULL;
+  }
+#endif
   dpomode = DP_OREADER;
   if(omode & VL_OWRITER){
     dpomode = DP_OWRITER;
@@ -150,9 +597,39 @@ VILLA *vlopen(const char *name, int omode, VLCFUNC cmp){
   }
   if(omode & VL_ONOLCK) dpomode |= DP_ONOLCK;
   if(omode & VL_OLCKNB) dpomode |= DP_OLCKNB;
-  if(!(depot = dpopen(name, dpomode, VL_INITBNUM))) return NULL;
+  if(omode & VL_OLARGE) dpomode |= DP_OLARGE;
+  if(omode & VL_OMAPALL) dpomode |= DP_OMAPALL;
+  depot = dpopen(name, dpomode, VL_INITBNUM);
+  if((omode & VL_OWRITER) && (depot || dpecode == DP_EBROKEN)){
+    /* a checkpoint interrupted by a crash is written again before the meta data is read, and
+       the file is repaired first if the crash left it broken, including records whose queued
+       writes were lost while the chains referring to them were updated */
+    if(!depot && vlwalredo(name, NULL) == 1 && dprepair(name))
+      depot = dpopen(name, dpomode, VL_INITBNUM);
+    if(depot && vlwalredo(name, depot) == -1){
+      dpclose(depot);
+      depot = NULL;
+      if(vlwalredo(name, NULL) == 1 && dprepair(name) &&
+         (depot = dpopen(name, dpomode, VL_INITBNUM)) != NULL && vlwalredo(name, depot) == -1){
+        dpclose(depot);
+        depot = NULL;
+      }
+      if(!depot) return NULL;
+    }
+  }
+  if(!depot) return NULL;
   flags = dpgetflags(depot);
   cmode = 0;
+  ocmode = 0;
+  for(i = 1; i < VL_CDNUM; i++){
+    if(omode & vlcodecs[i].omode){
+      ocmode = vlcodecs[i].omode;
+      break;
+    }
+  }
+  fcode = FALSE;
+  pcodec = FALSE;
+  dict = NULL;
   root = -1;
   last = -1;
   lnum = 0;
@@ -168,65 +645,150 @@ VILLA *vlopen(const char *name, int omode, VLCFUNC cmp){
       dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
       return NULL;
     }
-    if(flags & VL_FLISZLIB){
-      cmode = VL_OZCOMP;
-    } else if(flags & VL_FLISLZO){
-      cmode = VL_OYCOMP;
-    } else if(flags & VL_FLISBZIP){
-      cmode = VL_OXCOMP;
+    for(i = 1; i < VL_CDNUM; i++){
+      if(flags & vlcodecs[i].flag){
+        cmode = vlcodecs[i].omode;
+        break;
+      }
+    }
+    if(flags & VL_FLISFRONT) fcode = TRUE;
+    if(flags & VL_FLISCODEC){
+      pcodec = TRUE;
+      if((omode & VL_OWRITER) && ocmode) cmode = ocmode;
+      knum = VL_DICTKEY;
+      if((vbuf = dpget(depot, (char *)&knum, sizeof(int), 0, -1, &vsiz)) != NULL){
+        dict = cbdatumopen(vbuf, vsiz);
+        free(vbuf);
+      }
     }
   } else if(omode & VL_OWRITER){
-    if(omode & VL_OZCOMP){
-      cmode = VL_OZCOMP;
-    } else if(omode & VL_OYCOMP){
-      cmode = VL_OYCOMP;
-    } else if(omode & VL_OXCOMP){
-      cmode = VL_OXCOMP;
-    }
+    fcode = TRUE;
+    pcodec = TRUE;
+    cmode = ocmode;
   }
   if(omode & VL_OWRITER){
     flags |= VL_FLISVILLA;
-    if(_qdbm_deflate && cmode == VL_OZCOMP){
-      flags |= VL_FLISZLIB;
-    } else if(_qdbm_lzoencode && cmode == VL_OYCOMP){
-      flags |= VL_FLISLZO;
-    } else if(_qdbm_bzencode && cmode == VL_OXCOMP){
-      flags |= VL_FLISBZIP;
+    if(pcodec){
+      for(i = 1; i < VL_CDNUM; i++){
+        flags &= ~vlcodecs[i].flag;
+      }
+      flags |= VL_FLISCODEC;
     }
+    flags |= vlcodecs[vlcodecid(cmode)].flag;
+    if(fcode) flags |= VL_FLISFRONT;
     if(!dpsetflags(depot, flags) || !dpsetalign(depot, VL_PAGEALIGN) ||
-       !dpsetfbpsiz(depot, VL_FBPOOLSIZ)){
+       !dpsetfbpsiz(depot, VL_FBPOOLSIZ) ||
+       (vldpgetnum(depot, VL_SNAPKEY, &knum) && !vlsnapsweep(depot)) ||
+       (!(omode & VL_OPTAB) && !vlptabdrop(depot))){
+      if(dict) cbdatumclose(dict);
       dpclose(depot);
       return NULL;
     }
   }
+  if((omode & (VL_OWRITER | VL_OAIO)) &&
+     !dpsetaio(depot, VL_AIODEPTH, (omode & VL_OAIO) ? DP_AIOURING : DP_AIOSYNC)){
+    if(dict) cbdatumclose(dict);
+    dpclose(depot);
+    return NULL;
+  }
   CB_MALLOC(villa, sizeof(VILLA));
   villa->depot = depot;
   villa->cmp = cmp;
   villa->wmode = (omode & VL_OWRITER);
   villa->cmode = cmode;
+  villa->fcode = fcode;
+  villa->pcodec = pcodec;
+  villa->codec = vlcodecid(cmode);
+  villa->dict = dict;
+  villa->dictsmp = NULL;
   villa->root = root;
   villa->last = last;
   villa->lnum = lnum;
   villa->nnum = nnum;
   villa->rnum = rnum;
+  villa->leaffree = cbdatumopen(NULL, 0);
+  villa->nodefree = cbdatumopen(NULL, 0);
   villa->leafc = cbmapopen();
   villa->nodec = cbmapopen();
+  villa->mutex = NULL;
+  villa->tlatch = NULL;
+  villa->dlatch = NULL;
+  villa->saves = 0;
+  villa->base = NULL;
+  villa->sgen = 0;
+  villa->snaps = NULL;
+  villa->svers = NULL;
+  villa->svnum = 0;
+  villa->walfd = -1;
+  villa->walops = NULL;
+  villa->walfree = NULL;
+  villa->walsiz = 0;
+  villa->walmax = VL_DEFWALMAX;
+  villa->dwrite = (omode & VL_ODWRITE) && !(omode & VL_OWAL);
+  villa->replay = FALSE;
+  villa->ptab = NULL;
+#if defined(MYPTHREAD)
+  if(omode & VL_OTHREAD){
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+    CB_MALLOC(villa->mutex, sizeof(pthread_mutex_t));
+    pthread_mutex_init((pthread_mutex_t *)villa->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+    if(villa->wmode){
+      CB_MALLOC(villa->tlatch, sizeof(VLTLATCH));
+      pthread_rwlock_init(&(((VLTLATCH *)villa->tlatch)->rwlock), NULL);
+      pthread_mutex_init(&(((VLTLATCH *)villa->tlatch)->gate), NULL);
+      CB_MALLOC(villa->dlatch, sizeof(pthread_rwlock_t));
+      pthread_rwlock_init((pthread_rwlock_t *)villa->dlatch, NULL);
+    }
+  }
+#endif
   villa->hnum = 0;
   villa->hleaf = -1;
   villa->lleaf = -1;
   villa->curleaf = -1;
   villa->curknum = -1;
   villa->curvnum = -1;
+  villa->ramax = VL_DEFRAMAX;
+  villa->rawin = 0;
+  villa->raleft = 0;
   villa->leafrecmax = VL_DEFLRECMAX;
   villa->nodeidxmax = VL_DEFNIDXMAX;
   villa->leafcnum = VL_DEFLCNUM;
   villa->nodecnum = VL_DEFNCNUM;
+  for(i = 0; i < VL_CHUNKCLASS; i++){
+    villa->chunks[i] = NULL;
+    villa->chunknum[i] = 0;
+  }
+  villa->leafcsiz = 0;
+  villa->nodecsiz = 0;
+  villa->leafcmax = 0;
+  villa->nodecmax = 0;
+  villa->leafcpeak = 0;
+  villa->nodecpeak = 0;
+  villa->leafcpol = VL_CRLRU;
+  villa->nodecpol = VL_CRLRU;
+  villa->leafghost = cbmapopen();
+  villa->nodeghost = cbmapopen();
+  villa->leafchot = 0;
+  villa->nodechot = 0;
+  villa->pinlevel = 0;
+  villa->pinnum = 0;
+  villa->pinsiz = 0;
+  villa->bulk = FALSE;
   villa->tran = FALSE;
   villa->rbroot = -1;
   villa->rblast = -1;
   villa->rblnum = -1;
   villa->rbnnum = -1;
   villa->rbrnum = -1;
+  if((omode & VL_OPTAB) && !vlptabopen(villa)){
+    villa->wmode = FALSE;
+    vlclose(villa);
+    return NULL;
+  }
+  if(root != -1) vldpgetfree(villa);
   if(root == -1){
     leaf = vlleafnew(villa, -1, -1);
     villa->root = leaf->id;
@@ -236,19 +798,38 @@ VILLA *vlopen(const char *name, int omode, VLCFUNC cmp){
       return NULL;
     }
   }
+  if(villa->wmode && !vlwalopen(villa, omode & (VL_OWAL | VL_ODWRITE))){
+    vlcachedrop(villa);
+    villa->wmode = FALSE;
+    vlclose(villa);
+    return NULL;
+  }
   return villa;
 }
 
 
 /* Close a database handle. */
 int vlclose(VILLA *villa){
-  int err, pid;
+  VLCHUNK *chunk;
+  VLPTAB *ptab;
+  char path[VL_PATHBUFSIZ], *name;
+  int i, err, pid;
   const char *tmp;
+  double fsiz;
   assert(villa);
+  if(villa->snaps && CB_DATUMSIZE(villa->snaps) > 0){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
   err = FALSE;
   if(villa->tran){
     if(!vltranabort(villa)) err = TRUE;
   }
+  if(villa->bulk){
+    if(!vlbulkend(villa)) err = TRUE;
+  }
+  if(villa->walfd != -1 && !vlwalcheckpoint(villa)) err = TRUE;
+  vlaiobegin(villa);
   cbmapiterinit(villa->leafc);
   while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
     pid = *(int *)tmp;
@@ -266,10 +847,69 @@ int vlclose(VILLA *villa){
     if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
     if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
     if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
+    if(!vldpputfree(villa)) err = TRUE;
+    if(villa->ptab && !villa->base){
+      ptab = villa->ptab;
+      ptab->stamp++;
+      if(!vldpputnum(villa->depot, VL_PTABKEY, ptab->stamp)) err = TRUE;
+    }
   }
+  if(!vlaioend(villa)) err = TRUE;
   cbmapclose(villa->leafc);
   cbmapclose(villa->nodec);
-  if(!dpclose(villa->depot)) err = TRUE;
+  cbmapclose(villa->leafghost);
+  cbmapclose(villa->nodeghost);
+  cbdatumclose(villa->leaffree);
+  cbdatumclose(villa->nodefree);
+  if(villa->dict) cbdatumclose(villa->dict);
+  if(villa->dictsmp) cbdatumclose(villa->dictsmp);
+  if(villa->snaps) cbdatumclose(villa->snaps);
+  if(villa->svers) cbmapclose(villa->svers);
+  if(villa->walops) cbdatumclose(villa->walops);
+  if(villa->walfree) cbdatumclose(villa->walfree);
+  if(villa->walfd != -1){
+    if(close(villa->walfd) == -1){
+      dpecodeset(DP_ECLOSE, __FILE__, __LINE__);
+      err = TRUE;
+    }
+    if(!err){
+      name = dpname(villa->depot);
+      sprintf(path, "%s%s", name, VL_WALSUF);
+      free(name);
+      if(unlink(path) == -1){
+        dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+        err = TRUE;
+      }
+    }
+  }
+  for(i = 0; i < VL_CHUNKCLASS; i++){
+    while((chunk = villa->chunks[i]) != NULL){
+      villa->chunks[i] = chunk->next;
+      free(chunk);
+    }
+  }
+  if(villa->base){
+    if(!vlsnapdrop(villa)) err = TRUE;
+  } else {
+    fsiz = dpfsizd(villa->depot);
+    if(!dpclose(villa->depot)) err = TRUE;
+    if(villa->ptab && !vlptabclose(villa, !err, fsiz)) err = TRUE;
+  }
+#if defined(MYPTHREAD)
+  if(villa->mutex){
+    pthread_mutex_destroy((pthread_mutex_t *)villa->mutex);
+    free(villa->mutex);
+  }
+  if(villa->tlatch){
+    pthread_rwlock_destroy(&(((VLTLATCH *)villa->tlatch)->rwlock));
+    pthread_mutex_destroy(&(((VLTLATCH *)villa->tlatch)->gate));
+    free(villa->tlatch);
+  }
+  if(villa->dlatch && !villa->base){
+    pthread_rwlock_destroy((pthread_rwlock_t *)villa->dlatch);
+    free(villa->dlatch);
+  }
+#endif
   free(villa);
   return err ? FALSE : TRUE;
 }
@@ -277,11 +917,8 @@ int vlclose(VILLA *villa){
 
 /* Store a record. */
 int vlput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz, int dmode){
-  VLLEAF *leaf, *newleaf;
-  VLNODE *node, *newnode;
-  VLIDX *idxp;
-  CBDATUM *key;
-  int i, pid, todiv, heir, parent, mid;
+  VLLEAF *leaf;
+  int pid, rv;
   assert(villa && kbuf && vbuf);
   villa->curleaf = -1;
   villa->curknum = -1;
@@ -292,68 +929,25 @@ int vlput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
   }
   if(ksiz < 0) ksiz = strlen(kbuf);
   if(vsiz < 0) vsiz = strlen(vbuf);
+  if(villa->tlatch){
+    if((rv = vlputlatch(villa, kbuf, ksiz, vbuf, vsiz, dmode)) < 1){
+      if(rv == 0) dpecodeset(DP_EKEEP, __FILE__, __LINE__);
+      return FALSE;
+    }
+    if(!vlwallog(villa, VL_WOPUT, dmode, 0, kbuf, ksiz, vbuf, vsiz)) return FALSE;
+    if(!villa->tran && !vlcacheadjust(villa)) return FALSE;
+    return TRUE;
+  }
   if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
     if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return FALSE;
-    if(!(leaf = vlleafload(villa, pid))) return FALSE;
+    if(!(leaf = vlleafload(villa, pid, FALSE))) return FALSE;
   }
   if(!vlleafaddrec(villa, leaf, dmode, kbuf, ksiz, vbuf, vsiz)){
     dpecodeset(DP_EKEEP, __FILE__, __LINE__);
     return FALSE;
   }
-  todiv = FALSE;
-  switch(CB_LISTNUM(leaf->recs) % 4){
-  case 0:
-    if(CB_LISTNUM(leaf->recs) >= 4 &&
-       vlleafdatasize(leaf) > VL_MAXLEAFSIZ * (villa->cmode > 0 ? 2 : 1)){
-      todiv = TRUE;
-      break;
-    }
-  case 2:
-    if(CB_LISTNUM(leaf->recs) > villa->leafrecmax) todiv = TRUE;
-    break;
-  }
-  if(todiv){
-    if(!(newleaf = vlleafdivide(villa, leaf))) return FALSE;
-    if(leaf->id == villa->last) villa->last = newleaf->id;
-    heir = leaf->id;
-    pid = newleaf->id;
-    key = ((VLREC *)CB_LISTVAL(newleaf->recs, 0))->key;
-    key = cbdatumdup(key);
-    while(TRUE){
-      if(villa->hnum < 1){
-        node = vlnodenew(villa, heir);
-        vlnodeaddidx(villa, node, TRUE, pid, CB_DATUMPTR(key), CB_DATUMSIZE(key));
-        villa->root = node->id;
-        CB_DATUMCLOSE(key);
-        break;
-      }
-      parent = villa->hist[--villa->hnum];
-      if(!(node = vlnodeload(villa, parent))){
-        CB_DATUMCLOSE(key);
-        return FALSE;
-      }
-      vlnodeaddidx(villa, node, FALSE, pid, CB_DATUMPTR(key), CB_DATUMSIZE(key));
-      CB_DATUMCLOSE(key);
-      if(CB_LISTNUM(node->idxs) <= villa->nodeidxmax || CB_LISTNUM(node->idxs) % 2 == 0) break;
-      mid = CB_LISTNUM(node->idxs) / 2;
-      idxp = (VLIDX *)CB_LISTVAL(node->idxs, mid);
-      newnode = vlnodenew(villa, idxp->pid);
-      heir = node->id;
-      pid = newnode->id;
-      CB_DATUMOPEN2(key, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
-      for(i = mid + 1; i < CB_LISTNUM(node->idxs); i++){
-        idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-        vlnodeaddidx(villa, newnode, TRUE, idxp->pid,
-                     CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
-      }
-      for(i = 0; i <= mid; i++){
-        idxp = (VLIDX *)cblistpop(node->idxs, NULL);
-        CB_DATUMCLOSE(idxp->key);
-        free(idxp);
-      }
-      node->dirty = TRUE;
-    }
-  }
+  if(vlleafsplit(villa, leaf) == -1) return FALSE;
+  if(!vlwallog(villa, VL_WOPUT, dmode, 0, kbuf, ksiz, vbuf, vsiz)) return FALSE;
   if(!villa->tran && !vlcacheadjust(villa)) return FALSE;
   return TRUE;
 }
@@ -363,7 +957,7 @@ int vlput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
 int vlout(VILLA *villa, const char *kbuf, int ksiz){
   VLLEAF *leaf;
   VLREC *recp;
-  int pid, ri, vsiz;
+  int pid, ri, vsiz, under;
   char *vbuf;
   assert(villa && kbuf);
   villa->curleaf = -1;
@@ -374,30 +968,53 @@ int vlout(VILLA *villa, const char *kbuf, int ksiz){
     return FALSE;
   }
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
+  if(villa->tlatch){
+    if((pid = vlsearchpath(villa, kbuf, ksiz, villa->hist, &(villa->hnum))) == -1 ||
+       !(leaf = vlleafcachein(villa, pid, FALSE, TRUE))) return FALSE;
+    VL_LATCHLOCK(leaf, TRUE);
+  } else if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
     if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return FALSE;
-    if(!(leaf = vlleafload(villa, pid))) return FALSE;
+    if(!(leaf = vlleafload(villa, pid, FALSE))) return FALSE;
   }
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, &ri))){
+    VL_LATCHUNLOCK(leaf);
+    VL_PAGERELEASE(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
   if(recp->rest){
-    CB_DATUMCLOSE(recp->first);
     vbuf = cblistshift(recp->rest, &vsiz);
-    CB_DATUMOPEN2(recp->first, vbuf, vsiz);
+    vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
     free(vbuf);
     if(CB_LISTNUM(recp->rest) < 1){
       CB_LISTCLOSE(recp->rest);
       recp->rest = NULL;
+      leaf->rests--;
     }
   } else {
-    CB_DATUMCLOSE(recp->key);
-    CB_DATUMCLOSE(recp->first);
-    free(cblistremove(leaf->recs, ri, NULL));
+    leaf->waste += sizeof(VLREC) + CB_DATUMSIZE(recp->key) + CB_DATUMSIZE(recp->first);
+    cblistremove(leaf->recs, ri, NULL);
   }
-  leaf->dirty = TRUE;
+  vlleafcompact(villa, leaf);
+  VL_ATOMICSET(leaf->dirty, TRUE);
   villa->rnum--;
+  if(villa->tlatch){
+    pid = leaf->id;
+    under = vlleafunder(villa, leaf);
+    VL_LATCHUNLOCK(leaf);
+    VL_PAGERELEASE(villa, leaf);
+    if(under){
+      VL_TREELOCK(villa, TRUE);
+      villa->lleaf = -1;
+      under = (leaf = vlleafload(villa, pid, FALSE)) != NULL &&
+        vlleafmerge(villa, leaf, kbuf, ksiz);
+      VL_TREEUNLOCK(villa);
+      if(!under) return FALSE;
+    }
+  } else if(!vlleafmerge(villa, leaf, kbuf, ksiz)){
+    return FALSE;
+  }
+  if(!vlwallog(villa, VL_WOOUT, 0, 0, kbuf, ksiz, NULL, 0)) return FALSE;
   if(!villa->tran && !vlcacheadjust(villa)) return FALSE;
   return TRUE;
 }
@@ -408,20 +1025,20 @@ char *vlget(VILLA *villa, const char *kbuf, int ksiz, int *sp){
   VLLEAF *leaf;
   VLREC *recp;
   char *rv;
-  int pid;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
-    if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return NULL;
-    if(!(leaf = vlleafload(villa, pid))) return NULL;
-  }
+  if(!(leaf = vlkeyleaf(villa, kbuf, ksiz))) return NULL;
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
+    vlkeyleafrelease(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return NULL;
   }
-  if(!villa->tran && !vlcacheadjust(villa)) return NULL;
   if(sp) *sp = CB_DATUMSIZE(recp->first);
   CB_MEMDUP(rv, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
+  if(!vlkeyleafrelease(villa, leaf)){
+    free(rv);
+    return NULL;
+  }
   return rv;
 }
 
@@ -430,19 +1047,18 @@ char *vlget(VILLA *villa, const char *kbuf, int ksiz, int *sp){
 int vlvsiz(VILLA *villa, const char *kbuf, int ksiz){
   VLLEAF *leaf;
   VLREC *recp;
-  int pid;
+  int vsiz;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
-    if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return -1;
-    if(!(leaf = vlleafload(villa, pid))) return -1;
-  }
+  if(!(leaf = vlkeyleaf(villa, kbuf, ksiz))) return -1;
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
+    vlkeyleafrelease(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return -1;
   }
-  if(!villa->tran && !vlcacheadjust(villa)) return -1;
-  return CB_DATUMSIZE(recp->first);
+  vsiz = CB_DATUMSIZE(recp->first);
+  if(!vlkeyleafrelease(villa, leaf)) return -1;
+  return vsiz;
 }
 
 
@@ -450,19 +1066,18 @@ int vlvsiz(VILLA *villa, const char *kbuf, int ksiz){
 int vlvnum(VILLA *villa, const char *kbuf, int ksiz){
   VLLEAF *leaf;
   VLREC *recp;
-  int pid;
+  int vnum;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
-    if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return 0;
-    if(!(leaf = vlleafload(villa, pid))) return 0;
-  }
+  if(!(leaf = vlkeyleaf(villa, kbuf, ksiz))) return 0;
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
+    vlkeyleafrelease(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return 0;
   }
-  if(!villa->tran && !vlcacheadjust(villa)) return 0;
-  return 1 + (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+  vnum = 1 + (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+  if(!vlkeyleafrelease(villa, leaf)) return 0;
+  return vnum;
 }
 
 
@@ -509,16 +1124,14 @@ int vloutlist(VILLA *villa, const char *kbuf, int ksiz){
 CBLIST *vlgetlist(VILLA *villa, const char *kbuf, int ksiz){
   VLLEAF *leaf;
   VLREC *recp;
-  int pid, i, vsiz;
+  int i, vsiz;
   CBLIST *vals;
   const char *vbuf;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
-    if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return NULL;
-    if(!(leaf = vlleafload(villa, pid))) return NULL;
-  }
+  if(!(leaf = vlkeyleaf(villa, kbuf, ksiz))) return NULL;
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
+    vlkeyleafrelease(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return NULL;
   }
@@ -530,7 +1143,7 @@ CBLIST *vlgetlist(VILLA *villa, const char *kbuf, int ksiz){
       CB_LISTPUSH(vals, vbuf, vsiz);
     }
   }
-  if(!villa->tran && !vlcacheadjust(villa)){
+  if(!vlkeyleafrelease(villa, leaf)){
     CB_LISTCLOSE(vals);
     return NULL;
   }
@@ -542,16 +1155,14 @@ CBLIST *vlgetlist(VILLA *villa, const char *kbuf, int ksiz){
 char *vlgetcat(VILLA *villa, const char *kbuf, int ksiz, int *sp){
   VLLEAF *leaf;
   VLREC *recp;
-  int pid, i, vsiz, rsiz;
+  int i, vsiz, rsiz;
   char *rbuf;
   const char *vbuf;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
-  if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
-    if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return NULL;
-    if(!(leaf = vlleafload(villa, pid))) return NULL;
-  }
+  if(!(leaf = vlkeyleaf(villa, kbuf, ksiz))) return NULL;
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
+    vlkeyleafrelease(villa, leaf);
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return NULL;
   }
@@ -567,7 +1178,7 @@ char *vlgetcat(VILLA *villa, const char *kbuf, int ksiz, int *sp){
     }
   }
   rbuf[rsiz] = '\0';
-  if(!villa->tran && !vlcacheadjust(villa)){
+  if(!vlkeyleafrelease(villa, leaf)){
     free(rbuf);
     return NULL;
   }
@@ -576,52 +1187,316 @@ char *vlgetcat(VILLA *villa, const char *kbuf, int ksiz, int *sp){
 }
 
 
-/* Move the cursor to the first record. */
-int vlcurfirst(VILLA *villa){
+/* Store records in a batch. */
+int vlputbatch(VILLA *villa, const CBLIST *keys, const CBLIST *vals, int dmode){
   VLLEAF *leaf;
-  assert(villa);
-  villa->curleaf = VL_LEAFIDMIN;
-  villa->curknum = 0;
-  villa->curvnum = 0;
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
-    villa->curleaf = -1;
+  CBDATUM *bound;
+  const char *kbuf, *vbuf;
+  int i, err, kerr, num, pid, ksiz, vsiz, rv, *idxs;
+  assert(villa && keys && vals);
+  villa->curleaf = -1;
+  villa->curknum = -1;
+  villa->curvnum = -1;
+  if(!villa->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
     return FALSE;
   }
-  while(CB_LISTNUM(leaf->recs) < 1){
-    villa->curleaf = leaf->next;
-    villa->curknum = 0;
-    villa->curvnum = 0;
-    if(villa->curleaf == -1){
-      dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
-      return FALSE;
+  num = CB_LISTNUM(keys);
+  if(CB_LISTNUM(vals) != num){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  CB_MALLOC(idxs, num * sizeof(int) * 2 + 1);
+  for(i = 0; i < num; i++){
+    idxs[i] = i;
+  }
+  vlbatchsort(villa->cmp, keys, idxs, idxs + num, num);
+  leaf = NULL;
+  bound = NULL;
+  err = FALSE;
+  kerr = FALSE;
+  for(i = 0; i < num; i++){
+    kbuf = CB_LISTVAL2(keys, idxs[i], ksiz);
+    vbuf = CB_LISTVAL2(vals, idxs[i], vsiz);
+    if(villa->tlatch){
+      if((!villa->tran && !vlcacheadjust(villa)) ||
+         (rv = vlputlatch(villa, kbuf, ksiz, vbuf, vsiz, dmode)) == -1){
+        err = TRUE;
+        break;
+      }
+      if(rv == 0){
+        kerr = TRUE;
+      } else if(!vlwallog(villa, VL_WOPUT, dmode, 0, kbuf, ksiz, vbuf, vsiz)){
+        err = TRUE;
+        break;
+      }
+      continue;
     }
-    if(!(leaf = vlleafload(villa, villa->curleaf))){
-      villa->curleaf = -1;
-      return FALSE;
+    if(leaf && bound && villa->cmp(kbuf, ksiz, CB_DATUMPTR(bound), CB_DATUMSIZE(bound)) >= 0)
+      leaf = NULL;
+    if(!leaf){
+      if(!villa->tran && !vlcacheadjust(villa)){
+        err = TRUE;
+        break;
+      }
+      if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1 ||
+         !vlleafbound(villa, villa->hist, villa->hnum, pid, &bound) ||
+         !(leaf = vlleafload(villa, pid, FALSE))){
+        err = TRUE;
+        break;
+      }
+    }
+    if(!vlleafaddrec(villa, leaf, dmode, kbuf, ksiz, vbuf, vsiz)){
+      kerr = TRUE;
+      continue;
     }
+    if(!vlwallog(villa, VL_WOPUT, dmode, 0, kbuf, ksiz, vbuf, vsiz) ||
+       (rv = vlleafsplit(villa, leaf)) == -1){
+      err = TRUE;
+      break;
+    }
+    if(rv) leaf = NULL;
+  }
+  if(bound) CB_DATUMCLOSE(bound);
+  free(idxs);
+  if(err) return FALSE;
+  if(!villa->tran && !vlcacheadjust(villa)) return FALSE;
+  if(kerr){
+    dpecodeset(DP_EKEEP, __FILE__, __LINE__);
+    return FALSE;
   }
   return TRUE;
 }
 
 
-/* Move the cursor to the last record. */
-int vlcurlast(VILLA *villa){
+/* Retrieve records in a batch. */
+CBMAP *vlgetbatch(VILLA *villa, const CBLIST *keys){
   VLLEAF *leaf;
   VLREC *recp;
-  assert(villa);
-  villa->curleaf = villa->last;
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
-    villa->curleaf = -1;
-    return FALSE;
-  }
-  while(CB_LISTNUM(leaf->recs) < 1){
-    villa->curleaf = leaf->prev;
-    if(villa->curleaf == -1){
-      villa->curleaf = -1;
-      dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
-      return FALSE;
+  CBDATUM *bound;
+  CBMAP *map;
+  const char *kbuf;
+  int hist[VL_LEVELMAX];
+  int i, err, num, hnum, pid, ksiz, ln, miss, stage, *idxs;
+  assert(villa && keys);
+  num = CB_LISTNUM(keys);
+  CB_MALLOC(idxs, num * sizeof(int) * 2 + 1);
+  for(i = 0; i < num; i++){
+    idxs[i] = i;
+  }
+  vlbatchsort(villa->cmp, keys, idxs, idxs + num, num);
+  map = cbmapopen();
+  leaf = NULL;
+  bound = NULL;
+  err = FALSE;
+  stage = dpaioengine(villa->depot) > DP_AIOSYNC && !villa->depot->mapall ? 0 : num;
+  VL_TREELOCK(villa, FALSE);
+  for(i = 0; i < num; i++){
+    kbuf = CB_LISTVAL2(keys, idxs[i], ksiz);
+    if(leaf){
+      if(villa->tlatch){
+        ln = CB_LISTNUM(leaf->recs);
+        recp = ln > 0 ? (VLREC *)CB_LISTVAL(leaf->recs, ln - 1) : NULL;
+        miss = !recp ||
+          villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key)) > 0;
+      } else {
+        miss = bound &&
+          villa->cmp(kbuf, ksiz, CB_DATUMPTR(bound), CB_DATUMSIZE(bound)) >= 0;
+      }
+      if(miss){
+        VL_LATCHUNLOCK(leaf);
+        VL_PAGERELEASE(villa, leaf);
+        leaf = NULL;
+      }
+    }
+    if(!leaf){
+      if(!villa->tran && !vlcachetrim(villa, villa->tlatch != NULL)){
+        err = TRUE;
+        break;
+      }
+      if(!villa->tlatch && i >= stage &&
+         (stage = vlleafstagekeys(villa, keys, idxs, num, i)) == -1){
+        err = TRUE;
+        break;
+      }
+      if(villa->tlatch){
+        if(!(leaf = vlcrableaf(villa, kbuf, ksiz, FALSE))){
+          err = TRUE;
+          break;
+        }
+      } else if((pid = vlsearchpath(villa, kbuf, ksiz, hist, &hnum)) == -1 ||
+                !vlleafbound(villa, hist, hnum, pid, &bound) ||
+                !(leaf = vlleafcachein(villa, pid, FALSE, TRUE))){
+        err = TRUE;
+        break;
+      }
+    }
+    if((recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL)) != NULL)
+      cbmapput(map, kbuf, ksiz, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first), FALSE);
+  }
+  if(leaf){
+    VL_LATCHUNLOCK(leaf);
+    VL_PAGERELEASE(villa, leaf);
+  }
+  if(bound) CB_DATUMCLOSE(bound);
+  free(idxs);
+  if(!err && !villa->tran && !vlcachetrim(villa, villa->tlatch != NULL)) err = TRUE;
+  VL_TREEUNLOCK(villa);
+  if(err){
+    cbmapclose(map);
+    return NULL;
+  }
+  return map;
+}
+
+
+/* Delete records in a range of keys. */
+int vlrangeout(VILLA *villa, const char *lbuf, int lsiz, const char *ubuf, int usiz){
+  VLLEAF *leaf;
+  VLREC *recp;
+  CBDATUM *key;
+  int i, err, pid, ln, beg, end, num, unlink;
+  assert(villa);
+  villa->curleaf = -1;
+  villa->curknum = -1;
+  villa->curvnum = -1;
+  if(!villa->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return -1;
+  }
+  if(lbuf && lsiz < 0) lsiz = strlen(lbuf);
+  if(ubuf && usiz < 0) usiz = strlen(ubuf);
+  if(lbuf && ubuf && villa->cmp(lbuf, lsiz, ubuf, usiz) >= 0) return 0;
+  VL_TREELOCK(villa, TRUE);
+  villa->hleaf = -1;
+  villa->lleaf = -1;
+  err = FALSE;
+  num = 0;
+  leaf = NULL;
+  if((pid = lbuf ? vlsearchleaf(villa, lbuf, lsiz) : VL_LEAFIDMIN) == -1) err = TRUE;
+  for(i = 0; !err && pid != -1; i++){
+    if(i > 0 && !villa->tran && !vlcachetrim(villa, TRUE)){
+      err = TRUE;
+      break;
+    }
+    if(!(leaf = vlleafload(villa, pid, FALSE))){
+      err = TRUE;
+      break;
+    }
+    ln = CB_LISTNUM(leaf->recs);
+    beg = 0;
+    if(lbuf && i < 1){
+      while(beg < ln){
+        recp = (VLREC *)CB_LISTVAL(leaf->recs, beg);
+        if(villa->cmp(CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key), lbuf, lsiz) >= 0) break;
+        beg++;
+      }
+    }
+    end = ln;
+    if(ubuf){
+      while(end > beg){
+        recp = (VLREC *)CB_LISTVAL(leaf->recs, end - 1);
+        if(villa->cmp(CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key), ubuf, usiz) < 0) break;
+        end--;
+      }
+    }
+    pid = end < ln ? -1 : leaf->next;
+    if(beg >= end) continue;
+    unlink = beg < 1 && end >= ln && leaf->prev != -1 && !villa->tran && !villa->bulk;
+    key = NULL;
+    if(unlink){
+      recp = (VLREC *)CB_LISTVAL(leaf->recs, 0);
+      CB_DATUMOPEN2(key, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    }
+    ln = vlleafcut(villa, leaf, beg, end);
+    villa->rnum -= ln;
+    num += ln;
+    if(unlink){
+      if(!vlleafunlink(villa, leaf, CB_DATUMPTR(key), CB_DATUMSIZE(key))) err = TRUE;
+      CB_DATUMCLOSE(key);
+      leaf = NULL;
+    }
+  }
+  if(!err && leaf && CB_LISTNUM(leaf->recs) > 0){
+    recp = (VLREC *)CB_LISTVAL(leaf->recs, 0);
+    CB_DATUMOPEN2(key, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    if(!vlleafmerge(villa, leaf, CB_DATUMPTR(key), CB_DATUMSIZE(key))) err = TRUE;
+    CB_DATUMCLOSE(key);
+  }
+  VL_TREEUNLOCK(villa);
+  if(err) return -1;
+  if(num > 0 && !vlwallog(villa, VL_WORANGE, (lbuf ? 1 : 0) | (ubuf ? 2 : 0), 0,
+                          lbuf ? lbuf : "", lbuf ? lsiz : 0, ubuf, usiz)) return -1;
+  if(!villa->tran && !vlcacheadjust(villa)) return -1;
+  return num;
+}
+
+
+/* Delete records whose keys begin with a prefix. */
+int vloutprefix(VILLA *villa, const char *pbuf, int psiz){
+  char *ubuf;
+  int usiz, rv;
+  assert(villa && pbuf);
+  if(psiz < 0) psiz = strlen(pbuf);
+  CB_MEMDUP(ubuf, pbuf, psiz);
+  for(usiz = psiz; usiz > 0 && ((unsigned char *)ubuf)[usiz-1] == 0xff; usiz--);
+  if(usiz > 0) ubuf[usiz-1]++;
+  rv = vlrangeout(villa, pbuf, psiz, usiz > 0 ? ubuf : NULL, usiz);
+  free(ubuf);
+  return rv;
+}
+
+
+/* Move the cursor to the first record. */
+int vlcurfirst(VILLA *villa){
+  VLLEAF *leaf;
+  assert(villa);
+  villa->curleaf = VL_LEAFIDMIN;
+  villa->curknum = 0;
+  villa->curvnum = 0;
+  villa->rawin = 0;
+  villa->raleft = 0;
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
+    villa->curleaf = -1;
+    return FALSE;
+  }
+  while(CB_LISTNUM(leaf->recs) < 1){
+    villa->curleaf = leaf->next;
+    villa->curknum = 0;
+    villa->curvnum = 0;
+    if(villa->curleaf == -1){
+      dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+      return FALSE;
+    }
+    if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
+      villa->curleaf = -1;
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/* Move the cursor to the last record. */
+int vlcurlast(VILLA *villa){
+  VLLEAF *leaf;
+  VLREC *recp;
+  assert(villa);
+  villa->curleaf = villa->last;
+  villa->rawin = 0;
+  villa->raleft = 0;
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
+    villa->curleaf = -1;
+    return FALSE;
+  }
+  while(CB_LISTNUM(leaf->recs) < 1){
+    villa->curleaf = leaf->prev;
+    if(villa->curleaf == -1){
+      villa->curleaf = -1;
+      dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+      return FALSE;
     }
-    if(!(leaf = vlleafload(villa, villa->curleaf))){
+    if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
       villa->curleaf = -1;
       return FALSE;
     }
@@ -642,7 +1517,7 @@ int vlcurprev(VILLA *villa){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf)) || CB_LISTNUM(leaf->recs) < 1){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE)) || CB_LISTNUM(leaf->recs) < 1){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -651,13 +1526,15 @@ int vlcurprev(VILLA *villa){
   if(villa->curvnum < 0){
     villa->curknum--;
     if(villa->curknum < 0){
+      villa->rawin = 0;
+      villa->raleft = 0;
       villa->curleaf = leaf->prev;
       if(villa->curleaf == -1){
         villa->curleaf = -1;
         dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
         return FALSE;
       }
-      if(!(leaf = vlleafload(villa, villa->curleaf))){
+      if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
         villa->curleaf = -1;
         return FALSE;
       }
@@ -667,7 +1544,7 @@ int vlcurprev(VILLA *villa){
           dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
           return FALSE;
         }
-        if(!(leaf = vlleafload(villa, villa->curleaf))){
+        if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
           villa->curleaf = -1;
           return FALSE;
         }
@@ -693,7 +1570,7 @@ int vlcurnext(VILLA *villa){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf)) || CB_LISTNUM(leaf->recs) < 1){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE)) || CB_LISTNUM(leaf->recs) < 1){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -711,7 +1588,7 @@ int vlcurnext(VILLA *villa){
       dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
       return FALSE;
     }
-    if(!(leaf = vlleafload(villa, villa->curleaf))){
+    if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
       villa->curleaf = -1;
       return FALSE;
     }
@@ -723,11 +1600,12 @@ int vlcurnext(VILLA *villa){
         dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
         return FALSE;
       }
-      if(!(leaf = vlleafload(villa, villa->curleaf))){
+      if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
         villa->curleaf = -1;
         return FALSE;
       }
     }
+    vlreadahead(villa, leaf, &(villa->rawin), &(villa->raleft));
   }
   if(!villa->tran && !vlcacheadjust(villa)) return FALSE;
   return TRUE;
@@ -741,11 +1619,13 @@ int vlcurjump(VILLA *villa, const char *kbuf, int ksiz, int jmode){
   int pid, index;
   assert(villa && kbuf);
   if(ksiz < 0) ksiz = strlen(kbuf);
+  villa->rawin = 0;
+  villa->raleft = 0;
   if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1){
     villa->curleaf = -1;
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, pid))){
+  if(!(leaf = vlleafload(villa, pid, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -755,7 +1635,7 @@ int vlcurjump(VILLA *villa, const char *kbuf, int ksiz, int jmode){
       dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
       return FALSE;
     }
-    if(!(leaf = vlleafload(villa, villa->curleaf))){
+    if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
       villa->curleaf = -1;
       return FALSE;
     }
@@ -806,7 +1686,7 @@ char *vlcurkey(VILLA *villa, int *sp){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -831,7 +1711,7 @@ char *vlcurval(VILLA *villa, int *sp){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -852,8 +1732,6 @@ char *vlcurval(VILLA *villa, int *sp){
 int vlcurput(VILLA *villa, const char *vbuf, int vsiz, int cpmode){
   VLLEAF *leaf;
   VLREC *recp;
-  char *tbuf;
-  int tsiz;
   assert(villa && vbuf);
   if(!villa->wmode){
     dpecodeset(DP_EMODE, __FILE__, __LINE__);
@@ -864,45 +1742,48 @@ int vlcurput(VILLA *villa, const char *vbuf, int vsiz, int cpmode){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
   recp = (VLREC *)CB_LISTVAL(leaf->recs, villa->curknum);
+  if(!vlwallog(villa, VL_WOCURPUT, cpmode, villa->curvnum,
+               CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key), vbuf, vsiz)) return FALSE;
   switch(cpmode){
   case VL_CPBEFORE:
     if(villa->curvnum < 1){
       if(!recp->rest){
-        CB_DATUMTOMALLOC(recp->first, tbuf, tsiz);
-        CB_DATUMOPEN2(recp->first, vbuf, vsiz);
         CB_LISTOPEN(recp->rest);
-        CB_LISTPUSHBUF(recp->rest, tbuf, tsiz);
+        leaf->rests++;
+        CB_LISTPUSH(recp->rest, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
       } else {
         cblistunshift(recp->rest, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
-        CB_DATUMSETSIZE(recp->first, 0);
-        CB_DATUMCAT(recp->first, vbuf, vsiz);
       }
+      vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
     } else {
       CB_LISTINSERT(recp->rest, villa->curvnum - 1, vbuf, vsiz);
     }
     villa->rnum++;
     break;
   case VL_CPAFTER:
-    if(!recp->rest) CB_LISTOPEN(recp->rest);
+    if(!recp->rest){
+      CB_LISTOPEN(recp->rest);
+      leaf->rests++;
+    }
     CB_LISTINSERT(recp->rest, villa->curvnum, vbuf, vsiz);
     villa->curvnum++;
     villa->rnum++;
     break;
   default:
     if(villa->curvnum < 1){
-      CB_DATUMSETSIZE(recp->first, 0);
-      CB_DATUMCAT(recp->first, vbuf, vsiz);
+      vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
     } else {
       cblistover(recp->rest, villa->curvnum - 1, vbuf, vsiz);
     }
     break;
   }
-  leaf->dirty = TRUE;
+  vlleafcompact(villa, leaf);
+  VL_ATOMICSET(leaf->dirty, TRUE);
   return TRUE;
 }
 
@@ -911,6 +1792,7 @@ int vlcurput(VILLA *villa, const char *vbuf, int vsiz, int cpmode){
 int vlcurout(VILLA *villa){
   VLLEAF *leaf;
   VLREC *recp;
+  CBDATUM *key;
   char *vbuf;
   int vsiz;
   assert(villa);
@@ -922,25 +1804,28 @@ int vlcurout(VILLA *villa){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
   recp = (VLREC *)CB_LISTVAL(leaf->recs, villa->curknum);
+  if(!vlwallog(villa, VL_WOCUROUT, 0, villa->curvnum,
+               CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key), NULL, 0)) return FALSE;
+  key = NULL;
   if(villa->curvnum < 1){
     if(recp->rest){
       vbuf = cblistshift(recp->rest, &vsiz);
-      CB_DATUMSETSIZE(recp->first, 0);
-      CB_DATUMCAT(recp->first, vbuf, vsiz);
+      vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
       free(vbuf);
       if(CB_LISTNUM(recp->rest) < 1){
         CB_LISTCLOSE(recp->rest);
         recp->rest = NULL;
+        leaf->rests--;
       }
     } else {
-      CB_DATUMCLOSE(recp->first);
-      CB_DATUMCLOSE(recp->key);
-      free(cblistremove(leaf->recs, villa->curknum, NULL));
+      key = cbdatumdup(recp->key);
+      leaf->waste += sizeof(VLREC) + CB_DATUMSIZE(recp->key) + CB_DATUMSIZE(recp->first);
+      cblistremove(leaf->recs, villa->curknum, NULL);
     }
   } else {
     free(cblistremove(recp->rest, villa->curvnum - 1, NULL));
@@ -951,15 +1836,29 @@ int vlcurout(VILLA *villa){
     if(CB_LISTNUM(recp->rest) < 1){
       CB_LISTCLOSE(recp->rest);
       recp->rest = NULL;
+      leaf->rests--;
     }
   }
+  vlleafcompact(villa, leaf);
   villa->rnum--;
-  leaf->dirty = TRUE;
+  VL_ATOMICSET(leaf->dirty, TRUE);
+  if(key){
+    vsiz = vlleafmerge(villa, leaf, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+    CB_DATUMCLOSE(key);
+    if(!vsiz){
+      villa->curleaf = -1;
+      return FALSE;
+    }
+    if(villa->curleaf == -1 || !(leaf = vlleafload(villa, villa->curleaf, TRUE))){
+      villa->curleaf = -1;
+      return FALSE;
+    }
+  }
   if(villa->curknum >= CB_LISTNUM(leaf->recs)){
     villa->curleaf = leaf->next;
     villa->curknum = 0;
     villa->curvnum = 0;
-    while(villa->curleaf != -1 && (leaf = vlleafload(villa, villa->curleaf)) != NULL &&
+    while(villa->curleaf != -1 && (leaf = vlleafload(villa, villa->curleaf, TRUE)) != NULL &&
           CB_LISTNUM(leaf->recs) < 1){
       villa->curleaf = leaf->next;
     }
@@ -986,6 +1885,107 @@ void vlsettuning(VILLA *villa, int lrecmax, int nidxmax, int lcnum, int ncnum){
 }
 
 
+/* Set the limits of memory of the caches. */
+void vlsetcachesiz(VILLA *villa, int lcsiz, int ncsiz){
+  assert(villa);
+  villa->leafcmax = lcsiz > 0 ? lcsiz : 0;
+  villa->nodecmax = ncsiz > 0 ? ncsiz : 0;
+}
+
+
+/* Get the statistics of the memory of the caches. */
+void vlcachestat(VILLA *villa, int *lsp, int *lpp, int *nsp, int *npp){
+  assert(villa);
+  if(lsp) *lsp = villa->leafcsiz;
+  if(lpp) *lpp = villa->leafcpeak;
+  if(nsp) *nsp = villa->nodecsiz;
+  if(npp) *npp = villa->nodecpeak;
+}
+
+
+/* Set the replacement policies of the caches. */
+void vlsetcachepolicy(VILLA *villa, int lpolicy, int npolicy){
+  assert(villa);
+  villa->leafcpol = lpolicy == VL_CR2Q ? VL_CR2Q : VL_CRLRU;
+  villa->nodecpol = npolicy == VL_CR2Q ? VL_CR2Q : VL_CRLRU;
+}
+
+
+/* Pin the upper levels of the B+ tree in memory. */
+int vlsetpinlevel(VILLA *villa, int level){
+  VLNODE *node;
+  const char *tmp;
+  int err, pid;
+  assert(villa);
+  villa->pinlevel = level < 0 ? -1 : level;
+  cbmapiterinit(villa->nodec);
+  while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+    pid = *(int *)tmp;
+    node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
+    if(node->pin) vlnodepin(villa, node, FALSE);
+  }
+  err = FALSE;
+  if(villa->pinlevel != 0 && villa->root >= VL_NODEIDMIN &&
+     !vlnodepinload(villa, villa->root, 0)) err = TRUE;
+  if(!villa->tran && !vlcacheadjust(villa)) err = TRUE;
+  return err ? FALSE : TRUE;
+}
+
+
+/* Get the statistics of pinned nodes. */
+void vlpinstat(VILLA *villa, int *np, int *sp){
+  assert(villa);
+  if(np) *np = villa->pinnum;
+  if(sp) *sp = villa->pinsiz;
+}
+
+
+/* Get the statistics of the write-back of pages. */
+void vlflushstat(VILLA *villa, int *fp, int *wp, int *cp, double *bp, double *lp){
+  assert(villa);
+  VL_DEPOTLOCK(villa, FALSE);
+  dpaiostat(villa->depot, fp, wp, cp, bp, lp);
+  VL_DEPOTUNLOCK(villa);
+}
+
+
+/* Get the statistics of the table of the locations of pages. */
+void vlptabstat(VILLA *villa, int *np, int *hp, int *mp){
+  VLPTAB *ptab;
+  VLPTENT *ents;
+  int i, num;
+  assert(villa);
+  if(np) *np = 0;
+  if(hp) *hp = 0;
+  if(mp) *mp = 0;
+  if(!villa->ptab) return;
+  VL_DEPOTLOCK(villa, FALSE);
+  ptab = villa->ptab;
+  if(np){
+    ents = (VLPTENT *)(ptab->map + VL_PTHEADSIZ);
+    num = 0;
+    for(i = 0; i < ptab->lcap + ptab->ncap; i++){
+      if(ents[i].off > 0) num++;
+    }
+    *np = num;
+  }
+  if(hp) *hp = VL_ATOMICGET(ptab->hits);
+  if(mp) *mp = VL_ATOMICGET(ptab->misses);
+  VL_DEPOTUNLOCK(villa);
+}
+
+
+/* Get the engine of asynchronous I/O of a database handle. */
+int vlaioengine(VILLA *villa){
+  int engine;
+  assert(villa);
+  VL_DEPOTLOCK(villa, FALSE);
+  engine = dpaioengine(villa->depot);
+  VL_DEPOTUNLOCK(villa);
+  return engine;
+}
+
+
 /* Set the size of the free block pool of a database handle. */
 int vlsetfbpsiz(VILLA *villa, int size){
   assert(villa && size >= 0);
@@ -997,6 +1997,20 @@ int vlsetfbpsiz(VILLA *villa, int size){
 }
 
 
+/* Set the size of the write ahead log invoking a checkpoint. */
+void vlsetwalmax(VILLA *villa, int max){
+  assert(villa);
+  villa->walmax = max > 0 ? max : VL_DEFWALMAX;
+}
+
+
+/* Set the max number of leaves read ahead of cursors. */
+void vlsetreadahead(VILLA *villa, int max){
+  assert(villa);
+  villa->ramax = max >= 0 ? max : VL_DEFRAMAX;
+}
+
+
 /* Synchronize updating contents with the file and the device. */
 int vlsync(VILLA *villa){
   int err;
@@ -1021,11 +2035,30 @@ int vloptimize(VILLA *villa){
   }
   err = FALSE;
   if(!vlsync(villa)) return FALSE;
+  VL_DEPOTLOCK(villa, TRUE);
   if(!dpoptimize(villa->depot, -1)) err = TRUE;
+  if(villa->ptab) vlptabclear(villa);
+  VL_DEPOTUNLOCK(villa);
   return err ? FALSE : TRUE;
 }
 
 
+/* Compact a database file incrementally. */
+int vlcompact(VILLA *villa, int unum){
+  int rv;
+  assert(villa);
+  if(!villa->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return -1;
+  }
+  VL_DEPOTLOCK(villa, TRUE);
+  rv = dpcompact(villa->depot, unum);
+  if(villa->ptab) vlptabclear(villa);
+  VL_DEPOTUNLOCK(villa);
+  return rv;
+}
+
+
 /* Get the name of a database. */
 char *vlname(VILLA *villa){
   assert(villa);
@@ -1039,17 +2072,24 @@ int vlfsiz(VILLA *villa){
 }
 
 
+/* Get the size of a database file as double-precision floating-point number. */
+double vlfsizd(VILLA *villa){
+  assert(villa);
+  return dpfsizd(villa->depot);
+}
+
+
 /* Get the number of the leaf nodes of B+ tree. */
 int vllnum(VILLA *villa){
   assert(villa);
-  return villa->lnum;
+  return villa->lnum - CB_DATUMSIZE(villa->leaffree) / sizeof(int);
 }
 
 
 /* Get the number of the non-leaf nodes of B+ tree. */
 int vlnnum(VILLA *villa){
   assert(villa);
-  return villa->nnum;
+  return villa->nnum - CB_DATUMSIZE(villa->nodefree) / sizeof(int);
 }
 
 
@@ -1104,26 +2144,35 @@ int vltranbegin(VILLA *villa){
     return FALSE;
   }
   err = FALSE;
-  cbmapiterinit(villa->leafc);
-  while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
-    pid = *(int *)tmp;
-    leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&pid, sizeof(int), NULL);
-    if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
-  }
-  cbmapiterinit(villa->nodec);
-  while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
-    pid = *(int *)tmp;
-    node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
-    if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+  if(villa->walfd != -1){
+    if(villa->dwrite ? !vlwalcheckpoint(villa) : !vlwalflush(villa, FALSE)) err = TRUE;
+  } else {
+    vlaiobegin(villa);
+    cbmapiterinit(villa->leafc);
+    while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+      pid = *(int *)tmp;
+      leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&pid, sizeof(int), NULL);
+      if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
+    }
+    cbmapiterinit(villa->nodec);
+    while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+      pid = *(int *)tmp;
+      node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
+      if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+    }
+    VL_DEPOTLOCK(villa, TRUE);
+    if(!dpsetalign(villa->depot, 0)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
+    if(!vldpputfree(villa)) err = TRUE;
+    if(!dpaioend(villa->depot)) err = TRUE;
+    if(!dpmemsync(villa->depot)) err = TRUE;
+    if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
+    VL_DEPOTUNLOCK(villa);
   }
-  if(!dpsetalign(villa->depot, 0)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
-  if(!dpmemsync(villa->depot)) err = TRUE;
-  if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
   villa->tran = TRUE;
   villa->rbroot = villa->root;
   villa->rblast = villa->last;
@@ -1150,38 +2199,43 @@ int vltrancommit(VILLA *villa){
     return FALSE;
   }
   err = FALSE;
-  cbmapiterinit(villa->leafc);
-  while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
-    pid = *(int *)tmp;
-    leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&pid, sizeof(int), NULL);
-    if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
-  }
-  cbmapiterinit(villa->nodec);
-  while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
-    pid = *(int *)tmp;
-    node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
-    if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+  if(villa->walfd != -1){
+    if(!villa->dwrite && !vlwalflush(villa, TRUE)) err = TRUE;
+  } else {
+    vlaiobegin(villa);
+    cbmapiterinit(villa->leafc);
+    while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+      pid = *(int *)tmp;
+      leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&pid, sizeof(int), NULL);
+      if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
+    }
+    cbmapiterinit(villa->nodec);
+    while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+      pid = *(int *)tmp;
+      node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
+      if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+    }
+    VL_DEPOTLOCK(villa, TRUE);
+    if(!dpsetalign(villa->depot, 0)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
+    if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
+    if(!vldpputfree(villa)) err = TRUE;
+    if(!dpaioend(villa->depot)) err = TRUE;
+    if(!dpmemsync(villa->depot)) err = TRUE;
+    if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
+    VL_DEPOTUNLOCK(villa);
   }
-  if(!dpsetalign(villa->depot, 0)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
-  if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
-  if(!dpmemsync(villa->depot)) err = TRUE;
-  if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
   villa->tran = FALSE;
   villa->rbroot = -1;
   villa->rblast = -1;
   villa->rblnum = -1;
   villa->rbnnum = -1;
   villa->rbrnum = -1;
-  while(cbmaprnum(villa->leafc) > villa->leafcnum || cbmaprnum(villa->nodec) > villa->nodecnum){
-    if(!vlcacheadjust(villa)){
-      err = TRUE;
-      break;
-    }
-  }
+  if(villa->dwrite && !err && !vlwalcheckpoint(villa)) err = TRUE;
+  if(!vlcacheshrink(villa)) err = TRUE;
   return err ? FALSE : TRUE;
 }
 
@@ -1210,7 +2264,7 @@ int vltranabort(VILLA *villa){
       continue;
     }
     if(leaf->dirty){
-      leaf->dirty = FALSE;
+      VL_ATOMICSET(leaf->dirty, FALSE);
       if(!vlleafcacheout(villa, pid)) err = TRUE;
     }
   }
@@ -1222,41 +2276,172 @@ int vltranabort(VILLA *villa){
       continue;
     }
     if(node->dirty){
-      node->dirty = FALSE;
+      VL_ATOMICSET(node->dirty, FALSE);
       if(!vlnodecacheout(villa, pid)) err = TRUE;
     }
   }
   villa->tran = FALSE;
-  villa->root = villa->rbroot;
-  villa->last = villa->rblast;
-  villa->lnum = villa->rblnum;
-  villa->nnum = villa->rbnnum;
-  villa->rnum = villa->rbrnum;
-  while(cbmaprnum(villa->leafc) > villa->leafcnum || cbmaprnum(villa->nodec) > villa->nodecnum){
-    if(!vlcacheadjust(villa)){
-      err = TRUE;
-      break;
-    }
+  if(villa->walfd != -1){
+    cbdatumsetsize(villa->walops, VL_WALHEAD);
+    if(!vlwalrecover(villa)) err = TRUE;
+  } else {
+    villa->root = villa->rbroot;
+    villa->last = villa->rblast;
+    villa->lnum = villa->rblnum;
+    villa->nnum = villa->rbnnum;
+    villa->rnum = villa->rbrnum;
   }
+  if(!vlcacheshrink(villa)) err = TRUE;
   return err ? FALSE : TRUE;
 }
 
 
-/* Remove a database file. */
-int vlremove(const char *name){
-  assert(name);
-  return dpremove(name);
-}
-
-
-/* Repair a broken database file. */
-int vlrepair(const char *name, VLCFUNC cmp){
-  DEPOT *depot;
-  VILLA *tvilla;
-  char path[VL_PATHBUFSIZ], *kbuf, *vbuf, *zbuf, *rp, *tkbuf, *tvbuf;
-  int i, err, flags, omode, ksiz, vsiz, zsiz, size, step, tksiz, tvsiz, vnum;
-  assert(name && cmp);
-  err = FALSE;
+/* Get a handle of a snapshot of a database. */
+VILLA *vlsnapshotopen(VILLA *villa){
+  VILLA *snap;
+  VLLEAF *leaf;
+  VLNODE *node;
+  const char *tmp;
+  int i, err;
+  assert(villa);
+  if(villa->base || villa->tran || villa->bulk){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return NULL;
+  }
+  err = FALSE;
+  VL_CACHELOCK(villa);
+  if(villa->walfd != -1){
+    if(!vlwalcheckpoint(villa)) err = TRUE;
+  } else if(villa->wmode){
+    vlaiobegin(villa);
+    cbmapiterinit(villa->leafc);
+    while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+      leaf = (VLLEAF *)cbmapget(villa->leafc, tmp, sizeof(int), NULL);
+      if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
+    }
+    cbmapiterinit(villa->nodec);
+    while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+      node = (VLNODE *)cbmapget(villa->nodec, tmp, sizeof(int), NULL);
+      if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+    }
+    if(!vlaioend(villa)) err = TRUE;
+  }
+  if(err){
+    VL_CACHEUNLOCK(villa);
+    return NULL;
+  }
+  CB_MALLOC(snap, sizeof(VILLA));
+  *snap = *villa;
+  snap->wmode = FALSE;
+  snap->dict = villa->dict ? cbdatumdup(villa->dict) : NULL;
+  snap->dictsmp = NULL;
+  snap->leaffree = cbdatumopen(NULL, 0);
+  snap->nodefree = cbdatumopen(NULL, 0);
+  snap->leafc = cbmapopen();
+  snap->nodec = cbmapopen();
+  snap->mutex = NULL;
+  snap->tlatch = NULL;
+  snap->saves = 0;
+#if defined(MYPTHREAD)
+  if(villa->mutex){
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+    CB_MALLOC(snap->mutex, sizeof(pthread_mutex_t));
+    pthread_mutex_init((pthread_mutex_t *)snap->mutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+  }
+#endif
+  snap->base = villa;
+  snap->snaps = NULL;
+  snap->svers = NULL;
+  snap->svnum = 0;
+  snap->walfd = -1;
+  snap->walops = NULL;
+  snap->walfree = NULL;
+  snap->walsiz = 0;
+  snap->dwrite = FALSE;
+  snap->replay = FALSE;
+  snap->hnum = 0;
+  snap->hleaf = -1;
+  snap->lleaf = -1;
+  snap->curleaf = -1;
+  snap->curknum = -1;
+  snap->curvnum = -1;
+  snap->rawin = 0;
+  snap->raleft = 0;
+  for(i = 0; i < VL_CHUNKCLASS; i++){
+    snap->chunks[i] = NULL;
+    snap->chunknum[i] = 0;
+  }
+  snap->leafcsiz = 0;
+  snap->nodecsiz = 0;
+  snap->leafcpeak = 0;
+  snap->nodecpeak = 0;
+  snap->leafghost = cbmapopen();
+  snap->nodeghost = cbmapopen();
+  snap->leafchot = 0;
+  snap->nodechot = 0;
+  snap->pinlevel = 0;
+  snap->pinnum = 0;
+  snap->pinsiz = 0;
+  VL_DEPOTLOCK(villa, TRUE);
+  if(!villa->snaps){
+    villa->snaps = cbdatumopen(NULL, 0);
+    villa->svers = cbmapopen();
+  }
+  snap->sgen = ++villa->sgen;
+  CB_DATUMCAT(villa->snaps, (char *)&(snap->sgen), sizeof(int));
+  VL_DEPOTUNLOCK(villa);
+  VL_CACHEUNLOCK(villa);
+  return snap;
+}
+
+
+/* Close a handle of a snapshot. */
+int vlsnapshotclose(VILLA *snap){
+  assert(snap);
+  if(!snap->base){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  return vlclose(snap);
+}
+
+
+/* Remove a database file. */
+int vlremove(const char *name){
+  char path[VL_PATHBUFSIZ];
+  assert(name);
+  sprintf(path, "%s%s", name, VL_WALSUF);
+  if(unlink(path) == -1 && errno != ENOENT){
+    dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+    return FALSE;
+  }
+  sprintf(path, "%s%s", name, VL_PTSUF);
+  if(unlink(path) == -1 && errno != ENOENT){
+    dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+    return FALSE;
+  }
+  return dpremove(name);
+}
+
+
+/* Repair a broken database file. */
+int vlrepair(const char *name, VLCFUNC cmp){
+  DEPOT *depot;
+  VILLA *tvilla;
+  CBDATUM *pkey, *dict;
+  const char *tkbuf;
+  char path[VL_PATHBUFSIZ], *kbuf, *vbuf, *zbuf, *rp, *tvbuf;
+  int i, err, flags, omode, ksiz, vsiz, zsiz, size, step, tksiz, tvsiz, vnum, psiz, codec, knum;
+  assert(name && cmp);
+  err = FALSE;
+  sprintf(path, "%s%s", name, VL_PTSUF);
+  if(unlink(path) == -1 && errno != ENOENT){
+    dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+    err = TRUE;
+  }
   if(!dprepair(name)) err = TRUE;
   if(!(depot = dpopen(name, DP_OREADER, -1))) return FALSE;
   flags = dpgetflags(depot);
@@ -1267,39 +2452,45 @@ int vlrepair(const char *name, VLCFUNC cmp){
   }
   sprintf(path, "%s%s", name, VL_TMPFSUF);
   omode = VL_OWRITER | VL_OCREAT | VL_OTRUNC;
-  if(flags & VL_FLISZLIB){
-    omode |= VL_OZCOMP;
-  } else if(flags & VL_FLISLZO){
-    omode |= VL_OXCOMP;
-  } else if(flags & VL_FLISBZIP){
-    omode |= VL_OYCOMP;
+  codec = VL_CDNONE;
+  for(i = 1; i < VL_CDNUM; i++){
+    if(flags & vlcodecs[i].flag){
+      omode |= vlcodecs[i].omode;
+      codec = vlcodecid(vlcodecs[i].omode);
+      break;
+    }
   }
+  if(depot->large) omode |= VL_OLARGE;
   if(!(tvilla = vlopen(path, omode, cmp))){
     dpclose(depot);
     return FALSE;
   }
+  dict = NULL;
+  knum = VL_DICTKEY;
+  if((flags & VL_FLISCODEC) &&
+     (vbuf = dpget(depot, (char *)&knum, sizeof(int), 0, -1, &vsiz)) != NULL){
+    dict = cbdatumopen(vbuf, vsiz);
+    free(vbuf);
+  }
   if(!dpiterinit(depot)) err = TRUE;
+  CB_DATUMOPEN(pkey);
   while((kbuf =  dpiternext(depot, &ksiz)) != NULL){
     if(ksiz == sizeof(int) && *(int *)kbuf < VL_NODEIDMIN && *(int *)kbuf > 0){
       if((vbuf = dpget(depot, (char *)kbuf, sizeof(int), 0, -1, &vsiz)) != NULL){
-        if(_qdbm_inflate && (flags & VL_FLISZLIB) &&
-           (zbuf = _qdbm_inflate(vbuf, vsiz, &zsiz, _QDBM_ZMRAW)) != NULL){
-          free(vbuf);
-          vbuf = zbuf;
-          vsiz = zsiz;
-        } else if(_qdbm_lzodecode && (flags & VL_FLISLZO) &&
-                  (zbuf = _qdbm_lzodecode(vbuf, vsiz, &zsiz)) != NULL){
-          free(vbuf);
-          vbuf = zbuf;
-          vsiz = zsiz;
-        } else if(_qdbm_bzdecode && (flags & VL_FLISBZIP) &&
-                  (zbuf = _qdbm_bzdecode(vbuf, vsiz, &zsiz)) != NULL){
+        rp = vbuf;
+        size = vsiz;
+        if((flags & VL_FLISCODEC) && size >= 1){
+          codec = *(unsigned char *)rp;
+          rp++;
+          size--;
+        }
+        if(codec > VL_CDNONE && codec < VL_CDNUM &&
+           (zbuf = vlcodecs[codec].decode(rp, size, &zsiz, dict)) != NULL){
           free(vbuf);
           vbuf = zbuf;
-          vsiz = zsiz;
+          rp = vbuf;
+          size = zsiz;
         }
-        rp = vbuf;
-        size = vsiz;
         if(size >= 1){
           VL_READVNUMBUF(rp, size, vnum, step);
           rp += step;
@@ -1310,14 +2501,25 @@ int vlrepair(const char *name, VLCFUNC cmp){
           rp += step;
           size -= step;
         }
+        CB_DATUMSETSIZE(pkey, 0);
         while(size >= 1){
+          psiz = 0;
+          if(flags & VL_FLISFRONT){
+            VL_READVNUMBUF(rp, size, psiz, step);
+            rp += step;
+            size -= step;
+            if(size < 1 || psiz > CB_DATUMSIZE(pkey)) break;
+          }
           VL_READVNUMBUF(rp, size, tksiz, step);
           rp += step;
           size -= step;
           if(size < tksiz) break;
-          tkbuf = rp;
-          rp += tksiz;
-          size -= tksiz;
+          CB_DATUMSETSIZE(pkey, psiz);
+          CB_DATUMCAT(pkey, rp, tksiz);
+          tkbuf = CB_DATUMPTR(pkey);
+          tksiz = CB_DATUMSIZE(pkey);
+          rp += tksiz - psiz;
+          size -= tksiz - psiz;
           if(size < 1) break;
           VL_READVNUMBUF(rp, size, vnum, step);
           rp += step;
@@ -1339,6 +2541,8 @@ int vlrepair(const char *name, VLCFUNC cmp){
     }
     free(kbuf);
   }
+  CB_DATUMCLOSE(pkey);
+  if(dict) cbdatumclose(dict);
   if(!vlclose(tvilla)) err = TRUE;
   if(!dpclose(depot)) err = TRUE;
   if(!dpremove(name)) err = TRUE;
@@ -1423,6 +2627,277 @@ int vlimportdb(VILLA *villa, const char *name){
 }
 
 
+/* Begin bulk loading of sorted records. */
+int vlbulkbegin(VILLA *villa, int fill){
+  VLLEAF *leaf;
+  assert(villa);
+  if(!villa->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(villa->tran || villa->bulk || villa->rnum > 0 || villa->root >= VL_NODEIDMIN){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(villa->walfd != -1 && !vlwalcheckpoint(villa)) return FALSE;
+  if(!(leaf = vlleafload(villa, villa->root, TRUE))) return FALSE;
+  villa->curleaf = -1;
+  villa->curknum = -1;
+  villa->curvnum = -1;
+  villa->hnum = 0;
+  villa->hleaf = -1;
+  villa->lleaf = -1;
+  villa->bulk = TRUE;
+  villa->bulkfill = fill >= 1 && fill <= 100 ? fill : 100;
+  villa->bulkleaf = leaf->id;
+  villa->bulksiz = 0;
+  villa->bulkdepth = 0;
+  villa->last = leaf->id;
+  return TRUE;
+}
+
+
+/* Store a record in bulk loading. */
+int vlbulkput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz){
+  VLLEAF *leaf, *newleaf;
+  VLREC *recp;
+  int ln, rv, recmax, sizmax;
+  assert(villa && kbuf && vbuf);
+  if(!villa->bulk){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  if(vsiz < 0) vsiz = strlen(vbuf);
+  if(!(leaf = vlleafload(villa, villa->bulkleaf, TRUE))) return FALSE;
+  if((ln = CB_LISTNUM(leaf->recs)) > 0){
+    recp = (VLREC *)CB_LISTVAL(leaf->recs, ln - 1);
+    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    if(rv < 0){
+      dpecodeset(DP_EMISC, __FILE__, __LINE__);
+      return FALSE;
+    }
+    if(rv == 0){
+      vlleafaddrec(villa, leaf, VL_DDUP, kbuf, ksiz, vbuf, vsiz);
+      villa->bulksiz += vsiz;
+      return TRUE;
+    }
+    recmax = villa->leafrecmax * villa->bulkfill / 100;
+    if(recmax < 2) recmax = 2;
+    sizmax = VL_MAXLEAFSIZ * (villa->cmode > 0 ? 2 : 1) / 100 * villa->bulkfill;
+    if(ln >= recmax || villa->bulksiz >= sizmax){
+      newleaf = vlleafnew(villa, leaf->id, -1);
+      leaf->next = newleaf->id;
+      villa->last = newleaf->id;
+      if(!vlleafcacheout(villa, leaf->id)) return FALSE;
+      if(!vlbulkaddidx(villa, 0, villa->bulkleaf, newleaf->id, kbuf,
+                       vlsepsize(villa, recp->key, kbuf, ksiz))) return FALSE;
+      villa->bulkleaf = newleaf->id;
+      villa->bulksiz = 0;
+      leaf = newleaf;
+    }
+  }
+  recp = vlrecnew(villa, leaf, kbuf, ksiz, vbuf, vsiz, TRUE);
+  CB_LISTPUSHBUF(leaf->recs, (char *)recp, sizeof(VLREC));
+  VL_ATOMICSET(leaf->dirty, TRUE);
+  villa->bulksiz += ksiz + vsiz;
+  villa->rnum++;
+  return TRUE;
+}
+
+
+/* End bulk loading. */
+int vlbulkend(VILLA *villa){
+  VLNODE *node;
+  CBDATUM *key;
+  int i, err;
+  assert(villa);
+  if(!villa->bulk){
+    dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  villa->bulk = FALSE;
+  err = FALSE;
+  if(!vlleafcacheout(villa, villa->bulkleaf)) err = TRUE;
+  for(i = 0; i < villa->bulkdepth; i++){
+    key = villa->bulkkeys[i];
+    if(villa->bulkpids[i] > 0){
+      if((node = vlnodeload(villa, villa->bulknodes[i])) != NULL){
+        vlnodeaddidx(villa, node, TRUE, villa->bulkpids[i], CB_DATUMPTR(key), CB_DATUMSIZE(key));
+      } else {
+        err = TRUE;
+      }
+    }
+    if(key) CB_DATUMCLOSE(key);
+    if(!vlnodecacheout(villa, villa->bulknodes[i])) err = TRUE;
+  }
+  villa->root = villa->bulkdepth > 0 ? villa->bulknodes[villa->bulkdepth-1] : villa->bulkleaf;
+  if(villa->walfd != -1 && !vlwalcheckpoint(villa)) err = TRUE;
+  return err ? FALSE : TRUE;
+}
+
+
+
+/* Get a sorter of records for bulk loading. */
+VLSORT *vlsortopen(VILLA *villa, int max, int thnum){
+  VLSORT *sort;
+  assert(villa);
+  if(!villa->wmode){
+    dpecodeset(DP_EMODE, __FILE__, __LINE__);
+    return NULL;
+  }
+  CB_MALLOC(sort, sizeof(VLSORT));
+  sort->villa = villa;
+  sort->buf = NULL;
+  sort->bsiz = 0;
+  sort->basiz = 0;
+  sort->rnum = 0;
+  if(max < 1) max = VL_DEFSORTMAX;
+  sort->max = max > VL_SORTMINBUF * 4 ? max : VL_SORTMINBUF * 4;
+  sort->thnum = thnum > 0 ? thnum : 1;
+  if(sort->thnum > VL_SORTTHMAX) sort->thnum = VL_SORTTHMAX;
+  sort->runs = cblistopen();
+  sort->seq = 0;
+  return sort;
+}
+
+
+/* Close a sorter of records. */
+int vlsortclose(VLSORT *sort){
+  const char *path;
+  int i, err;
+  assert(sort);
+  err = FALSE;
+  for(i = 0; i < CB_LISTNUM(sort->runs); i++){
+    path = CB_LISTVAL(sort->runs, i);
+    if(unlink(path) == -1){
+      dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+      err = TRUE;
+    }
+  }
+  cblistclose(sort->runs);
+  free(sort->buf);
+  free(sort);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Add a record to a sorter. */
+int vlsortput(VLSORT *sort, const char *kbuf, int ksiz, const char *vbuf, int vsiz){
+  char *wp;
+  int rsiz;
+  assert(sort && kbuf && vbuf);
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  if(vsiz < 0) vsiz = strlen(vbuf);
+  rsiz = VL_ARENAPAD(sizeof(int) * 2 + ksiz + vsiz);
+  if(sort->rnum > 0 &&
+     sort->bsiz + rsiz + (sort->rnum + 1) * (int)sizeof(char *) * 2 > sort->max &&
+     !vlsortspill(sort)) return FALSE;
+  if(sort->bsiz + rsiz > sort->basiz){
+    sort->basiz = sort->basiz * 2 + rsiz;
+    if(sort->basiz > sort->max && sort->bsiz + rsiz <= sort->max) sort->basiz = sort->max;
+    CB_REALLOC(sort->buf, sort->basiz);
+  }
+  wp = sort->buf + sort->bsiz;
+  memcpy(wp, &ksiz, sizeof(int));
+  memcpy(wp + sizeof(int), &vsiz, sizeof(int));
+  memcpy(wp + sizeof(int) * 2, kbuf, ksiz);
+  memcpy(wp + sizeof(int) * 2 + ksiz, vbuf, vsiz);
+  sort->bsiz += rsiz;
+  sort->rnum++;
+  return TRUE;
+}
+
+
+/* Store the records of a sorter into the database by bulk loading. */
+int vlsortload(VLSORT *sort, int fill){
+  VLSORTSRC *srcs;
+  VLSORTJOB jobs[VL_SORTTHMAX];
+  char path[VL_PATHBUFSIZ], *name, *rp;
+  FILE *ofp;
+  int i, err, num, fanin, rbsiz;
+  assert(sort);
+  if(!vlbulkbegin(sort->villa, fill)) return FALSE;
+  err = FALSE;
+  if(CB_LISTNUM(sort->runs) < 1){
+    num = vlsortrun(sort, jobs, FALSE);
+    CB_MALLOC(srcs, sizeof(VLSORTSRC) * (num + 1));
+    for(i = 0; i < num; i++){
+      if(jobs[i].err) err = TRUE;
+      srcs[i].ifp = NULL;
+      srcs[i].recs = jobs[i].recs;
+      srcs[i].num = jobs[i].num;
+      srcs[i].idx = 0;
+      srcs[i].rbuf = NULL;
+    }
+    if(!err && !vlsortmerge(sort, srcs, num, NULL)) err = TRUE;
+    free(srcs);
+    free(jobs[0].recs);
+  } else {
+    if(sort->rnum > 0 && !vlsortspill(sort)) err = TRUE;
+    fanin = sort->max / VL_SORTMINBUF - 1;
+    if(fanin > VL_SORTFANIN) fanin = VL_SORTFANIN;
+    CB_MALLOC(srcs, sizeof(VLSORTSRC) * fanin);
+    name = dpname(sort->villa->depot);
+    while(!err){
+      num = CB_LISTNUM(sort->runs) < fanin ? CB_LISTNUM(sort->runs) : fanin;
+      rbsiz = sort->max / (num + 1);
+      for(i = 0; i < num; i++){
+        srcs[i].rbuf = NULL;
+        srcs[i].bufs[0] = NULL;
+        srcs[i].bufs[1] = NULL;
+        srcs[i].bsizs[0] = 0;
+        srcs[i].bsizs[1] = 0;
+        srcs[i].cur = 0;
+        if(!(srcs[i].ifp = fopen(CB_LISTVAL(sort->runs, i), "rb"))){
+          dpecodeset(DP_EOPEN, __FILE__, __LINE__);
+          err = TRUE;
+          continue;
+        }
+        CB_MALLOC(srcs[i].rbuf, rbsiz);
+        setvbuf(srcs[i].ifp, srcs[i].rbuf, _IOFBF, rbsiz);
+      }
+      ofp = NULL;
+      if(!err && num < CB_LISTNUM(sort->runs)){
+        sprintf(path, "%s%s.%d", name, VL_TMPFSUF, sort->seq++);
+        if(!(ofp = fopen(path, "wb"))){
+          dpecodeset(DP_EOPEN, __FILE__, __LINE__);
+          err = TRUE;
+        } else {
+          setvbuf(ofp, NULL, _IOFBF, rbsiz);
+        }
+      }
+      if(!err && !vlsortmerge(sort, srcs, num, ofp)) err = TRUE;
+      if(ofp){
+        if(fclose(ofp) != 0){
+          dpecodeset(DP_ECLOSE, __FILE__, __LINE__);
+          err = TRUE;
+        }
+      }
+      for(i = 0; i < num; i++){
+        if(srcs[i].ifp) fclose(srcs[i].ifp);
+        free(srcs[i].rbuf);
+        free(srcs[i].bufs[0]);
+        free(srcs[i].bufs[1]);
+      }
+      if(!ofp) break;
+      for(i = 0; i < num; i++){
+        rp = cblistshift(sort->runs, NULL);
+        if(unlink(rp) == -1){
+          dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+          err = TRUE;
+        }
+        free(rp);
+      }
+      cblistunshift(sort->runs, path, strlen(path));
+    }
+    free(name);
+    free(srcs);
+  }
+  if(!vlbulkend(sort->villa)) err = TRUE;
+  return err ? FALSE : TRUE;
+}
+
 
 /*************************************************************************************************
  * features for experts
@@ -1446,6 +2921,7 @@ int *vlcrdnumptr(void){
 
 /* Synchronize updating contents on memory. */
 int vlmemsync(VILLA *villa){
+  VLNODE *node;
   int err, pid;
   const char *tmp;
   assert(villa);
@@ -1457,7 +2933,9 @@ int vlmemsync(VILLA *villa){
     dpecodeset(DP_EMISC, __FILE__, __LINE__);
     return FALSE;
   }
+  if(villa->walfd != -1) return vlwalcheckpoint(villa);
   err = FALSE;
+  vlaiobegin(villa);
   cbmapiterinit(villa->leafc);
   while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
     pid = *(int *)tmp;
@@ -1466,16 +2944,25 @@ int vlmemsync(VILLA *villa){
   cbmapiterinit(villa->nodec);
   while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
     pid = *(int *)tmp;
-    if(!vlnodecacheout(villa, pid)) err = TRUE;
+    node = (VLNODE *)cbmapget(villa->nodec, (char *)&pid, sizeof(int), NULL);
+    if(node->pin){
+      if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+    } else if(!vlnodecacheout(villa, pid)){
+      err = TRUE;
+    }
   }
+  VL_DEPOTLOCK(villa, TRUE);
   if(!dpsetalign(villa->depot, 0)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
+  if(!vldpputfree(villa)) err = TRUE;
   if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
+  if(!dpaioend(villa->depot)) err = TRUE;
   if(!dpmemsync(villa->depot)) err = TRUE;
+  VL_DEPOTUNLOCK(villa);
   return err ? FALSE : TRUE;
 }
 
@@ -1493,7 +2980,9 @@ int vlmemflush(VILLA *villa){
     dpecodeset(DP_EMISC, __FILE__, __LINE__);
     return FALSE;
   }
+  if(villa->walfd != -1) return vlwalcheckpoint(villa);
   err = FALSE;
+  vlaiobegin(villa);
   cbmapiterinit(villa->leafc);
   while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
     pid = *(int *)tmp;
@@ -1504,14 +2993,18 @@ int vlmemflush(VILLA *villa){
     pid = *(int *)tmp;
     if(!vlnodecacheout(villa, pid)) err = TRUE;
   }
+  VL_DEPOTLOCK(villa, TRUE);
   if(!dpsetalign(villa->depot, 0)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_ROOTKEY, villa->root)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_LASTKEY, villa->last)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_LNUMKEY, villa->lnum)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_NNUMKEY, villa->nnum)) err = TRUE;
   if(!vldpputnum(villa->depot, VL_RNUMKEY, villa->rnum)) err = TRUE;
+  if(!vldpputfree(villa)) err = TRUE;
   if(!dpsetalign(villa->depot, VL_PAGEALIGN)) err = TRUE;
+  if(!dpaioend(villa->depot)) err = TRUE;
   if(!dpmemflush(villa->depot)) err = TRUE;
+  VL_DEPOTUNLOCK(villa);
   return err ? FALSE : TRUE;
 }
 
@@ -1525,7 +3018,7 @@ const char *vlgetcache(VILLA *villa, const char *kbuf, int ksiz, int *sp){
   if(ksiz < 0) ksiz = strlen(kbuf);
   if(villa->hleaf < VL_LEAFIDMIN || !(leaf = vlgethistleaf(villa, kbuf, ksiz))){
     if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return NULL;
-    if(!(leaf = vlleafload(villa, pid))) return NULL;
+    if(!(leaf = vlleafload(villa, pid, FALSE))) return NULL;
   }
   if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, NULL))){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
@@ -1548,7 +3041,7 @@ const char *vlcurkeycache(VILLA *villa, int *sp){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -1571,7 +3064,7 @@ const char *vlcurvalcache(VILLA *villa, int *sp){
     dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
     return FALSE;
   }
-  if(!(leaf = vlleafload(villa, villa->curleaf))){
+  if(!(leaf = vlleafload(villa, villa->curleaf, TRUE))){
     villa->curleaf = -1;
     return FALSE;
   }
@@ -1600,6 +3093,9 @@ VLMULCUR *vlmulcuropen(VILLA *villa){
   mulcur->curleaf = -1;
   mulcur->curknum = -1;
   mulcur->curvnum = -1;
+  mulcur->rawin = 0;
+  mulcur->raleft = 0;
+  mulcur->leaf = NULL;
   return mulcur;
 }
 
@@ -1607,205 +3103,175 @@ VLMULCUR *vlmulcuropen(VILLA *villa){
 /* Close a multiple cursor handle. */
 void vlmulcurclose(VLMULCUR *mulcur){
   assert(mulcur);
+  vlmulcurrelease(mulcur);
   free(mulcur);
 }
 
 
 /* Move a multiple cursor to the first record. */
 int vlmulcurfirst(VLMULCUR *mulcur){
-  VLMULCUR swap;
-  int rv;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurfirst(mulcur->villa);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  mulcur->rawin = 0;
+  mulcur->raleft = 0;
+  if(!vlmulcurseek(mulcur, VL_LEAFIDMIN, FALSE)) return FALSE;
+  mulcur->curknum = 0;
+  mulcur->curvnum = 0;
+  return TRUE;
 }
 
 
 /* Move a multiple cursor to the last record. */
 int vlmulcurlast(VLMULCUR *mulcur){
-  VLMULCUR swap;
-  int rv;
+  VLLEAF *leaf;
+  VLREC *recp;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurlast(mulcur->villa);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  mulcur->rawin = 0;
+  mulcur->raleft = 0;
+  if(!(leaf = vlmulcurseek(mulcur, mulcur->villa->last, TRUE))) return FALSE;
+  mulcur->curknum = CB_LISTNUM(leaf->recs) - 1;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, mulcur->curknum);
+  mulcur->curvnum = recp->rest ? CB_LISTNUM(recp->rest) : 0;
+  return TRUE;
 }
 
 
 /* Move a multiple cursor to the previous record. */
 int vlmulcurprev(VLMULCUR *mulcur){
-  VLMULCUR swap;
-  int rv;
+  VLLEAF *leaf;
+  VLREC *recp;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurprev(mulcur->villa);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  if(!(leaf = vlmulcurseek(mulcur, mulcur->curleaf, TRUE))) return FALSE;
+  mulcur->curvnum--;
+  if(mulcur->curvnum < 0){
+    mulcur->curknum--;
+    if(mulcur->curknum < 0){
+      mulcur->rawin = 0;
+      mulcur->raleft = 0;
+      if(!(leaf = vlmulcurseek(mulcur, leaf->prev, TRUE))) return FALSE;
+      mulcur->curknum = CB_LISTNUM(leaf->recs) - 1;
+    }
+    recp = (VLREC *)CB_LISTVAL(leaf->recs, mulcur->curknum);
+    mulcur->curvnum = recp->rest ? CB_LISTNUM(recp->rest) : 0;
+  }
+  return vlcacheadjust(mulcur->villa);
 }
 
 
 /* Move a multiple cursor to the next record. */
 int vlmulcurnext(VLMULCUR *mulcur){
-  VLMULCUR swap;
-  int rv;
+  VLLEAF *leaf;
+  VLREC *recp;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurnext(mulcur->villa);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  if(!(leaf = vlmulcurseek(mulcur, mulcur->curleaf, FALSE))) return FALSE;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, mulcur->curknum);
+  mulcur->curvnum++;
+  if(mulcur->curvnum > (recp->rest ? CB_LISTNUM(recp->rest) : 0)){
+    mulcur->curknum++;
+    mulcur->curvnum = 0;
+  }
+  if(mulcur->curknum >= CB_LISTNUM(leaf->recs)){
+    mulcur->curknum = 0;
+    mulcur->curvnum = 0;
+    if(!(leaf = vlmulcurseek(mulcur, leaf->next, FALSE))) return FALSE;
+    vlreadahead(mulcur->villa, leaf, &(mulcur->rawin), &(mulcur->raleft));
+  }
+  return vlcacheadjust(mulcur->villa);
 }
 
 
 /* Move a multiple cursor to a position around a record. */
 int vlmulcurjump(VLMULCUR *mulcur, const char *kbuf, int ksiz, int jmode){
-  VLMULCUR swap;
-  int rv;
-  assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurjump(mulcur->villa, kbuf, ksiz, jmode);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  VILLA *villa;
+  VLLEAF *leaf;
+  VLREC *recp;
+  int hist[VL_LEVELMAX];
+  int hnum, pid, index;
+  assert(mulcur && kbuf);
+  villa = mulcur->villa;
+  if(ksiz < 0) ksiz = strlen(kbuf);
+  mulcur->rawin = 0;
+  mulcur->raleft = 0;
+  if((pid = vlsearchpath(villa, kbuf, ksiz, hist, &hnum)) == -1){
+    vlmulcurrelease(mulcur);
+    return FALSE;
+  }
+  if(!(leaf = vlmulcurseek(mulcur, pid, jmode != VL_JFORWARD))) return FALSE;
+  if(!(recp = vlrecsearch(villa, leaf, kbuf, ksiz, &index))){
+    if(index >= CB_LISTNUM(leaf->recs)) index--;
+    mulcur->curknum = index;
+    recp = (VLREC *)CB_LISTVAL(leaf->recs, index);
+    if(jmode == VL_JFORWARD){
+      mulcur->curvnum = 0;
+      if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key)) < 0) return TRUE;
+      mulcur->curvnum = (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+      return vlmulcurnext(mulcur);
+    }
+    mulcur->curvnum = (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+    if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key)) > 0) return TRUE;
+    mulcur->curvnum = 0;
+    return vlmulcurprev(mulcur);
+  }
+  mulcur->curknum = index;
+  mulcur->curvnum = (jmode == VL_JFORWARD) ? 0 : (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+  return TRUE;
 }
 
 
 /* Get the key of the record where a multiple cursor is. */
 char *vlmulcurkey(VLMULCUR *mulcur, int *sp){
-  VLMULCUR swap;
+  const char *kbuf;
   char *rv;
+  int ksiz;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurkey(mulcur->villa, sp);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
+  if(!(kbuf = vlmulcurkeycache(mulcur, &ksiz))) return NULL;
+  if(sp) *sp = ksiz;
+  CB_MEMDUP(rv, kbuf, ksiz);
   return rv;
 }
 
 
 /* Get the value of the record where a multiple cursor is. */
 char *vlmulcurval(VLMULCUR *mulcur, int *sp){
-  VLMULCUR swap;
+  const char *vbuf;
   char *rv;
+  int vsiz;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurval(mulcur->villa, sp);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
+  if(!(vbuf = vlmulcurvalcache(mulcur, &vsiz))) return NULL;
+  if(sp) *sp = vsiz;
+  CB_MEMDUP(rv, vbuf, vsiz);
   return rv;
 }
 
 
 /* Refer to volatile cache of the key of the record where a multiple cursor is. */
 const char *vlmulcurkeycache(VLMULCUR *mulcur, int *sp){
-  VLMULCUR swap;
-  const char *rv;
+  VLLEAF *leaf;
+  VLREC *recp;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurkeycache(mulcur->villa, sp);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  if(!(leaf = vlmulcurseek(mulcur, mulcur->curleaf, FALSE))) return NULL;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, mulcur->curknum);
+  if(sp) *sp = CB_DATUMSIZE(recp->key);
+  return CB_DATUMPTR(recp->key);
 }
 
 
 /* Refer to volatile cache of the value of the record where a multiple cursor is. */
 const char *vlmulcurvalcache(VLMULCUR *mulcur, int *sp){
-  VLMULCUR swap;
-  const char *rv;
+  VLLEAF *leaf;
+  VLREC *recp;
+  const char *vbuf;
+  int vsiz;
   assert(mulcur);
-  swap.curleaf = mulcur->villa->curleaf;
-  swap.curknum = mulcur->villa->curknum;
-  swap.curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = mulcur->curleaf;
-  mulcur->villa->curknum = mulcur->curknum;
-  mulcur->villa->curvnum = mulcur->curvnum;
-  rv = vlcurvalcache(mulcur->villa, sp);
-  mulcur->curleaf = mulcur->villa->curleaf;
-  mulcur->curknum = mulcur->villa->curknum;
-  mulcur->curvnum = mulcur->villa->curvnum;
-  mulcur->villa->curleaf = swap.curleaf;
-  mulcur->villa->curknum = swap.curknum;
-  mulcur->villa->curvnum = swap.curvnum;
-  return rv;
+  if(!(leaf = vlmulcurseek(mulcur, mulcur->curleaf, FALSE))) return NULL;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, mulcur->curknum);
+  if(mulcur->curvnum < 1){
+    vbuf = CB_DATUMPTR(recp->first);
+    vsiz = CB_DATUMSIZE(recp->first);
+  } else {
+    vbuf = CB_LISTVAL2(recp->rest, mulcur->curvnum - 1, vsiz);
+  }
+  if(sp) *sp = vsiz;
+  return vbuf;
 }
 
 
@@ -1914,218 +3380,2777 @@ static int vldpgetnum(DEPOT *depot, int knum, int *vnp){
 }
 
 
-/* Create a new leaf.
+/* Store the IDs of freed pages.
    `villa' specifies a database handle.
-   `prev' specifies the ID number of the previous leaf.
-   `next' specifies the ID number of the previous leaf.
-   The return value is a handle of the leaf. */
-static VLLEAF *vlleafnew(VILLA *villa, int prev, int next){
-  VLLEAF lent;
+   The return value is true if successful, else, it is false.
+   The value of the record is the number of freed leaves, the IDs of them, and the IDs of freed
+   nodes. */
+static int vldpputfree(VILLA *villa){
+  CBDATUM *buf;
+  int knum, lfnum, err;
   assert(villa);
-  lent.id = villa->lnum + VL_LEAFIDMIN;
-  lent.dirty = TRUE;
-  CB_LISTOPEN(lent.recs);
-  lent.prev = prev;
-  lent.next = next;
-  villa->lnum++;
-  cbmapput(villa->leafc, (char *)&(lent.id), sizeof(int), (char *)&lent, sizeof(VLLEAF), TRUE);
-  return (VLLEAF *)cbmapget(villa->leafc, (char *)&(lent.id), sizeof(int), NULL);
-}
-
-
-/* Remove a leaf from the cache.
-   `villa' specifies a database handle.
-   `id' specifies the ID number of the leaf.
-   The return value is true if successful, else, it is false. */
-static int vlleafcacheout(VILLA *villa, int id){
-  VLLEAF *leaf;
-  VLREC *recp;
-  CBLIST *recs;
-  int i, err, ln;
-  assert(villa && id >= VL_LEAFIDMIN);
-  if(!(leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL))) return FALSE;
+  knum = VL_FREEKEY;
+  lfnum = CB_DATUMSIZE(villa->leaffree) / sizeof(int);
+  CB_DATUMOPEN(buf);
+  CB_DATUMCAT(buf, (char *)&lfnum, sizeof(int));
+  CB_DATUMCAT(buf, CB_DATUMPTR(villa->leaffree), CB_DATUMSIZE(villa->leaffree));
+  CB_DATUMCAT(buf, CB_DATUMPTR(villa->nodefree), CB_DATUMSIZE(villa->nodefree));
   err = FALSE;
-  if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
-  recs = leaf->recs;
-  ln = CB_LISTNUM(recs);
-  for(i = 0; i < ln; i++){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    CB_DATUMCLOSE(recp->key);
-    CB_DATUMCLOSE(recp->first);
-    if(recp->rest) CB_LISTCLOSE(recp->rest);
-  }
-  CB_LISTCLOSE(recs);
-  cbmapout(villa->leafc, (char *)&id, sizeof(int));
+  if(!dpput(villa->depot, (char *)&knum, sizeof(int),
+            CB_DATUMPTR(buf), CB_DATUMSIZE(buf), DP_DOVER)) err = TRUE;
+  CB_DATUMCLOSE(buf);
   return err ? FALSE : TRUE;
 }
 
 
-/* Save a leaf into the database.
+/* Retrieve the IDs of freed pages.
    `villa' specifies a database handle.
-   `leaf' specifies a leaf handle.
-   The return value is true if successful, else, it is false. */
-static int vlleafsave(VILLA *villa, VLLEAF *leaf){
-  VLREC *recp;
-  CBLIST *recs;
-  CBDATUM *buf;
-  char vnumbuf[VL_VNUMBUFSIZ], *zbuf;
-  const char *vbuf;
-  int i, j, ksiz, vnum, vsiz, prev, next, vnumsiz, ln, zsiz;
-  assert(villa && leaf);
-  CB_DATUMOPEN(buf);
-  prev = leaf->prev;
-  if(prev == -1) prev = VL_NODEIDMIN - 1;
-  VL_SETVNUMBUF(vnumsiz, vnumbuf, prev);
-  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-  next = leaf->next;
-  if(next == -1) next = VL_NODEIDMIN - 1;
-  VL_SETVNUMBUF(vnumsiz, vnumbuf, next);
-  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-  recs = leaf->recs;
-  ln = CB_LISTNUM(recs);
-  for(i = 0; i < ln; i++){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    ksiz = CB_DATUMSIZE(recp->key);
-    VL_SETVNUMBUF(vnumsiz, vnumbuf, ksiz);
-    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-    CB_DATUMCAT(buf, CB_DATUMPTR(recp->key), ksiz);
-    vnum = 1 + (recp->rest ? CB_LISTNUM(recp->rest) : 0);
-    VL_SETVNUMBUF(vnumsiz, vnumbuf, vnum);
-    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-    vsiz = CB_DATUMSIZE(recp->first);
-    VL_SETVNUMBUF(vnumsiz, vnumbuf, vsiz);
-    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-    CB_DATUMCAT(buf, CB_DATUMPTR(recp->first), vsiz);
-    if(recp->rest){
-      for(j = 0; j < CB_LISTNUM(recp->rest); j++){
-        vbuf = CB_LISTVAL2(recp->rest, j, vsiz);
-        VL_SETVNUMBUF(vnumsiz, vnumbuf, vsiz);
-        CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-        CB_DATUMCAT(buf, vbuf, vsiz);
-      }
-    }
+   The return value is true if successful, else, it is false.
+   If the record is missing or broken, no page is reused. */
+static int vldpgetfree(VILLA *villa){
+  char *vbuf;
+  const int *ids;
+  int i, knum, vsiz, lfnum, num;
+  assert(villa);
+  knum = VL_FREEKEY;
+  if(!(vbuf = dpget(villa->depot, (char *)&knum, sizeof(int), 0, -1, &vsiz))) return FALSE;
+  ids = (int *)vbuf;
+  num = vsiz / sizeof(int);
+  if(vsiz % sizeof(int) != 0 || num < 1 || (lfnum = ids[0]) < 0 || lfnum >= num){
+    free(vbuf);
+    return FALSE;
   }
-  if(_qdbm_deflate && villa->cmode == VL_OZCOMP){
-    if(!(zbuf = _qdbm_deflate(CB_DATUMPTR(buf), CB_DATUMSIZE(buf), &zsiz, _QDBM_ZMRAW))){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EMISC, __FILE__, __LINE__);
+  for(i = 1; i < num; i++){
+    if(i <= lfnum ? (ids[i] < VL_LEAFIDMIN || ids[i] >= villa->lnum + VL_LEAFIDMIN) :
+       (ids[i] < VL_NODEIDMIN || ids[i] >= villa->nnum + VL_NODEIDMIN)){
+      free(vbuf);
       return FALSE;
     }
-    if(!dpput(villa->depot, (char *)&(leaf->id), sizeof(int), zbuf, zsiz, DP_DOVER)){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+  }
+  cbdatumsetsize(villa->leaffree, 0);
+  cbdatumsetsize(villa->nodefree, 0);
+  CB_DATUMCAT(villa->leaffree, (char *)(ids + 1), lfnum * sizeof(int));
+  CB_DATUMCAT(villa->nodefree, (char *)(ids + 1 + lfnum), (num - 1 - lfnum) * sizeof(int));
+  free(vbuf);
+  return TRUE;
+}
+
+
+/* Keep the record of a page for snapshots before it is overwritten or removed.
+   `villa' specifies a database handle connected as a writer.
+   `id' specifies the ID number of the page.
+   The return value is true if successful, else, it is false.
+   Unless the page has been kept since the latest open snapshot was taken, the record is copied
+   under the pair of the ID number and the generation of the snapshot, and the generation is
+   appended to the ones of the page.  A page missing in the database is not referred by the
+   snapshots and is only marked. */
+static int vlsnapkeep(VILLA *villa, int id){
+  const int *gens;
+  char *vbuf;
+  int gen, num, vsiz, dkey[2], *buf;
+  assert(villa && id >= VL_LEAFIDMIN);
+  if(!villa->snaps || CB_DATUMSIZE(villa->snaps) < 1) return TRUE;
+  gen = ((int *)CB_DATUMPTR(villa->snaps))[CB_DATUMSIZE(villa->snaps)/sizeof(int)-1];
+  gens = (int *)cbmapget(villa->svers, (char *)&id, sizeof(int), &vsiz);
+  if(gens && gens[0] >= gen) return TRUE;
+  num = gens ? vsiz / sizeof(int) : 1;
+  CB_MALLOC(buf, (num + 1) * sizeof(int));
+  if(gens) memcpy(buf, gens, vsiz);
+  buf[0] = gen;
+  if((vbuf = dpget(villa->depot, (char *)&id, sizeof(int), 0, -1, &vsiz)) != NULL){
+    dkey[0] = id;
+    dkey[1] = gen;
+    if((villa->svnum < 1 && !vldpputnum(villa->depot, VL_SNAPKEY, 1)) ||
+       !dpput(villa->depot, (char *)dkey, sizeof(dkey), vbuf, vsiz, DP_DOVER)){
+      free(vbuf);
+      free(buf);
       return FALSE;
     }
-    free(zbuf);
-  } else if(_qdbm_lzoencode && villa->cmode == VL_OYCOMP){
-    if(!(zbuf = _qdbm_lzoencode(CB_DATUMPTR(buf), CB_DATUMSIZE(buf), &zsiz))){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EMISC, __FILE__, __LINE__);
-      return FALSE;
+    free(vbuf);
+    villa->svnum++;
+    buf[num++] = gen;
+  } else if(dpecode != DP_ENOITEM){
+    free(buf);
+    return FALSE;
+  }
+  cbmapput(villa->svers, (char *)&id, sizeof(int), (char *)buf, num * sizeof(int), TRUE);
+  free(buf);
+  return TRUE;
+}
+
+
+/* Get the key of the record of a page to be read.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the page.
+   `dkey' specifies the pointer to an array of two integers where the key is written.
+   The return value is the size of the key.
+   A snapshot reads the copy of the oldest generation not older than itself if any, else the
+   page itself.  This function should be called under the latch of the internal database. */
+static int vlsnapkey(VILLA *villa, int id, int *dkey){
+  const int *gens;
+  int i, num, vsiz;
+  assert(villa && id >= VL_LEAFIDMIN && dkey);
+  dkey[0] = id;
+  if(!villa->base ||
+     !(gens = (int *)cbmapget(villa->base->svers, (char *)&id, sizeof(int), &vsiz)))
+    return sizeof(int);
+  num = vsiz / sizeof(int);
+  for(i = 1; i < num; i++){
+    if(gens[i] >= villa->sgen){
+      dkey[1] = gens[i];
+      return sizeof(int) * 2;
     }
-    if(!dpput(villa->depot, (char *)&(leaf->id), sizeof(int), zbuf, zsiz, DP_DOVER)){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+  }
+  return sizeof(int);
+}
+
+
+/* Remove a snapshot from the database and the copies of pages no longer read.
+   `snap' specifies a handle of a snapshot.
+   The return value is true if successful, else, it is false.
+   Copies older than the oldest open snapshot are removed, and so are the marks of pages not
+   kept for the latest one. */
+static int vlsnapdrop(VILLA *snap){
+  VILLA *villa;
+  CBMAP *svers;
+  const char *kbuf;
+  int i, j, err, num, gnum, vsiz, min, max, rnum, knum, dkey[2], *snaps, *buf;
+  const int *gens;
+  assert(snap && snap->base);
+  villa = snap->base;
+  err = FALSE;
+  VL_CACHELOCK(villa);
+  VL_DEPOTLOCK(villa, TRUE);
+  snaps = (int *)CB_DATUMPTR(villa->snaps);
+  num = CB_DATUMSIZE(villa->snaps) / sizeof(int);
+  for(i = 0; i < num && snaps[i] != snap->sgen; i++);
+  if(i < num){
+    memmove(snaps + i, snaps + i + 1, (num - i - 1) * sizeof(int));
+    num--;
+    cbdatumsetsize(villa->snaps, num * sizeof(int));
+  }
+  min = num > 0 ? snaps[0] : INT_MAX;
+  max = num > 0 ? snaps[num-1] : INT_MAX;
+  rnum = 0;
+  if(cbmaprnum(villa->svers) < 1){
+    VL_DEPOTUNLOCK(villa);
+    VL_CACHEUNLOCK(villa);
+    return TRUE;
+  }
+  svers = cbmapopen();
+  cbmapiterinit(villa->svers);
+  while((kbuf = cbmapiternext(villa->svers, NULL)) != NULL){
+    gens = (int *)cbmapiterval(kbuf, &vsiz);
+    gnum = vsiz / sizeof(int);
+    CB_MALLOC(buf, vsiz);
+    buf[0] = gens[0];
+    num = 1;
+    for(j = 1; j < gnum; j++){
+      if(gens[j] >= min){
+        buf[num++] = gens[j];
+      } else {
+        dkey[0] = *(int *)kbuf;
+        dkey[1] = gens[j];
+        if(!dpout(villa->depot, (char *)dkey, sizeof(dkey))) err = TRUE;
+        villa->svnum--;
+        rnum++;
+      }
+    }
+    if(num > 1 || buf[0] >= max)
+      cbmapput(svers, kbuf, sizeof(int), (char *)buf, num * sizeof(int), FALSE);
+    free(buf);
+  }
+  cbmapclose(villa->svers);
+  villa->svers = svers;
+  if(rnum > 0 && villa->svnum < 1){
+    knum = VL_SNAPKEY;
+    if(!dpout(villa->depot, (char *)&knum, sizeof(int))) err = TRUE;
+  }
+  VL_DEPOTUNLOCK(villa);
+  VL_CACHEUNLOCK(villa);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Remove copies of pages left by a process which did not close the database appropriately.
+   `depot' specifies an internal database handle connected as a writer.
+   The return value is true if successful, else, it is false. */
+static int vlsnapsweep(DEPOT *depot){
+  CBLIST *keys;
+  const char *kbuf;
+  char *tbuf;
+  int i, err, ksiz, knum;
+  assert(depot);
+  err = FALSE;
+  CB_LISTOPEN(keys);
+  if(!dpiterinit(depot)) err = TRUE;
+  while((tbuf = dpiternext(depot, &ksiz)) != NULL){
+    if(ksiz == sizeof(int) * 2) CB_LISTPUSH(keys, tbuf, ksiz);
+    free(tbuf);
+  }
+  for(i = 0; i < CB_LISTNUM(keys); i++){
+    kbuf = CB_LISTVAL2(keys, i, ksiz);
+    if(!dpout(depot, kbuf, ksiz)) err = TRUE;
+  }
+  CB_LISTCLOSE(keys);
+  knum = VL_SNAPKEY;
+  if(!dpout(depot, (char *)&knum, sizeof(int))) err = TRUE;
+  return err ? FALSE : TRUE;
+}
+
+
+/* Open the table of the locations of pages of a database handle.
+   `villa' specifies a database handle.
+   The return value is true if successful, else, it is false.
+   The table is valid if it was closed cleanly with the same stamp and the same size of the
+   database file as recorded in the database.  A writer marks the table as being updated and
+   rebuilds it from scratch unless it is valid.  A reader maps a valid table only and reads
+   pages as usual otherwise. */
+static int vlptabopen(VILLA *villa){
+  struct stat sbuf;
+  VLPTAB *ptab;
+  char path[VL_PATHBUFSIZ], *name, *map;
+  int fd, valid, clean, stamp, dstamp, lcap, ncap, msiz;
+  long long fsiz;
+  assert(villa);
+  name = dpname(villa->depot);
+  sprintf(path, "%s%s", name, VL_PTSUF);
+  free(name);
+  if(!villa->wmode && stat(path, &sbuf) == -1) return TRUE;
+  if((fd = open(path, villa->wmode ? O_RDWR | O_CREAT : O_RDONLY, 00644)) == -1 ||
+     fstat(fd, &sbuf) == -1){
+    if(fd != -1) close(fd);
+    dpecodeset(DP_EOPEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(!vldpgetnum(villa->depot, VL_PTABKEY, &dstamp)) dstamp = -1;
+  valid = FALSE;
+  map = MAP_FAILED;
+  msiz = sbuf.st_size;
+  if(dstamp >= 0 && sbuf.st_size >= VL_PTHEADSIZ && sbuf.st_size <= INT_MAX &&
+     (map = mmap(0, msiz, PROT_READ | (villa->wmode ? PROT_WRITE : 0), MAP_SHARED,
+                 fd, 0)) != MAP_FAILED){
+    memcpy(&clean, map + VL_PTCLEANOFF, sizeof(int));
+    memcpy(&stamp, map + VL_PTSTAMPOFF, sizeof(int));
+    memcpy(&lcap, map + VL_PTLCAPOFF, sizeof(int));
+    memcpy(&ncap, map + VL_PTNCAPOFF, sizeof(int));
+    memcpy(&fsiz, map + VL_PTFSIZOFF, sizeof(long long));
+    if(!memcmp(map, VL_PTMAGIC, VL_PTMAGSIZ) && clean && stamp == dstamp &&
+       fsiz == (long long)dpfsizd(villa->depot) && lcap > 0 && ncap > 0 &&
+       VL_PTHEADSIZ + ((double)lcap + ncap) * sizeof(VLPTENT) == msiz) valid = TRUE;
+  }
+  if(!valid){
+    if(map != MAP_FAILED) munmap(map, msiz);
+    if(!villa->wmode){
+      close(fd);
+      return TRUE;
+    }
+    lcap = VL_PTINITNUM;
+    ncap = VL_PTINITNUM;
+    msiz = VL_PTHEADSIZ + (lcap + ncap) * sizeof(VLPTENT);
+    if(ftruncate(fd, 0) == -1 || ftruncate(fd, msiz) == -1){
+      close(fd);
+      dpecodeset(DP_ETRUNC, __FILE__, __LINE__);
       return FALSE;
     }
-    free(zbuf);
-  } else if(_qdbm_bzencode && villa->cmode == VL_OXCOMP){
-    if(!(zbuf = _qdbm_bzencode(CB_DATUMPTR(buf), CB_DATUMSIZE(buf), &zsiz))){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EMISC, __FILE__, __LINE__);
+    if((map = mmap(0, msiz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED){
+      close(fd);
+      dpecodeset(DP_EMAP, __FILE__, __LINE__);
       return FALSE;
     }
-    if(!dpput(villa->depot, (char *)&(leaf->id), sizeof(int), zbuf, zsiz, DP_DOVER)){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    memcpy(map, VL_PTMAGIC, VL_PTMAGSIZ);
+    stamp = dstamp >= 0 ? dstamp : 0;
+    memcpy(map + VL_PTSTAMPOFF, &stamp, sizeof(int));
+    memcpy(map + VL_PTLCAPOFF, &lcap, sizeof(int));
+    memcpy(map + VL_PTNCAPOFF, &ncap, sizeof(int));
+  }
+  if(villa->wmode){
+    clean = FALSE;
+    memcpy(map + VL_PTCLEANOFF, &clean, sizeof(int));
+    if(msync(map, VL_PTHEADSIZ, MS_SYNC) == -1){
+      munmap(map, msiz);
+      close(fd);
+      dpecodeset(DP_EMAP, __FILE__, __LINE__);
       return FALSE;
     }
-    free(zbuf);
+  }
+  CB_MALLOC(ptab, sizeof(VLPTAB));
+  ptab->fd = fd;
+  ptab->wmode = villa->wmode;
+  ptab->map = map;
+  ptab->msiz = msiz;
+  ptab->lcap = lcap;
+  ptab->ncap = ncap;
+  ptab->stamp = stamp;
+  ptab->hits = 0;
+  ptab->misses = 0;
+  villa->ptab = ptab;
+  return TRUE;
+}
+
+
+/* Close the table of the locations of pages of a database handle.
+   `villa' specifies a database handle with the table.
+   `clean' specifies whether the database has been closed without error.
+   `fsiz' specifies the size of the database file.
+   The return value is true if successful, else, it is false.
+   The table of a writer is marked as valid only if the database was closed cleanly, after the
+   entries are written into the device. */
+static int vlptabclose(VILLA *villa, int clean, double fsiz){
+  VLPTAB *ptab;
+  long long lfsiz;
+  int err;
+  assert(villa && villa->ptab);
+  ptab = villa->ptab;
+  err = FALSE;
+  if(ptab->wmode && clean){
+    lfsiz = fsiz;
+    memcpy(ptab->map + VL_PTSTAMPOFF, &(ptab->stamp), sizeof(int));
+    memcpy(ptab->map + VL_PTFSIZOFF, &lfsiz, sizeof(long long));
+    if(msync(ptab->map, ptab->msiz, MS_SYNC) == -1){
+      dpecodeset(DP_EMAP, __FILE__, __LINE__);
+      err = TRUE;
+    } else {
+      memcpy(ptab->map + VL_PTCLEANOFF, &clean, sizeof(int));
+      if(msync(ptab->map, VL_PTHEADSIZ, MS_SYNC) == -1){
+        dpecodeset(DP_EMAP, __FILE__, __LINE__);
+        err = TRUE;
+      }
+    }
+  }
+  if(munmap(ptab->map, ptab->msiz) == -1){
+    dpecodeset(DP_EMAP, __FILE__, __LINE__);
+    err = TRUE;
+  }
+  if(close(ptab->fd) == -1){
+    dpecodeset(DP_ECLOSE, __FILE__, __LINE__);
+    err = TRUE;
+  }
+  free(ptab);
+  villa->ptab = NULL;
+  return err ? FALSE : TRUE;
+}
+
+
+/* Invalidate the table of the locations of pages of a database.
+   `depot' specifies an internal database handle connected as a writer.
+   The return value is true if successful, else, it is false.
+   A writer without the table removes the stamp so that the table is not used afterward. */
+static int vlptabdrop(DEPOT *depot){
+  int knum;
+  assert(depot);
+  knum = VL_PTABKEY;
+  if(!dpout(depot, (char *)&knum, sizeof(int)) && dpecode != DP_ENOITEM) return FALSE;
+  return TRUE;
+}
+
+
+/* Get the entry of a page in the table of locations.
+   `ptab' specifies a table of locations.
+   `id' specifies the ID number of the page.
+   The return value is the pointer to the entry or `NULL' if it is out of the table.
+   The entries of leaves are followed by those of nodes. */
+static VLPTENT *vlptabent(VLPTAB *ptab, int id){
+  int idx;
+  assert(ptab && id >= VL_LEAFIDMIN);
+  if(id >= VL_NODEIDMIN){
+    idx = id - VL_NODEIDMIN;
+    if(idx >= ptab->ncap) return NULL;
+    idx += ptab->lcap;
+  } else {
+    idx = id - VL_LEAFIDMIN;
+    if(idx >= ptab->lcap) return NULL;
+  }
+  return (VLPTENT *)(ptab->map + VL_PTHEADSIZ) + idx;
+}
+
+
+/* Enlarge the table of locations to hold the entry of a page.
+   `ptab' specifies a table of locations of a writer.
+   `id' specifies the ID number of the page.
+   The return value is true if successful, else, it is false.
+   The region of leaves or nodes is doubled until it covers the page, and the entries of nodes
+   are moved behind the enlarged region of leaves. */
+static int vlptabgrow(VLPTAB *ptab, int id){
+  char *map;
+  int lcap, ncap, msiz, eoff;
+  assert(ptab && id >= VL_LEAFIDMIN);
+  lcap = ptab->lcap;
+  ncap = ptab->ncap;
+  if(id >= VL_NODEIDMIN){
+    while(ncap <= id - VL_NODEIDMIN && ncap < INT_MAX / 2){
+      ncap *= 2;
+    }
   } else {
-    if(!dpput(villa->depot, (char *)&(leaf->id), sizeof(int),
-              CB_DATUMPTR(buf), CB_DATUMSIZE(buf), DP_DOVER)){
-      CB_DATUMCLOSE(buf);
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-      return FALSE;
+    while(lcap <= id - VL_LEAFIDMIN){
+      lcap *= 2;
     }
   }
-  CB_DATUMCLOSE(buf);
-  leaf->dirty = FALSE;
+  if(VL_PTHEADSIZ + ((double)lcap + ncap) * sizeof(VLPTENT) > INT_MAX) return FALSE;
+  msiz = VL_PTHEADSIZ + (lcap + ncap) * sizeof(VLPTENT);
+  if(ftruncate(ptab->fd, msiz) == -1 ||
+     (map = mmap(0, msiz, PROT_READ | PROT_WRITE, MAP_SHARED, ptab->fd, 0)) == MAP_FAILED)
+    return FALSE;
+  munmap(ptab->map, ptab->msiz);
+  if(lcap > ptab->lcap){
+    eoff = VL_PTHEADSIZ + ptab->lcap * sizeof(VLPTENT);
+    memmove(map + VL_PTHEADSIZ + lcap * sizeof(VLPTENT), map + eoff,
+            ptab->ncap * sizeof(VLPTENT));
+    memset(map + eoff, 0, (lcap - ptab->lcap) * sizeof(VLPTENT));
+  }
+  eoff = VL_PTHEADSIZ + (lcap + ptab->ncap) * sizeof(VLPTENT);
+  memset(map + eoff, 0, msiz - eoff);
+  memcpy(map + VL_PTLCAPOFF, &lcap, sizeof(int));
+  memcpy(map + VL_PTNCAPOFF, &ncap, sizeof(int));
+  ptab->map = map;
+  ptab->msiz = msiz;
+  ptab->lcap = lcap;
+  ptab->ncap = ncap;
   return TRUE;
 }
 
 
-/* Load a leaf from the database.
-   `villa' specifies a database handle.
-   `id' specifies the ID number of the leaf.
-   If successful, the return value is the pointer to the leaf, else, it is `NULL'. */
-static VLLEAF *vlleafload(VILLA *villa, int id){
-  char wbuf[VL_PAGEBUFSIZ], *buf, *rp, *kbuf, *vbuf, *zbuf;
-  int i, size, step, ksiz, vnum, vsiz, prev, next, zsiz;
-  VLLEAF *leaf, lent;
-  VLREC rec;
-  assert(villa && id >= VL_LEAFIDMIN);
-  if((leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL)) != NULL){
-    cbmapmove(villa->leafc, (char *)&id, sizeof(int), FALSE);
-    return leaf;
+/* Set the location of a page in the table of locations.
+   `villa' specifies a database handle with the table.
+   `id' specifies the ID number of the page.
+   `off' specifies the offset of the record of the page, or 0 if it is unknown.
+   `size' specifies the size of the record.
+   `grow' specifies whether the table is enlarged to hold the entry.
+   This function should be called under the exclusive latch of the internal database, unless
+   the handle is not shared by threads. */
+static void vlptabset(VILLA *villa, int id, long long off, int size, int grow){
+  VLPTAB *ptab;
+  VLPTENT *ent;
+  assert(villa && villa->ptab && id >= VL_LEAFIDMIN);
+  ptab = villa->ptab;
+  if(!ptab->wmode) return;
+  if(!(ent = vlptabent(ptab, id))){
+    if(!grow || off < 1 || !vlptabgrow(ptab, id)) return;
+    ent = vlptabent(ptab, id);
+  }
+  ent->off = off;
+  ent->size = size;
+}
+
+
+/* Record the location of the record of a page in the table of locations.
+   `villa' specifies a database handle with the table.
+   `id' specifies the ID number of the page.
+   `last' specifies whether the page is the record stored last, else it is searched for.
+   The entry is cleared if the record is not found. */
+static void vlptabupdate(VILLA *villa, int id, int last){
+  long long off;
+  int size;
+  assert(villa && villa->ptab && id >= VL_LEAFIDMIN);
+  if(last ? dplastloc(villa->depot, &off, &size) :
+     dprecloc(villa->depot, (char *)&id, sizeof(int), &off, &size)){
+    vlptabset(villa, id, off, size, TRUE);
+  } else {
+    vlptabset(villa, id, 0, 0, FALSE);
   }
-  ksiz = -1;
-  prev = -1;
-  next = -1;
-  if((size = dpgetwb(villa->depot, (char *)&id, sizeof(int), 0, VL_PAGEBUFSIZ, wbuf)) > 0 &&
-     size < VL_PAGEBUFSIZ){
-    buf = NULL;
-  } else if(!(buf = dpget(villa->depot, (char *)&id, sizeof(int), 0, -1, &size))){
-    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+}
+
+
+/* Clear all entries of the table of locations.
+   `villa' specifies a database handle with the table.
+   This function is called after records are moved in the database file. */
+static void vlptabclear(VILLA *villa){
+  VLPTAB *ptab;
+  assert(villa && villa->ptab);
+  ptab = villa->ptab;
+  if(!ptab->wmode) return;
+  memset(ptab->map + VL_PTHEADSIZ, 0, ptab->msiz - VL_PTHEADSIZ);
+}
+
+
+/* Read the record of a page located by the table of locations.
+   `villa' specifies a database handle with the table.
+   `id' specifies the ID number of the page.
+   `wbuf' specifies the buffer of `VL_PAGEBUFSIZ' bytes used for a small record.
+   `bufp' specifies the pointer to a variable to which the region allocated for a large record
+   or `NULL' is assigned.
+   `sp' specifies the pointer to a variable to which the size of the image is assigned.
+   The return value is the pointer to the image of the page or `NULL' if it is not located.
+   The record is read with one call and its header and key are verified, so a stale entry is
+   only a miss.  This function should be called under the latch of the internal database. */
+static const char *vlptabread(VILLA *villa, int id, char *wbuf, char **bufp, int *sp){
+  VLPTAB *ptab;
+  VLPTENT *ent;
+  const char *rp;
+  char *buf;
+  assert(villa && villa->ptab && id >= VL_LEAFIDMIN && wbuf && bufp && sp);
+  ptab = villa->ptab;
+  *bufp = NULL;
+  if(!(ent = vlptabent(ptab, id)) || ent->off < 1){
+    VL_ATOMICINC(ptab->misses);
     return NULL;
   }
-  if(_qdbm_inflate && villa->cmode == VL_OZCOMP){
-    if(!(zbuf = _qdbm_inflate(buf ? buf : wbuf, size, &zsiz, _QDBM_ZMRAW))){
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-      free(buf);
-      return NULL;
-    }
-    free(buf);
-    buf = zbuf;
-    size = zsiz;
-  } else if(_qdbm_lzodecode && villa->cmode == VL_OYCOMP){
-    if(!(zbuf = _qdbm_lzodecode(buf ? buf : wbuf, size, &zsiz))){
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-      free(buf);
-      return NULL;
+  if(ent->size > VL_PAGEBUFSIZ){
+    CB_MALLOC(buf, ent->size);
+  } else {
+    buf = wbuf;
+  }
+  if(!(rp = dpgetat(villa->depot, ent->off, ent->size, (char *)&id, sizeof(int), buf, sp))){
+    if(buf != wbuf) free(buf);
+    VL_ATOMICINC(ptab->misses);
+    return NULL;
+  }
+  if(buf != wbuf) *bufp = buf;
+  VL_ATOMICINC(ptab->hits);
+  return rp;
+}
+
+
+/* Open the write ahead log of a database handle connected as a writer.
+   `villa' specifies a database handle.
+   `wal' specifies whether the log is kept open.
+   The return value is true if successful, else, it is false.
+   If the log of a writer not closed appropriately is left, it is replayed and a checkpoint is
+   performed.  Unless the log is kept open, it is removed then. */
+static int vlwalopen(VILLA *villa, int wal){
+  struct stat sbuf;
+  char path[VL_PATHBUFSIZ], *name;
+  int err, fd;
+  assert(villa);
+  name = dpname(villa->depot);
+  sprintf(path, "%s%s", name, VL_WALSUF);
+  free(name);
+  if(!wal && stat(path, &sbuf) == -1) return TRUE;
+  if((fd = open(path, O_RDWR | O_CREAT, 00644)) == -1 || fstat(fd, &sbuf) == -1){
+    if(fd != -1) close(fd);
+    dpecodeset(DP_EOPEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  villa->walfd = fd;
+  villa->walops = cbdatumopen(NULL, 0);
+  cbdatumsetsize(villa->walops, VL_WALHEAD);
+  villa->walfree = cbdatumopen(NULL, 0);
+  err = FALSE;
+  if(sbuf.st_size > 0 && (!vlwalrecover(villa) || !vlwalcheckpoint(villa))) err = TRUE;
+  if(wal && !err) return TRUE;
+  close(fd);
+  villa->walfd = -1;
+  if(!err && unlink(path) == -1){
+    dpecodeset(DP_EUNLINK, __FILE__, __LINE__);
+    err = TRUE;
+  }
+  return err ? FALSE : TRUE;
+}
+
+
+/* Log an operation updating a database.
+   `villa' specifies a database handle connected as a writer.
+   `op' specifies the kind of the operation.
+   `num' specifies the write mode or the insertion mode of the operation.
+   `vidx' specifies the index of the value where the cursor is.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of the value or `NULL'.
+   `vsiz' specifies the size of the region of the value.
+   The return value is true if successful, else, it is false.
+   Nothing is logged if the handle has no log or the log is being replayed.  Records out of the
+   transaction are written into the log when they are buffered enough, and records in the
+   transaction are written when it is committed.  If only the images of pages are logged, the
+   size of the updating is counted so that a checkpoint is performed as often. */
+static int vlwallog(VILLA *villa, int op, int num, int vidx,
+                    const char *kbuf, int ksiz, const char *vbuf, int vsiz){
+  char vnumbuf[VL_VNUMBUFSIZ];
+  int vnumsiz;
+  assert(villa && kbuf && ksiz >= 0);
+  if(villa->walfd == -1 || villa->replay) return TRUE;
+  if(!vbuf) vsiz = 0;
+  if(villa->dwrite){
+    villa->walsiz += ksiz + vsiz;
+    return TRUE;
+  }
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, op);
+  CB_DATUMCAT(villa->walops, vnumbuf, vnumsiz);
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, num);
+  CB_DATUMCAT(villa->walops, vnumbuf, vnumsiz);
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, vidx);
+  CB_DATUMCAT(villa->walops, vnumbuf, vnumsiz);
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, ksiz);
+  CB_DATUMCAT(villa->walops, vnumbuf, vnumsiz);
+  CB_DATUMCAT(villa->walops, kbuf, ksiz);
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, vsiz);
+  CB_DATUMCAT(villa->walops, vnumbuf, vnumsiz);
+  if(vsiz > 0) CB_DATUMCAT(villa->walops, vbuf, vsiz);
+  if(!villa->tran && CB_DATUMSIZE(villa->walops) >= VL_WALBUFSIZ) return vlwalflush(villa, FALSE);
+  return TRUE;
+}
+
+
+/* Write buffered operations into the write ahead log.
+   `villa' specifies a database handle connected as a writer with the log.
+   `sync' specifies whether the log is synchronized with the device.
+   The return value is true if successful, else, it is false.
+   The buffered operations are written as a frame which is replayed entirely or not at all. */
+static int vlwalflush(VILLA *villa, int sync){
+  int size;
+  assert(villa && villa->walfd != -1);
+  if((size = CB_DATUMSIZE(villa->walops)) > VL_WALHEAD){
+    vlwalseal(villa->walops->dptr, VL_WFOPS, size - VL_WALHEAD);
+    if(!vlwalwrite(villa->walfd, CB_DATUMPTR(villa->walops), size)){
+      dpecodeset(DP_EWRITE, __FILE__, __LINE__);
+      return FALSE;
     }
-    free(buf);
-    buf = zbuf;
-    size = zsiz;
-  } else if(_qdbm_bzdecode && villa->cmode == VL_OXCOMP){
-    if(!(zbuf = _qdbm_bzdecode(buf ? buf : wbuf, size, &zsiz))){
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-      free(buf);
-      return NULL;
+    villa->walsiz += size;
+    cbdatumsetsize(villa->walops, VL_WALHEAD);
+  }
+  if(sync && fsync(villa->walfd) == -1){
+    dpecodeset(DP_ESYNC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Write updated pages back with the write ahead log.
+   `villa' specifies a database handle connected as a writer with the log, out of the
+   transaction.
+   The return value is true if successful, else, it is false.
+   The images of the updated pages and the meta data are appended to the log and synchronized
+   before they are written into the database, so that an interrupted checkpoint is completed by
+   replaying the log.  The log is emptied afterwards.  The caches are locked only while the
+   images are taken and while the pages are marked clean, so threads reading cached pages are
+   not blocked by writing and synchronizing, and the updated pages stay in the caches meanwhile
+   as only the writer updates or sweeps out them. */
+static int vlwalcheckpoint(VILLA *villa){
+  CBDATUM *buf;
+  VLLEAF *leaf;
+  VLNODE *node;
+  const char *tmp;
+  char *ibuf;
+  int err, isiz, off, num;
+  assert(villa && villa->walfd != -1 && !villa->tran);
+  err = FALSE;
+  CB_DATUMOPEN(buf);
+  VL_CACHELOCK(villa);
+  cbmapiterinit(villa->leafc);
+  while(!err && (tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+    leaf = (VLLEAF *)cbmapget(villa->leafc, tmp, sizeof(int), NULL);
+    if(!leaf->dirty) continue;
+    if(!(ibuf = vlleafencode(villa, leaf, &isiz))){
+      err = TRUE;
+      break;
     }
-    free(buf);
-    buf = zbuf;
-    size = zsiz;
+    off = CB_DATUMSIZE(buf);
+    cbdatumsetsize(buf, off + VL_WALHEAD);
+    CB_DATUMCAT(buf, (char *)&(leaf->id), sizeof(int));
+    CB_DATUMCAT(buf, ibuf, isiz);
+    vlwalseal(buf->dptr + off, VL_WFPAGE, sizeof(int) + isiz);
+    free(ibuf);
   }
-  rp = buf ? buf : wbuf;
-  if(size >= 1){
-    VL_READVNUMBUF(rp, size, prev, step);
-    rp += step;
-    size -= step;
-    if(prev >= VL_NODEIDMIN - 1) prev = -1;
+  cbmapiterinit(villa->nodec);
+  while(!err && (tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+    node = (VLNODE *)cbmapget(villa->nodec, tmp, sizeof(int), NULL);
+    if(!node->dirty) continue;
+    ibuf = vlnodeencode(villa, node, &isiz);
+    off = CB_DATUMSIZE(buf);
+    cbdatumsetsize(buf, off + VL_WALHEAD);
+    CB_DATUMCAT(buf, (char *)&(node->id), sizeof(int));
+    CB_DATUMCAT(buf, ibuf, isiz);
+    vlwalseal(buf->dptr + off, VL_WFPAGE, sizeof(int) + isiz);
+    free(ibuf);
+  }
+  off = CB_DATUMSIZE(buf);
+  cbdatumsetsize(buf, off + VL_WALHEAD);
+  CB_DATUMCAT(buf, (char *)&(villa->root), sizeof(int));
+  CB_DATUMCAT(buf, (char *)&(villa->last), sizeof(int));
+  CB_DATUMCAT(buf, (char *)&(villa->lnum), sizeof(int));
+  CB_DATUMCAT(buf, (char *)&(villa->nnum), sizeof(int));
+  CB_DATUMCAT(buf, (char *)&(villa->rnum), sizeof(int));
+  num = CB_DATUMSIZE(villa->walfree) / sizeof(int);
+  CB_DATUMCAT(buf, (char *)&num, sizeof(int));
+  CB_DATUMCAT(buf, CB_DATUMPTR(villa->walfree), CB_DATUMSIZE(villa->walfree));
+  num = CB_DATUMSIZE(villa->leaffree) / sizeof(int);
+  CB_DATUMCAT(buf, (char *)&num, sizeof(int));
+  CB_DATUMCAT(buf, CB_DATUMPTR(villa->leaffree), CB_DATUMSIZE(villa->leaffree));
+  CB_DATUMCAT(buf, CB_DATUMPTR(villa->nodefree), CB_DATUMSIZE(villa->nodefree));
+  vlwalseal(buf->dptr + off, VL_WFCKPT, CB_DATUMSIZE(buf) - off - VL_WALHEAD);
+  VL_CACHEUNLOCK(villa);
+  if(!err){
+    if(!vlwalwrite(villa->walfd, CB_DATUMPTR(buf), CB_DATUMSIZE(buf))){
+      dpecodeset(DP_EWRITE, __FILE__, __LINE__);
+      err = TRUE;
+    } else if(fsync(villa->walfd) == -1){
+      dpecodeset(DP_ESYNC, __FILE__, __LINE__);
+      err = TRUE;
+    }
   }
-  if(size >= 1){
-    VL_READVNUMBUF(rp, size, next, step);
-    rp += step;
-    size -= step;
-    if(next >= VL_NODEIDMIN - 1) next = -1;
+  if(!err && !vlwalapply(villa->depot, villa, CB_DATUMPTR(buf), CB_DATUMSIZE(buf))) err = TRUE;
+  CB_DATUMCLOSE(buf);
+  if(!err){
+    VL_CACHELOCK(villa);
+    cbmapiterinit(villa->leafc);
+    while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+      leaf = (VLLEAF *)cbmapget(villa->leafc, tmp, sizeof(int), NULL);
+      VL_ATOMICSET(leaf->dirty, FALSE);
+    }
+    cbmapiterinit(villa->nodec);
+    while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+      node = (VLNODE *)cbmapget(villa->nodec, tmp, sizeof(int), NULL);
+      VL_ATOMICSET(node->dirty, FALSE);
+    }
+    VL_CACHEUNLOCK(villa);
+    cbdatumsetsize(villa->walfree, 0);
+    cbdatumsetsize(villa->walops, VL_WALHEAD);
+    if(ftruncate(villa->walfd, 0) == -1 || lseek(villa->walfd, 0, SEEK_SET) == -1){
+      dpecodeset(DP_ETRUNC, __FILE__, __LINE__);
+      err = TRUE;
+    } else if(fsync(villa->walfd) == -1){
+      dpecodeset(DP_ESYNC, __FILE__, __LINE__);
+      err = TRUE;
+    }
+    villa->walsiz = 0;
   }
-  lent.id = id;
-  lent.dirty = FALSE;
-  CB_LISTOPEN(lent.recs);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Write the frames of a checkpoint into the database.
+   `depot' specifies the handle of the database file connected as a writer.
+   `villa' specifies the database handle, or `NULL' if the database is not opened yet.
+   `ptr' specifies the pointer to the frames of the images of pages and the end of a checkpoint.
+   `size' specifies the size of the region of the frames.
+   The return value is true if successful, else, it is false.
+   Pages freed before the checkpoint are removed first, then the images are written and the
+   database is synchronized with the device.  Writing the same frames again is harmless. */
+static int vlwalapply(DEPOT *depot, VILLA *villa, const char *ptr, int size){
+  const char *rp, *meta;
+  int i, err, off, fsiz, msiz, num, knum, *ids;
+  assert(depot && ptr && size >= 0);
+  meta = NULL;
+  msiz = 0;
+  for(off = 0; off + VL_WALHEAD <= size; off += VL_WALHEAD + fsiz){
+    memcpy(&fsiz, ptr + off + 1, sizeof(int));
+    if(ptr[off] == VL_WFCKPT){
+      meta = ptr + off + VL_WALHEAD;
+      msiz = fsiz;
+    }
+  }
+  if(!meta || msiz < sizeof(int) * 7){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  memcpy(&num, meta + sizeof(int) * 5, sizeof(int));
+  if(num < 0 || msiz < sizeof(int) * (7 + num)){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  err = FALSE;
+  if(villa) VL_DEPOTLOCK(villa, TRUE);
+  if(!dpaiobegin(depot)) err = TRUE;
+  CB_MALLOC(ids, num * sizeof(int) + 1);
+  memcpy(ids, meta + sizeof(int) * 6, num * sizeof(int));
+  for(i = 0; i < num; i++){
+    if((villa && !vlsnapkeep(villa, ids[i])) ||
+       (!dpout(depot, (char *)(ids + i), sizeof(int)) && dpecode != DP_ENOITEM))
+      err = TRUE;
+    if(villa && villa->ptab) vlptabset(villa, ids[i], 0, 0, FALSE);
+  }
+  free(ids);
+  for(off = 0; off + VL_WALHEAD <= size; off += VL_WALHEAD + fsiz){
+    memcpy(&fsiz, ptr + off + 1, sizeof(int));
+    if(ptr[off] != VL_WFPAGE) continue;
+    rp = ptr + off + VL_WALHEAD;
+    memcpy(&knum, rp, sizeof(int));
+    if((villa && !vlsnapkeep(villa, knum)) ||
+       !dpput(depot, rp, sizeof(int), rp + sizeof(int), fsiz - sizeof(int), DP_DOVER)){
+      err = TRUE;
+      break;
+    }
+    if(villa && villa->ptab) vlptabupdate(villa, knum, TRUE);
+    if(villa) VL_ATOMICINC(villa->saves);
+  }
+  rp = meta + sizeof(int) * (6 + num);
+  if(!dpsetalign(depot, 0)) err = TRUE;
+  for(i = 0; i < 5; i++){
+    memcpy(&num, meta + sizeof(int) * i, sizeof(int));
+    if(!vldpputnum(depot, VL_ROOTKEY - i, num)) err = TRUE;
+  }
+  knum = VL_FREEKEY;
+  if(!dpput(depot, (char *)&knum, sizeof(int), rp, msiz - (rp - meta), DP_DOVER)) err = TRUE;
+  if(!dpsetalign(depot, VL_PAGEALIGN)) err = TRUE;
+  if(!dpaioend(depot)) err = TRUE;
+  if(!dpsync(depot)) err = TRUE;
+  if(villa) VL_DEPOTUNLOCK(villa);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Recover the state of a database from the write ahead log.
+   `villa' specifies a database handle connected as a writer with the log.
+   The return value is true if successful, else, it is false.
+   If the log has a complete checkpoint, it is written into the database first.  The cached
+   pages and the meta data are then reloaded from the database and the operations logged after
+   the checkpoint are replayed on them.  A frame torn by a crash ends the log and is cut off. */
+static int vlwalrecover(VILLA *villa){
+  char *buf;
+  int err, size, off, fsiz, ckbeg, ckend;
+  assert(villa && villa->walfd != -1);
+  if(!(buf = vlwalread(villa->walfd, &size))) return FALSE;
+  size = vlwalscan(buf, size, &ckbeg, &ckend);
+  err = FALSE;
+  if(ckbeg >= 0){
+    vlcachedrop(villa);
+    if(!vlwalapply(villa->depot, villa, buf + ckbeg, ckend - ckbeg)) err = TRUE;
+  }
+  if(!err){
+    if(!vldpgetnum(villa->depot, VL_ROOTKEY, &(villa->root)) ||
+       !vldpgetnum(villa->depot, VL_LASTKEY, &(villa->last)) ||
+       !vldpgetnum(villa->depot, VL_LNUMKEY, &(villa->lnum)) ||
+       !vldpgetnum(villa->depot, VL_NNUMKEY, &(villa->nnum)) ||
+       !vldpgetnum(villa->depot, VL_RNUMKEY, &(villa->rnum))){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      err = TRUE;
+    }
+    cbdatumsetsize(villa->leaffree, 0);
+    cbdatumsetsize(villa->nodefree, 0);
+    vldpgetfree(villa);
+  }
+  cbdatumsetsize(villa->walfree, 0);
+  cbdatumsetsize(villa->walops, VL_WALHEAD);
+  villa->hnum = 0;
+  villa->hleaf = -1;
+  villa->lleaf = -1;
+  villa->replay = TRUE;
+  for(off = ckend; !err && off < size; off += VL_WALHEAD + fsiz){
+    memcpy(&fsiz, buf + off + 1, sizeof(int));
+    if(buf[off] == VL_WFOPS && !vlwalreplay(villa, buf + off + VL_WALHEAD, fsiz)){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      err = TRUE;
+    }
+  }
+  villa->replay = FALSE;
+  villa->curleaf = -1;
+  villa->curknum = -1;
+  villa->curvnum = -1;
+  free(buf);
+  if(err){
+    vlcachedrop(villa);
+    return FALSE;
+  }
+  if(ftruncate(villa->walfd, size) == -1 || lseek(villa->walfd, size, SEEK_SET) == -1){
+    dpecodeset(DP_ETRUNC, __FILE__, __LINE__);
+    return FALSE;
+  }
+  villa->walsiz = size;
+  return TRUE;
+}
+
+
+/* Write again a checkpoint left in the write ahead log of a database.
+   `name' specifies the name of a database file.
+   `depot' specifies the handle of the database file connected as a writer, or `NULL' if the
+   checkpoint is only detected.
+   The return value is 1 if the log has a checkpoint, 0 if it does not, or -1 on failure.
+   As a completed checkpoint empties the log and nothing is logged after a checkpoint until it
+   is completed, a checkpoint left in the log is at its end and means that the writer was
+   interrupted while writing the pages back.  The meta data of the database may be torn then,
+   so the checkpoint is written again before the database is read, and the log is emptied. */
+static int vlwalredo(const char *name, DEPOT *depot){
+  char path[VL_PATHBUFSIZ], *buf;
+  int fd, err, size, ckbeg, ckend;
+  assert(name);
+  sprintf(path, "%s%s", name, VL_WALSUF);
+  if((fd = open(path, depot ? O_RDWR : O_RDONLY, 00644)) == -1) return 0;
+  if(!(buf = vlwalread(fd, &size))){
+    close(fd);
+    return -1;
+  }
+  vlwalscan(buf, size, &ckbeg, &ckend);
+  err = FALSE;
+  if(depot && ckbeg >= 0){
+    if(!vlwalapply(depot, NULL, buf + ckbeg, ckend - ckbeg)){
+      err = TRUE;
+    } else if(ftruncate(fd, 0) == -1 || fsync(fd) == -1){
+      dpecodeset(DP_ETRUNC, __FILE__, __LINE__);
+      err = TRUE;
+    }
+  }
+  free(buf);
+  if(close(fd) == -1 && !err){
+    dpecodeset(DP_ECLOSE, __FILE__, __LINE__);
+    err = TRUE;
+  }
+  if(err) return -1;
+  return ckbeg >= 0 ? 1 : 0;
+}
+
+
+/* Read the whole of the write ahead log.
+   `fd' specifies the file descriptor of the log.
+   `sp' specifies the pointer to a variable to which the size of the region of the return value
+   is assigned.
+   If successful, the return value is the pointer to the region of the log, else, it is `NULL'.
+   Because the region of the return value is allocated with the `malloc' call, it should be
+   released with the `free' call if it is no longer in use. */
+static char *vlwalread(int fd, int *sp){
+  struct stat sbuf;
+  char *buf;
+  int size, off, rsiz;
+  assert(fd >= 0 && sp);
+  if(fstat(fd, &sbuf) == -1){
+    dpecodeset(DP_ESTAT, __FILE__, __LINE__);
+    return NULL;
+  }
+  size = sbuf.st_size;
+  if(lseek(fd, 0, SEEK_SET) == -1){
+    dpecodeset(DP_ESEEK, __FILE__, __LINE__);
+    return NULL;
+  }
+  CB_MALLOC(buf, size + 1);
+  for(off = 0; off < size; off += rsiz){
+    if((rsiz = read(fd, buf + off, size - off)) < 1){
+      if(rsiz == -1 && errno == EINTR){
+        rsiz = 0;
+        continue;
+      }
+      free(buf);
+      dpecodeset(DP_EREAD, __FILE__, __LINE__);
+      return NULL;
+    }
+  }
+  *sp = size;
+  return buf;
+}
+
+
+/* Find the frames of the write ahead log to be recovered.
+   `buf' specifies the pointer to the region of the log.
+   `size' specifies the size of the region.
+   `ckbp' specifies the pointer to a variable to which the offset of the last complete checkpoint
+   is assigned, or -1 if the log has no checkpoint.
+   `ckep' specifies the pointer to a variable to which the offset of the end of the last complete
+   checkpoint is assigned, or 0 if the log has no checkpoint.
+   The return value is the size of the valid frames.  A frame torn by a crash ends the log. */
+static int vlwalscan(const char *buf, int size, int *ckbp, int *ckep){
+  unsigned int sum;
+  int off, fsiz, type, ptype, run;
+  assert(buf && size >= 0 && ckbp && ckep);
+  ptype = 0;
+  run = 0;
+  *ckbp = -1;
+  *ckep = 0;
+  for(off = 0; off + VL_WALHEAD <= size; off += VL_WALHEAD + fsiz){
+    type = buf[off];
+    memcpy(&fsiz, buf + off + 1, sizeof(int));
+    memcpy(&sum, buf + off + 1 + sizeof(int), sizeof(int));
+    if((type != VL_WFOPS && type != VL_WFPAGE && type != VL_WFCKPT) ||
+       fsiz < 0 || fsiz > size - off - VL_WALHEAD ||
+       vlwalsum(buf + off + VL_WALHEAD, fsiz) != sum) break;
+    if(type == VL_WFPAGE && ptype != VL_WFPAGE) run = off;
+    if(type == VL_WFCKPT){
+      *ckbp = ptype == VL_WFPAGE ? run : off;
+      *ckep = off + VL_WALHEAD + fsiz;
+    }
+    ptype = type;
+  }
+  return off;
+}
+
+
+/* Replay operations in a frame of the write ahead log.
+   `villa' specifies a database handle connected as a writer.
+   `ptr' specifies the pointer to the records of the operations.
+   `size' specifies the size of the region of the records.
+   The return value is true if successful, else, it is false.
+   Because only operations which succeeded are logged, any failure means the log does not match
+   the database. */
+static int vlwalreplay(VILLA *villa, const char *ptr, int size){
+  const char *kbuf, *vbuf;
+  int i, step, op, num, vidx, ksiz, vsiz, nums[4];
+  assert(villa && ptr && size >= 0);
+  while(size > 0){
+    for(i = 0; i < 4; i++){
+      if(size < 1) return FALSE;
+      VL_READVNUMBUF(ptr, size, nums[i], step);
+      ptr += step;
+      size -= step;
+    }
+    op = nums[0];
+    num = nums[1];
+    vidx = nums[2];
+    ksiz = nums[3];
+    if(ksiz < 0 || ksiz >= size) return FALSE;
+    kbuf = ptr;
+    ptr += ksiz;
+    size -= ksiz;
+    VL_READVNUMBUF(ptr, size, vsiz, step);
+    ptr += step;
+    size -= step;
+    if(vsiz < 0 || vsiz > size) return FALSE;
+    vbuf = ptr;
+    ptr += vsiz;
+    size -= vsiz;
+    switch(op){
+    case VL_WOPUT:
+      if(!vlput(villa, kbuf, ksiz, vbuf, vsiz, num)) return FALSE;
+      break;
+    case VL_WOOUT:
+      if(!vlout(villa, kbuf, ksiz)) return FALSE;
+      break;
+    case VL_WOCURPUT:
+      if(!vlwalseek(villa, kbuf, ksiz, vidx) || !vlcurput(villa, vbuf, vsiz, num)) return FALSE;
+      break;
+    case VL_WOCUROUT:
+      if(!vlwalseek(villa, kbuf, ksiz, vidx) || !vlcurout(villa)) return FALSE;
+      break;
+    case VL_WORANGE:
+      if(vlrangeout(villa, (num & 1) ? kbuf : NULL, ksiz, (num & 2) ? vbuf : NULL, vsiz) == -1)
+        return FALSE;
+      break;
+    default:
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/* Move the cursor to a value of a key for replaying the write ahead log.
+   `villa' specifies a database handle.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   `vidx' specifies the index of the value among the values of the key.
+   The return value is true if the value exists, else, it is false. */
+static int vlwalseek(VILLA *villa, const char *kbuf, int ksiz, int vidx){
+  const char *rp;
+  int i, rsiz;
+  assert(villa && kbuf && ksiz >= 0 && vidx >= 0);
+  if(!vlcurjump(villa, kbuf, ksiz, VL_JFORWARD) || !(rp = vlcurkeycache(villa, &rsiz)) ||
+     villa->cmp(rp, rsiz, kbuf, ksiz) != 0) return FALSE;
+  for(i = 0; i < vidx; i++){
+    if(!vlcurnext(villa)) return FALSE;
+  }
+  return villa->curvnum == vidx;
+}
+
+
+/* Set the header of a frame of the write ahead log.
+   `ptr' specifies the pointer to the region of the frame.
+   `type' specifies the type of the frame.
+   `size' specifies the size of the body following the header. */
+static void vlwalseal(char *ptr, int type, int size){
+  unsigned int sum;
+  assert(ptr && size >= 0);
+  sum = vlwalsum(ptr + VL_WALHEAD, size);
+  ptr[0] = type;
+  memcpy(ptr + 1, &size, sizeof(int));
+  memcpy(ptr + 1 + sizeof(int), &sum, sizeof(int));
+}
+
+
+/* Get the checksum of the body of a frame of the write ahead log.
+   `ptr' specifies the pointer to the region.
+   `size' specifies the size of the region.
+   The return value is the CRC-32 of the region if QDBM was built with ZLIB enabled, else, it
+   is the FNV-1a hash value of the region. */
+static unsigned int vlwalsum(const char *ptr, int size){
+  unsigned int sum;
+  int i;
+  assert(ptr && size >= 0);
+  if(_qdbm_getcrc) return _qdbm_getcrc(ptr, size);
+  sum = 2166136261U;
+  for(i = 0; i < size; i++){
+    sum = (sum ^ ((unsigned char *)ptr)[i]) * 16777619U;
+  }
+  return sum;
+}
+
+
+/* Write the whole of a region into a file.
+   `fd' specifies a file descriptor.
+   `buf' specifies the pointer to the region.
+   `size' specifies the size of the region.
+   The return value is true if successful, else, it is false. */
+static int vlwalwrite(int fd, const char *buf, int size){
+  int wsiz;
+  assert(fd >= 0 && buf && size >= 0);
+  while(size > 0){
+    if((wsiz = write(fd, buf, size)) == -1){
+      if(errno == EINTR) continue;
+      return FALSE;
+    }
+    buf += wsiz;
+    size -= wsiz;
+  }
+  return TRUE;
+}
+
+
+/* Discard every page in the caches without writing it.
+   `villa' specifies a database handle. */
+static void vlcachedrop(VILLA *villa){
+  VLLEAF *leaf;
+  VLNODE *node;
+  const char *tmp;
+  int pid;
+  assert(villa);
+  cbmapiterinit(villa->leafc);
+  while((tmp = cbmapiternext(villa->leafc, NULL)) != NULL){
+    pid = *(int *)tmp;
+    leaf = (VLLEAF *)cbmapget(villa->leafc, tmp, sizeof(int), NULL);
+    VL_ATOMICSET(leaf->dirty, FALSE);
+    vlleafcacheout(villa, pid);
+  }
+  cbmapiterinit(villa->nodec);
+  while((tmp = cbmapiternext(villa->nodec, NULL)) != NULL){
+    pid = *(int *)tmp;
+    node = (VLNODE *)cbmapget(villa->nodec, tmp, sizeof(int), NULL);
+    VL_ATOMICSET(node->dirty, FALSE);
+    vlnodecacheout(villa, pid);
+  }
+}
+
+
+/* Get the size of the common prefix of two keys.
+   `abuf' specifies the pointer to the region of one key.
+   `asiz' specifies the size of the region of one key.
+   `bbuf' specifies the pointer to the region of the other key.
+   `bsiz' specifies the size of the region of the other key.
+   The return value is the number of the leading bytes shared by the two keys. */
+static int vlkeyshared(const char *abuf, int asiz, const char *bbuf, int bsiz){
+  int i, min;
+  assert(abuf && asiz >= 0 && bbuf && bsiz >= 0);
+  min = asiz < bsiz ? asiz : bsiz;
+  for(i = 0; i < min && abuf[i] == bbuf[i]; i++);
+  return i;
+}
+
+
+/* Get the size of the shortest separator between two adjacent keys.
+   `villa' specifies a database handle.
+   `lkey' specifies the last key of the former page.
+   `rbuf' specifies the pointer to the region of the first key of the latter page.
+   `rsiz' specifies the size of the region of the key.
+   The return value is the size of the shortest prefix of the latter key which is greater than
+   the former key.  Unless keys are compared in lexical order, it is the size of the whole key. */
+static int vlsepsize(VILLA *villa, const CBDATUM *lkey, const char *rbuf, int rsiz){
+  int size;
+  assert(villa && lkey && rbuf && rsiz >= 0);
+  if(villa->cmp != vllexcompare) return rsiz;
+  size = vlkeyshared(CB_DATUMPTR(lkey), CB_DATUMSIZE(lkey), rbuf, rsiz) + 1;
+  return size < rsiz ? size : rsiz;
+}
+
+
+/* Get the ID number for a new page.
+   `villa' specifies a database handle.
+   `node' specifies whether the page is a node.
+   The return value is the ID number of a freed page if any, else the next unused one.  Freed
+   pages are not reused in the transaction so that aborting it restores the counters. */
+static int vlpagenewid(VILLA *villa, int node){
+  CBDATUM *ids;
+  int size, id;
+  assert(villa);
+  ids = node ? villa->nodefree : villa->leaffree;
+  if(!villa->tran && (size = CB_DATUMSIZE(ids)) >= sizeof(int)){
+    size -= sizeof(int);
+    memcpy(&id, CB_DATUMPTR(ids) + size, sizeof(int));
+    cbdatumsetsize(ids, size);
+    return id;
+  }
+  if(node) return VL_NODEIDMIN + villa->nnum++;
+  return VL_LEAFIDMIN + villa->lnum++;
+}
+
+
+/* Free a page removed from the tree.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the page.
+   The return value is true if successful, else, it is false.
+   The page is discarded from the cache and the database, and its ID number is reused later.
+   The record is kept for snapshots older than the removal.  With the write ahead log, the record
+   is removed by the next checkpoint. */
+static int vlpagefree(VILLA *villa, int id){
+  VLLEAF *leaf;
+  VLNODE *node;
+  int err;
+  assert(villa && id >= VL_LEAFIDMIN);
+  err = FALSE;
+  if(id >= VL_NODEIDMIN){
+    if((node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL)) != NULL){
+      VL_ATOMICSET(node->dirty, FALSE);
+      if(!vlnodecacheout(villa, id)) err = TRUE;
+    }
+    cbmapout(villa->nodeghost, (char *)&id, sizeof(int));
+    CB_DATUMCAT(villa->nodefree, (char *)&id, sizeof(int));
+  } else {
+    if((leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL)) != NULL){
+      VL_ATOMICSET(leaf->dirty, FALSE);
+      if(!vlleafcacheout(villa, id)) err = TRUE;
+    }
+    cbmapout(villa->leafghost, (char *)&id, sizeof(int));
+    CB_DATUMCAT(villa->leaffree, (char *)&id, sizeof(int));
+  }
+  if(villa->walfd != -1){
+    CB_DATUMCAT(villa->walfree, (char *)&id, sizeof(int));
+    return err ? FALSE : TRUE;
+  }
+  VL_DEPOTLOCK(villa, TRUE);
+  if(!vlsnapkeep(villa, id) ||
+     (!dpout(villa->depot, (char *)&id, sizeof(int)) && dpecode != DP_ENOITEM)) err = TRUE;
+  if(villa->ptab) vlptabset(villa, id, 0, 0, FALSE);
+  VL_DEPOTUNLOCK(villa);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Create a new leaf.
+   `villa' specifies a database handle.
+   `prev' specifies the ID number of the previous leaf.
+   `next' specifies the ID number of the previous leaf.
+   The return value is a handle of the leaf. */
+static VLLEAF *vlleafnew(VILLA *villa, int prev, int next){
+  VLLEAF *leaf, lent;
+  assert(villa);
+  lent.id = vlpagenewid(villa, FALSE);
+  lent.dirty = TRUE;
+  CB_LISTOPEN(lent.recs);
   lent.prev = prev;
   lent.next = next;
+  lent.arena = NULL;
+  lent.waste = 0;
+  lent.rests = 0;
+  lent.heat = VL_HCOLD;
+  lent.refs = 0;
+  lent.latch = vllatchopen(villa);
+  VL_CACHELOCK(villa);
+  cbmapput(villa->leafc, (char *)&(lent.id), sizeof(int), (char *)&lent, sizeof(VLLEAF), TRUE);
+  leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&(lent.id), sizeof(int), NULL);
+  VL_CACHEUNLOCK(villa);
+  return leaf;
+}
+
+
+/* Remove a leaf from the cache.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the leaf.
+   The return value is true if successful, else, it is false. */
+static int vlleafcacheout(VILLA *villa, int id){
+  VLLEAF *leaf;
+  int err;
+  assert(villa && id >= VL_LEAFIDMIN);
+  if(!(leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL))) return FALSE;
+  err = FALSE;
+  if(leaf->dirty && !vlleafsave(villa, leaf)) err = TRUE;
+  vlleafclose(villa, leaf);
+  if(leaf->heat == VL_HHOT) villa->leafchot--;
+  cbmapout(villa->leafc, (char *)&id, sizeof(int));
+  return err ? FALSE : TRUE;
+}
+
+
+/* Release the records, the arena, and the latch of a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle, which is not removed from the cache. */
+static void vlleafclose(VILLA *villa, VLLEAF *leaf){
+  VLREC *recp;
+  CBLIST *recs;
+  int i, ln;
+  assert(villa && leaf);
+  recs = leaf->recs;
+  if(leaf->rests > 0){
+    ln = CB_LISTNUM(recs);
+    for(i = 0; i < ln; i++){
+      recp = (VLREC *)CB_LISTVAL(recs, i);
+      if(recp->rest) CB_LISTCLOSE(recp->rest);
+    }
+  }
+  VL_LISTCLOSEBUF(recs);
+  vlarenaclose(villa, leaf->arena, &(villa->leafcsiz));
+  vllatchclose(leaf->latch);
+}
+
+
+/* Save a leaf into the database.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   The return value is true if successful, else, it is false. */
+static int vlleafsave(VILLA *villa, VLLEAF *leaf){
+  char *ibuf;
+  int isiz;
+  assert(villa && leaf);
+  if(!(ibuf = vlleafencode(villa, leaf, &isiz))) return FALSE;
+  VL_DEPOTLOCK(villa, TRUE);
+  if(!vlsnapkeep(villa, leaf->id) ||
+     !dpput(villa->depot, (char *)&(leaf->id), sizeof(int), ibuf, isiz, DP_DOVER)){
+    VL_DEPOTUNLOCK(villa);
+    free(ibuf);
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(villa->ptab) vlptabupdate(villa, leaf->id, TRUE);
+  VL_ATOMICINC(villa->saves);
+  VL_DEPOTUNLOCK(villa);
+  free(ibuf);
+  VL_ATOMICSET(leaf->dirty, FALSE);
+  return TRUE;
+}
+
+
+/* Serialize a leaf into the image of its record.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   `sp' specifies the pointer to a variable to which the size of the image is assigned.
+   If successful, the return value is the pointer to the region of the image, else, it is
+   `NULL'.  Because the region of the return value is allocated with the `malloc' call, it
+   should be released with the `free' call if it is no longer in use. */
+static char *vlleafencode(VILLA *villa, VLLEAF *leaf, int *sp){
+  VLREC *recp;
+  CBLIST *recs;
+  CBDATUM *buf, *key;
+  char vnumbuf[VL_VNUMBUFSIZ], *zbuf;
+  const char *vbuf;
+  int i, j, ksiz, psiz, vnum, vsiz, prev, next, vnumsiz, ln, zsiz, hsiz, codec;
+  assert(villa && leaf && sp);
+  CB_DATUMOPEN(buf);
+  hsiz = 0;
+  if(villa->pcodec){
+    CB_DATUMCAT(buf, "", 1);
+    hsiz = 1;
+  }
+  prev = leaf->prev;
+  if(prev == -1) prev = VL_NODEIDMIN - 1;
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, prev);
+  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+  next = leaf->next;
+  if(next == -1) next = VL_NODEIDMIN - 1;
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, next);
+  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+  recs = leaf->recs;
+  ln = CB_LISTNUM(recs);
+  for(i = 0; i < ln; i++){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    ksiz = CB_DATUMSIZE(recp->key);
+    psiz = 0;
+    if(villa->fcode){
+      if(i % VL_KEYRESTART != 0){
+        key = ((VLREC *)CB_LISTVAL(recs, i - 1))->key;
+        psiz = vlkeyshared(CB_DATUMPTR(key), CB_DATUMSIZE(key), CB_DATUMPTR(recp->key), ksiz);
+      }
+      VL_SETVNUMBUF(vnumsiz, vnumbuf, psiz);
+      CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    }
+    VL_SETVNUMBUF(vnumsiz, vnumbuf, ksiz - psiz);
+    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    CB_DATUMCAT(buf, CB_DATUMPTR(recp->key) + psiz, ksiz - psiz);
+    vnum = 1 + (recp->rest ? CB_LISTNUM(recp->rest) : 0);
+    VL_SETVNUMBUF(vnumsiz, vnumbuf, vnum);
+    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    vsiz = CB_DATUMSIZE(recp->first);
+    VL_SETVNUMBUF(vnumsiz, vnumbuf, vsiz);
+    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    CB_DATUMCAT(buf, CB_DATUMPTR(recp->first), vsiz);
+    if(recp->rest){
+      for(j = 0; j < CB_LISTNUM(recp->rest); j++){
+        vbuf = CB_LISTVAL2(recp->rest, j, vsiz);
+        VL_SETVNUMBUF(vnumsiz, vnumbuf, vsiz);
+        CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+        CB_DATUMCAT(buf, vbuf, vsiz);
+      }
+    }
+  }
+  codec = villa->codec;
+  if(codec == VL_CDDICT && !villa->dict){
+    if(villa->wmode && !vldictfeed(villa, CB_DATUMPTR(buf) + hsiz, CB_DATUMSIZE(buf) - hsiz)){
+      CB_DATUMCLOSE(buf);
+      return NULL;
+    }
+    if(!villa->dict) codec = VL_CDLZF;
+  }
+  zbuf = NULL;
+  zsiz = 0;
+  if(codec != VL_CDNONE){
+    if(!(zbuf = vlcodecs[codec].encode(CB_DATUMPTR(buf) + hsiz, CB_DATUMSIZE(buf) - hsiz,
+                                       &zsiz, villa->dict))){
+      CB_DATUMCLOSE(buf);
+      dpecodeset(DP_EMISC, __FILE__, __LINE__);
+      return NULL;
+    }
+    if(villa->pcodec){
+      if(zsiz + hsiz < CB_DATUMSIZE(buf)){
+        CB_REALLOC(zbuf, zsiz + hsiz + 1);
+        memmove(zbuf + hsiz, zbuf, zsiz + 1);
+        zbuf[0] = codec;
+        zsiz += hsiz;
+      } else {
+        free(zbuf);
+        zbuf = NULL;
+      }
+    }
+  }
+  if(zbuf){
+    CB_DATUMCLOSE(buf);
+    *sp = zsiz;
+    return zbuf;
+  }
+  *sp = CB_DATUMSIZE(buf);
+  return cbdatumtomalloc(buf, NULL);
+}
+
+
+/* Load a leaf from the database.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the leaf.
+   `seq' specifies whether the leaf is read by a cursor.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'. */
+static VLLEAF *vlleafload(VILLA *villa, int id, int seq){
+  assert(villa && id >= VL_LEAFIDMIN);
+  return vlleafcachein(villa, id, seq, FALSE);
+}
+
+
+/* Load a leaf into the cache.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the leaf.
+   `seq' specifies whether the leaf is read by a cursor.
+   `hold' specifies whether the leaf is held so that other threads sharing the handle do not
+   sweep it out of the cache until it is released with `VL_PAGERELEASE'.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'.
+   The decoded page is copied into the arena of the leaf and the keys and the first values of
+   the records refer to regions of it.  The page is read, decoded, and parsed without locking the
+   caches, so a leaf loaded by another thread meanwhile is preferred to the copy.  If the handle is
+   shared with the writer, the page is read again when any page has been written back meanwhile,
+   as the copy may be older than the written one.  A snapshot reads the copy of the page kept for
+   it if any.  A page located by the table of locations is read with one call, and a writer not
+   shared by threads records the location of a page found otherwise. */
+static VLLEAF *vlleafcachein(VILLA *villa, int id, int seq, int hold){
+  char wbuf[VL_PAGEBUFSIZ], *buf;
+  const char *pbuf;
+  int size, saves, dksiz, ptab;
+  int dkey[2];
+  const CBDATUM *dict;
+  VLLEAF *leaf;
+  assert(villa && id >= VL_LEAFIDMIN);
+  VL_CACHELOCK(villa);
+  if((leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL)) != NULL){
+    vlcachehit(villa, FALSE, id, &(leaf->heat), seq);
+    if(hold) VL_PAGEHOLD(villa, leaf);
+    VL_CACHEUNLOCK(villa);
+    return leaf;
+  }
+  VL_CACHEUNLOCK(villa);
+  saves = VL_ATOMICGET(villa->saves);
+  vldepotlatch(villa);
+  dksiz = vlsnapkey(villa, id, dkey);
+  ptab = villa->ptab && dksiz == sizeof(int);
+  if(villa->depot->mapall &&
+     (pbuf = dpgetmap(villa->depot, (char *)dkey, dksiz, &size)) != NULL){
+    buf = NULL;
+    if(villa->dlatch){
+      CB_MEMDUP(buf, pbuf, size);
+      pbuf = buf;
+    }
+    ptab = FALSE;
+  } else if(ptab && (pbuf = vlptabread(villa, id, wbuf, &buf, &size)) != NULL){
+    ptab = FALSE;
+  } else if((size = dpgetwb(villa->depot, (char *)dkey, dksiz, 0,
+                            VL_PAGEBUFSIZ, wbuf)) > 0 && size < VL_PAGEBUFSIZ){
+    buf = NULL;
+    pbuf = wbuf;
+  } else if(!(buf = dpget(villa->depot, (char *)dkey, dksiz, 0, -1, &size))){
+    VL_DEPOTUNLOCK(villa);
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return NULL;
+  } else {
+    pbuf = buf;
+  }
+  if(ptab && villa->wmode && !villa->dlatch) vlptabupdate(villa, id, FALSE);
+  dict = villa->dict;
+  VL_DEPOTUNLOCK(villa);
+  return vlleafcacheimage(villa, id, seq, hold, buf, pbuf, size, dict, saves);
+}
+
+
+/* Load the image of a leaf read from the database into the cache.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the leaf.
+   `seq' specifies whether the leaf is read by a cursor.
+   `hold' specifies whether the leaf is held.
+   `buf' specifies the region allocated for the image, which is released, or `NULL'.
+   `pbuf' specifies the pointer to the image as stored in the database.
+   `size' specifies the size of the image.
+   `dict' specifies the dictionary of the codec when the image was read.
+   `saves' specifies the count of pages written back before the image was read.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'.
+   The leaf is built in its own arena without locking the caches, which are locked only to add
+   it.  If another thread has added the leaf meanwhile, the copy is discarded. */
+static VLLEAF *vlleafcacheimage(VILLA *villa, int id, int seq, int hold, char *buf,
+                                const char *pbuf, int size, const CBDATUM *dict, int saves){
+  char *rp, *kbuf, *vbuf, *zbuf, *pkbuf, *tbuf;
+  int i, step, ksiz, psiz, pksiz, vnum, vsiz, prev, next, zsiz, codec;
+  VLLEAF *leaf, lent;
+  VLREC *recp;
+  assert(villa && id >= VL_LEAFIDMIN && pbuf && size >= 0);
+  ksiz = -1;
+  prev = -1;
+  next = -1;
+  codec = villa->codec;
+  if(villa->pcodec){
+    if(size < 1){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      free(buf);
+      return NULL;
+    }
+    codec = *(unsigned char *)pbuf;
+    pbuf++;
+    size--;
+  }
+  if(codec != VL_CDNONE){
+    if(codec >= VL_CDNUM || !(zbuf = vlcodecs[codec].decode(pbuf, size, &zsiz, dict))){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      free(buf);
+      return NULL;
+    }
+    free(buf);
+    buf = zbuf;
+    pbuf = buf;
+    size = zsiz;
+  }
+  lent.arena = NULL;
+  rp = vlarenaalloc(villa, &(lent.arena), size + 1, &(villa->leafcsiz));
+  memcpy(rp, pbuf, size);
+  rp[size] = '\0';
+  free(buf);
+  if(size >= 1){
+    VL_READVNUMBUF(rp, size, prev, step);
+    rp += step;
+    size -= step;
+    if(prev >= VL_NODEIDMIN - 1) prev = -1;
+  }
+  if(size >= 1){
+    VL_READVNUMBUF(rp, size, next, step);
+    rp += step;
+    size -= step;
+    if(next >= VL_NODEIDMIN - 1) next = -1;
+  }
+  lent.id = id;
+  lent.dirty = FALSE;
+  CB_LISTOPEN(lent.recs);
+  lent.prev = prev;
+  lent.next = next;
+  lent.waste = 0;
+  lent.rests = 0;
+  lent.heat = VL_HCOLD;
+  lent.refs = 0;
+  lent.latch = vllatchopen(villa);
+  recp = NULL;
+  pkbuf = NULL;
+  pksiz = 0;
+  while(size >= 1){
+    psiz = 0;
+    if(villa->fcode){
+      VL_READVNUMBUF(rp, size, psiz, step);
+      *rp = '\0';
+      rp += step;
+      size -= step;
+      if(size < 1 || psiz > pksiz) break;
+    }
+    VL_READVNUMBUF(rp, size, ksiz, step);
+    *rp = '\0';
+    rp += step;
+    size -= step;
+    if(size < ksiz) break;
+    kbuf = rp;
+    rp += ksiz;
+    size -= ksiz;
+    if(psiz > 0){
+      tbuf = vlarenaalloc(villa, &(lent.arena), psiz + ksiz + 1, &(villa->leafcsiz));
+      memcpy(tbuf, pkbuf, psiz);
+      memcpy(tbuf + psiz, kbuf, ksiz);
+      tbuf[psiz+ksiz] = '\0';
+      kbuf = tbuf;
+      ksiz += psiz;
+    }
+    pkbuf = kbuf;
+    pksiz = ksiz;
+    VL_READVNUMBUF(rp, size, vnum, step);
+    *rp = '\0';
+    rp += step;
+    size -= step;
+    if(vnum < 1 || size < 1) break;
+    for(i = 0; i < vnum && size >= 1; i++){
+      VL_READVNUMBUF(rp, size, vsiz, step);
+      *rp = '\0';
+      rp += step;
+      size -= step;
+      if(size < vsiz) break;
+      vbuf = rp;
+      rp += vsiz;
+      size -= vsiz;
+      if(i < 1){
+        recp = vlrecnew(villa, &lent, kbuf, ksiz, vbuf, vsiz, FALSE);
+      } else {
+        if(!recp->rest){
+          CB_LISTOPEN(recp->rest);
+          lent.rests++;
+        }
+        CB_LISTPUSH(recp->rest, vbuf, vsiz);
+      }
+    }
+    if(i > 0) CB_LISTPUSHBUF(lent.recs, (char *)recp, sizeof(VLREC));
+  }
+  VL_CACHELOCK(villa);
+  if(villa->mutex && (leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL))){
+    if(hold) VL_PAGEHOLD(villa, leaf);
+    VL_CACHEUNLOCK(villa);
+    vlleafclose(villa, &lent);
+    return leaf;
+  }
+  if(villa->dlatch && VL_ATOMICGET(villa->saves) != saves){
+    VL_CACHEUNLOCK(villa);
+    vlleafclose(villa, &lent);
+    return vlleafcachein(villa, id, seq, hold);
+  }
+  lent.heat = vlcacheheat(villa, FALSE, id, seq);
+  cbmapput(villa->leafc, (char *)&(lent.id), sizeof(int), (char *)&lent, sizeof(VLLEAF), TRUE);
+  leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&(lent.id), sizeof(int), NULL);
+  if(hold) VL_PAGEHOLD(villa, leaf);
+  VL_CACHEUNLOCK(villa);
+  return leaf;
+}
+
+
+/* Load leaves into the cache with one batch of reads.
+   `villa' specifies a database handle.
+   `ids' specifies an array of the ID numbers of the leaves.
+   `num' specifies the number of the elements of the array.
+   `seq' specifies whether the leaves are read by a cursor.
+   The return value is the number of the loaded leaves.
+   Leaves already cached are not read but moved to the end of the cache as with a hit.  The
+   pages are retrieved with `dpgetbatch', so those not mapped are read with one submission of the
+   engine of asynchronous I/O. */
+static int vlleafstage(VILLA *villa, const int *ids, int num, int seq){
+  const CBDATUM *dict;
+  const char **kbufs;
+  char **vbufs;
+  int i, knum, lnum, saves, *tids, *dkeys, *ksizs, *vsizs;
+  assert(villa && ids && num >= 0);
+  if(num < 1) return 0;
+  CB_MALLOC(tids, num * sizeof(int));
+  knum = 0;
+  VL_CACHELOCK(villa);
+  for(i = 0; i < num; i++){
+    if(!cbmapget(villa->leafc, (char *)(ids + i), sizeof(int), NULL)){
+      tids[knum++] = ids[i];
+    } else if(villa->leafcpol != VL_CR2Q){
+      cbmapmove(villa->leafc, (char *)(ids + i), sizeof(int), FALSE);
+    }
+  }
+  VL_CACHEUNLOCK(villa);
+  if(knum < 1){
+    free(tids);
+    return 0;
+  }
+  CB_MALLOC(dkeys, knum * sizeof(int) * 2);
+  CB_MALLOC(kbufs, knum * sizeof(char *));
+  CB_MALLOC(ksizs, knum * sizeof(int));
+  CB_MALLOC(vbufs, knum * sizeof(char *));
+  CB_MALLOC(vsizs, knum * sizeof(int));
+  saves = VL_ATOMICGET(villa->saves);
+  vldepotlatch(villa);
+  for(i = 0; i < knum; i++){
+    ksizs[i] = vlsnapkey(villa, tids[i], dkeys + i * 2);
+    kbufs[i] = (char *)(dkeys + i * 2);
+  }
+  lnum = dpgetbatch(villa->depot, kbufs, ksizs, knum, vbufs, vsizs);
+  dict = villa->dict;
+  VL_DEPOTUNLOCK(villa);
+  if(lnum > 0){
+    lnum = 0;
+    for(i = 0; i < knum; i++){
+      if(vbufs[i] &&
+         vlleafcacheimage(villa, tids[i], seq, FALSE, vbufs[i], vbufs[i], vsizs[i], dict, saves))
+        lnum++;
+    }
+  }
+  free(vsizs);
+  free(vbufs);
+  free(ksizs);
+  free(kbufs);
+  free(dkeys);
+  free(tids);
+  return lnum > 0 ? lnum : 0;
+}
+
+
+/* Load the leaves of the keys of a batch ahead of looking them up.
+   `villa' specifies a database handle.
+   `keys' specifies a list handle of the keys.
+   `idxs' specifies the array of the indices of the keys in sorted order.
+   `num' specifies the number of the indices.
+   `start' specifies the position of the key looked up next.
+   The return value is the position of the first key whose leaf was not loaded, or -1 on failure.
+   The leaves are loaded as many as the depth of the engine of asynchronous I/O but not more than
+   a half of the cache, counted in leaves of the average size of the cached ones if the memory
+   of the cache is limited. */
+static int vlleafstagekeys(VILLA *villa, const CBLIST *keys, const int *idxs, int num, int start){
+  CBDATUM *bound;
+  const char *kbuf;
+  int hist[VL_LEVELMAX];
+  int i, ksiz, pid, hnum, inum, max, lnum, asiz, *ids;
+  assert(villa && keys && idxs && num >= 0 && start >= 0);
+  max = villa->leafcnum / 2;
+  if(max > VL_AIODEPTH) max = VL_AIODEPTH;
+  if(villa->leafcmax > 0){
+    VL_CACHELOCK(villa);
+    lnum = cbmaprnum(villa->leafc);
+    asiz = lnum > 0 ? villa->leafcsiz / lnum : 0;
+    VL_CACHEUNLOCK(villa);
+    if(asiz > 0 && max > villa->leafcmax / 2 / asiz) max = villa->leafcmax / 2 / asiz;
+  }
+  if(max < 2) return num;
+  CB_MALLOC(ids, max * sizeof(int));
+  bound = NULL;
+  inum = 0;
+  for(i = start; i < num; i++){
+    kbuf = CB_LISTVAL2(keys, idxs[i], ksiz);
+    if(i > start && (!bound || villa->cmp(kbuf, ksiz, CB_DATUMPTR(bound),
+                                          CB_DATUMSIZE(bound)) < 0)) continue;
+    if(inum >= max) break;
+    if((pid = vlsearchpath(villa, kbuf, ksiz, hist, &hnum)) == -1 ||
+       !vlleafbound(villa, hist, hnum, pid, &bound)){
+      i = -1;
+      break;
+    }
+    ids[inum++] = pid;
+  }
+  if(bound) CB_DATUMCLOSE(bound);
+  if(i != -1 && inum > 1) vlleafstage(villa, ids, inum, FALSE);
+  free(ids);
+  return i;
+}
+
+
+/* Compact the arena of a leaf if most of it is abandoned.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle. */
+static void vlleafcompact(VILLA *villa, VLLEAF *leaf){
+  VLCHUNK *arena, *chunk;
+  VLREC *recp, *nrecp;
+  CBLIST *recs;
+  int i, ln, used;
+  assert(villa && leaf);
+  if(leaf->waste < VL_CHUNKMIN) return;
+  used = 0;
+  for(chunk = leaf->arena; chunk; chunk = chunk->next){
+    used += chunk->used;
+  }
+  if(leaf->waste * 2 < used) return;
+  arena = leaf->arena;
+  recs = leaf->recs;
+  ln = CB_LISTNUM(recs);
+  leaf->arena = NULL;
+  leaf->waste = 0;
+  CB_LISTOPEN2(leaf->recs, ln);
+  for(i = 0; i < ln; i++){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    nrecp = vlrecnew(villa, leaf, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key),
+                     CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first), TRUE);
+    nrecp->rest = recp->rest;
+    CB_LISTPUSHBUF(leaf->recs, (char *)nrecp, sizeof(VLREC));
+  }
+  VL_LISTCLOSEBUF(recs);
+  vlarenaclose(villa, arena, &(villa->leafcsiz));
+}
+
+
+/* Load the historical leaf from the database.
+   `villa' specifies a database handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'. */
+static VLLEAF *vlgethistleaf(VILLA *villa, const char *kbuf, int ksiz){
+  VLLEAF *leaf;
+  VLREC *recp;
+  int ln, rv;
+  assert(villa && kbuf && ksiz >= 0);
+  if(!(leaf = vlleafload(villa, villa->hleaf, FALSE))) return NULL;
+  if((ln = CB_LISTNUM(leaf->recs)) < 2) return NULL;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, 0);
+  rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+  if(rv == 0) return leaf;
+  if(rv < 0) return NULL;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, ln - 1);
+  rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+  if(rv <= 0 || leaf->next < VL_LEAFIDMIN) return leaf;
+  return NULL;
+}
+
+
+/* Load the leaf corresponding to a key.
+   `villa' specifies a database handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'.
+   The leaf is held and should be released with `vlkeyleafrelease'.  If the handle is shared by
+   threads, the history of the handle is neither referred to nor modified.  If it is shared with
+   the writer, the tree is latched shared and the leaf is latched by crabbing. */
+static VLLEAF *vlkeyleaf(VILLA *villa, const char *kbuf, int ksiz){
+  VLLEAF *leaf;
+  int hist[VL_LEVELMAX];
+  int hnum, pid;
+  assert(villa && kbuf && ksiz >= 0);
+  if(villa->tlatch){
+    VL_TREELOCK(villa, FALSE);
+    if(!(leaf = vlcrableaf(villa, kbuf, ksiz, FALSE))) VL_TREEUNLOCK(villa);
+    return leaf;
+  }
+  if(villa->mutex){
+    if((pid = vlsearchpath(villa, kbuf, ksiz, hist, &hnum)) == -1) return NULL;
+    return vlleafcachein(villa, pid, FALSE, TRUE);
+  }
+  if(villa->hleaf >= VL_LEAFIDMIN && (leaf = vlgethistleaf(villa, kbuf, ksiz)) != NULL)
+    return leaf;
+  if((pid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return NULL;
+  return vlleafload(villa, pid, FALSE);
+}
+
+
+/* Release a leaf loaded by `vlkeyleaf' and adjust the caches.
+   `villa' specifies a database handle.
+   `leaf' specifies the leaf handle.
+   The return value is true if successful, else, it is false.
+   If the handle is shared with the writer, the leaf and the tree are unlatched, and only pages
+   which are not dirty are swept out of the caches, as the writer may be modifying the others. */
+static int vlkeyleafrelease(VILLA *villa, VLLEAF *leaf){
+  int err;
+  assert(villa && leaf);
+  VL_LATCHUNLOCK(leaf);
+  VL_PAGERELEASE(villa, leaf);
+  err = !villa->tran && !vlcachetrim(villa, villa->tlatch != NULL);
+  VL_TREEUNLOCK(villa);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Latch the leaf corresponding to a key by crabbing down from the root.
+   `villa' specifies a database handle shared with the writer.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   `ex' specifies whether the leaf is latched exclusively.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'.
+   Each node is latched shared until its child is latched, so that the writer never divides a
+   page between being routed to and being latched.  The search starts over if the root is
+   replaced before it is latched.  The leaf is held and latched, and it should be unlatched with
+   `VL_LATCHUNLOCK' and released with `VL_PAGERELEASE'. */
+static VLLEAF *vlcrableaf(VILLA *villa, const char *kbuf, int ksiz, int ex){
+  VLNODE *node, *child;
+  VLLEAF *leaf;
+  int pid, root, depth, pin;
+  assert(villa && kbuf && ksiz >= 0);
+  node = NULL;
+  root = VL_ATOMICGET(villa->root);
+  pid = root;
+  depth = 0;
+  while(TRUE){
+    child = NULL;
+    leaf = NULL;
+    if(pid >= VL_NODEIDMIN){
+      pin = villa->pinlevel != 0 && (villa->pinlevel < 0 || depth < villa->pinlevel);
+      if((child = vlnodecachein(villa, pid, TRUE, pin)) != NULL){
+        VL_LATCHLOCK(child, FALSE);
+      } else {
+        dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      }
+    } else if((leaf = vlleafcachein(villa, pid, FALSE, TRUE)) != NULL){
+      VL_LATCHLOCK(leaf, ex);
+    }
+    if(node){
+      VL_LATCHUNLOCK(node);
+      VL_PAGERELEASE(villa, node);
+      node = NULL;
+    } else if((child || leaf) && VL_ATOMICGET(villa->root) != root){
+      if(child){
+        VL_LATCHUNLOCK(child);
+        VL_PAGERELEASE(villa, child);
+      } else {
+        VL_LATCHUNLOCK(leaf);
+        VL_PAGERELEASE(villa, leaf);
+      }
+      root = VL_ATOMICGET(villa->root);
+      pid = root;
+      depth = 0;
+      continue;
+    }
+    if(!child) return leaf;
+    node = child;
+    depth++;
+    if((pid = vlnoderoute(villa, node, kbuf, ksiz)) == -1){
+      VL_LATCHUNLOCK(node);
+      VL_PAGERELEASE(villa, node);
+      return NULL;
+    }
+  }
+}
+
+
+/* Store a record into a database handle shared with readers.
+   `villa' specifies a database handle connected as a writer.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.
+   `dmode' specifies behavior when the key overlaps.
+   The return value is 1 if the record is stored, 0 if the existing one is kept, or -1 on error.
+   As the writer is the only thread modifying the tree, it searches the tree without latches and
+   latches exclusively only the pages it modifies.  If the leaf is to be divided, it is unlatched
+   and the nodes up to the lowest one which is not divided are latched from the top down before
+   the leaf again, in the same order as readers. */
+static int vlputlatch(VILLA *villa, const char *kbuf, int ksiz,
+                      const char *vbuf, int vsiz, int dmode){
+  VLNODE *nodes[VL_LEVELMAX];
+  VLLEAF *leaf;
+  int i, top, hnum, pid, ln, rv;
+  assert(villa && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  if((pid = vlsearchpath(villa, kbuf, ksiz, villa->hist, &(villa->hnum))) == -1 ||
+     !(leaf = vlleafcachein(villa, pid, FALSE, TRUE))) return -1;
+  VL_LATCHLOCK(leaf, TRUE);
+  rv = vlleafaddrec(villa, leaf, dmode, kbuf, ksiz, vbuf, vsiz);
+  if(!rv || !vlleafover(villa, leaf)){
+    VL_LATCHUNLOCK(leaf);
+    VL_PAGERELEASE(villa, leaf);
+    return rv ? 1 : 0;
+  }
+  VL_LATCHUNLOCK(leaf);
+  hnum = villa->hnum;
+  for(i = 0; i < hnum; i++){
+    if(!(nodes[i] = vlnodecachein(villa, villa->hist[i], TRUE, FALSE))){
+      while(--i >= 0){
+        VL_PAGERELEASE(villa, nodes[i]);
+      }
+      VL_PAGERELEASE(villa, leaf);
+      return -1;
+    }
+  }
+  for(top = hnum - 1; top > 0; top--){
+    ln = CB_LISTNUM(nodes[top]->idxs) + 1;
+    if(ln <= villa->nodeidxmax || ln % 2 == 0) break;
+  }
+  if(top < 0) top = 0;
+  for(i = top; i < hnum; i++){
+    VL_LATCHLOCK(nodes[i], TRUE);
+  }
+  VL_LATCHLOCK(leaf, TRUE);
+  rv = vlleafsplit(villa, leaf);
+  VL_LATCHUNLOCK(leaf);
+  VL_PAGERELEASE(villa, leaf);
+  for(i = 0; i < hnum; i++){
+    if(i >= top) VL_LATCHUNLOCK(nodes[i]);
+    VL_PAGERELEASE(villa, nodes[i]);
+  }
+  return rv == -1 ? -1 : 1;
+}
+
+
+/* Add a record to a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   `dmode' specifies behavior when the key overlaps.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.
+   The return value is true if successful, else, it is false. */
+static int vlleafaddrec(VILLA *villa, VLLEAF *leaf, int dmode,
+                        const char *kbuf, int ksiz, const char *vbuf, int vsiz){
+  VLREC *recp;
+  CBLIST *recs;
+  int i, rv, left, right, ln;
+  assert(villa && leaf && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  left = 0;
+  recs = leaf->recs;
+  ln = CB_LISTNUM(recs);
+  right = ln;
+  i = (left + right) / 2;
+  while(right >= left && i < ln){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    if(rv == 0){
+      break;
+    } else if(rv <= 0){
+      right = i - 1;
+    } else {
+      left = i + 1;
+    }
+    i = (left + right) / 2;
+  }
+  while(i < ln){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    if(rv == 0){
+      switch(dmode){
+      case VL_DKEEP:
+        return FALSE;
+      case VL_DCAT:
+        vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, TRUE);
+        break;
+      case VL_DDUP:
+        if(!recp->rest){
+          CB_LISTOPEN(recp->rest);
+          leaf->rests++;
+        }
+        CB_LISTPUSH(recp->rest, vbuf, vsiz);
+        villa->rnum++;
+        break;
+      case VL_DDUPR:
+        if(!recp->rest){
+          CB_LISTOPEN(recp->rest);
+          leaf->rests++;
+          CB_LISTPUSH(recp->rest, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
+        } else {
+          cblistunshift(recp->rest, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
+        }
+        vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
+        villa->rnum++;
+        break;
+      default:
+        vlrecsetfirst(villa, leaf, recp, vbuf, vsiz, FALSE);
+        break;
+      }
+      vlleafcompact(villa, leaf);
+      break;
+    } else if(rv < 0){
+      recp = vlrecnew(villa, leaf, kbuf, ksiz, vbuf, vsiz, TRUE);
+      VL_LISTINSERTBUF(recs, i, (char *)recp, sizeof(VLREC));
+      villa->rnum++;
+      break;
+    }
+    i++;
+  }
+  if(i >= ln){
+    recp = vlrecnew(villa, leaf, kbuf, ksiz, vbuf, vsiz, TRUE);
+    CB_LISTPUSHBUF(recs, (char *)recp, sizeof(VLREC));
+    villa->rnum++;
+  }
+  VL_ATOMICSET(leaf->dirty, TRUE);
+  return TRUE;
+}
+
+
+/* Calculate the size of data of a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   The return value is size of data of the leaf. */
+static int vlleafdatasize(VILLA *villa, VLLEAF *leaf){
+  VLREC *recp, *precp;
+  CBLIST *recs, *rest;
+  const char *vbuf;
+  int i, j, sum, rnum, restnum, vsiz;
+  assert(villa && leaf);
+  sum = 0;
+  recs = leaf->recs;
+  rnum = CB_LISTNUM(recs);
+  precp = NULL;
+  for(i = 0; i < rnum; i++){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    sum += CB_DATUMSIZE(recp->key);
+    if(villa->fcode && i % VL_KEYRESTART != 0)
+      sum -= vlkeyshared(CB_DATUMPTR(precp->key), CB_DATUMSIZE(precp->key),
+                         CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    precp = recp;
+    sum += CB_DATUMSIZE(recp->first);
+    if(recp->rest){
+      rest = recp->rest;
+      restnum = CB_LISTNUM(rest);
+      for(j = 0; j < restnum; j++){
+        vbuf = CB_LISTVAL2(rest, j, vsiz);
+        sum += vsiz;
+      }
+    }
+  }
+  return sum;
+}
+
+
+/* Check whether a leaf is to be divided.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   The return value is true if the leaf is too large, else, it is false. */
+static int vlleafover(VILLA *villa, VLLEAF *leaf){
+  assert(villa && leaf);
+  switch(CB_LISTNUM(leaf->recs) % 4){
+  case 0:
+    if(CB_LISTNUM(leaf->recs) >= 4 &&
+       vlleafdatasize(villa, leaf) > VL_MAXLEAFSIZ * (villa->cmode > 0 ? 2 : 1)) return TRUE;
+  case 2:
+    if(CB_LISTNUM(leaf->recs) > villa->leafrecmax) return TRUE;
+    break;
+  }
+  return FALSE;
+}
+
+
+/* Check whether a leaf is to be merged with its sibling.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   The return value is true if the leaf is underflowing, else, it is false. */
+static int vlleafunder(VILLA *villa, VLLEAF *leaf){
+  int sizmax;
+  assert(villa && leaf);
+  sizmax = VL_MAXLEAFSIZ * (villa->cmode > 0 ? 2 : 1);
+  return CB_LISTNUM(leaf->recs) < villa->leafrecmax / VL_LEAFUNDER &&
+    (CB_LISTNUM(leaf->recs) < 1 || vlleafdatasize(villa, leaf) < sizmax / VL_LEAFUNDER);
+}
+
+
+/* Divide a leaf into two.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   The return value is the handle of a new leaf, or `NULL' on failure. */
+static VLLEAF *vlleafdivide(VILLA *villa, VLLEAF *leaf){
+  VLLEAF *newleaf, *nextleaf;
+  VLREC *recp, *nrecp;
+  CBLIST *recs, *newrecs;
+  int i, mid, ln;
+  assert(villa && leaf);
+  villa->hleaf = -1;
+  recs = leaf->recs;
+  mid = CB_LISTNUM(recs) / 2;
+  recp = (VLREC *)CB_LISTVAL(recs, mid);
+  newleaf = vlleafnew(villa, leaf->id, leaf->next);
+  if(newleaf->next != -1){
+    if(!(nextleaf = vlleafcachein(villa, newleaf->next, FALSE, TRUE))) return NULL;
+    VL_LATCHLOCK(nextleaf, TRUE);
+    nextleaf->prev = newleaf->id;
+    VL_ATOMICSET(nextleaf->dirty, TRUE);
+    VL_LATCHUNLOCK(nextleaf);
+    VL_PAGERELEASE(villa, nextleaf);
+  }
+  leaf->next = newleaf->id;
+  VL_ATOMICSET(leaf->dirty, TRUE);
+  ln = CB_LISTNUM(recs);
+  newrecs = newleaf->recs;
+  for(i = mid; i < ln; i++){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    nrecp = vlrecnew(villa, newleaf, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key),
+                     CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first), TRUE);
+    if((nrecp->rest = recp->rest) != NULL){
+      leaf->rests--;
+      newleaf->rests++;
+    }
+    leaf->waste += sizeof(VLREC) + CB_DATUMSIZE(recp->key) + CB_DATUMSIZE(recp->first);
+    CB_LISTPUSHBUF(newrecs, (char *)nrecp, sizeof(VLREC));
+  }
+  ln = CB_LISTNUM(newrecs);
+  for(i = 0; i < ln; i++){
+    cblistpop(recs, NULL);
+  }
+  vlleafcompact(villa, leaf);
+  return newleaf;
+}
+
+
+/* Move records between adjacent leaves.
+   `villa' specifies a database handle.
+   `src' specifies the leaf handle of the source.
+   `dest' specifies the leaf handle of the destination.
+   `front' specifies whether records are moved from the front of the source to the end of the
+   destination.  If it is false, records are moved from the end of the source to the front of
+   the destination.
+   `num' specifies the number of records to be moved.
+   The return value is the number of records moved. */
+static int vlleafmove(VILLA *villa, VLLEAF *src, VLLEAF *dest, int front, int num){
+  VLREC *recp, *nrecp;
+  int i, ri, ln;
+  assert(villa && src && dest && num >= 0);
+  ln = CB_LISTNUM(src->recs);
+  if(num > ln) num = ln;
+  for(i = 0; i < num; i++){
+    ri = front ? i : ln - num + i;
+    recp = (VLREC *)CB_LISTVAL(src->recs, ri);
+    nrecp = vlrecnew(villa, dest, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key),
+                     CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first), TRUE);
+    if((nrecp->rest = recp->rest) != NULL){
+      recp->rest = NULL;
+      src->rests--;
+      dest->rests++;
+    }
+    src->waste += sizeof(VLREC) + CB_DATUMSIZE(recp->key) + CB_DATUMSIZE(recp->first);
+    if(front){
+      CB_LISTPUSHBUF(dest->recs, (char *)nrecp, sizeof(VLREC));
+    } else {
+      VL_LISTINSERTBUF(dest->recs, i, (char *)nrecp, sizeof(VLREC));
+    }
+  }
+  for(i = 0; i < num; i++){
+    if(front){
+      cblistremove(src->recs, 0, NULL);
+    } else {
+      cblistpop(src->recs, NULL);
+    }
+  }
+  vlleafcompact(villa, src);
+  VL_ATOMICSET(src->dirty, TRUE);
+  VL_ATOMICSET(dest->dirty, TRUE);
+  return num;
+}
+
+
+/* Merge or redistribute an underflowing leaf with its sibling.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle where a record has been removed.
+   `kbuf' specifies the pointer to the region of the key of the removed record.
+   `ksiz' specifies the size of the region of the key.
+   The return value is true if successful, else, it is false.
+   The leaf is merged into its sibling under the same parent if both fit in a leaf, else records
+   are moved from the sibling to balance them.  The index of a merged leaf is removed from the
+   parent and its ID number is reused.  Nothing is done in the transaction. */
+static int vlleafmerge(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz){
+  VLLEAF *left, *right, *tleaf;
+  VLNODE *node;
+  VLREC *recp;
+  VLIDX *idxp;
+  CBDATUM *key;
+  int ci, si, lnum, rnum, sizmax, num, rid;
+  assert(villa && leaf && kbuf && ksiz >= 0);
+  if(villa->tran || villa->bulk || !vlleafunder(villa, leaf)) return TRUE;
+  sizmax = VL_MAXLEAFSIZ * (villa->cmode > 0 ? 2 : 1);
+  node = NULL;
+  if(villa->lleaf != leaf->id || villa->hnum < 1 ||
+     !(node = vlnodeload(villa, villa->hist[villa->hnum-1])) ||
+     (ci = vlnodechild(node, leaf->id)) < -1){
+    if((rid = vlsearchleaf(villa, kbuf, ksiz)) == -1) return FALSE;
+    if(rid != leaf->id || villa->hnum < 1) return TRUE;
+    if(!(node = vlnodeload(villa, villa->hist[villa->hnum-1])) ||
+       (ci = vlnodechild(node, leaf->id)) < -1){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      return FALSE;
+    }
+  }
+  if(ci < 0){
+    si = 0;
+    left = leaf;
+    idxp = (VLIDX *)CB_LISTVAL(node->idxs, si);
+    if(!(right = vlleafload(villa, idxp->pid, FALSE))) return FALSE;
+  } else {
+    si = ci;
+    right = leaf;
+    idxp = ci > 0 ? (VLIDX *)CB_LISTVAL(node->idxs, ci - 1) : NULL;
+    if(!(left = vlleafload(villa, idxp ? idxp->pid : node->heir, FALSE))) return FALSE;
+  }
+  if(left->next != right->id){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  villa->hleaf = -1;
+  villa->lleaf = -1;
+  lnum = CB_LISTNUM(left->recs);
+  rnum = CB_LISTNUM(right->recs);
+  if(lnum + rnum <= villa->leafrecmax && vlleafdatasize(villa, left) + vlleafdatasize(villa, right) <= sizmax){
+    rid = right->id;
+    vlleafmove(villa, right, left, TRUE, rnum);
+    if((left->next = right->next) != -1){
+      if(!(tleaf = vlleafload(villa, left->next, FALSE))) return FALSE;
+      tleaf->prev = left->id;
+      VL_ATOMICSET(tleaf->dirty, TRUE);
+    }
+    if(villa->last == rid) villa->last = left->id;
+    if(villa->curleaf == rid){
+      villa->curleaf = left->id;
+      villa->curknum += lnum;
+    }
+    cblistremove(node->idxs, si, NULL);
+    vlnodecompact(villa, node);
+    VL_ATOMICSET(node->dirty, TRUE);
+    if(!vlpagefree(villa, rid)) return FALSE;
+    if(CB_LISTNUM(node->idxs) < 1) return vlnodemerge(villa, villa->hnum - 1);
+    return TRUE;
+  }
+  if(lnum < rnum){
+    num = vlleafmove(villa, right, left, TRUE, (rnum - lnum) / 2);
+    if(villa->curleaf == right->id){
+      if(villa->curknum < num){
+        villa->curleaf = left->id;
+        villa->curknum += lnum;
+      } else {
+        villa->curknum -= num;
+      }
+    }
+  } else {
+    num = vlleafmove(villa, left, right, FALSE, (lnum - rnum) / 2);
+    if(villa->curleaf == left->id && villa->curknum >= lnum - num){
+      villa->curleaf = right->id;
+      villa->curknum -= lnum - num;
+    } else if(villa->curleaf == right->id){
+      villa->curknum += num;
+    }
+  }
+  if(num < 1 || CB_LISTNUM(right->recs) < 1) return TRUE;
+  recp = (VLREC *)CB_LISTVAL(right->recs, 0);
+  CB_DATUMOPEN2(key, CB_DATUMPTR(recp->key),
+                vlsepsize(villa, ((VLREC *)CB_LISTVAL(left->recs, CB_LISTNUM(left->recs) - 1))->key,
+                          CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key)));
+  vlnodesetidx(villa, node, si, key);
+  CB_DATUMCLOSE(key);
+  return TRUE;
+}
+
+
+/* Remove a run of records from a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   `beg' specifies the index of the first record to be removed.
+   `end' specifies the index following the last record to be removed.
+   The return value is the number of the values removed.
+   The records are removed at once without searching each of them. */
+static int vlleafcut(VILLA *villa, VLLEAF *leaf, int beg, int end){
+  VLREC *recp;
+  CBLIST *recs;
+  int i, num;
+  assert(villa && leaf && beg >= 0 && end >= beg);
+  recs = leaf->recs;
+  num = 0;
+  for(i = beg; i < end; i++){
+    recp = (VLREC *)CB_LISTVAL(recs, i);
+    num++;
+    if(recp->rest){
+      num += CB_LISTNUM(recp->rest);
+      CB_LISTCLOSE(recp->rest);
+      leaf->rests--;
+    }
+    leaf->waste += sizeof(VLREC) + CB_DATUMSIZE(recp->key) + CB_DATUMSIZE(recp->first);
+  }
+  memmove(recs->array + recs->start + beg, recs->array + recs->start + end,
+          sizeof(recs->array[0]) * (recs->num - end));
+  recs->num -= end - beg;
+  vlleafcompact(villa, leaf);
+  VL_ATOMICSET(leaf->dirty, TRUE);
+  return num;
+}
+
+
+/* Remove an empty leaf from the tree.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle which is not the first one.
+   `kbuf' specifies the pointer to the region of a key routed to the leaf.
+   `ksiz' specifies the size of the region of the key.
+   The return value is true if successful, else, it is false.
+   The index of the leaf is removed from the parent, where the following index takes over if the
+   leaf is the heir, and the siblings of the leaf are linked to each other.  A parent left
+   without indexes is merged with its sibling.  The leaf is kept if it is the only child. */
+static int vlleafunlink(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz){
+  VLLEAF *tleaf;
+  VLNODE *node;
+  int id, prev, next, ci;
+  assert(villa && leaf && leaf->prev != -1 && kbuf && ksiz >= 0);
+  id = leaf->id;
+  prev = leaf->prev;
+  next = leaf->next;
+  if((ci = vlsearchleaf(villa, kbuf, ksiz)) == -1) return FALSE;
+  if(ci != id || villa->hnum < 1) return TRUE;
+  if(!(node = vlnodeload(villa, villa->hist[villa->hnum-1])) ||
+     (ci = vlnodechild(node, id)) < -1){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(CB_LISTNUM(node->idxs) < 1) return TRUE;
+  if(ci < 0){
+    node->heir = ((VLIDX *)CB_LISTVAL(node->idxs, 0))->pid;
+    ci = 0;
+  }
+  cblistremove(node->idxs, ci, NULL);
+  vlnodecompact(villa, node);
+  VL_ATOMICSET(node->dirty, TRUE);
+  if(!(tleaf = vlleafload(villa, prev, FALSE))) return FALSE;
+  tleaf->next = next;
+  VL_ATOMICSET(tleaf->dirty, TRUE);
+  if(next != -1){
+    if(!(tleaf = vlleafload(villa, next, FALSE))) return FALSE;
+    tleaf->prev = prev;
+    VL_ATOMICSET(tleaf->dirty, TRUE);
+  }
+  if(villa->last == id) villa->last = prev;
+  villa->hleaf = -1;
+  villa->lleaf = -1;
+  if(!vlpagefree(villa, id)) return FALSE;
+  if(CB_LISTNUM(node->idxs) < 1) return vlnodemerge(villa, villa->hnum - 1);
+  return TRUE;
+}
+
+
+/* Divide a leaf if it is too large and add the new leaf to the parent node.
+   `villa' specifies a database handle whose history is the path to the leaf.
+   `leaf' specifies a leaf handle.
+   The return value is 1 if the leaf is divided, 0 if not, or -1 on error.
+   Nodes overflowing in the course are divided up to the root and the history is cleared after
+   the division.  If the handle is shared with readers, the leaf and the nodes to be modified
+   should be latched exclusively and the new root is published atomically. */
+static int vlleafsplit(VILLA *villa, VLLEAF *leaf){
+  VLLEAF *newleaf;
+  VLNODE *node, *newnode;
+  VLREC *recp;
+  VLIDX *idxp;
+  CBDATUM *key;
+  int i, pid, todiv, heir, parent, mid;
+  assert(villa && leaf);
+  todiv = vlleafover(villa, leaf);
+  if(todiv){
+    if(!(newleaf = vlleafdivide(villa, leaf))) return -1;
+    if(leaf->id == villa->last) villa->last = newleaf->id;
+    heir = leaf->id;
+    pid = newleaf->id;
+    recp = (VLREC *)CB_LISTVAL(newleaf->recs, 0);
+    CB_DATUMOPEN2(key, CB_DATUMPTR(recp->key),
+                  vlsepsize(villa, ((VLREC *)CB_LISTVAL(leaf->recs, CB_LISTNUM(leaf->recs) - 1))->key,
+                            CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key)));
+    while(TRUE){
+      if(villa->hnum < 1){
+        node = vlnodenew(villa, heir);
+        if(villa->pinlevel != 0) vlnodepin(villa, node, TRUE);
+        vlnodeaddidx(villa, node, TRUE, pid, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+        VL_ATOMICSET(villa->root, node->id);
+        CB_DATUMCLOSE(key);
+        break;
+      }
+      parent = villa->hist[--villa->hnum];
+      if(!(node = vlnodeload(villa, parent))){
+        CB_DATUMCLOSE(key);
+        return -1;
+      }
+      vlnodeaddidx(villa, node, FALSE, pid, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+      CB_DATUMCLOSE(key);
+      if(CB_LISTNUM(node->idxs) <= villa->nodeidxmax || CB_LISTNUM(node->idxs) % 2 == 0) break;
+      mid = CB_LISTNUM(node->idxs) / 2;
+      idxp = (VLIDX *)CB_LISTVAL(node->idxs, mid);
+      newnode = vlnodenew(villa, idxp->pid);
+      if(node->pin) vlnodepin(villa, newnode, TRUE);
+      heir = node->id;
+      pid = newnode->id;
+      CB_DATUMOPEN2(key, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
+      for(i = mid + 1; i < CB_LISTNUM(node->idxs); i++){
+        idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+        vlnodeaddidx(villa, newnode, TRUE, idxp->pid,
+                     CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
+      }
+      for(i = 0; i <= mid; i++){
+        cblistpop(node->idxs, NULL);
+      }
+      vlnodecompact(villa, node);
+      VL_ATOMICSET(node->dirty, TRUE);
+    }
+    villa->hnum = 0;
+    return 1;
+  }
+  return 0;
+}
+
+
+/* Get the upper bound of the keys routed to a leaf.
+   `villa' specifies a database handle.
+   `hist' specifies the array of the IDs of the nodes on the path to the leaf.
+   `hnum' specifies the number of the elements of the path.
+   `id' specifies the ID number of the leaf.
+   `boundp' specifies the pointer to a variable to which the datum of the bound is assigned.  The
+   previous datum assigned to it is closed.  `NULL' is assigned if the leaf is the last one.
+   If successful, the return value is true, else, it is false.
+   The bound is the key of the index following the path at the deepest level where one exists. */
+static int vlleafbound(VILLA *villa, const int *hist, int hnum, int id, CBDATUM **boundp){
+  VLNODE *node;
+  CBDATUM *key;
+  int i, ci;
+  assert(villa && hist && hnum >= 0 && id >= VL_LEAFIDMIN && boundp);
+  if(*boundp){
+    CB_DATUMCLOSE(*boundp);
+    *boundp = NULL;
+  }
+  for(i = hnum - 1; i >= 0; i--){
+    if(!(node = vlnodecachein(villa, hist[i], TRUE, FALSE))) return FALSE;
+    if((ci = vlnodechild(node, id)) < -1){
+      VL_PAGERELEASE(villa, node);
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      return FALSE;
+    }
+    if(ci + 1 < CB_LISTNUM(node->idxs)){
+      key = ((VLIDX *)CB_LISTVAL(node->idxs, ci + 1))->key;
+      CB_DATUMOPEN2(*boundp, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+      VL_PAGERELEASE(villa, node);
+      return TRUE;
+    }
+    id = node->id;
+    VL_PAGERELEASE(villa, node);
+  }
+  return TRUE;
+}
+
+
+/* Sort indices of a list of keys stably.
+   `cmp' specifies the comparing function.
+   `keys' specifies a list handle of the keys.
+   `idxs' specifies the array of the indices to be sorted in place.
+   `tmp' specifies a working array as long as the array of indices.
+   `num' specifies the number of the keys. */
+static void vlbatchsort(VLCFUNC cmp, const CBLIST *keys, int *idxs, int *tmp, int num){
+  const char *abuf, *bbuf;
+  int i, j, k, mid, asiz, bsiz, swap;
+  assert(cmp && keys && idxs && tmp && num >= 0);
+  if(num < VL_SORTINSMAX){
+    for(i = 1; i < num; i++){
+      swap = idxs[i];
+      bbuf = CB_LISTVAL2(keys, swap, bsiz);
+      for(j = i; j > 0; j--){
+        abuf = CB_LISTVAL2(keys, idxs[j-1], asiz);
+        if(cmp(abuf, asiz, bbuf, bsiz) <= 0) break;
+        idxs[j] = idxs[j-1];
+      }
+      idxs[j] = swap;
+    }
+    return;
+  }
+  mid = num / 2;
+  vlbatchsort(cmp, keys, idxs, tmp, mid);
+  vlbatchsort(cmp, keys, idxs + mid, tmp + mid, num - mid);
+  abuf = CB_LISTVAL2(keys, idxs[mid-1], asiz);
+  bbuf = CB_LISTVAL2(keys, idxs[mid], bsiz);
+  if(cmp(abuf, asiz, bbuf, bsiz) <= 0) return;
+  memcpy(tmp, idxs, sizeof(int) * num);
+  i = 0;
+  j = mid;
+  k = 0;
+  while(i < mid && j < num){
+    abuf = CB_LISTVAL2(keys, tmp[i], asiz);
+    bbuf = CB_LISTVAL2(keys, tmp[j], bsiz);
+    idxs[k++] = cmp(bbuf, bsiz, abuf, asiz) < 0 ? tmp[j++] : tmp[i++];
+  }
+  while(i < mid){
+    idxs[k++] = tmp[i++];
+  }
+  while(j < num){
+    idxs[k++] = tmp[j++];
+  }
+}
+
+
+/* Create a new node.
+   `villa' specifies a database handle.
+   `heir' specifies the ID of the child before the first index.
+   The return value is a handle of the node. */
+static VLNODE *vlnodenew(VILLA *villa, int heir){
+  VLNODE *node, nent;
+  assert(villa && heir >= VL_LEAFIDMIN);
+  nent.id = vlpagenewid(villa, TRUE);
+  nent.dirty = TRUE;
+  nent.heir = heir;
+  CB_LISTOPEN(nent.idxs);
+  nent.arena = NULL;
+  nent.heat = VL_HCOLD;
+  nent.pin = FALSE;
+  nent.refs = 0;
+  nent.latch = vllatchopen(villa);
+  VL_CACHELOCK(villa);
+  cbmapput(villa->nodec, (char *)&(nent.id), sizeof(int), (char *)&nent, sizeof(VLNODE), TRUE);
+  node = (VLNODE *)cbmapget(villa->nodec, (char *)&(nent.id), sizeof(int), NULL);
+  VL_CACHEUNLOCK(villa);
+  return node;
+}
+
+
+/* Remove a node from the cache.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the node.
+   The return value is true if successful, else, it is false. */
+static int vlnodecacheout(VILLA *villa, int id){
+  VLNODE *node;
+  int err;
+  assert(villa && id >= VL_NODEIDMIN);
+  if(!(node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL))) return FALSE;
+  err = FALSE;
+  if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
+  VL_LISTCLOSEBUF(node->idxs);
+  vlarenaclose(villa, node->arena, VL_NODESUMP(villa, node));
+  vllatchclose(node->latch);
+  if(node->heat == VL_HHOT) villa->nodechot--;
+  if(node->pin) villa->pinnum--;
+  cbmapout(villa->nodec, (char *)&id, sizeof(int));
+  return err ? FALSE : TRUE;
+}
+
+
+/* Save a node into the database.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   The return value is true if successful, else, it is false. */
+static int vlnodesave(VILLA *villa, VLNODE *node){
+  char *ibuf;
+  int isiz;
+  assert(villa && node);
+  ibuf = vlnodeencode(villa, node, &isiz);
+  VL_DEPOTLOCK(villa, TRUE);
+  if(!vlsnapkeep(villa, node->id) ||
+     !dpput(villa->depot, (char *)&(node->id), sizeof(int), ibuf, isiz, DP_DOVER)){
+    VL_DEPOTUNLOCK(villa);
+    free(ibuf);
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(villa->ptab) vlptabupdate(villa, node->id, TRUE);
+  VL_ATOMICINC(villa->saves);
+  VL_DEPOTUNLOCK(villa);
+  free(ibuf);
+  VL_ATOMICSET(node->dirty, FALSE);
+  return TRUE;
+}
+
+
+/* Serialize a node into the image of its record.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `sp' specifies the pointer to a variable to which the size of the image is assigned.
+   The return value is the pointer to the region of the image.  Because the region of the
+   return value is allocated with the `malloc' call, it should be released with the `free' call
+   if it is no longer in use. */
+static char *vlnodeencode(VILLA *villa, VLNODE *node, int *sp){
+  CBDATUM *buf;
+  char vnumbuf[VL_VNUMBUFSIZ];
+  VLIDX *idxp, *pidxp;
+  int i, heir, pid, ksiz, psiz, vnumsiz, ln;
+  assert(villa && node && sp);
+  CB_DATUMOPEN(buf);
+  heir = node->heir;
+  VL_SETVNUMBUF(vnumsiz, vnumbuf, heir);
+  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+  ln = CB_LISTNUM(node->idxs);
+  for(i = 0; i < ln; i++){
+    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+    pid = idxp->pid;
+    VL_SETVNUMBUF(vnumsiz, vnumbuf, pid);
+    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    ksiz = CB_DATUMSIZE(idxp->key);
+    psiz = 0;
+    if(villa->fcode){
+      if(i % VL_KEYRESTART != 0){
+        pidxp = (VLIDX *)CB_LISTVAL(node->idxs, i - 1);
+        psiz = vlkeyshared(CB_DATUMPTR(pidxp->key), CB_DATUMSIZE(pidxp->key),
+                           CB_DATUMPTR(idxp->key), ksiz);
+      }
+      VL_SETVNUMBUF(vnumsiz, vnumbuf, psiz);
+      CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    }
+    VL_SETVNUMBUF(vnumsiz, vnumbuf, ksiz - psiz);
+    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
+    CB_DATUMCAT(buf, CB_DATUMPTR(idxp->key) + psiz, ksiz - psiz);
+  }
+  *sp = CB_DATUMSIZE(buf);
+  return cbdatumtomalloc(buf, NULL);
+}
+
+
+/* Load a node from the database.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the node.
+   If successful, the return value is the pointer to the node, else, it is `NULL'. */
+static VLNODE *vlnodeload(VILLA *villa, int id){
+  assert(villa && id >= VL_NODEIDMIN);
+  return vlnodecachein(villa, id, FALSE, FALSE);
+}
+
+
+/* Load a node into the cache.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the node.
+   `hold' specifies whether the node is held so that other threads sharing the handle do not
+   sweep it out of the cache until it is released with `VL_PAGERELEASE'.
+   `pin' specifies whether the node is pinned in the cache.
+   If successful, the return value is the pointer to the node, else, it is `NULL'.
+   The page is read in the same way as leaves. */
+static VLNODE *vlnodecachein(VILLA *villa, int id, int hold, int pin){
+  char wbuf[VL_PAGEBUFSIZ], *buf, *rp, *kbuf, *pkbuf, *tbuf;
+  const char *pbuf;
+  int size, step, heir, pid, ksiz, psiz, pksiz, saves, dksiz, ptab;
+  int dkey[2];
+  VLNODE *node, nent;
+  VLIDX *idxp;
+  assert(villa && id >= VL_NODEIDMIN);
+  VL_CACHELOCK(villa);
+  if((node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL)) != NULL){
+    if(!node->pin) vlcachehit(villa, TRUE, id, &(node->heat), FALSE);
+    if(pin && !node->pin) vlnodepin(villa, node, TRUE);
+    if(hold) VL_PAGEHOLD(villa, node);
+    VL_CACHEUNLOCK(villa);
+    return node;
+  }
+  VL_CACHEUNLOCK(villa);
+  saves = VL_ATOMICGET(villa->saves);
+  heir = -1;
+  vldepotlatch(villa);
+  dksiz = vlsnapkey(villa, id, dkey);
+  ptab = villa->ptab && dksiz == sizeof(int);
+  if(villa->depot->mapall &&
+     (pbuf = dpgetmap(villa->depot, (char *)dkey, dksiz, &size)) != NULL){
+    buf = NULL;
+    if(villa->dlatch){
+      CB_MEMDUP(buf, pbuf, size);
+      pbuf = buf;
+    }
+    ptab = FALSE;
+  } else if(ptab && (pbuf = vlptabread(villa, id, wbuf, &buf, &size)) != NULL){
+    ptab = FALSE;
+  } else if((size = dpgetwb(villa->depot, (char *)dkey, dksiz, 0,
+                            VL_PAGEBUFSIZ, wbuf)) > 0 && size < VL_PAGEBUFSIZ){
+    buf = NULL;
+    pbuf = wbuf;
+  } else if(!(buf = dpget(villa->depot, (char *)dkey, dksiz, 0, -1, &size))){
+    VL_DEPOTUNLOCK(villa);
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return NULL;
+  } else {
+    pbuf = buf;
+  }
+  if(ptab && villa->wmode && !villa->dlatch) vlptabupdate(villa, id, FALSE);
+  VL_DEPOTUNLOCK(villa);
+  if(size >= 1){
+    VL_READVNUMBUF(pbuf, size, heir, step);
+    pbuf += step;
+    size -= step;
+  }
+  if(heir < 0){
+    free(buf);
+    return NULL;
+  }
+  VL_CACHELOCK(villa);
+  if(villa->mutex && (node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL))){
+    if(pin && !node->pin) vlnodepin(villa, node, TRUE);
+    if(hold) VL_PAGEHOLD(villa, node);
+    VL_CACHEUNLOCK(villa);
+    free(buf);
+    return node;
+  }
+  if(villa->dlatch && VL_ATOMICGET(villa->saves) != saves){
+    VL_CACHEUNLOCK(villa);
+    free(buf);
+    return vlnodecachein(villa, id, hold, pin);
+  }
+  nent.id = id;
+  nent.dirty = FALSE;
+  nent.heir = heir;
+  CB_LISTOPEN(nent.idxs);
+  nent.arena = NULL;
+  nent.heat = vlcacheheat(villa, TRUE, id, FALSE);
+  nent.pin = FALSE;
+  nent.refs = 0;
+  nent.latch = vllatchopen(villa);
+  rp = vlarenaalloc(villa, &(nent.arena), size + 1, &(villa->nodecsiz));
+  memcpy(rp, pbuf, size);
+  rp[size] = '\0';
+  free(buf);
+  pkbuf = NULL;
+  pksiz = 0;
   while(size >= 1){
+    VL_READVNUMBUF(rp, size, pid, step);
+    *rp = '\0';
+    rp += step;
+    size -= step;
+    if(size < 1) break;
+    psiz = 0;
+    if(villa->fcode){
+      VL_READVNUMBUF(rp, size, psiz, step);
+      rp += step;
+      size -= step;
+      if(size < 1 || psiz > pksiz) break;
+    }
     VL_READVNUMBUF(rp, size, ksiz, step);
     rp += step;
     size -= step;
@@ -2133,82 +6158,670 @@ static VLLEAF *vlleafload(VILLA *villa, int id){
     kbuf = rp;
     rp += ksiz;
     size -= ksiz;
-    VL_READVNUMBUF(rp, size, vnum, step);
-    rp += step;
-    size -= step;
-    if(vnum < 1 || size < 1) break;
-    for(i = 0; i < vnum && size >= 1; i++){
-      VL_READVNUMBUF(rp, size, vsiz, step);
-      rp += step;
-      size -= step;
-      if(size < vsiz) break;
-      vbuf = rp;
-      rp += vsiz;
-      size -= vsiz;
-      if(i < 1){
-        CB_DATUMOPEN2(rec.key, kbuf, ksiz);
-        CB_DATUMOPEN2(rec.first, vbuf, vsiz);
-        rec.rest = NULL;
+    if(psiz > 0){
+      tbuf = vlarenaalloc(villa, &(nent.arena), psiz + ksiz + 1, &(villa->nodecsiz));
+      memcpy(tbuf, pkbuf, psiz);
+      memcpy(tbuf + psiz, kbuf, ksiz);
+      tbuf[psiz+ksiz] = '\0';
+      kbuf = tbuf;
+      ksiz += psiz;
+    }
+    pkbuf = kbuf;
+    pksiz = ksiz;
+    idxp = vlidxnew(villa, &nent, pid, kbuf, ksiz, FALSE);
+    CB_LISTPUSHBUF(nent.idxs, (char *)idxp, sizeof(VLIDX));
+  }
+  cbmapput(villa->nodec, (char *)&(nent.id), sizeof(int), (char *)&nent, sizeof(VLNODE), TRUE);
+  node = (VLNODE *)cbmapget(villa->nodec, (char *)&(nent.id), sizeof(int), NULL);
+  if(pin) vlnodepin(villa, node, TRUE);
+  if(hold) VL_PAGEHOLD(villa, node);
+  VL_CACHEUNLOCK(villa);
+  return node;
+}
+
+
+/* Rebuild the arena of a node to release abandoned regions.
+   `villa' specifies a database handle.
+   `node' specifies a node handle. */
+static void vlnodecompact(VILLA *villa, VLNODE *node){
+  VLCHUNK *arena;
+  VLIDX *idxp, *nidxp;
+  CBLIST *idxs;
+  int i, ln;
+  assert(villa && node);
+  arena = node->arena;
+  idxs = node->idxs;
+  ln = CB_LISTNUM(idxs);
+  node->arena = NULL;
+  CB_LISTOPEN2(node->idxs, ln);
+  for(i = 0; i < ln; i++){
+    idxp = (VLIDX *)CB_LISTVAL(idxs, i);
+    nidxp = vlidxnew(villa, node, idxp->pid,
+                     CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key), TRUE);
+    CB_LISTPUSHBUF(node->idxs, (char *)nidxp, sizeof(VLIDX));
+  }
+  VL_LISTCLOSEBUF(idxs);
+  VL_CACHELOCK(villa);
+  vlarenaclose(villa, arena, VL_NODESUMP(villa, node));
+  VL_CACHEUNLOCK(villa);
+}
+
+
+/* Set whether a node is pinned in the cache.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `pin' specifies whether the node is pinned.
+   The memory of the node is moved between the accounts of the cache and pinned nodes.  A node
+   is left unpinned if pinning it would make the pinned nodes exceed the limits of the cache. */
+static void vlnodepin(VILLA *villa, VLNODE *node, int pin){
+  VLCHUNK *chunk;
+  int size;
+  assert(villa && node);
+  VL_CACHELOCK(villa);
+  if(node->pin == pin){
+    VL_CACHEUNLOCK(villa);
+    return;
+  }
+  size = 0;
+  for(chunk = node->arena; chunk; chunk = chunk->next){
+    size += sizeof(VLCHUNK) + chunk->size;
+  }
+  if(pin && (villa->pinnum >= villa->nodecnum ||
+             VL_CACHEOVER(villa->pinsiz + size, villa->nodecmax))){
+    VL_CACHEUNLOCK(villa);
+    return;
+  }
+  if(pin){
+    if(node->heat == VL_HHOT) villa->nodechot--;
+    node->heat = VL_HCOLD;
+    villa->nodecsiz -= size;
+    villa->pinsiz += size;
+    villa->pinnum++;
+  } else {
+    villa->pinsiz -= size;
+    villa->nodecsiz += size;
+    villa->pinnum--;
+  }
+  node->pin = pin;
+  VL_CACHEUNLOCK(villa);
+}
+
+
+/* Get the position of a child page in a node.
+   `node' specifies a node handle.
+   `pid' specifies the ID number of the child page.
+   The return value is -1 for the heir, the index of the corresponding index, or -2 if the page
+   is not a child. */
+static int vlnodechild(VLNODE *node, int pid){
+  int i, ln;
+  assert(node);
+  if(node->heir == pid) return -1;
+  ln = CB_LISTNUM(node->idxs);
+  for(i = 0; i < ln; i++){
+    if(((VLIDX *)CB_LISTVAL(node->idxs, i))->pid == pid) return i;
+  }
+  return -2;
+}
+
+
+/* Replace the key of an index of a node.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `index' specifies the index of the index.
+   `key' specifies the new key, which must not be a part of the node. */
+static void vlnodesetidx(VILLA *villa, VLNODE *node, int index, const CBDATUM *key){
+  VLIDX *idxp;
+  int pid;
+  assert(villa && node && index >= 0 && key);
+  pid = ((VLIDX *)CB_LISTVAL(node->idxs, index))->pid;
+  cblistremove(node->idxs, index, NULL);
+  idxp = vlidxnew(villa, node, pid, CB_DATUMPTR(key), CB_DATUMSIZE(key), TRUE);
+  VL_LISTINSERTBUF(node->idxs, index, (char *)idxp, sizeof(VLIDX));
+  vlnodecompact(villa, node);
+  VL_ATOMICSET(node->dirty, TRUE);
+}
+
+
+/* Merge or redistribute a node without indexes with its sibling.
+   `villa' specifies a database handle.
+   `level' specifies the position of the node in the history.
+   The return value is true if successful, else, it is false.
+   A root without indexes is replaced by its heir.  Otherwise, the node is merged with its
+   sibling under the same parent by pulling down the separating key, or an index is rotated
+   through the parent if the sibling is full. */
+static int vlnodemerge(VILLA *villa, int level){
+  VLNODE *node, *parent, *left, *right;
+  VLIDX *idxp;
+  CBDATUM *key;
+  int i, ci, si, ln, rid;
+  assert(villa && level >= 0);
+  while(level >= 0){
+    if(!(node = vlnodeload(villa, villa->hist[level]))) return FALSE;
+    if(CB_LISTNUM(node->idxs) > 0) break;
+    if(level < 1){
+      villa->root = node->heir;
+      villa->hnum = 0;
+      return vlpagefree(villa, node->id);
+    }
+    if(!(parent = vlnodeload(villa, villa->hist[level-1])) ||
+       (ci = vlnodechild(parent, node->id)) < -1){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      return FALSE;
+    }
+    if(ci < 0){
+      si = 0;
+      left = node;
+      idxp = (VLIDX *)CB_LISTVAL(parent->idxs, si);
+      if(!(right = vlnodeload(villa, idxp->pid))) return FALSE;
+    } else {
+      si = ci;
+      right = node;
+      idxp = ci > 0 ? (VLIDX *)CB_LISTVAL(parent->idxs, ci - 1) : NULL;
+      if(!(left = vlnodeload(villa, idxp ? idxp->pid : parent->heir))) return FALSE;
+    }
+    idxp = (VLIDX *)CB_LISTVAL(parent->idxs, si);
+    key = cbdatumdup(idxp->key);
+    if(CB_LISTNUM(left->idxs) + CB_LISTNUM(right->idxs) + 1 <= villa->nodeidxmax){
+      vlnodeaddidx(villa, left, TRUE, right->heir, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+      ln = CB_LISTNUM(right->idxs);
+      for(i = 0; i < ln; i++){
+        idxp = (VLIDX *)CB_LISTVAL(right->idxs, i);
+        vlnodeaddidx(villa, left, TRUE, idxp->pid, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
+      }
+      CB_DATUMCLOSE(key);
+      rid = right->id;
+      cblistremove(parent->idxs, si, NULL);
+      vlnodecompact(villa, parent);
+      VL_ATOMICSET(parent->dirty, TRUE);
+      if(!vlpagefree(villa, rid)) return FALSE;
+      level--;
+      continue;
+    }
+    if(left == node){
+      vlnodeaddidx(villa, left, TRUE, right->heir, CB_DATUMPTR(key), CB_DATUMSIZE(key));
+      CB_DATUMCLOSE(key);
+      idxp = (VLIDX *)CB_LISTVAL(right->idxs, 0);
+      right->heir = idxp->pid;
+      key = cbdatumdup(idxp->key);
+      cblistremove(right->idxs, 0, NULL);
+      vlnodecompact(villa, right);
+    } else {
+      idxp = vlidxnew(villa, right, right->heir, CB_DATUMPTR(key), CB_DATUMSIZE(key), TRUE);
+      VL_LISTINSERTBUF(right->idxs, 0, (char *)idxp, sizeof(VLIDX));
+      CB_DATUMCLOSE(key);
+      idxp = (VLIDX *)CB_LISTVAL(left->idxs, CB_LISTNUM(left->idxs) - 1);
+      right->heir = idxp->pid;
+      key = cbdatumdup(idxp->key);
+      cblistpop(left->idxs, NULL);
+      vlnodecompact(villa, left);
+      VL_ATOMICSET(left->dirty, TRUE);
+    }
+    VL_ATOMICSET(right->dirty, TRUE);
+    vlnodesetidx(villa, parent, si, key);
+    CB_DATUMCLOSE(key);
+    break;
+  }
+  villa->hnum = 0;
+  return TRUE;
+}
+
+
+/* Load and pin a node and its descendant nodes.
+   `villa' specifies a database handle.
+   `id' specifies the ID number of the node.
+   `level' specifies the level of the node, which is 0 for the root.
+   The return value is true if successful, else, it is false. */
+static int vlnodepinload(VILLA *villa, int id, int level){
+  VLNODE *node;
+  VLIDX *idxp;
+  int i, ln;
+  assert(villa && id >= VL_NODEIDMIN && level >= 0);
+  if(!(node = vlnodecachein(villa, id, FALSE, TRUE))){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return FALSE;
+  }
+  if(villa->pinlevel > 0 && level + 1 >= villa->pinlevel) return TRUE;
+  if(node->heir >= VL_NODEIDMIN && !vlnodepinload(villa, node->heir, level + 1)) return FALSE;
+  ln = CB_LISTNUM(node->idxs);
+  for(i = 0; i < ln; i++){
+    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+    if(idxp->pid >= VL_NODEIDMIN && !vlnodepinload(villa, idxp->pid, level + 1)) return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Add an index to a node.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `order' specifies whether the calling sequence is orderd or not.
+   `pid' specifies the ID number of referred page.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key. */
+static void vlnodeaddidx(VILLA *villa, VLNODE *node, int order,
+                         int pid, const char *kbuf, int ksiz){
+  VLIDX *nidxp, *idxp;
+  int i, rv, left, right, ln;
+  assert(villa && node && pid >= VL_LEAFIDMIN && kbuf && ksiz >= 0);
+  nidxp = vlidxnew(villa, node, pid, kbuf, ksiz, TRUE);
+  if(order){
+    CB_LISTPUSHBUF(node->idxs, (char *)nidxp, sizeof(VLIDX));
+  } else {
+    left = 0;
+    right = CB_LISTNUM(node->idxs);
+    i = (left + right) / 2;
+    ln = CB_LISTNUM(node->idxs);
+    while(right >= left && i < ln){
+      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+      rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
+      if(rv == 0){
+        break;
+      } else if(rv <= 0){
+        right = i - 1;
       } else {
-        if(!rec.rest) CB_LISTOPEN(rec.rest);
-        CB_LISTPUSH(rec.rest, vbuf, vsiz);
+        left = i + 1;
+      }
+      i = (left + right) / 2;
+    }
+    ln = CB_LISTNUM(node->idxs);
+    while(i < ln){
+      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+      if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key)) < 0){
+        VL_LISTINSERTBUF(node->idxs, i, (char *)nidxp, sizeof(VLIDX));
+        break;
+      }
+      i++;
+    }
+    if(i >= CB_LISTNUM(node->idxs)) CB_LISTPUSHBUF(node->idxs, (char *)nidxp, sizeof(VLIDX));
+  }
+  VL_ATOMICSET(node->dirty, TRUE);
+}
+
+
+/* Add an index of a page to the node being filled by bulk loading.
+   `villa' specifies a database handle.
+   `level' specifies the level of the node, which is 0 for the parents of leaves.
+   `prev' specifies the ID number of the page before the page of the index.
+   `pid' specifies the ID number of the page of the index.
+   `kbuf' specifies the pointer to the region of the first key of the page.
+   `ksiz' specifies the size of the region of the key.
+   The return value is true if successful, else, it is false.
+   When the node is filled, the page is kept pending until the next page comes, and then a new
+   node of the two pages is started and added to the upper level.  So, no node is left without
+   indexes. */
+static int vlbulkaddidx(VILLA *villa, int level, int prev, int pid, const char *kbuf, int ksiz){
+  VLNODE *node, *newnode;
+  CBDATUM *key;
+  int idxmax;
+  assert(villa && level >= 0 && prev > 0 && pid > 0 && kbuf && ksiz >= 0);
+  if(level >= villa->bulkdepth){
+    if(level >= VL_LEVELMAX){
+      dpecodeset(DP_EMISC, __FILE__, __LINE__);
+      return FALSE;
+    }
+    node = vlnodenew(villa, prev);
+    villa->bulknodes[level] = node->id;
+    villa->bulkpids[level] = -1;
+    villa->bulkkeys[level] = NULL;
+    villa->bulkdepth = level + 1;
+  } else if(!(node = vlnodeload(villa, villa->bulknodes[level]))){
+    return FALSE;
+  }
+  if(villa->bulkpids[level] > 0){
+    newnode = vlnodenew(villa, villa->bulkpids[level]);
+    vlnodeaddidx(villa, newnode, TRUE, pid, kbuf, ksiz);
+    villa->bulknodes[level] = newnode->id;
+    villa->bulkpids[level] = -1;
+    prev = node->id;
+    if(!vlnodecacheout(villa, prev)) return FALSE;
+    key = villa->bulkkeys[level];
+    return vlbulkaddidx(villa, level + 1, prev, villa->bulknodes[level],
+                        CB_DATUMPTR(key), CB_DATUMSIZE(key));
+  }
+  idxmax = villa->nodeidxmax * villa->bulkfill / 100;
+  if(idxmax < 2) idxmax = 2;
+  if(CB_LISTNUM(node->idxs) >= idxmax){
+    villa->bulkpids[level] = pid;
+    if(!villa->bulkkeys[level]) CB_DATUMOPEN(villa->bulkkeys[level]);
+    cbdatumsetsize(villa->bulkkeys[level], 0);
+    CB_DATUMCAT(villa->bulkkeys[level], kbuf, ksiz);
+    return TRUE;
+  }
+  vlnodeaddidx(villa, node, TRUE, pid, kbuf, ksiz);
+  return TRUE;
+}
+
+
+/* Sort records in a job of a sorter and write them into a file of a run.
+   `arg' specifies the pointer to the job.
+   The return value is `NULL'. */
+static void *vlsortjob(void *arg){
+  VLSORTJOB *job;
+  FILE *ofp;
+  int i, ksiz, vsiz, rsiz;
+  assert(arg);
+  job = (VLSORTJOB *)arg;
+  vlsortrecs(job->cmp, job->recs, job->tmp, job->num);
+  if(job->path[0] == '\0') return NULL;
+  if(!(ofp = fopen(job->path, "wb"))){
+    job->err = TRUE;
+    return NULL;
+  }
+  for(i = 0; i < job->num; i++){
+    memcpy(&ksiz, job->recs[i], sizeof(int));
+    memcpy(&vsiz, job->recs[i] + sizeof(int), sizeof(int));
+    rsiz = sizeof(int) * 2 + ksiz + vsiz;
+    if(fwrite(job->recs[i], 1, rsiz, ofp) != (size_t)rsiz){
+      job->err = TRUE;
+      break;
+    }
+  }
+  if(fclose(ofp) != 0) job->err = TRUE;
+  return NULL;
+}
+
+
+/* Sort the records in the buffer of a sorter by threads.
+   `sort' specifies a sorter.
+   `jobs' specifies an array of jobs to be set.
+   `spill' specifies whether to write the sorted records into files of runs.
+   The return value is the number of the jobs.
+   The array of records of the first job is allocated with `malloc' and it should be released
+   with `free', which also releases the arrays of the other jobs. */
+static int vlsortrun(VLSORT *sort, VLSORTJOB *jobs, int spill){
+#if defined(MYPTHREAD)
+  pthread_t ths[VL_SORTTHMAX];
+  int started[VL_SORTTHMAX];
+#endif
+  char **recs, *rp, *name;
+  int i, jnum, step, ksiz, vsiz;
+  assert(sort && jobs);
+  CB_MALLOC(recs, sizeof(char *) * (sort->rnum * 2 + 1));
+  rp = sort->buf;
+  for(i = 0; i < sort->rnum; i++){
+    recs[i] = rp;
+    memcpy(&ksiz, rp, sizeof(int));
+    memcpy(&vsiz, rp + sizeof(int), sizeof(int));
+    rp += VL_ARENAPAD(sizeof(int) * 2 + ksiz + vsiz);
+  }
+  jnum = sort->rnum / VL_SORTTHMIN;
+  if(jnum > sort->thnum) jnum = sort->thnum;
+  if(jnum < 1) jnum = 1;
+  step = sort->rnum / jnum;
+  name = spill ? dpname(sort->villa->depot) : NULL;
+  for(i = 0; i < jnum; i++){
+    jobs[i].cmp = sort->villa->cmp;
+    jobs[i].recs = recs + i * step;
+    jobs[i].tmp = recs + sort->rnum + i * step;
+    jobs[i].num = i < jnum - 1 ? step : sort->rnum - i * step;
+    jobs[i].path[0] = '\0';
+    if(name) sprintf(jobs[i].path, "%s%s.%d", name, VL_TMPFSUF, sort->seq++);
+    jobs[i].err = FALSE;
+  }
+  free(name);
+#if defined(MYPTHREAD)
+  for(i = 1; i < jnum; i++){
+    started[i] = pthread_create(ths + i, NULL, vlsortjob, jobs + i) == 0;
+    if(!started[i]) vlsortjob(jobs + i);
+  }
+  vlsortjob(jobs);
+  for(i = 1; i < jnum; i++){
+    if(started[i]) pthread_join(ths[i], NULL);
+  }
+#else
+  for(i = 0; i < jnum; i++){
+    vlsortjob(jobs + i);
+  }
+#endif
+  return jnum;
+}
+
+
+/* Write the records in the buffer of a sorter into files of sorted runs.
+   `sort' specifies a sorter.
+   The return value is true if successful, else, it is false. */
+static int vlsortspill(VLSORT *sort){
+  VLSORTJOB jobs[VL_SORTTHMAX];
+  int i, num, err;
+  assert(sort);
+  num = vlsortrun(sort, jobs, TRUE);
+  err = FALSE;
+  for(i = 0; i < num; i++){
+    if(jobs[i].err) err = TRUE;
+    CB_LISTPUSH(sort->runs, jobs[i].path, strlen(jobs[i].path));
+  }
+  free(jobs[0].recs);
+  sort->bsiz = 0;
+  sort->rnum = 0;
+  if(err){
+    dpecodeset(DP_EWRITE, __FILE__, __LINE__);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+/* Sort an array of records stably.
+   `cmp' specifies the comparing function.
+   `recs' specifies the array of records.
+   `tmp' specifies a working array as long as the array of records.
+   `num' specifies the number of the records. */
+static void vlsortrecs(VLCFUNC cmp, char **recs, char **tmp, int num){
+  char *swap;
+  int i, j, k, mid;
+  assert(cmp && recs && tmp && num >= 0);
+  if(num < VL_SORTINSMAX){
+    for(i = 1; i < num; i++){
+      swap = recs[i];
+      for(j = i; j > 0 && vlsortcmp(cmp, recs[j-1], swap) > 0; j--){
+        recs[j] = recs[j-1];
+      }
+      recs[j] = swap;
+    }
+    return;
+  }
+  mid = num / 2;
+  vlsortrecs(cmp, recs, tmp, mid);
+  vlsortrecs(cmp, recs + mid, tmp + mid, num - mid);
+  if(vlsortcmp(cmp, recs[mid-1], recs[mid]) <= 0) return;
+  memcpy(tmp, recs, sizeof(char *) * num);
+  i = 0;
+  j = mid;
+  k = 0;
+  while(i < mid && j < num){
+    recs[k++] = vlsortcmp(cmp, tmp[j], tmp[i]) < 0 ? tmp[j++] : tmp[i++];
+  }
+  while(i < mid){
+    recs[k++] = tmp[i++];
+  }
+  while(j < num){
+    recs[k++] = tmp[j++];
+  }
+}
+
+
+/* Compare the keys of two records of a sorter.
+   `cmp' specifies the comparing function.
+   `arec' specifies the pointer to the region of a record.
+   `brec' specifies the pointer to the region of the other record.
+   The return value is the result of the comparing function. */
+static int vlsortcmp(VLCFUNC cmp, const char *arec, const char *brec){
+  int asiz, bsiz;
+  assert(cmp && arec && brec);
+  memcpy(&asiz, arec, sizeof(int));
+  memcpy(&bsiz, brec, sizeof(int));
+  return cmp(arec + sizeof(int) * 2, asiz, brec + sizeof(int) * 2, bsiz);
+}
+
+
+/* Compare two entries of the heap to merge sorted runs.
+   `a' specifies the pointer to an entry.
+   `b' specifies the pointer to the other entry.
+   The return value is positive if the former should be output earlier.
+   Records of equal keys are output in order of runs, and exhausted runs come last. */
+static int vlsortentcmp(const void *a, const void *b){
+  const VLSORTENT *ea, *eb;
+  int rv;
+  assert(a && b);
+  ea = (VLSORTENT *)a;
+  eb = (VLSORTENT *)b;
+  if(!ea->rec) return eb->rec ? -1 : 0;
+  if(!eb->rec) return 1;
+  rv = vlsortcmp(ea->cmp, ea->rec, eb->rec);
+  if(rv == 0) rv = ea->src - eb->src;
+  return -rv;
+}
+
+
+/* Read the next record from a source of a merge.
+   `src' specifies a source.
+   `errp' specifies the pointer to a variable to which true is assigned on failure.
+   The return value is the pointer to the record, or `NULL' if the source is exhausted.
+   Records read from a file are kept in two buffers by turns, so that the previous record is
+   valid until the next record is read. */
+static const char *vlsortnext(VLSORTSRC *src, int *errp){
+  char head[sizeof(int)*2], *buf;
+  int ksiz, vsiz, rsiz;
+  assert(src && errp);
+  if(!src->ifp) return src->idx < src->num ? src->recs[src->idx++] : NULL;
+  if((rsiz = fread(head, 1, sizeof(head), src->ifp)) < 1) return NULL;
+  memcpy(&ksiz, head, sizeof(int));
+  memcpy(&vsiz, head + sizeof(int), sizeof(int));
+  if(rsiz != sizeof(head) || ksiz < 0 || vsiz < 0){
+    dpecodeset(DP_EREAD, __FILE__, __LINE__);
+    *errp = TRUE;
+    return NULL;
+  }
+  src->cur = !src->cur;
+  rsiz = sizeof(head) + ksiz + vsiz;
+  if(rsiz > src->bsizs[src->cur]){
+    src->bsizs[src->cur] = rsiz * 2;
+    CB_REALLOC(src->bufs[src->cur], src->bsizs[src->cur]);
+  }
+  buf = src->bufs[src->cur];
+  memcpy(buf, head, sizeof(head));
+  if(fread(buf + sizeof(head), 1, ksiz + vsiz, src->ifp) != (size_t)(ksiz + vsiz)){
+    dpecodeset(DP_EREAD, __FILE__, __LINE__);
+    *errp = TRUE;
+    return NULL;
+  }
+  return buf;
+}
+
+
+/* Merge sorted runs.
+   `sort' specifies a sorter.
+   `srcs' specifies an array of sources of sorted runs.
+   `num' specifies the number of the sources.
+   `ofp' specifies the stream of a file of a new run.  If it is `NULL', the records are stored
+   into the database by bulk loading.
+   The return value is true if successful, else, it is false. */
+static int vlsortmerge(VLSORT *sort, VLSORTSRC *srcs, int num, FILE *ofp){
+  CBHEAP *heap;
+  VLSORTENT ent;
+  const char *rec;
+  int i, err, alive, ksiz, vsiz, rsiz;
+  assert(sort && srcs && num >= 0);
+  heap = cbheapopen(sizeof(VLSORTENT), num > 0 ? num : 1, vlsortentcmp);
+  err = FALSE;
+  alive = 0;
+  for(i = 0; i < num; i++){
+    ent.cmp = sort->villa->cmp;
+    ent.rec = vlsortnext(srcs + i, &err);
+    ent.src = i;
+    if(ent.rec) alive++;
+    cbheapinsert(heap, &ent);
+  }
+  while(!err && alive > 0){
+    ent = *(VLSORTENT *)cbheapval(heap, 0);
+    rec = ent.rec;
+    memcpy(&ksiz, rec, sizeof(int));
+    memcpy(&vsiz, rec + sizeof(int), sizeof(int));
+    if(ofp){
+      rsiz = sizeof(int) * 2 + ksiz + vsiz;
+      if(fwrite(rec, 1, rsiz, ofp) != (size_t)rsiz){
+        dpecodeset(DP_EWRITE, __FILE__, __LINE__);
+        err = TRUE;
       }
+    } else {
+      rec += sizeof(int) * 2;
+      if(!vlbulkput(sort->villa, rec, ksiz, rec + ksiz, vsiz)) err = TRUE;
     }
-    if(i > 0) CB_LISTPUSH(lent.recs, (char *)&rec, sizeof(VLREC));
+    if(!(ent.rec = vlsortnext(srcs + ent.src, &err))) alive--;
+    cbheapinsert(heap, &ent);
   }
-  free(buf);
-  cbmapput(villa->leafc, (char *)&(lent.id), sizeof(int), (char *)&lent, sizeof(VLLEAF), TRUE);
-  return (VLLEAF *)cbmapget(villa->leafc, (char *)&(lent.id), sizeof(int), NULL);
+  cbheapclose(heap);
+  return err ? FALSE : TRUE;
 }
 
 
-/* Load the historical leaf from the database.
+/* Search the leaf corresponding to a key.
    `villa' specifies a database handle.
    `kbuf' specifies the pointer to the region of a key.
    `ksiz' specifies the size of the region of the key.
-   If successful, the return value is the pointer to the leaf, else, it is `NULL'. */
-static VLLEAF *vlgethistleaf(VILLA *villa, const char *kbuf, int ksiz){
-  VLLEAF *leaf;
-  VLREC *recp;
-  int ln, rv;
+   The return value is the ID number of the leaf, or -1 on failure. */
+static int vlsearchleaf(VILLA *villa, const char *kbuf, int ksiz){
+  int pid;
   assert(villa && kbuf && ksiz >= 0);
-  if(!(leaf = vlleafload(villa, villa->hleaf))) return NULL;
-  if((ln = CB_LISTNUM(leaf->recs)) < 2) return NULL;
-  recp = (VLREC *)CB_LISTVAL(leaf->recs, 0);
-  rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
-  if(rv == 0) return leaf;
-  if(rv < 0) return NULL;
-  recp = (VLREC *)CB_LISTVAL(leaf->recs, ln - 1);
-  rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
-  if(rv <= 0 || leaf->next < VL_LEAFIDMIN) return leaf;
-  return NULL;
+  villa->hleaf = -1;
+  if((pid = vlsearchpath(villa, kbuf, ksiz, villa->hist, &(villa->hnum))) == -1) return -1;
+  if(villa->lleaf == pid) villa->hleaf = pid;
+  villa->lleaf = pid;
+  return pid;
 }
 
 
-/* Add a record to a leaf.
+/* Search the path from the root to the leaf corresponding to a key.
    `villa' specifies a database handle.
-   `leaf' specifies a leaf handle.
-   `dmode' specifies behavior when the key overlaps.
    `kbuf' specifies the pointer to the region of a key.
    `ksiz' specifies the size of the region of the key.
-   `vbuf' specifies the pointer to the region of a value.
-   `vsiz' specifies the size of the region of the value.
-   The return value is true if successful, else, it is false. */
-static int vlleafaddrec(VILLA *villa, VLLEAF *leaf, int dmode,
-                        const char *kbuf, int ksiz, const char *vbuf, int vsiz){
-  VLREC *recp, rec;
-  CBLIST *recs;
-  int i, rv, left, right, ln, tsiz;
-  char *tbuf;
-  assert(villa && leaf && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
-  left = 0;
-  recs = leaf->recs;
-  ln = CB_LISTNUM(recs);
+   `hist' specifies the array to which the ID numbers of the visited nodes are assigned.
+   `hnp' specifies the pointer to a variable to which the number of the visited nodes is assigned.
+   The return value is the ID number of the leaf, or -1 on failure.
+   Each node is held while it is searched, so threads sharing the handle can search at once. */
+static int vlsearchpath(VILLA *villa, const char *kbuf, int ksiz, int *hist, int *hnp){
+  VLNODE *node;
+  int pid, pin;
+  assert(villa && kbuf && ksiz >= 0 && hist && hnp);
+  pid = VL_ATOMICGET(villa->root);
+  *hnp = 0;
+  while(pid >= VL_NODEIDMIN){
+    pin = villa->pinlevel != 0 && (villa->pinlevel < 0 || *hnp < villa->pinlevel);
+    if(!(node = vlnodecachein(villa, pid, TRUE, pin))){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      return -1;
+    }
+    hist[(*hnp)++] = pid;
+    pid = vlnoderoute(villa, node, kbuf, ksiz);
+    VL_PAGERELEASE(villa, node);
+    if(pid == -1) return -1;
+  }
+  return pid;
+}
+
+
+/* Get the child of a node to which a key is routed.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   The return value is the ID number of the child, or -1 if the node is broken. */
+static int vlnoderoute(VILLA *villa, VLNODE *node, const char *kbuf, int ksiz){
+  VLIDX *idxp;
+  int i, pid, rv, left, right, ln;
+  assert(villa && node && kbuf && ksiz >= 0);
+  if((ln = CB_LISTNUM(node->idxs)) < 1){
+    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+    return -1;
+  }
+  idxp = NULL;
+  pid = -1;
+  left = 1;
   right = ln;
   i = (left + right) / 2;
   while(right >= left && i < ln){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
+    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
     if(rv == 0){
       break;
     } else if(rv <= 0){
@@ -2218,391 +6831,429 @@ static int vlleafaddrec(VILLA *villa, VLLEAF *leaf, int dmode,
     }
     i = (left + right) / 2;
   }
+  if(i > 0) i--;
   while(i < ln){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key));
-    if(rv == 0){
-      switch(dmode){
-      case VL_DKEEP:
-        return FALSE;
-      case VL_DCAT:
-        CB_DATUMCAT(recp->first, vbuf, vsiz);
-        break;
-      case VL_DDUP:
-        if(!recp->rest) CB_LISTOPEN(recp->rest);
-        CB_LISTPUSH(recp->rest, vbuf, vsiz);
-        villa->rnum++;
-        break;
-      case VL_DDUPR:
-        if(!recp->rest){
-          CB_DATUMTOMALLOC(recp->first, tbuf, tsiz);
-          CB_DATUMOPEN2(recp->first, vbuf, vsiz);
-          CB_LISTOPEN(recp->rest);
-          CB_LISTPUSHBUF(recp->rest, tbuf, tsiz);
-        } else {
-          cblistunshift(recp->rest, CB_DATUMPTR(recp->first), CB_DATUMSIZE(recp->first));
-          CB_DATUMSETSIZE(recp->first, 0);
-          CB_DATUMCAT(recp->first, vbuf, vsiz);
-        }
-        villa->rnum++;
-        break;
-      default:
-        CB_DATUMSETSIZE(recp->first, 0);
-        CB_DATUMCAT(recp->first, vbuf, vsiz);
+    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
+    if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key)) < 0){
+      if(i == 0){
+        pid = node->heir;
         break;
       }
-      break;
-    } else if(rv < 0){
-      CB_DATUMOPEN2(rec.key, kbuf, ksiz);
-      CB_DATUMOPEN2(rec.first, vbuf, vsiz);
-      rec.rest = NULL;
-      CB_LISTINSERT(recs, i, (char *)&rec, sizeof(VLREC));
-      villa->rnum++;
+      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i - 1);
+      pid = idxp->pid;
       break;
     }
     i++;
   }
-  if(i >= ln){
-    CB_DATUMOPEN2(rec.key, kbuf, ksiz);
-    CB_DATUMOPEN2(rec.first, vbuf, vsiz);
-    rec.rest = NULL;
-    CB_LISTPUSH(recs, (char *)&rec, sizeof(VLREC));
-    villa->rnum++;
-  }
-  leaf->dirty = TRUE;
-  return TRUE;
-}
-
-
-/* Calculate the size of data of a leaf.
-   `leaf' specifies a leaf handle.
-   The return value is size of data of the leaf. */
-static int vlleafdatasize(VLLEAF *leaf){
-  VLREC *recp;
-  CBLIST *recs, *rest;
-  const char *vbuf;
-  int i, j, sum, rnum, restnum, vsiz;
-  assert(leaf);
-  sum = 0;
-  recs = leaf->recs;
-  rnum = CB_LISTNUM(recs);
-  for(i = 0; i < rnum; i++){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    sum += CB_DATUMSIZE(recp->key);
-    sum += CB_DATUMSIZE(recp->first);
-    if(recp->rest){
-      rest = recp->rest;
-      restnum = CB_LISTNUM(rest);
-      for(j = 0; j < restnum; j++){
-        vbuf = CB_LISTVAL2(rest, j, vsiz);
-        sum += vsiz;
-      }
-    }
-  }
-  return sum;
-}
-
-
-/* Divide a leaf into two.
-   `villa' specifies a database handle.
-   `leaf' specifies a leaf handle.
-   The return value is the handle of a new leaf, or `NULL' on failure. */
-static VLLEAF *vlleafdivide(VILLA *villa, VLLEAF *leaf){
-  VLLEAF *newleaf, *nextleaf;
-  VLREC *recp;
-  CBLIST *recs, *newrecs;
-  int i, mid, ln;
-  assert(villa && leaf);
-  villa->hleaf = -1;
-  recs = leaf->recs;
-  mid = CB_LISTNUM(recs) / 2;
-  recp = (VLREC *)CB_LISTVAL(recs, mid);
-  newleaf = vlleafnew(villa, leaf->id, leaf->next);
-  if(newleaf->next != -1){
-    if(!(nextleaf = vlleafload(villa, newleaf->next))) return NULL;
-    nextleaf->prev = newleaf->id;
-    nextleaf->dirty = TRUE;
-  }
-  leaf->next = newleaf->id;
-  leaf->dirty = TRUE;
-  ln = CB_LISTNUM(recs);
-  newrecs = newleaf->recs;
-  for(i = mid; i < ln; i++){
-    recp = (VLREC *)CB_LISTVAL(recs, i);
-    CB_LISTPUSH(newrecs, (char *)recp, sizeof(VLREC));
-  }
-  ln = CB_LISTNUM(newrecs);
-  for(i = 0; i < ln; i++){
-    CB_LISTDROP(recs);
-  }
-  return newleaf;
-}
-
-
-/* Create a new node.
-   `villa' specifies a database handle.
-   `heir' specifies the ID of the child before the first index.
-   The return value is a handle of the node. */
-static VLNODE *vlnodenew(VILLA *villa, int heir){
-  VLNODE nent;
-  assert(villa && heir >= VL_LEAFIDMIN);
-  nent.id = villa->nnum + VL_NODEIDMIN;
-  nent.dirty = TRUE;
-  nent.heir = heir;
-  CB_LISTOPEN(nent.idxs);
-  villa->nnum++;
-  cbmapput(villa->nodec, (char *)&(nent.id), sizeof(int), (char *)&nent, sizeof(VLNODE), TRUE);
-  return (VLNODE *)cbmapget(villa->nodec, (char *)&(nent.id), sizeof(int), NULL);
+  if(i >= ln) pid = idxp->pid;
+  return pid;
 }
 
 
-/* Remove a node from the cache.
+/* Adjust the caches for leaves and nodes.
    `villa' specifies a database handle.
-   `id' specifies the ID number of the node.
    The return value is true if successful, else, it is false. */
-static int vlnodecacheout(VILLA *villa, int id){
-  VLNODE *node;
-  VLIDX *idxp;
-  int i, err, ln;
-  assert(villa && id >= VL_NODEIDMIN);
-  if(!(node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL))) return FALSE;
-  err = FALSE;
-  if(node->dirty && !vlnodesave(villa, node)) err = TRUE;
-  ln = CB_LISTNUM(node->idxs);
-  for(i = 0; i < ln; i++){
-    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-    CB_DATUMCLOSE(idxp->key);
-  }
-  CB_LISTCLOSE(node->idxs);
-  cbmapout(villa->nodec, (char *)&id, sizeof(int));
-  return err ? FALSE : TRUE;
+static int vlcacheadjust(VILLA *villa){
+  assert(villa);
+  return vlcachetrim(villa, FALSE);
 }
 
 
-/* Save a node into the database.
+/* Sweep pages out of the caches for leaves and nodes until they are within the limits.
    `villa' specifies a database handle.
-   `node' specifies a node handle.
-   The return value is true if successful, else, it is false. */
-static int vlnodesave(VILLA *villa, VLNODE *node){
-  CBDATUM *buf;
-  char vnumbuf[VL_VNUMBUFSIZ];
-  VLIDX *idxp;
-  int i, heir, pid, ksiz, vnumsiz, ln;
-  assert(villa && node);
-  CB_DATUMOPEN(buf);
-  heir = node->heir;
-  VL_SETVNUMBUF(vnumsiz, vnumbuf, heir);
-  CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-  ln = CB_LISTNUM(node->idxs);
-  for(i = 0; i < ln; i++){
-    idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-    pid = idxp->pid;
-    VL_SETVNUMBUF(vnumsiz, vnumbuf, pid);
-    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-    ksiz = CB_DATUMSIZE(idxp->key);
-    VL_SETVNUMBUF(vnumsiz, vnumbuf, ksiz);
-    CB_DATUMCAT(buf, vnumbuf, vnumsiz);
-    CB_DATUMCAT(buf, CB_DATUMPTR(idxp->key), ksiz);
-  }
-  if(!dpput(villa->depot, (char *)&(node->id), sizeof(int),
-            CB_DATUMPTR(buf), CB_DATUMSIZE(buf), DP_DOVER)){
-    CB_DATUMCLOSE(buf);
-    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-    return FALSE;
+   The return value is true if successful, else, it is false.
+   This is called at the end of a transaction, during which the caches may grow without limit.
+   Pinned nodes are not counted, and it stops when no more page can be swept out. */
+static int vlcacheshrink(VILLA *villa){
+  int lnum, nnum;
+  assert(villa);
+  while(cbmaprnum(villa->leafc) > villa->leafcnum ||
+        cbmaprnum(villa->nodec) - villa->pinnum > villa->nodecnum){
+    lnum = cbmaprnum(villa->leafc);
+    nnum = cbmaprnum(villa->nodec);
+    if(!vlcacheadjust(villa)) return FALSE;
+    if(cbmaprnum(villa->leafc) >= lnum && cbmaprnum(villa->nodec) >= nnum) break;
   }
-  CB_DATUMCLOSE(buf);
-  node->dirty = FALSE;
   return TRUE;
 }
 
 
-/* Load a node from the database.
+/* Sweep pages out of the caches for leaves and nodes if they exceed the limits.
    `villa' specifies a database handle.
-   `id' specifies the ID number of the node.
-   If successful, the return value is the pointer to the node, else, it is `NULL'. */
-static VLNODE *vlnodeload(VILLA *villa, int id){
-  char wbuf[VL_PAGEBUFSIZ], *buf, *rp, *kbuf;
-  int size, step, heir, pid, ksiz;
-  VLNODE *node, nent;
-  VLIDX idx;
-  assert(villa && id >= VL_NODEIDMIN);
-  if((node = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL)) != NULL){
-    cbmapmove(villa->nodec, (char *)&id, sizeof(int), FALSE);
-    return node;
-  }
-  heir = -1;
-  if((size = dpgetwb(villa->depot, (char *)&id, sizeof(int), 0, VL_PAGEBUFSIZ, wbuf)) > 0 &&
-     size < VL_PAGEBUFSIZ){
-    buf = NULL;
-  } else if(!(buf = dpget(villa->depot, (char *)&id, sizeof(int), 0, -1, &size))){
-    dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-    return NULL;
-  }
-  rp = buf ? buf : wbuf;
-  if(size >= 1){
-    VL_READVNUMBUF(rp, size, heir, step);
-    rp += step;
-    size -= step;
-  }
-  if(heir < 0){
-    free(buf);
-    return NULL;
+   `clean' specifies whether only pages which are not dirty are swept out.
+   The return value is true if successful, else, it is false.
+   With the write ahead log, dirty pages are never swept out one by one.  A checkpoint is
+   performed instead when the log exceeds its limit or when only dirty pages are left to be
+   swept out, unless the log is being replayed.  The images of dirty pages are taken while the
+   caches are locked, and they are written after the caches are unlocked.  The internal
+   database is latched exclusively and the count of pages written back is incremented before
+   the caches are unlocked, so that a thread missing such a page waits for the image to be
+   written and a thread which has read an older image reads it again.  A cache over the number
+   of pages loses several pages at once, but one over the size of memory loses only as many as
+   needed to fit, so that leaves read ahead and not reached yet stay in a small cache. */
+static int vlcachetrim(VILLA *villa, int clean){
+  CBDATUM *imgs;
+  int i, pid, err, ckpt, full, out;
+  assert(villa);
+  err = FALSE;
+  ckpt = FALSE;
+  if(villa->walfd != -1 && !clean){
+    clean = TRUE;
+    ckpt = !villa->replay && !villa->tran && !villa->bulk;
+    if(ckpt && villa->walsiz >= villa->walmax){
+      if(!vlwalcheckpoint(villa)) err = TRUE;
+      ckpt = FALSE;
+    }
   }
-  nent.id = id;
-  nent.dirty = FALSE;
-  nent.heir = heir;
-  CB_LISTOPEN(nent.idxs);
-  while(size >= 1){
-    VL_READVNUMBUF(rp, size, pid, step);
-    rp += step;
-    size -= step;
-    if(size < 1) break;
-    VL_READVNUMBUF(rp, size, ksiz, step);
-    rp += step;
-    size -= step;
-    if(size < ksiz) break;
-    kbuf = rp;
-    rp += ksiz;
-    size -= ksiz;
-    idx.pid = pid;
-    CB_DATUMOPEN2(idx.key, kbuf, ksiz);
-    CB_LISTPUSH(nent.idxs, (char *)&idx, sizeof(VLIDX));
+  vlaiobegin(villa);
+  CB_DATUMOPEN(imgs);
+  while(TRUE){
+    VL_CACHELOCK(villa);
+    full = FALSE;
+    if(cbmaprnum(villa->leafc) > villa->leafcnum ||
+       VL_CACHEOVER(villa->leafcsiz, villa->leafcmax)){
+      out = cbmaprnum(villa->leafc) > villa->leafcnum ? VL_CACHEOUT : 0;
+      for(i = 0; cbmaprnum(villa->leafc) > 1 &&
+            (i < out || VL_CACHEOVER(villa->leafcsiz, villa->leafcmax)); i++){
+        if((pid = vlcachevictim(villa, FALSE, clean)) == -1){
+          full = TRUE;
+          break;
+        }
+        if(!vlcachetake(villa, FALSE, pid, imgs)) err = TRUE;
+      }
+    }
+    if(cbmaprnum(villa->nodec) - villa->pinnum > villa->nodecnum ||
+       VL_CACHEOVER(villa->nodecsiz, villa->nodecmax)){
+      out = cbmaprnum(villa->nodec) - villa->pinnum > villa->nodecnum ? VL_CACHEOUT : 0;
+      for(i = 0; cbmaprnum(villa->nodec) - villa->pinnum > 1 &&
+            (i < out || VL_CACHEOVER(villa->nodecsiz, villa->nodecmax)); i++){
+        if((pid = vlcachevictim(villa, TRUE, clean)) == -1){
+          full = TRUE;
+          break;
+        }
+        if(!vlcachetake(villa, TRUE, pid, imgs)) err = TRUE;
+      }
+    }
+    if(CB_DATUMSIZE(imgs) > 0){
+      VL_DEPOTLOCK(villa, TRUE);
+      VL_ATOMICINC(villa->saves);
+    }
+    VL_CACHEUNLOCK(villa);
+    if(CB_DATUMSIZE(imgs) > 0){
+      if(!vlcachewrite(villa, imgs)) err = TRUE;
+      VL_DEPOTUNLOCK(villa);
+      cbdatumsetsize(imgs, 0);
+    }
+    if(!full || !ckpt || err ||
+       (villa->walsiz < 1 && CB_DATUMSIZE(villa->walops) <= VL_WALHEAD)) break;
+    if(!vlwalcheckpoint(villa)) err = TRUE;
+    ckpt = FALSE;
   }
-  free(buf);
-  cbmapput(villa->nodec, (char *)&(nent.id), sizeof(int), (char *)&nent, sizeof(VLNODE), TRUE);
-  return (VLNODE *)cbmapget(villa->nodec, (char *)&(nent.id), sizeof(int), NULL);
+  CB_DATUMCLOSE(imgs);
+  if(!vlaioend(villa)) err = TRUE;
+  return err ? FALSE : TRUE;
 }
 
 
-/* Add an index to a node.
-   `villa' specifies a database handle.
-   `node' specifies a node handle.
-   `order' specifies whether the calling sequence is orderd or not.
-   `pid' specifies the ID number of referred page.
-   `kbuf' specifies the pointer to the region of a key.
-   `ksiz' specifies the size of the region of the key. */
-static void vlnodeaddidx(VILLA *villa, VLNODE *node, int order,
-                         int pid, const char *kbuf, int ksiz){
-  VLIDX idx, *idxp;
-  int i, rv, left, right, ln;
-  assert(villa && node && pid >= VL_LEAFIDMIN && kbuf && ksiz >= 0);
-  idx.pid = pid;
-  CB_DATUMOPEN2(idx.key, kbuf, ksiz);
-  if(order){
-    CB_LISTPUSH(node->idxs, (char *)&idx, sizeof(VLIDX));
+/* Take a page selected to be swept out of a cache.
+   `villa' specifies a database handle whose caches are locked.
+   `node' specifies whether the page is a node.
+   `id' specifies the ID number of the page.
+   `imgs' specifies a datum handle to which the image of the page is appended if it is dirty.
+   The return value is true if successful, else, it is false.
+   The page is marked clean so that it is swept out without being written. */
+static int vlcachetake(VILLA *villa, int node, int id, CBDATUM *imgs){
+  VLLEAF *leaf;
+  VLNODE *pnode;
+  char *ibuf;
+  int err, isiz;
+  assert(villa && id > 0 && imgs);
+  err = FALSE;
+  ibuf = NULL;
+  if(node){
+    if(!(pnode = (VLNODE *)cbmapget(villa->nodec, (char *)&id, sizeof(int), NULL))) return FALSE;
+    if(pnode->dirty){
+      ibuf = vlnodeencode(villa, pnode, &isiz);
+      VL_ATOMICSET(pnode->dirty, FALSE);
+    }
   } else {
-    left = 0;
-    right = CB_LISTNUM(node->idxs);
-    i = (left + right) / 2;
-    ln = CB_LISTNUM(node->idxs);
-    while(right >= left && i < ln){
-      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-      rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
-      if(rv == 0){
-        break;
-      } else if(rv <= 0){
-        right = i - 1;
-      } else {
-        left = i + 1;
-      }
-      i = (left + right) / 2;
+    if(!(leaf = (VLLEAF *)cbmapget(villa->leafc, (char *)&id, sizeof(int), NULL))) return FALSE;
+    if(leaf->dirty){
+      if(!(ibuf = vlleafencode(villa, leaf, &isiz))) err = TRUE;
+      VL_ATOMICSET(leaf->dirty, FALSE);
     }
-    ln = CB_LISTNUM(node->idxs);
-    while(i < ln){
-      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-      if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key)) < 0){
-        CB_LISTINSERT(node->idxs, i, (char *)&idx, sizeof(VLIDX));
-        break;
-      }
-      i++;
+  }
+  if(ibuf){
+    CB_DATUMCAT(imgs, (char *)&id, sizeof(int));
+    CB_DATUMCAT(imgs, (char *)&isiz, sizeof(int));
+    CB_DATUMCAT(imgs, ibuf, isiz);
+    free(ibuf);
+  }
+  if(!(node ? vlnodecacheout(villa, id) : vlleafcacheout(villa, id))) err = TRUE;
+  return err ? FALSE : TRUE;
+}
+
+
+/* Write the images of pages taken out of the caches into the database.
+   `villa' specifies a database handle connected as a writer, whose internal database is
+   latched exclusively.
+   `imgs' specifies a datum handle of the images appended by `vlcachetake'.
+   The return value is true if successful, else, it is false. */
+static int vlcachewrite(VILLA *villa, CBDATUM *imgs){
+  const char *rp;
+  int err, size, id, isiz;
+  assert(villa && imgs);
+  err = FALSE;
+  rp = CB_DATUMPTR(imgs);
+  size = CB_DATUMSIZE(imgs);
+  while(size >= sizeof(int) * 2){
+    memcpy(&id, rp, sizeof(int));
+    memcpy(&isiz, rp + sizeof(int), sizeof(int));
+    rp += sizeof(int) * 2;
+    if(!vlsnapkeep(villa, id) ||
+       !dpput(villa->depot, (char *)&id, sizeof(int), rp, isiz, DP_DOVER)){
+      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
+      err = TRUE;
+    } else if(villa->ptab){
+      vlptabupdate(villa, id, TRUE);
     }
-    if(i >= CB_LISTNUM(node->idxs)) CB_LISTPUSH(node->idxs, (char *)&idx, sizeof(VLIDX));
+    rp += isiz;
+    size -= sizeof(int) * 2 + isiz;
   }
-  node->dirty = TRUE;
+  return err ? FALSE : TRUE;
 }
 
 
-/* Search the leaf corresponding to a key.
+/* Get the initial state of a page loaded into a cache.
    `villa' specifies a database handle.
-   `kbuf' specifies the pointer to the region of a key.
-   `ksiz' specifies the size of the region of the key.
-   The return value is the ID number of the leaf, or -1 on failure. */
-static int vlsearchleaf(VILLA *villa, const char *kbuf, int ksiz){
-  VLNODE *node;
-  VLIDX *idxp;
-  int i, pid, rv, left, right, ln;
-  assert(villa && kbuf && ksiz >= 0);
-  pid = villa->root;
-  idxp = NULL;
-  villa->hnum = 0;
-  villa->hleaf = -1;
-  while(pid >= VL_NODEIDMIN){
-    if(!(node = vlnodeload(villa, pid)) || (ln = CB_LISTNUM(node->idxs)) < 1){
-      dpecodeset(DP_EBROKEN, __FILE__, __LINE__);
-      return -1;
+   `node' specifies whether the page is a node.
+   `id' specifies the ID number of the page.
+   `seq' specifies whether the page is read by a cursor.
+   The return value is the state of the page. */
+static int vlcacheheat(VILLA *villa, int node, int id, int seq){
+  CBMAP *ghost;
+  assert(villa && id > 0);
+  if((node ? villa->nodecpol : villa->leafcpol) != VL_CR2Q) return VL_HCOLD;
+  if(seq) return VL_HSCAN;
+  ghost = node ? villa->nodeghost : villa->leafghost;
+  if(!cbmapout(ghost, (char *)&id, sizeof(int))) return VL_HCOLD;
+  if(node){
+    villa->nodechot++;
+  } else {
+    villa->leafchot++;
+  }
+  return VL_HHOT;
+}
+
+
+/* Update the state of a page found in a cache.
+   `villa' specifies a database handle whose caches are locked.
+   `node' specifies whether the page is a node.
+   `id' specifies the ID number of the page.
+   `heatp' specifies the pointer to the variable of the state of the page.
+   `seq' specifies whether the page is read by a cursor.
+   Under the 2Q policy, a page on probation is protected when it is read by a lookup for the
+   second time, where reading by cursors does not count, and only protected pages are moved to
+   the end of the cache.  Reading by cursors moves no page under the 2Q policy. */
+static void vlcachehit(VILLA *villa, int node, int id, int *heatp, int seq){
+  CBMAP *cache;
+  assert(villa && id > 0 && heatp);
+  cache = node ? villa->nodec : villa->leafc;
+  if((node ? villa->nodecpol : villa->leafcpol) != VL_CR2Q){
+    cbmapmove(cache, (char *)&id, sizeof(int), FALSE);
+    return;
+  }
+  if(seq) return;
+  if(*heatp == VL_HSCAN){
+    *heatp = VL_HCOLD;
+    return;
+  }
+  if(*heatp == VL_HCOLD){
+    *heatp = VL_HHOT;
+    if(node){
+      villa->nodechot++;
+    } else {
+      villa->leafchot++;
     }
-    villa->hist[villa->hnum++] = node->id;
-    left = 1;
-    right = ln;
-    i = (left + right) / 2;
-    while(right >= left && i < ln){
-      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-      rv = villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key));
-      if(rv == 0){
-        break;
-      } else if(rv <= 0){
-        right = i - 1;
+  }
+  cbmapmove(cache, (char *)&id, sizeof(int), FALSE);
+}
+
+
+/* Select a page to be swept out of a cache.
+   `villa' specifies a database handle.
+   `node' specifies whether the cache is for nodes.
+   `clean' specifies whether dirty pages are not selectable.
+   The return value is the ID number of the page, or -1 if no page is selectable.
+   Pages held by threads sharing the handle are not selectable, and whether a page is dirty is
+   read atomically as the writer may be updating it.  Under the 2Q policy, pages read only by
+   cursors are always selectable first, other pages on probation are selected before protected
+   pages unless the probation queue is short, and the IDs of evicted pages read by point lookups
+   are remembered so that a page read again soon after is protected. */
+static int vlcachevictim(VILLA *villa, int node, int clean){
+  CBMAP *cache, *ghost;
+  const char *kbuf, *vbuf, *gbuf;
+  int i, rnum, hot, gmax, want, heat;
+  assert(villa);
+  cache = node ? villa->nodec : villa->leafc;
+  if((node ? villa->nodecpol : villa->leafcpol) != VL_CR2Q){
+    cbmapiterinit(cache);
+    while((kbuf = cbmapiternext(cache, NULL)) != NULL){
+      vbuf = cbmapget(cache, kbuf, sizeof(int), NULL);
+      if(node){
+        if(((VLNODE *)vbuf)->pin || VL_PAGEBUSY(villa, (VLNODE *)vbuf)) continue;
+        if(clean && VL_ATOMICGET(((VLNODE *)vbuf)->dirty)) continue;
       } else {
-        left = i + 1;
+        if(VL_PAGEBUSY(villa, (VLLEAF *)vbuf)) continue;
+        if(clean && VL_ATOMICGET(((VLLEAF *)vbuf)->dirty)) continue;
       }
-      i = (left + right) / 2;
+      return *(int *)kbuf;
     }
-    if(i > 0) i--;
-    while(i < ln){
-      idxp = (VLIDX *)CB_LISTVAL(node->idxs, i);
-      if(villa->cmp(kbuf, ksiz, CB_DATUMPTR(idxp->key), CB_DATUMSIZE(idxp->key)) < 0){
-        if(i == 0){
-          pid = node->heir;
-          break;
+    return -1;
+  }
+  ghost = node ? villa->nodeghost : villa->leafghost;
+  rnum = cbmaprnum(cache);
+  hot = node ? villa->nodechot : villa->leafchot;
+  gmax = node ? villa->nodecnum : villa->leafcnum;
+  want = hot > 0 && rnum - hot <= (rnum / 4 > 1 ? rnum / 4 : 1);
+  for(i = 0; i < 2; i++){
+    cbmapiterinit(cache);
+    while((kbuf = cbmapiternext(cache, NULL)) != NULL){
+      if(!node && *(int *)kbuf == villa->lleaf) continue;
+      vbuf = cbmapget(cache, kbuf, sizeof(int), NULL);
+      if(node && (((VLNODE *)vbuf)->pin || VL_PAGEBUSY(villa, (VLNODE *)vbuf))) continue;
+      if(!node && VL_PAGEBUSY(villa, (VLLEAF *)vbuf)) continue;
+      if(clean && (node ? VL_ATOMICGET(((VLNODE *)vbuf)->dirty) :
+                   VL_ATOMICGET(((VLLEAF *)vbuf)->dirty))) continue;
+      heat = node ? ((VLNODE *)vbuf)->heat : ((VLLEAF *)vbuf)->heat;
+      if(i < 1 && heat != VL_HSCAN && (heat == VL_HHOT) != want) continue;
+      if(heat == VL_HCOLD){
+        cbmapput(ghost, kbuf, sizeof(int), "", 0, TRUE);
+        if(cbmaprnum(ghost) > gmax){
+          cbmapiterinit(ghost);
+          gbuf = cbmapiternext(ghost, NULL);
+          cbmapout(ghost, gbuf, sizeof(int));
         }
-        idxp = (VLIDX *)CB_LISTVAL(node->idxs, i - 1);
-        pid = idxp->pid;
-        break;
       }
-      i++;
+      return *(int *)kbuf;
     }
-    if(i >= ln) pid = idxp->pid;
   }
-  if(villa->lleaf == pid) villa->hleaf = pid;
-  villa->lleaf = pid;
-  return pid;
+  return -1;
 }
 
 
-/* Adjust the caches for leaves and nodes.
+/* Move a multiple cursor to a leaf which is not empty.
+   `mulcur' specifies a multiple cursor handle.
+   `id' specifies the ID number of the leaf to start with.
+   `back' specifies whether empty leaves are skipped backward.
+   If successful, the return value is the pointer to the leaf, else, it is `NULL'.
+   If the database handle is shared by threads, the leaf is held by the cursor until it moves to
+   another leaf. */
+static VLLEAF *vlmulcurseek(VLMULCUR *mulcur, int id, int back){
+  VILLA *villa;
+  VLLEAF *leaf;
+  assert(mulcur);
+  villa = mulcur->villa;
+  while(id != -1){
+    if(mulcur->leaf && mulcur->leaf->id == id){
+      leaf = mulcur->leaf;
+    } else {
+      if(!(leaf = vlleafcachein(villa, id, TRUE, TRUE))){
+        vlmulcurrelease(mulcur);
+        return NULL;
+      }
+      if(mulcur->leaf) VL_PAGERELEASE(villa, mulcur->leaf);
+      mulcur->leaf = villa->mutex ? leaf : NULL;
+    }
+    mulcur->curleaf = id;
+    if(CB_LISTNUM(leaf->recs) > 0) return leaf;
+    id = back ? leaf->prev : leaf->next;
+  }
+  vlmulcurrelease(mulcur);
+  dpecodeset(DP_ENOITEM, __FILE__, __LINE__);
+  return NULL;
+}
+
+
+/* Release the leaf held by a multiple cursor and invalidate the cursor.
+   `mulcur' specifies a multiple cursor handle. */
+static void vlmulcurrelease(VLMULCUR *mulcur){
+  assert(mulcur);
+  if(mulcur->leaf){
+    VL_PAGERELEASE(mulcur->villa, mulcur->leaf);
+    mulcur->leaf = NULL;
+  }
+  mulcur->curleaf = -1;
+}
+
+
+/* Read ahead the leaves following one where a cursor moves forward.
    `villa' specifies a database handle.
-   The return value is true if successful, else, it is false. */
-static int vlcacheadjust(VILLA *villa){
-  const char *tmp;
-  int i, pid, err;
-  err = FALSE;
-  if(cbmaprnum(villa->leafc) > villa->leafcnum){
-    cbmapiterinit(villa->leafc);
-    for(i = 0; i < VL_CACHEOUT; i++){
-      tmp = cbmapiternext(villa->leafc, NULL);
-      pid = *(int *)tmp;
-      if(!vlleafcacheout(villa, pid)) err = TRUE;
+   `leaf' specifies the leaf which is not empty where the cursor has moved.
+   `winp' specifies the pointer to the variable of the window of the cursor.
+   `leftp' specifies the pointer to the variable of the number of leaves advised ahead.
+   When the cursor has consumed half of the window, the window is doubled up to the limit and
+   the leaves following the advised ones in the parent node of the leaf are advised so that the
+   cursor has the whole window ahead.  The window is cut at the end of the parent node, whose
+   leaves are advised after the cursor moves into it.  If the engine of asynchronous I/O does
+   not block and the file is not mapped, the whole window is staged into the cache instead of being
+   advised, so that the leaves loaded before and not reached yet are not swept out first, and
+   the window is limited to a half of the cache, counted in leaves of the size of the arena of
+   the leaf if the memory of the cache is limited. */
+static void vlreadahead(VILLA *villa, VLLEAF *leaf, int *winp, int *leftp){
+  VLNODE *node;
+  VLREC *recp;
+  VLCHUNK *chunk;
+  int hist[VL_LEVELMAX];
+  int i, hnum, ci, ln, pid, dksiz, hit, stage, max, asiz, inum, *ids;
+  int dkey[2];
+  assert(villa && leaf && winp && leftp);
+  if(*leftp > 0) (*leftp)--;
+  stage = dpaioengine(villa->depot) > DP_AIOSYNC && !villa->depot->mapall;
+  max = villa->ramax;
+  if(stage && max > villa->leafcnum / 2) max = villa->leafcnum / 2;
+  if(stage && villa->leafcmax > 0){
+    asiz = 0;
+    for(chunk = leaf->arena; chunk; chunk = chunk->next){
+      asiz += sizeof(VLCHUNK) + chunk->size;
     }
+    if(asiz > 0 && max > villa->leafcmax / 2 / asiz) max = villa->leafcmax / 2 / asiz;
   }
-  if(cbmaprnum(villa->nodec) > villa->nodecnum){
-    cbmapiterinit(villa->nodec);
-    for(i = 0; i < VL_CACHEOUT; i++){
-      tmp = cbmapiternext(villa->nodec, NULL);
-      pid = *(int *)tmp;
-      if(!vlnodecacheout(villa, pid)) err = TRUE;
+  if(max < 1 || CB_LISTNUM(leaf->recs) < 1 || *leftp > *winp / 2) return;
+  *winp = *winp < VL_RAWINMIN ? VL_RAWINMIN : *winp * 2;
+  if(*winp > max) *winp = max;
+  recp = (VLREC *)CB_LISTVAL(leaf->recs, 0);
+  if(vlsearchpath(villa, CB_DATUMPTR(recp->key), CB_DATUMSIZE(recp->key), hist, &hnum) !=
+     leaf->id || hnum < 1 || !(node = vlnodecachein(villa, hist[hnum-1], TRUE, FALSE))) return;
+  ids = NULL;
+  if(stage){
+    CB_MALLOC(ids, *winp * sizeof(int));
+    *leftp = 0;
+  }
+  inum = 0;
+  ln = CB_LISTNUM(node->idxs);
+  if((ci = vlnodechild(node, leaf->id)) < -1) ci = ln;
+  for(i = ci + 1 + *leftp; i < ln && *leftp < *winp; i++){
+    pid = ((VLIDX *)CB_LISTVAL(node->idxs, i))->pid;
+    (*leftp)++;
+    if(ids){
+      ids[inum++] = pid;
+      continue;
     }
+    VL_CACHELOCK(villa);
+    hit = cbmapget(villa->leafc, (char *)&pid, sizeof(int), NULL) != NULL;
+    VL_CACHEUNLOCK(villa);
+    if(hit) continue;
+    vldepotlatch(villa);
+    dksiz = vlsnapkey(villa, pid, dkey);
+    dpprefetch(villa->depot, (char *)dkey, dksiz, VL_PAGEBUFSIZ);
+    VL_DEPOTUNLOCK(villa);
+  }
+  VL_PAGERELEASE(villa, node);
+  if(ids){
+    vlleafstage(villa, ids, inum, TRUE);
+    free(ids);
   }
-  return err ? FALSE : TRUE;
 }
 
 
@@ -2641,6 +7292,481 @@ static VLREC *vlrecsearch(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz
 }
 
 
+/* Create a record in the arena of a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies a leaf handle.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.
+   `copy' specifies whether to copy the regions into the arena.  If it is false, the regions
+   should be in the arena already and each of them should be followed by a zero code.
+   The return value is the pointer to the record, which is not added to the leaf yet. */
+static VLREC *vlrecnew(VILLA *villa, VLLEAF *leaf, const char *kbuf, int ksiz,
+                       const char *vbuf, int vsiz, int copy){
+  VLREC *recp;
+  char *ptr;
+  int size;
+  assert(villa && leaf && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  size = sizeof(VLREC) + sizeof(CBDATUM) * 2;
+  if(copy) size += ksiz + vsiz + 2;
+  ptr = vlarenaalloc(villa, &(leaf->arena), size, &(villa->leafcsiz));
+  recp = (VLREC *)ptr;
+  recp->key = (CBDATUM *)(ptr + sizeof(VLREC));
+  recp->first = recp->key + 1;
+  recp->rest = NULL;
+  if(copy){
+    ptr += sizeof(VLREC) + sizeof(CBDATUM) * 2;
+    memcpy(ptr, kbuf, ksiz);
+    ptr[ksiz] = '\0';
+    kbuf = ptr;
+    ptr += ksiz + 1;
+    memcpy(ptr, vbuf, vsiz);
+    ptr[vsiz] = '\0';
+    vbuf = ptr;
+  }
+  VL_SETSLICE(recp->key, (char *)kbuf, ksiz);
+  VL_SETSLICE(recp->first, (char *)vbuf, vsiz);
+  return recp;
+}
+
+
+/* Set the first value of a record in a leaf.
+   `villa' specifies a database handle.
+   `leaf' specifies the leaf handle containing the record.
+   `recp' specifies the pointer to the record.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.
+   `cat' specifies whether to concatenate the value at the end of the existing one. */
+static void vlrecsetfirst(VILLA *villa, VLLEAF *leaf, VLREC *recp,
+                          const char *vbuf, int vsiz, int cat){
+  VLCHUNK *chunk;
+  CBDATUM *datum;
+  char *ptr;
+  int osiz, grow;
+  assert(villa && leaf && recp && vbuf && vsiz >= 0);
+  datum = recp->first;
+  osiz = CB_DATUMSIZE(datum);
+  chunk = leaf->arena;
+  if(cat && chunk && datum->dptr == (char *)(datum + 1) &&
+     (char *)datum + VL_ARENAPAD(sizeof(CBDATUM) + osiz + 1) == VL_CHUNKTOP(chunk)){
+    grow = VL_ARENAPAD(sizeof(CBDATUM) + osiz + vsiz + 1) -
+      VL_ARENAPAD(sizeof(CBDATUM) + osiz + 1);
+    if(grow <= chunk->size - chunk->used){
+      chunk->used += grow;
+      memcpy(datum->dptr + osiz, vbuf, vsiz);
+      datum->dsize += vsiz;
+      datum->dptr[datum->dsize] = '\0';
+      return;
+    }
+  }
+  if(!cat) osiz = 0;
+  ptr = vlarenaalloc(villa, &(leaf->arena), sizeof(CBDATUM) + osiz + vsiz + 1,
+                     &(villa->leafcsiz));
+  datum = (CBDATUM *)ptr;
+  ptr += sizeof(CBDATUM);
+  memcpy(ptr, CB_DATUMPTR(recp->first), osiz);
+  memcpy(ptr + osiz, vbuf, vsiz);
+  ptr[osiz+vsiz] = '\0';
+  VL_SETSLICE(datum, ptr, osiz + vsiz);
+  leaf->waste += sizeof(CBDATUM) + CB_DATUMSIZE(recp->first);
+  recp->first = datum;
+}
+
+
+/* Create an index in the arena of a node.
+   `villa' specifies a database handle.
+   `node' specifies a node handle.
+   `pid' specifies the ID number of referred page.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.
+   `copy' specifies whether to copy the region into the arena.  If it is false, the region
+   should be in the arena already and it should be followed by a zero code.
+   The return value is the pointer to the index, which is not added to the node yet. */
+static VLIDX *vlidxnew(VILLA *villa, VLNODE *node, int pid, const char *kbuf, int ksiz, int copy){
+  VLIDX *idxp;
+  char *ptr;
+  int size;
+  assert(villa && node && kbuf && ksiz >= 0);
+  size = sizeof(VLIDX) + sizeof(CBDATUM);
+  if(copy) size += ksiz + 1;
+  VL_CACHELOCK(villa);
+  ptr = vlarenaalloc(villa, &(node->arena), size, VL_NODESUMP(villa, node));
+  VL_CACHEUNLOCK(villa);
+  idxp = (VLIDX *)ptr;
+  idxp->pid = pid;
+  idxp->key = (CBDATUM *)(ptr + sizeof(VLIDX));
+  if(copy){
+    ptr += sizeof(VLIDX) + sizeof(CBDATUM);
+    memcpy(ptr, kbuf, ksiz);
+    ptr[ksiz] = '\0';
+    kbuf = ptr;
+  }
+  VL_SETSLICE(idxp->key, (char *)kbuf, ksiz);
+  return idxp;
+}
+
+
+/* Get the size class of chunks which can contain a region.
+   `size' specifies the size of the region.
+   The return value is the index of the size class, or `VL_CHUNKCLASS' if no class fits. */
+static int vlchunkclass(int size){
+  int i;
+  for(i = 0; i < VL_CHUNKCLASS && (VL_CHUNKMIN << i) < size; i++);
+  return i;
+}
+
+
+/* Allocate a region in an arena.
+   `villa' specifies a database handle.
+   `arenap' specifies the pointer to the variable of the first chunk of the arena.
+   `size' specifies the size of the region.
+   `sump' specifies the pointer to the variable accounting the size of the cache.
+   The return value is the pointer to the region, which is aligned for pointers.
+   Chunks are taken from the pool of the handle if possible.  Regions are not released
+   individually but altogether when the arena is closed.  The pool and the accounts are shared
+   by threads and they are modified while the caches are locked. */
+static char *vlarenaalloc(VILLA *villa, VLCHUNK **arenap, int size, int *sump){
+  VLCHUNK *chunk;
+  char *ptr;
+  int ci, csiz;
+  assert(villa && arenap && size >= 0 && sump);
+  size = VL_ARENAPAD(size);
+  chunk = *arenap;
+  if(!chunk || chunk->size - chunk->used < size){
+    csiz = chunk ? chunk->size * 2 : VL_CHUNKMIN;
+    if(csiz > (VL_CHUNKMIN << (VL_CHUNKCLASS - 1))) csiz = VL_CHUNKMIN << (VL_CHUNKCLASS - 1);
+    if(csiz < size) csiz = size;
+    ci = vlchunkclass(csiz);
+    VL_CACHELOCK(villa);
+    if(ci < VL_CHUNKCLASS){
+      csiz = VL_CHUNKMIN << ci;
+      if((chunk = villa->chunks[ci]) != NULL){
+        villa->chunks[ci] = chunk->next;
+        villa->chunknum[ci]--;
+      } else {
+        CB_MALLOC(chunk, sizeof(VLCHUNK) + csiz);
+      }
+    } else {
+      CB_MALLOC(chunk, sizeof(VLCHUNK) + csiz);
+    }
+    chunk->next = *arenap;
+    chunk->size = csiz;
+    chunk->used = 0;
+    *arenap = chunk;
+    *sump += sizeof(VLCHUNK) + csiz;
+    if(villa->leafcsiz > villa->leafcpeak) villa->leafcpeak = villa->leafcsiz;
+    if(villa->nodecsiz > villa->nodecpeak) villa->nodecpeak = villa->nodecsiz;
+    VL_CACHEUNLOCK(villa);
+  }
+  ptr = VL_CHUNKTOP(chunk);
+  chunk->used += size;
+  return ptr;
+}
+
+
+/* Close an arena.
+   `villa' specifies a database handle.
+   `arena' specifies the first chunk of the arena.  If it is `NULL', nothing is done.
+   `sump' specifies the pointer to the variable accounting the size of the cache.
+   Chunks of the size classes are returned to the pool of the handle unless it is full. */
+static void vlarenaclose(VILLA *villa, VLCHUNK *arena, int *sump){
+  VLCHUNK *next;
+  int ci;
+  assert(villa && sump);
+  VL_CACHELOCK(villa);
+  while(arena){
+    next = arena->next;
+    *sump -= sizeof(VLCHUNK) + arena->size;
+    ci = vlchunkclass(arena->size);
+    if(ci < VL_CHUNKCLASS && (VL_CHUNKMIN << ci) == arena->size &&
+       villa->chunknum[ci] < VL_CHUNKPOOL){
+      arena->next = villa->chunks[ci];
+      villa->chunks[ci] = arena;
+      villa->chunknum[ci]++;
+    } else {
+      free(arena);
+    }
+    arena = next;
+  }
+  VL_CACHEUNLOCK(villa);
+}
+
+
+/* Create a latch of a page.
+   `villa' specifies a database handle.
+   The return value is the latch, or `NULL' unless the handle is shared with the writer. */
+static void *vllatchopen(VILLA *villa){
+  void *latch;
+  assert(villa);
+  latch = NULL;
+#if defined(MYPTHREAD)
+  if(villa->tlatch){
+    CB_MALLOC(latch, sizeof(pthread_rwlock_t));
+    pthread_rwlock_init((pthread_rwlock_t *)latch, NULL);
+  }
+#endif
+  return latch;
+}
+
+
+/* Destroy a latch of a page.
+   `latch' specifies the latch.  If it is `NULL', nothing is done. */
+static void vllatchclose(void *latch){
+#if defined(MYPTHREAD)
+  if(latch){
+    pthread_rwlock_destroy((pthread_rwlock_t *)latch);
+    free(latch);
+  }
+#endif
+}
+
+
+/* Latch the internal database to read a page.
+   `villa' specifies a database handle.
+   The latch is shared unless the whole file is mapped, as reading the mapping of a file grown
+   by the writer maps it again.  It should be released with `VL_DEPOTUNLOCK'. */
+static void vldepotlatch(VILLA *villa){
+  assert(villa);
+  VL_DEPOTLOCK(villa, FALSE);
+  if(villa->dlatch && villa->depot->mapall){
+    VL_DEPOTUNLOCK(villa);
+    VL_DEPOTLOCK(villa, TRUE);
+  }
+}
+
+
+/* Begin queuing the pages written into the internal database.
+   `villa' specifies a database handle.
+   Nothing is done unless the handle is a writer.  The queued pages are sorted by the offset
+   when they are submitted, so that a flush writes the file sequentially. */
+static void vlaiobegin(VILLA *villa){
+  assert(villa);
+  if(!villa->wmode) return;
+  VL_DEPOTLOCK(villa, TRUE);
+  dpaiobegin(villa->depot);
+  VL_DEPOTUNLOCK(villa);
+}
+
+
+/* End queuing the pages written into the internal database.
+   `villa' specifies a database handle.
+   If successful, the return value is true, else, it is false.
+   The pages queued since the outermost `vlaiobegin' are submitted at once. */
+static int vlaioend(VILLA *villa){
+  int err;
+  assert(villa);
+  if(!villa->wmode) return TRUE;
+  VL_DEPOTLOCK(villa, TRUE);
+  err = !dpaioend(villa->depot);
+  VL_DEPOTUNLOCK(villa);
+  return err ? FALSE : TRUE;
+}
+
+
+/* Compress a leaf with ZLIB.
+   `ptr' specifies the pointer to the region of a leaf.
+   `size' specifies the size of the region.
+   `sp' specifies the pointer to a variable to which the size of the region of the return value
+   is assigned.
+   `dict' is ignored.
+   If successful, the return value is the pointer to the region of the result, else, it is
+   `NULL'.  Because the region of the return value is allocated with the `malloc' call, it
+   should be released with the `free' call if it is no longer in use. */
+static char *vlzlibencode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_deflate) return NULL;
+  return _qdbm_deflate(ptr, size, sp, _QDBM_ZMRAW);
+}
+
+
+/* Decompress a leaf compressed with ZLIB.
+   The arguments and the return value are same as those of `vlzlibencode'. */
+static char *vlzlibdecode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_inflate) return NULL;
+  return _qdbm_inflate(ptr, size, sp, _QDBM_ZMRAW);
+}
+
+
+/* Compress a leaf with LZO.
+   The arguments and the return value are same as those of `vlzlibencode'. */
+static char *vllzoencode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_lzoencode) return NULL;
+  return _qdbm_lzoencode(ptr, size, sp);
+}
+
+
+/* Decompress a leaf compressed with LZO.
+   The arguments and the return value are same as those of `vlzlibencode'. */
+static char *vllzodecode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_lzodecode) return NULL;
+  return _qdbm_lzodecode(ptr, size, sp);
+}
+
+
+/* Compress a leaf with BZIP2.
+   The arguments and the return value are same as those of `vlzlibencode'. */
+static char *vlbzipencode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_bzencode) return NULL;
+  return _qdbm_bzencode(ptr, size, sp);
+}
+
+
+/* Decompress a leaf compressed with BZIP2.
+   The arguments and the return value are same as those of `vlzlibencode'. */
+static char *vlbzipdecode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_bzdecode) return NULL;
+  return _qdbm_bzdecode(ptr, size, sp);
+}
+
+
+/* Compress a leaf with the fast LZ codec.
+   `dict' specifies the dictionary or `NULL'.  Matches are also searched in the dictionary.
+   The other arguments and the return value are same as those of `vlzlibencode'. */
+static char *vllzfencode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_lzfencode) return NULL;
+  return _qdbm_lzfencode(ptr, size, sp, dict ? CB_DATUMPTR(dict) : NULL,
+                         dict ? CB_DATUMSIZE(dict) : 0);
+}
+
+
+/* Decompress a leaf compressed with the fast LZ codec.
+   `dict' specifies the dictionary used when the leaf was compressed or `NULL'.
+   The other arguments and the return value are same as those of `vlzlibencode'. */
+static char *vllzfdecode(const char *ptr, int size, int *sp, const CBDATUM *dict){
+  assert(ptr && size >= 0 && sp);
+  if(!_qdbm_lzfdecode) return NULL;
+  return _qdbm_lzfdecode(ptr, size, sp, dict ? CB_DATUMPTR(dict) : NULL,
+                         dict ? CB_DATUMSIZE(dict) : 0);
+}
+
+
+/* Get the ID of the codec selected by a compression mode.
+   `cmode' specifies a compression mode.
+   The return value is the ID of the codec, or `VL_CDNONE' if the mode selects nothing or the
+   library of the codec is not available. */
+static int vlcodecid(int cmode){
+  switch(cmode){
+  case VL_OZCOMP: return _qdbm_deflate && _qdbm_inflate ? VL_CDZLIB : VL_CDNONE;
+  case VL_OYCOMP: return _qdbm_lzoencode && _qdbm_lzodecode ? VL_CDLZO : VL_CDNONE;
+  case VL_OXCOMP: return _qdbm_bzencode && _qdbm_bzdecode ? VL_CDBZIP : VL_CDNONE;
+  case VL_OFCOMP: return _qdbm_lzfencode && _qdbm_lzfdecode ? VL_CDLZF : VL_CDNONE;
+  case VL_ODCOMP: return _qdbm_lzfencode && _qdbm_lzfdecode ? VL_CDDICT : VL_CDNONE;
+  }
+  return VL_CDNONE;
+}
+
+
+/* Add a leaf to the samples and train the dictionary when enough samples are gathered.
+   `villa' specifies a database handle connected as a writer.
+   `ptr' specifies the pointer to the region of a serialized leaf.
+   `size' specifies the size of the region.
+   If successful, the return value is true, else, it is false.
+   The trained dictionary is stored in the database before any leaf refers to it. */
+static int vldictfeed(VILLA *villa, const char *ptr, int size){
+  CBDATUM *dict;
+  int knum;
+  assert(villa && ptr && size >= 0);
+  if(!villa->dictsmp) villa->dictsmp = cbdatumopen(NULL, 0);
+  if(size > VL_DICTSMPUNIT){
+    ptr += (size - VL_DICTSMPUNIT) / 2;
+    size = VL_DICTSMPUNIT;
+  }
+  CB_DATUMCAT(villa->dictsmp, ptr, size);
+  if(CB_DATUMSIZE(villa->dictsmp) < VL_DICTSMPMAX) return TRUE;
+  dict = vldicttrain(CB_DATUMPTR(villa->dictsmp), CB_DATUMSIZE(villa->dictsmp), VL_DICTMAX);
+  cbdatumclose(villa->dictsmp);
+  villa->dictsmp = NULL;
+  knum = VL_DICTKEY;
+  VL_DEPOTLOCK(villa, TRUE);
+  if(!dpsetalign(villa->depot, 0) ||
+     !dpput(villa->depot, (char *)&knum, sizeof(int),
+            CB_DATUMPTR(dict), CB_DATUMSIZE(dict), DP_DOVER) ||
+     !dpsetalign(villa->depot, VL_PAGEALIGN)){
+    VL_DEPOTUNLOCK(villa);
+    cbdatumclose(dict);
+    return FALSE;
+  }
+  villa->dict = dict;
+  VL_DEPOTUNLOCK(villa);
+  return TRUE;
+}
+
+
+/* Train a dictionary from samples.
+   `ptr' specifies the pointer to the region of the samples.
+   `size' specifies the size of the region.
+   `max' specifies the max size of the dictionary.
+   The return value is the datum of the dictionary.
+   Segments of the samples containing the substrings which occur most frequently are selected
+   greedily and the counts of the substrings of a selected segment are cleared so that the
+   following selections cover other substrings.  The best segments are put at the end so that
+   they are referred to with the shortest offsets. */
+static CBDATUM *vldicttrain(const char *ptr, int size, int max){
+  CBDATUM *dict;
+  int *hashes, *segs;
+  unsigned short *freqs;
+  char *used;
+  int i, j, snum, gnum, cnum, best, score, bscore;
+  unsigned int hash;
+  assert(ptr && size >= 0 && max >= 0);
+  snum = size / VL_DICTSEGSIZ;
+  gnum = size - VL_DICTGRAM + 1;
+  if(gnum < 1) gnum = 0;
+  CB_MALLOC(hashes, gnum * sizeof(int) + 1);
+  CB_MALLOC(freqs, (1 << VL_DICTHBITS) * sizeof(unsigned short));
+  memset(freqs, 0, (1 << VL_DICTHBITS) * sizeof(unsigned short));
+  for(i = 0; i < gnum; i++){
+    hash = 2166136261U;
+    for(j = 0; j < VL_DICTGRAM; j++){
+      hash = (hash ^ ((unsigned char *)ptr)[i+j]) * 16777619U;
+    }
+    hashes[i] = (hash ^ (hash >> VL_DICTHBITS)) & ((1 << VL_DICTHBITS) - 1);
+    if(freqs[hashes[i]] < USHRT_MAX) freqs[hashes[i]]++;
+  }
+  CB_MALLOC(used, snum + 1);
+  memset(used, 0, snum + 1);
+  CB_MALLOC(segs, (max / VL_DICTSEGSIZ + 1) * sizeof(int));
+  cnum = 0;
+  while(cnum < max / VL_DICTSEGSIZ){
+    best = -1;
+    bscore = 0;
+    for(i = 0; i < snum; i++){
+      if(used[i]) continue;
+      score = 0;
+      for(j = i * VL_DICTSEGSIZ; j < (i + 1) * VL_DICTSEGSIZ && j < gnum; j++){
+        if(freqs[hashes[j]] > 1) score += freqs[hashes[j]] - 1;
+      }
+      if(score > bscore){
+        best = i;
+        bscore = score;
+      }
+    }
+    if(best < 0) break;
+    used[best] = TRUE;
+    segs[cnum++] = best;
+    for(j = best * VL_DICTSEGSIZ; j < (best + 1) * VL_DICTSEGSIZ && j < gnum; j++){
+      freqs[hashes[j]] = 0;
+    }
+  }
+  dict = cbdatumopen(NULL, 0);
+  for(i = cnum - 1; i >= 0; i--){
+    CB_DATUMCAT(dict, ptr + segs[i] * VL_DICTSEGSIZ, VL_DICTSEGSIZ);
+  }
+  free(segs);
+  free(used);
+  free(freqs);
+  free(hashes);
+  return dict;
+}
+
+
 /* Get flags of a database. */
 int vlgetflags(VILLA *villa){
   assert(villa);
@@ -42,6 +42,7 @@ extern "C" {
 
 
 #define VL_LEVELMAX    64                /* max level of B+ tree */
+#define VL_CHUNKCLASS  7                 /* number of size classes of arena chunks */
 
 typedef struct {                         /* type of structure for a record */
   CBDATUM *key;                          /* datum of the key */
@@ -54,12 +55,24 @@ typedef struct {                         /* type of structure for index of a pag
   CBDATUM *key;                          /* threshold key of the page */
 } VLIDX;
 
+typedef struct _VLCHUNK {                /* type of structure for a chunk of an arena */
+  struct _VLCHUNK *next;                 /* pointer to the next chunk */
+  int size;                              /* size of the region for data */
+  int used;                              /* size of the used region */
+} VLCHUNK;
+
 typedef struct {                         /* type of structure for a leaf page */
   int id;                                /* ID number of the leaf */
   int dirty;                             /* whether to be written back */
   CBLIST *recs;                          /* list of records */
   int prev;                              /* ID number of the previous leaf */
   int next;                              /* ID number of the next leaf */
+  VLCHUNK *arena;                        /* arena of the records */
+  int waste;                             /* size of abandoned regions in the arena */
+  int rests;                             /* number of records with the rest values */
+  int heat;                              /* state for the cache replacement */
+  int refs;                              /* number of holders sharing the leaf */
+  void *latch;                           /* latch of the leaf shared with the writer or `NULL' */
 } VLLEAF;
 
 typedef struct {                         /* type of structure for a node page */
@@ -67,6 +80,11 @@ typedef struct {                         /* type of structure for a node page */
   int dirty;                             /* whether to be written back */
   int heir;                              /* ID of the child before the first index */
   CBLIST *idxs;                          /* list of indexes */
+  VLCHUNK *arena;                        /* arena of the indexes */
+  int heat;                              /* state for the cache replacement */
+  int pin;                               /* whether to be pinned in the cache */
+  int refs;                              /* number of holders sharing the node */
+  void *latch;                           /* latch of the node shared with the writer or `NULL' */
 } VLNODE;
 
 /* type of the pointer to a comparing function.
@@ -82,18 +100,42 @@ MYEXTERN VLCFUNC VL_CMPINT;              /* native integer comparing function */
 MYEXTERN VLCFUNC VL_CMPNUM;              /* big endian number comparing function */
 MYEXTERN VLCFUNC VL_CMPDEC;              /* decimal string comparing function */
 
-typedef struct {                         /* type of structure for a database handle */
+typedef struct _VILLA {                  /* type of structure for a database handle */
   DEPOT *depot;                          /* internal database handle */
   VLCFUNC cmp;                           /* pointer to the comparing function */
   int wmode;                             /* whether to be writable */
   int cmode;                             /* compression mode for leaves */
+  int fcode;                             /* whether keys in pages are front-coded */
+  int pcodec;                            /* whether each leaf is tagged with its codec */
+  int codec;                             /* ID of the codec for leaves to be written */
+  CBDATUM *dict;                         /* dictionary trained for leaves or `NULL' */
+  CBDATUM *dictsmp;                      /* samples of leaves to train the dictionary */
   int root;                              /* ID number of the root page */
   int last;                              /* ID number of the last leaf */
   int lnum;                              /* number of leaves */
   int nnum;                              /* number of nodes */
+  CBDATUM *leaffree;                     /* IDs of freed leaves to be reused */
+  CBDATUM *nodefree;                     /* IDs of freed nodes to be reused */
   int rnum;                              /* number of records */
   CBMAP *leafc;                          /* cache for leaves */
   CBMAP *nodec;                          /* cache for nodes */
+  void *mutex;                           /* mutex of the caches shared by threads or `NULL' */
+  void *tlatch;                          /* latch of the tree shared with the writer or `NULL' */
+  void *dlatch;                          /* latch of the internal database or `NULL' */
+  int saves;                             /* number of pages written back */
+  struct _VILLA *base;                   /* handle of the database of a snapshot or `NULL' */
+  int sgen;                              /* generation of the snapshot or of the latest one */
+  CBDATUM *snaps;                        /* generations of the open snapshots or `NULL' */
+  CBMAP *svers;                          /* generations of the pages kept for snapshots */
+  int svnum;                             /* number of the pages kept in the database */
+  int walfd;                             /* file descriptor of the write ahead log or -1 */
+  CBDATUM *walops;                       /* frame of operations not written into the log */
+  CBDATUM *walfree;                      /* IDs of pages freed since the last checkpoint */
+  int walsiz;                            /* size of the updating logged since the last checkpoint */
+  int walmax;                            /* size of the log invoking a checkpoint */
+  int dwrite;                            /* whether only the images of pages are logged */
+  int replay;                            /* whether the log is being replayed */
+  void *ptab;                            /* table of the locations of pages or `NULL' */
   int hist[VL_LEVELMAX];                 /* array history of visited nodes */
   int hnum;                              /* number of elements of the history */
   int hleaf;                             /* ID number of the leaf referred by the history */
@@ -101,12 +143,40 @@ typedef struct {                         /* type of structure for a database han
   int curleaf;                           /* ID number of the leaf where the cursor is */
   int curknum;                           /* index of the key where the cursor is */
   int curvnum;                           /* index of the value where the cursor is */
+  int ramax;                             /* max number of leaves read ahead of cursors */
+  int rawin;                             /* window of leaves read ahead of the cursor */
+  int raleft;                            /* number of leaves advised ahead of the cursor */
   int leafrecmax;                        /* max number of records in a leaf */
   int nodeidxmax;                        /* max number of indexes in a node */
   int leafcnum;                          /* max number of caching leaves */
   int nodecnum;                          /* max number of caching nodes */
   int avglsiz;                           /* average size of each leave */
   int avgnsiz;                           /* average size of each node */
+  VLCHUNK *chunks[VL_CHUNKCLASS];        /* pools of free chunks of each size class */
+  int chunknum[VL_CHUNKCLASS];           /* numbers of the pooled chunks */
+  int leafcsiz;                          /* size of the arenas of the cached leaves */
+  int nodecsiz;                          /* size of the arenas of the cached nodes */
+  int leafcmax;                          /* max size of the arenas of the cached leaves */
+  int nodecmax;                          /* max size of the arenas of the cached nodes */
+  int leafcpeak;                         /* peak size of the arenas of the cached leaves */
+  int nodecpeak;                         /* peak size of the arenas of the cached nodes */
+  int leafcpol;                          /* replacement policy of the leaf cache */
+  int nodecpol;                          /* replacement policy of the node cache */
+  CBMAP *leafghost;                      /* IDs of leaves evicted from the probation */
+  CBMAP *nodeghost;                      /* IDs of nodes evicted from the probation */
+  int leafchot;                          /* number of protected leaves in the cache */
+  int nodechot;                          /* number of protected nodes in the cache */
+  int pinlevel;                          /* number of levels of pinned nodes */
+  int pinnum;                            /* number of pinned nodes */
+  int pinsiz;                            /* size of memory of pinned nodes */
+  int bulk;                              /* whether in bulk loading */
+  int bulkfill;                          /* fill factor of bulk loading in percent */
+  int bulkleaf;                          /* ID number of the leaf being filled */
+  int bulksiz;                           /* size of data of the leaf being filled */
+  int bulknodes[VL_LEVELMAX];            /* IDs of the nodes being filled at each level */
+  int bulkpids[VL_LEVELMAX];             /* IDs of the pages pending at each level */
+  CBDATUM *bulkkeys[VL_LEVELMAX];        /* first keys of the pages pending at each level */
+  int bulkdepth;                         /* number of levels of the nodes being filled */
   int tran;                              /* whether in the transaction */
   int rbroot;                            /* root for rollback */
   int rblast;                            /* last for rollback */
@@ -120,8 +190,23 @@ typedef struct {                         /* type of structure for a multiple cur
   int curleaf;                           /* ID number of the leaf where the cursor is */
   int curknum;                           /* index of the key where the cursor is */
   int curvnum;                           /* index of the value where the cursor is */
+  int rawin;                             /* window of leaves read ahead of the cursor */
+  int raleft;                            /* number of leaves advised ahead of the cursor */
+  VLLEAF *leaf;                          /* leaf held by the cursor of a shared handle */
 } VLMULCUR;
 
+typedef struct {                         /* type of structure for a sorter of records */
+  VILLA *villa;                          /* database handle */
+  char *buf;                             /* buffer of records not written into runs */
+  int bsiz;                              /* size of the used region of the buffer */
+  int basiz;                             /* size of the allocated region of the buffer */
+  int rnum;                              /* number of records in the buffer */
+  int max;                               /* max size of memory */
+  int thnum;                             /* number of threads to sort records */
+  CBLIST *runs;                          /* names of the files of sorted runs */
+  int seq;                               /* sequence number of the files of runs */
+} VLSORT;
+
 enum {                                   /* enumeration for open modes */
   VL_OREADER = 1 << 0,                   /* open as a reader */
   VL_OWRITER = 1 << 1,                   /* open as a writer */
@@ -131,7 +216,21 @@ enum {                                   /* enumeration for open modes */
   VL_OLCKNB = 1 << 5,                    /* lock without blocking */
   VL_OZCOMP = 1 << 6,                    /* compress leaves with ZLIB */
   VL_OYCOMP = 1 << 7,                    /* compress leaves with LZO */
-  VL_OXCOMP = 1 << 8                     /* compress leaves with BZIP2 */
+  VL_OXCOMP = 1 << 8,                    /* compress leaves with BZIP2 */
+  VL_OLARGE = 1 << 9,                    /* create as a large file */
+  VL_OMAPALL = 1 << 10,                  /* map the whole file */
+  VL_OFCOMP = 1 << 11,                   /* compress leaves with the fast LZ codec */
+  VL_ODCOMP = 1 << 12,                   /* compress leaves with a trained dictionary */
+  VL_OTHREAD = 1 << 13,                  /* share the handle among threads */
+  VL_OWAL = 1 << 14,                     /* log updating ahead of writing pages */
+  VL_ODWRITE = 1 << 15,                  /* write pages back through a double write log */
+  VL_OAIO = 1 << 16,                     /* read and write pages with asynchronous I/O */
+  VL_OPTAB = 1 << 17                     /* look up pages through a table of locations */
+};
+
+enum {                                   /* enumeration for cache replacement policies */
+  VL_CRLRU,                              /* least recently used */
+  VL_CR2Q                                /* two queues resisting scans */
 };
 
 enum {                                   /* enumeration for write modes */
@@ -161,10 +260,21 @@ enum {                                   /* enumeration for insertion modes */
    means it creates a new database if not exist, `VL_OTRUNC', which means it creates a new
    database regardless if one exists, `VL_OZCOMP', which means leaves in the database are
    compressed with ZLIB, `VL_OYCOMP', which means leaves in the database are compressed with LZO,
-   `VL_OXCOMP', which means leaves in the database are compressed with BZIP2.  Both of
+   `VL_OXCOMP', which means leaves in the database are compressed with BZIP2, `VL_OFCOMP', which
+   means leaves in the database are compressed with the fast LZ codec, `VL_ODCOMP', which means
+   leaves in the database are compressed with the fast LZ codec and a dictionary trained from the
+   first leaves, `VL_OLARGE', which
+   means the database file is created with 64-bit offsets so that it can grow beyond 2GB,
+   `VL_OWAL', which means updating is logged in a file whose name is that of the database with
+   the suffix ".vlwal" before updated pages are written back, or `VL_ODWRITE', which means
+   updated pages are written back through the same file without logging each updating.  Both of
    `VL_OREADER' and `VL_OWRITER' can be added to by bitwise or: `VL_ONOLCK', which means it opens
-   a database file without file locking, or `VL_OLCKNB', which means locking is performed without
-   blocking.
+   a database file without file locking, `VL_OLCKNB', which means locking is performed without
+   blocking, or `VL_OMAPALL', which means the whole of the database file is mapped into memory and
+   pages are loaded from the mapping without system calls nor intermediate copies.  Both of them
+   can also be added to by bitwise or: `VL_OTHREAD', which means the handle is shared by threads,
+   `VL_OAIO', which means pages are read and written with the engine of asynchronous I/O, or
+   `VL_OPTAB', which means pages are looked up through a table of their locations.
    `cmp' specifies a comparing function: `VL_CMPLEX' comparing keys in lexical order,
    `VL_CMPINT' comparing keys as objects of `int' in native byte order, `VL_CMPNUM' comparing
    keys as numbers of big endian, `VL_CMPDEC' comparing keys as decimal strings.  Any function
@@ -174,8 +284,57 @@ enum {                                   /* enumeration for insertion modes */
    While connecting as a writer, an exclusive lock is invoked to the database file.
    While connecting as a reader, a shared lock is invoked to the database file.  The thread
    blocks until the lock is achieved.  `VL_OZCOMP', `VL_OYCOMP', and `VL_OXCOMP' are available
-   only if QDBM was built each with ZLIB, LZO, and BZIP2 enabled.  If `VL_ONOLCK' is used, the
-   application is responsible for exclusion control. */
+   only if QDBM was built each with ZLIB, LZO, and BZIP2 enabled.  Each leaf of a database created
+   by this version records the codec it was written with, so a compression option given when
+   opening an existing database as a writer applies to leaves written from then on while the
+   others are still readable.  A database file is created with 32-bit offsets unless
+   `VL_OLARGE' is specified, because earlier versions can not read files with 64-bit offsets.
+   Whether an existing file has 64-bit offsets is detected from its header, and updating a file
+   with 32-bit offsets fails with `DP_EMISC' when it would grow beyond 2GB, while the handle is
+   still usable.  Files with 64-bit offsets are neither created nor opened on platforms whose
+   system calls can not address them.  `VL_OTHREAD' is available only if QDBM was built with POSIX
+   thread enabled.  The retrieving functions and the multiple cursors of a reader opened with it
+   can be called by threads at the same time, while the cursor of the handle itself and the
+   functions tuning the handle should be used by one thread only.  A writer opened with it can
+   be updated with `vlput', `vlputlist', `vlout', `vloutlist', `vlputbatch', `vlrangeout', and
+   `vloutprefix' by one thread while the retrieving functions are called by other threads.
+   Pages are latched one by one from the root to a leaf, so readers proceed while the writer
+   modifies other leaves, and only merging underflowing leaves and deleting a range exclude
+   them for a while.  The multiple cursors, the cursor of
+   the handle, and the other functions of such a writer should be used while no other thread
+   uses the handle.  If `VL_ONOLCK' is used, the
+   application is responsible for exclusion control.  Whether an existing database file is a
+   large file or not is detected automatically.  With `VL_OWAL', each updating function appends
+   a compact record of the operation to the log, and committing the transaction writes the
+   records of the transaction and synchronizes the log with the device only, so that its cost
+   does not depend on the number of the cached pages.  Updated pages stay in the cache until a
+   checkpoint writes them back at once, when the log grows beyond the size set with
+   `vlsetwalmax', when the cache is filled with updated pages, or when the database is
+   synchronized or closed.  A checkpoint logs the images of the pages before writing them, so
+   it is completed by the next writer if it is interrupted, after the database file is
+   repaired with `dprepair' if the interruption left it broken.  If a writer with the log is not
+   closed appropriately, the next writer replays the log, so that every committed transaction
+   and the other updating logged before the crash are restored.  The log of a database which
+   was not closed appropriately is replayed even if the next writer is opened without
+   `VL_OWAL'.  Bulk loading is not logged.  With `VL_ODWRITE' and without `VL_OWAL', updated
+   pages are written back only by checkpoints as with `VL_OWAL', which are performed also when
+   the transaction begins and when it is committed.  Each image of a page and the meta data in
+   the log are verified with a CRC-32 checksum if QDBM was built with ZLIB enabled, so a crash
+   leaves the database in the state of the last completed checkpoint, which the next writer
+   restores in time proportional to the size of the log rather than of the database.  The pages
+   written back by a flush of the cache, a synchronization, or a commit are queued, sorted by the
+   offset in the file, and written with a vectored call for each run of adjacent pages.  With
+   `VL_OAIO', the runs are submitted at once, and the leaves needed by `vlgetbatch' and read
+   ahead by cursors are loaded with one submission.  The engine is io_uring on Linux, or helper
+   threads if it is not available and QDBM was built with POSIX thread enabled.  With
+   `VL_OPTAB', the offset and the size of the record of each page are kept in an array indexed
+   by the ID number of the page, in a file whose name is that of the database with the suffix
+   ".vlpt" mapped into memory, so that a page missing in the cache is read with one call
+   without walking the chain of the bucket.  Each location is verified with the header of the
+   record, and a page not found in the table is read as usual.  The table is valid only if it
+   was closed appropriately together with the database, so a writer opened with it after a
+   crash or after a writer without it rebuilds the table as pages are written and read, and a
+   reader opened with it then reads pages as usual. */
 VILLA *vlopen(const char *name, int omode, VLCFUNC cmp);
 
 
@@ -184,8 +343,11 @@ VILLA *vlopen(const char *name, int omode, VLCFUNC cmp);
    If successful, the return value is true, else, it is false.
    Because the region of a closed handle is released, it becomes impossible to use the handle.
    Updating a database is assured to be written when the handle is closed.  If a writer opens
-   a database but does not close it appropriately, the database will be broken.  If the
-   transaction is activated and not committed, it is aborted. */
+   a database but does not close it appropriately, the database will be broken, unless it was
+   opened with `VL_OWAL'.  The log of a writer opened with it is removed.  If the
+   transaction is activated and not committed, it is aborted.  A handle whose snapshots are
+   open is not closed and false is returned.  A snapshot given to this function is closed as
+   with `vlsnapshotclose'. */
 int vlclose(VILLA *villa);
 
 
@@ -216,7 +378,9 @@ int vlput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz,
    If successful, the return value is true, else, it is false.  False is returned when no
    record corresponds to the specified key.
    When the key of duplicated records is specified, the first record of the same key is deleted.
-   The cursor becomes unavailable due to updating database. */
+   The cursor becomes unavailable due to updating database.  Out of the transaction, a leaf left
+   with few records is merged with or balanced by its sibling, and the ID numbers of the freed
+   pages are reused. */
 int vlout(VILLA *villa, const char *kbuf, int ksiz);
 
 
@@ -308,6 +472,63 @@ CBLIST *vlgetlist(VILLA *villa, const char *kbuf, int ksiz);
 char *vlgetcat(VILLA *villa, const char *kbuf, int ksiz, int *sp);
 
 
+/* Store records in a batch.
+   `villa' specifies a database handle connected as a writer.
+   `keys' specifies a list handle of the keys.
+   `vals' specifies a list handle of the values.  Each of them is stored with the key of the same
+   index.
+   `dmode' specifies behavior when a key overlaps, as with `vlput'.
+   If successful, the return value is true, else, it is false.  When `VL_DKEEP' is specified, the
+   records of existing keys are skipped and false is returned after the others are stored.
+   The keys are sorted with the comparing function and the tree is walked once in their order, so
+   that each leaf is searched and loaded only once for all keys falling into it.  Records of the
+   same key are stored in the order of the lists.  The cursor becomes unavailable due to updating
+   database. */
+int vlputbatch(VILLA *villa, const CBLIST *keys, const CBLIST *vals, int dmode);
+
+
+/* Retrieve records in a batch.
+   `villa' specifies a database handle.
+   `keys' specifies a list handle of the keys.
+   If successful, the return value is a map handle whose keys are the keys of existing records
+   and whose values are the values of the first records of them, else, it is `NULL'.
+   Keys without records are not included in the map.  As with `vlputbatch', the keys are looked
+   up in sorted order.  Because the handle of the return value is opened with the function
+   `cbmapopen', it should be closed with the function `cbmapclose' if it is no longer in use. */
+CBMAP *vlgetbatch(VILLA *villa, const CBLIST *keys);
+
+
+/* Delete records in a range of keys.
+   `villa' specifies a database handle connected as a writer.
+   `lbuf' specifies the pointer to the region of the lower bound of the keys, which is included
+   in the range.  If it is `NULL', the range begins with the first record.
+   `lsiz' specifies the size of the region of the lower bound.  If it is negative, the size is
+   assigned with `strlen(lbuf)'.
+   `ubuf' specifies the pointer to the region of the upper bound of the keys, which is excluded
+   from the range.  If it is `NULL', the range ends with the last record.
+   `usiz' specifies the size of the region of the upper bound.  If it is negative, the size is
+   assigned with `strlen(ubuf)'.
+   If successful, the return value is the number of the deleted records, else, it is -1.
+   Leaves whose records are all in the range are emptied at once and removed from the tree by
+   relinking their siblings and removing their indexes from the parents, so that records are
+   compared only in the two leaves at the ends of the range.  In the transaction and in bulk
+   loading, emptied leaves are left in the tree.  The cursor becomes unavailable due to updating
+   database. */
+int vlrangeout(VILLA *villa, const char *lbuf, int lsiz, const char *ubuf, int usiz);
+
+
+/* Delete records whose keys begin with a prefix.
+   `villa' specifies a database handle connected as a writer.
+   `pbuf' specifies the pointer to the region of the prefix.
+   `psiz' specifies the size of the region of the prefix.  If it is negative, the size is
+   assigned with `strlen(pbuf)'.
+   If successful, the return value is the number of the deleted records, else, it is -1.
+   This function calls `vlrangeout' with the range from the prefix to the least string greater
+   than any string beginning with it, so it is meaningful only if the comparing function is
+   `VL_CMPLEX'. */
+int vloutprefix(VILLA *villa, const char *pbuf, int psiz);
+
+
 /* Move the cursor to the first record.
    `villa' specifies a database handle.
    If successful, the return value is true, else, it is false.  False is returned if there is
@@ -416,6 +637,111 @@ int vlcurout(VILLA *villa);
 void vlsettuning(VILLA *villa, int lrecmax, int nidxmax, int lcnum, int ncnum);
 
 
+/* Set the limits of memory of the caches of a database handle.
+   `villa' specifies a database handle.
+   `lcsiz' specifies the max size in bytes of the memory of caching leaf nodes.  If it is not
+   more than 0, the size is not limited.
+   `ncsiz' specifies the max size in bytes of the memory of caching non-leaf nodes.  If it is
+   not more than 0, the size is not limited.
+   The memory of a cached node is the size of the arena holding its decoded page, records and
+   modified data.  The caches are limited by both of the numbers set with `vlsettuning' and
+   the sizes.  At least one page is kept in each cache, and the limits are not applied while
+   the transaction is in progress.  By default, the sizes are not limited. */
+void vlsetcachesiz(VILLA *villa, int lcsiz, int ncsiz);
+
+
+/* Get the statistics of the memory of the caches of a database handle.
+   `villa' specifies a database handle.
+   `lsp' specifies the pointer to a variable to which the current size in bytes of the memory
+   of caching leaf nodes is assigned.  If it is `NULL', it is not used.
+   `lpp' specifies the pointer to a variable to which the peak size of the memory of caching
+   leaf nodes is assigned.  If it is `NULL', it is not used.
+   `nsp' specifies the pointer to a variable to which the current size of the memory of
+   caching non-leaf nodes is assigned.  If it is `NULL', it is not used.
+   `npp' specifies the pointer to a variable to which the peak size of the memory of caching
+   non-leaf nodes is assigned.  If it is `NULL', it is not used. */
+void vlcachestat(VILLA *villa, int *lsp, int *lpp, int *nsp, int *npp);
+
+
+/* Set the replacement policies of the caches of a database handle.
+   `villa' specifies a database handle.
+   `lpolicy' specifies the policy of the cache of leaf nodes: `VL_CRLRU' to evict the least
+   recently used page, `VL_CR2Q' to evict pages by two queues.
+   `npolicy' specifies the policy of the cache of non-leaf nodes in the same way.
+   With `VL_CR2Q', a page read for the first time enters a probationary queue which keeps a
+   quarter of the cache.  A page is protected if it is read again by a lookup while it is on
+   probation or soon after it was evicted from the probation, and the protected pages are evicted
+   in LRU order.  Reading by cursors does not count, and pages read only by cursors are evicted
+   first.  So, a full scan by a cursor does not flush the working set of random access.  The default policy is `VL_CRLRU' for both of the caches. */
+void vlsetcachepolicy(VILLA *villa, int lpolicy, int npolicy);
+
+
+/* Pin the upper levels of the B+ tree of a database handle in memory.
+   `villa' specifies a database handle.
+   `level' specifies the number of levels of non-leaf nodes to be pinned, counted from the root.
+   If it is negative, all non-leaf nodes are pinned.  If it is 0, no node is pinned.
+   If successful, the return value is true, else, it is false.
+   Pinned nodes are loaded at once and they are never swept out of the cache except by
+   `vlmemflush' or the end of a transaction, after which they are pinned again when they are
+   read.  Nodes created by division of pinned nodes are also pinned.  Pinned nodes are not
+   counted in the limits of the cache of non-leaf nodes, but no node is pinned beyond the number
+   and the size of memory allowed by the limits, so nodes past them are cached as usual.  As
+   non-leaf nodes are a few percent of all pages, pinning all of them lets each lookup read one
+   page at most if the limits are large enough. */
+int vlsetpinlevel(VILLA *villa, int level);
+
+
+/* Get the statistics of pinned nodes of a database handle.
+   `villa' specifies a database handle.
+   `np' specifies the pointer to a variable to which the number of pinned nodes is assigned.  If
+   it is `NULL', it is not used.
+   `sp' specifies the pointer to a variable to which the size of memory of pinned nodes is
+   assigned.  If it is `NULL', it is not used.
+   The size of memory of pinned nodes is not included in that of the cache of non-leaf nodes
+   reported by `vlcachestat'. */
+void vlpinstat(VILLA *villa, int *np, int *sp);
+
+
+/* Get the statistics of the write-back of pages of a database handle.
+   `villa' specifies a database handle.
+   `fp' specifies the pointer to a variable to which the number of flushes is assigned.  If it
+   is `NULL', it is not used.
+   `wp' specifies the pointer to a variable to which the number of regions written by the
+   flushes is assigned.  If it is `NULL', it is not used.
+   `cp' specifies the pointer to a variable to which the number of calls of writing them is
+   assigned.  If it is `NULL', it is not used.
+   `bp' specifies the pointer to a variable to which the total size written by the flushes is
+   assigned.  If it is `NULL', it is not used.
+   `lp' specifies the pointer to a variable to which the size written by the last flush is
+   assigned.  If it is `NULL', it is not used.
+   A flush is counted when the pages written back by a synchronization, a transaction, a
+   checkpoint or trimming of the cache are written into the file.  The number of calls is less
+   than that of regions as far as adjacent regions are gathered.  All of them are 0 for a
+   reader. */
+void vlflushstat(VILLA *villa, int *fp, int *wp, int *cp, double *bp, double *lp);
+
+
+/* Get the statistics of the table of the locations of pages.
+   `villa' specifies a database handle.
+   `np' specifies the pointer to a variable to which the number of entries of the table is
+   assigned.  If it is `NULL', it is not used.
+   `hp' specifies the pointer to a variable to which the number of pages read through the table
+   is assigned.  If it is `NULL', it is not used.
+   `mp' specifies the pointer to a variable to which the number of pages not found in the table
+   is assigned.  If it is `NULL', it is not used.
+   All of them are 0 unless the handle was opened with `VL_OPTAB' and the table is valid. */
+void vlptabstat(VILLA *villa, int *np, int *hp, int *mp);
+
+
+/* Get the engine of asynchronous I/O of a database handle.
+   `villa' specifies a database handle.
+   The return value is `DP_AIONONE' for a reader opened without `VL_OAIO', else one of
+   `DP_AIOSYNC', `DP_AIOTHREAD' and `DP_AIOURING'.  `DP_AIOURING' is used only if the handle was
+   opened with `VL_OAIO' and a ring of io_uring was set up.  If the setup failed, the next engine
+   available is used instead. */
+int vlaioengine(VILLA *villa);
+
+
 /* Set the size of the free block pool of a database handle.
    `villa' specifies a database handle connected as a writer.
    `size' specifies the size of the free block pool of a database.
@@ -425,11 +751,36 @@ void vlsettuning(VILLA *villa, int lrecmax, int nidxmax, int lcnum, int ncnum);
 int vlsetfbpsiz(VILLA *villa, int size);
 
 
+/* Set the size of the write ahead log invoking a checkpoint.
+   `villa' specifies a database handle connected as a writer with `VL_OWAL' or `VL_ODWRITE'.
+   `max' specifies the size of the log in bytes.  If it is not more than 0, the default value is
+   specified.  The default is 16777216.
+   When the log written since the last checkpoint exceeds the size, updated pages are written
+   back and the log is emptied out of the transaction.  With `VL_ODWRITE', the total size of the
+   keys and the values updated is compared with it instead.  If the size is greater, updating the
+   same pages repeatedly is more efficient with the time to replay the log after a crash and
+   to abort the transaction sacrificed. */
+void vlsetwalmax(VILLA *villa, int max);
+
+
+/* Set the max number of leaves read ahead of cursors.
+   `villa' specifies a database handle.
+   `max' specifies the max number of leaves.  If it is negative, the default value is specified.
+   If it is 0, reading ahead is disabled.  The default is 32.
+   When a cursor of the handle or a multiple cursor moves forward into another leaf, the system
+   is advised to read the leaves following it in the same parent node without waiting for them.
+   The window of the leaves starts with 2 and is doubled each time the cursor consumes half of
+   it, up to the max number.  Moving a cursor backward or jumping resets the window.  Leaves in
+   the cache are not advised.  The max number is inherited by snapshots opened afterward. */
+void vlsetreadahead(VILLA *villa, int max);
+
+
 /* Synchronize updating contents with the file and the device.
    `villa' specifies a database handle connected as a writer.
    If successful, the return value is true, else, it is false.
    This function is useful when another process uses the connected database file.  This function
-   should not be used while the transaction is activated. */
+   should not be used while the transaction is activated.  If the handle is opened with
+   `VL_OWAL' or `VL_ODWRITE', this function performs a checkpoint. */
 int vlsync(VILLA *villa);
 
 
@@ -442,6 +793,18 @@ int vlsync(VILLA *villa);
 int vloptimize(VILLA *villa);
 
 
+/* Compact a database file incrementally.
+   `villa' specifies a database handle connected as a writer.
+   `unum' specifies the max number of pages visited in this call.  If it is not more than 0,
+   the default value is specified.
+   The return value is 1 if the compaction is in progress, 0 if it has reached the end of the
+   file, or -1 on failure.
+   Unlike `vloptimize', this function does not rewrite the whole file at once.  Pages are moved
+   toward the front of the file a few at a time and the file is truncated at the end, so this
+   function should be called repeatedly between other operations until it returns 0. */
+int vlcompact(VILLA *villa, int unum);
+
+
 /* Get the name of a database.
    `villa' specifies a database handle.
    If successful, the return value is the pointer to the region of the name of the database,
@@ -454,10 +817,18 @@ char *vlname(VILLA *villa);
 /* Get the size of a database file.
    `villa' specifies a database handle.
    If successful, the return value is the size of the database file, else, it is -1.
-   Because of the I/O buffer, the return value may be less than the hard size. */
+   Because of the I/O buffer, the return value may be less than the hard size.
+   If the size is more than 2GB, the return value is `INT_MAX'. */
 int vlfsiz(VILLA *villa);
 
 
+/* Get the size of a database file as double-precision floating-point number.
+   `villa' specifies a database handle.
+   If successful, the return value is the size of the database file, else, it is -1.0.
+   Because of the I/O buffer, the return value may be less than the hard size. */
+double vlfsizd(VILLA *villa);
+
+
 /* Get the number of the leaf nodes of B+ tree.
    `villa' specifies a database handle.
    If successful, the return value is the number of the leaf nodes, else, it is -1. */
@@ -506,14 +877,22 @@ time_t vlmtime(VILLA *villa);
    If successful, the return value is true, else, it is false.
    Because this function does not perform mutual exclusion control in multi-thread, the
    application is responsible for it.  Only one transaction can be activated with a database
-   handle at the same time. */
+   handle at the same time.  Without `VL_OWAL', updated pages are written back when the
+   transaction begins and when it is committed, by a checkpoint if the handle is opened with
+   `VL_ODWRITE'. */
 int vltranbegin(VILLA *villa);
 
 
 /* Commit the transaction.
    `villa' specifies a database handle connected as a writer.
    If successful, the return value is true, else, it is false.
-   Updating a database in the transaction is fixed when it is committed successfully. */
+   Updating a database in the transaction is fixed when it is committed successfully.  If the
+   handle is opened with `VL_OWAL', the records of the transaction and of the updating logged
+   before it are written into the log and synchronized with the device by one call, and the
+   updated pages are left for the next checkpoint.  If the handle is opened with `VL_ODWRITE'
+   and without `VL_OWAL', the images of the updated pages and the meta data are written into
+   the log with one synchronization before the database is updated, so that the transaction is
+   fixed entirely or not at all even if the writer crashes meanwhile. */
 int vltrancommit(VILLA *villa);
 
 
@@ -521,13 +900,43 @@ int vltrancommit(VILLA *villa);
    `villa' specifies a database handle connected as a writer.
    If successful, the return value is true, else, it is false.
    Updating a database in the transaction is discarded when it is aborted.  The state of the
-   database is rollbacked to before transaction. */
+   database is rollbacked to before transaction.  If the handle is opened with `VL_OWAL' or
+   `VL_ODWRITE', the updated pages are discarded and the log written since the last checkpoint
+   is replayed. */
 int vltranabort(VILLA *villa);
 
 
+/* Get a handle of a snapshot of a database.
+   `villa' specifies a database handle out of the transaction and bulk loading.
+   The return value is a handle of the snapshot or `NULL' if it is not successful.
+   The snapshot is a handle connected as a reader to the state of the database at the moment,
+   with its own caches and cursor, and any retrieving function, the cursors, and `vlexportdb'
+   can be used with it while the database is updated.  Updated pages are cached in the database
+   handle before being written back, so taking a snapshot writes them back first.  Afterwards,
+   the first time a page is overwritten or removed while snapshots are open, the writer copies
+   its former record under another key, which snapshots older than the copy read instead of the
+   page.  The writer is never blocked by snapshots and copies each page once for the latest one.
+   Copies are removed when no open snapshot is older than them, and copies left by a process
+   which was not closed appropriately are removed when the database is opened as a writer next
+   time.  If the database handle is a writer shared by threads, this function should be called
+   by the thread updating it, and the snapshot can be used by another thread while the handle is
+   updated.  A snapshot is shared by threads if the database handle is.  Every snapshot should
+   be closed before the database handle is closed. */
+VILLA *vlsnapshotopen(VILLA *villa);
+
+
+/* Close a handle of a snapshot.
+   `snap' specifies a handle of a snapshot.
+   If successful, the return value is true, else, it is false.
+   Because the region of a closed handle is released, it becomes impossible to use the handle.
+   Copies of pages which no other open snapshot reads are removed from the database. */
+int vlsnapshotclose(VILLA *snap);
+
+
 /* Remove a database file.
    `name' specifies the name of a database file.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   The write ahead log of the database is also removed if any. */
 int vlremove(const char *name);
 
 
@@ -543,7 +952,9 @@ int vlrepair(const char *name, VLCFUNC cmp);
 /* Dump all records as endian independent data.
    `villa' specifies a database handle.
    `name' specifies the name of an output file.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   If a snapshot is given, the records are dumped as of the snapshot while the database is
+   updated. */
 int vlexportdb(VILLA *villa, const char *name);
 
 
@@ -555,6 +966,84 @@ int vlexportdb(VILLA *villa, const char *name);
 int vlimportdb(VILLA *villa, const char *name);
 
 
+/* Begin bulk loading of sorted records.
+   `villa' specifies a database handle connected as a writer.  The database of the handle must
+   be empty.
+   `fill' specifies the fill factor of leaves and nodes in percent.  If it is not in the range
+   from 1 to 100, it is 100.
+   If successful, the return value is true, else, it is false.
+   While bulk loading, records should be stored only by `vlbulkput' and other functions to
+   access records should not be used until `vlbulkend' is called.  A lower fill factor leaves
+   room for records stored later without division of pages. */
+int vlbulkbegin(VILLA *villa, int fill);
+
+
+/* Store a record in bulk loading.
+   `villa' specifies a database handle in bulk loading.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.  If it is negative, the size is
+   assigned with `strlen(vbuf)'.
+   If successful, the return value is true, else, it is false.
+   Records must be stored in ascending order of the comparing function of the database.  The
+   value of a record whose key is equal to the previous one is added as a duplicated value.
+   Leaves are filled and written sequentially, and nodes are built bottom-up, so that no page
+   is divided. */
+int vlbulkput(VILLA *villa, const char *kbuf, int ksiz, const char *vbuf, int vsiz);
+
+
+/* End bulk loading.
+   `villa' specifies a database handle in bulk loading.
+   If successful, the return value is true, else, it is false.
+   The root of the database is set to the highest node built by the loading. */
+int vlbulkend(VILLA *villa);
+
+
+/* Get a sorter of records for bulk loading.
+   `villa' specifies a database handle connected as a writer.
+   `max' specifies the max size of memory used by the sorter.  If it is not more than 0, the
+   default value is specified.  The default value is 64MB and the minimum is 256KB.
+   `thnum' specifies the number of threads to sort records.  It is meaningful only if the
+   library is built with POSIX thread support.
+   The return value is a sorter or `NULL' if it is not successful.
+   Records given in any order are sorted by the comparing function of the database.  When the
+   buffer is full, its records are sorted by the threads and written into temporary files of
+   sorted runs beside the database file. */
+VLSORT *vlsortopen(VILLA *villa, int max, int thnum);
+
+
+/* Close a sorter of records.
+   `sort' specifies a sorter.
+   If successful, the return value is true, else, it is false.
+   Temporary files of the sorter are removed. */
+int vlsortclose(VLSORT *sort);
+
+
+/* Add a record to a sorter.
+   `sort' specifies a sorter.
+   `kbuf' specifies the pointer to the region of a key.
+   `ksiz' specifies the size of the region of the key.  If it is negative, the size is assigned
+   with `strlen(kbuf)'.
+   `vbuf' specifies the pointer to the region of a value.
+   `vsiz' specifies the size of the region of the value.  If it is negative, the size is
+   assigned with `strlen(vbuf)'.
+   If successful, the return value is true, else, it is false. */
+int vlsortput(VLSORT *sort, const char *kbuf, int ksiz, const char *vbuf, int vsiz);
+
+
+/* Store the records of a sorter into the database by bulk loading.
+   `sort' specifies a sorter.  The database of the sorter must be empty.
+   `fill' specifies the fill factor of leaves and nodes in percent as with `vlbulkbegin'.
+   If successful, the return value is true, else, it is false.
+   Sorted runs are merged by a heap and the merged records are stored by `vlbulkput' directly.
+   If there are more runs than can be read at once within the memory limit, they are merged
+   into longer runs in advance.  Values of records of the same key are stored as duplicated
+   values in order of addition. */
+int vlsortload(VLSORT *sort, int fill);
+
+
 
 /*************************************************************************************************
  * features for experts
@@ -628,7 +1117,8 @@ const char *vlcurvalcache(VILLA *villa, int *sp);
    The returned object is should be closed before the database handle is closed.  Even if plural
    cursors are fetched out of a database handle, they does not share the locations with each
    other.  Note that this function can be used only if the database handle is connected as a
-   reader. */
+   reader.  If the database handle is shared by threads, each cursor should be used by one thread
+   at a time and the leaf where it is stays in the cache until it moves to another leaf. */
 VLMULCUR *vlmulcuropen(VILLA *villa);
 
 
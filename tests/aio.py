@@ -0,0 +1,81 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import resource
+
+from villa import Villa, villa
+
+NUM = 20000
+
+def lowest_free_fd():
+    fd = 0
+    while True:
+        try:
+            os.fstat(fd)
+        except OSError:
+            return fd
+        fd += 1
+
+def use(db, tag):
+    # read pages in batches and one by one, then write them back through the engine
+    keys = ['%08d' % i for i in xrange(0, NUM, 7)]
+    assert db.get_many(keys) == dict((k, k * 8) for k in keys)
+    for k in keys[::3]:
+        assert db[k] == k * 8
+    for i in xrange(NUM, NUM + 2000):
+        db['%08d' % i] = tag
+    assert db.sync()
+    assert db.rnum() == NUM + 2000
+
+def main():
+    db = Villa('aio.db', 'n')
+    for i in xrange(NUM):
+        db['%08d' % i] = '%08d' % i * 8
+    db.close()
+
+    # without the flag pages are read and written by blocking calls
+    db = Villa('aio.db', 'r')
+    assert db.info()['aio_engine'] == 'none'
+    db.close()
+    db = Villa('aio.db', 'w')
+    assert db.info()['aio_engine'] == 'sync'
+    db.close()
+
+    db = Villa('aio.db', 'wa')
+    engine = db.info()['aio_engine']
+    print 'engine with the flag:', engine
+    assert engine in ('uring', 'thread')
+    use(db, 'ring')
+    db.close()
+
+    # no descriptor is left for the ring, so its setup fails and helper threads are used
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    limit = lowest_free_fd() + 1
+    db = None
+    try:
+        while db is None:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (limit, hard))
+            try:
+                db = Villa('aio.db', 'wa')
+            except villa.error:
+                limit += 1
+                assert limit < 64
+    finally:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (soft, hard))
+    engine = db.info()['aio_engine']
+    print 'engine without a descriptor for the ring:', engine
+    assert engine == 'thread'
+    use(db, 'fallback')
+    db.close()
+
+    db = Villa('aio.db', 'ra')
+    assert db.rnum() == NUM + 2000
+    for i in xrange(0, NUM, 11):
+        assert db['%08d' % i] == '%08d' % i * 8
+    for i in xrange(NUM, NUM + 2000):
+        assert db['%08d' % i] == 'fallback'
+    db.close()
+    os.remove('aio.db')
+
+if __name__ == '__main__':
+    main()
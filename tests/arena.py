@@ -0,0 +1,73 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa, villa
+
+HANDLES = 6
+
+def main():
+    rnd = random.Random(9)
+
+    # overwriting the records of cached leaves again and again does not pile up the memory of
+    # the replaced data, which is given back when the leaves are rebuilt
+    db = Villa('arena0.db', 'n')
+    for i in xrange(2000):
+        db['%05d' % i] = 'v' * 50
+    base = db.info()['leaf_cache_size']
+    for n in xrange(50):
+        for i in xrange(2000):
+            db['%05d' % i] = '%d' % n * rnd.randrange(1, 100)
+    size = db.info()['leaf_cache_size']
+    print 'leaf cache', base, '->', size
+    assert size < base * 3
+    # a value concatenated one piece at a time is extended where it is, or moved to a larger
+    # chunk, so the memory grows in proportion to the value rather than to the pieces
+    for n in xrange(2000):
+        db.db.put('%05d' % 7, 'x' * 10, villa.VL_DCAT)
+    assert db.get('%05d' % 7).endswith('x' * 20000)
+    print 'after concatenation', db.info()['leaf_cache_size']
+    assert db.info()['leaf_cache_size'] < size + 20000 * 6
+    db.db.close()
+
+    # handles in one process churning small caches keep their records intact, and their caches
+    # are charged the memory they hold
+    dbs = [Villa('arena%d.db' % i, 'n') for i in xrange(HANDLES)]
+    expects = [{} for i in xrange(HANDLES)]
+    for db in dbs:
+        db.db.setcache(32 * 1024, 8 * 1024)
+    for n in xrange(30000):
+        i = rnd.randrange(HANDLES)
+        k = '%06d' % rnd.randrange(20000)
+        if rnd.random() < 0.2:
+            v = os.urandom(rnd.randrange(1, 30)).encode('hex')
+            dbs[i].push(k, v)
+            expects[i].setdefault(k, []).append(v)
+        elif rnd.random() < 0.1 and k in expects[i]:
+            del dbs[i][k]
+            del expects[i][k][0]
+            if not expects[i][k]:
+                del expects[i][k]
+        else:
+            v = 'v' * rnd.randrange(200)
+            dbs[i][k] = v
+            expects[i].setdefault(k, [None])[0] = v
+    for db, expect in zip(dbs, expects):
+        info = db.info()
+        assert 0 < info['leaf_cache_size'] <= info['leaf_cache_peak']
+        assert info['leaf_cache_size'] < 64 * 1024
+        assert db.rnum() == sum(len(vs) for vs in expect.itervalues())
+        for k, vs in expect.iteritems():
+            assert db.getlist(k) == vs
+        db.db.close()
+    for i, expect in enumerate(expects):
+        db = Villa('arena%d.db' % i, 'r')
+        assert list(db.db.iterprefix('', villa.VL_JFORWARD)) == \
+            [(k, v) for k in sorted(expect) for v in expect[k]]
+        db.db.close()
+    for i in xrange(HANDLES):
+        os.remove('arena%d.db' % i)
+
+if __name__ == '__main__':
+    main()
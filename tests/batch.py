@@ -0,0 +1,98 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa, villa
+
+MODES = [villa.VL_DOVER, villa.VL_DKEEP, villa.VL_DCAT, villa.VL_DDUP]
+
+def items(db):
+    return list(db.db.iterprefix('', villa.VL_JFORWARD))
+
+def batch(rnd, n):
+    # unsorted keys, some of them repeated within the batch, with values long enough to split
+    # leaves in the middle of a batch
+    pairs = []
+    for i in xrange(n):
+        k = '%06d' % rnd.randrange(100000)
+        pairs.append((k, os.urandom(rnd.randrange(1, 60)).encode('hex')))
+        if rnd.random() < 0.05:
+            pairs.append((k, 'again'))
+    return pairs
+
+def main():
+    rnd = random.Random(15)
+
+    # records stored in batches are the same as those stored one by one in the same order
+    many = Villa('many.db', 'n')
+    one = Villa('one.db', 'n')
+    for n in xrange(12):
+        mode = MODES[n % len(MODES)]
+        pairs = batch(rnd, 10000)
+        try:
+            many.db.put_many(pairs, mode)
+            ok = True
+        except villa.error:
+            ok = False
+        kept = True
+        for k, v in pairs:
+            try:
+                one.db.put(k, v, mode)
+            except villa.error:
+                kept = False
+        # with VL_DKEEP, existing keys are skipped and reported at the end
+        assert ok == kept
+        assert many.rnum() == one.rnum()
+        assert items(many) == items(one)
+
+    # a dict is stored as its items
+    d = dict(batch(rnd, 5000))
+    assert many.db.put_many(d)
+    for k, v in d.iteritems():
+        one[k] = v
+    assert items(many) == items(one)
+
+    # keys are looked up in a batch, missing and repeated ones included
+    keys = [k for k, v in batch(rnd, 20000)] + ['missing', '', '999999x']
+    rnd.shuffle(keys)
+    got = many.db.get_many(keys)
+    assert got == dict((k, one.get(k)) for k in keys if one.get(k) is not None)
+    assert many.db.get_many([]) == {}
+
+    # a batch is undone with the transaction it belongs to
+    before = items(many)
+    assert many.tranbegin()
+    assert many.db.put_many(batch(rnd, 10000), villa.VL_DDUP)
+    assert many.tranabort()
+    assert items(many) == before
+    many.db.close()
+    one.db.close()
+
+    many = Villa('many.db', 'r')
+    assert items(many) == before
+    try:
+        many.db.put_many([('a', 'b')])
+        assert False
+    except villa.error:
+        pass
+    many.db.close()
+
+    # leaves loaded ahead of a batch with asynchronous I/O fit into a small cache, so that no
+    # more calls are made than by reading them one by one
+    keys = sorted(k for k, v in before)[::7]
+    calls = []
+    for flag in ['r', 'ra']:
+        many = Villa('many.db', flag)
+        many.db.setcache(64 * 1024)
+        villa.syscount(0)
+        assert len(many.db.get_many(keys)) == len(set(keys))
+        calls.append(villa.syscount(-1))
+        many.db.close()
+    print 'calls of lookups in a batch', calls
+    assert calls[1] < calls[0] * 1.1
+    os.remove('many.db')
+    os.remove('one.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,75 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa
+
+NUM = 50000
+# a page being loaded or split is charged before older pages are swept out, and its arena is
+# at most a chunk of the largest class
+SLACK = 64 * 1024
+
+def value(i):
+    return 'v' * (i % 300)
+
+def read(db, rnd):
+    for n in xrange(5000):
+        i = rnd.randrange(NUM)
+        assert db['%07d' % i] == value(i)
+    for k, v in db.db.iteritems():
+        pass
+
+def main():
+    rnd = random.Random(1)
+    db = Villa('budget.db', 'n')
+    for i in xrange(NUM):
+        db['%07d' % i] = value(i)
+    db.db.close()
+
+    # without limits, the caches hold most of the file
+    db = Villa('budget.db', 'r')
+    db.db.setcache(0, 0)
+    read(db, rnd)
+    info = db.info()
+    print 'unlimited', info['leaf_cache_size'], info['node_cache_size']
+    assert info['leaf_cache_size'] > info['file_size'] / 2
+    db.db.close()
+
+    # the memory of the caches stays within their limits while pages are read
+    for lsiz, nsiz in [(16384, 4096), (65536, 16384), (262144, 65536), (1 << 20, 1 << 18)]:
+        db = Villa('budget.db', 'r')
+        db.db.setcache(lsiz, nsiz)
+        read(db, rnd)
+        info = db.info()
+        print lsiz, nsiz, info['leaf_cache_size'], info['leaf_cache_peak'], \
+            info['node_cache_size'], info['node_cache_peak']
+        assert info['leaf_cache_size'] <= lsiz
+        assert info['leaf_cache_peak'] <= lsiz + SLACK
+        assert info['node_cache_peak'] <= nsiz + SLACK
+        db.db.close()
+
+    # and while pages are updated and split, except within a transaction; a leaf being rebuilt
+    # or divided holds a second arena for a moment
+    db = Villa('budget.db', 'w')
+    db.db.setcache(65536, 16384)
+    for n in xrange(20000):
+        i = rnd.randrange(NUM * 2)
+        db['%07d' % i] = value(i) * 2
+    info = db.info()
+    print 'updated', info['leaf_cache_size'], info['leaf_cache_peak']
+    assert info['leaf_cache_size'] <= 65536
+    assert info['leaf_cache_peak'] <= 65536 + SLACK * 2
+    assert db.tranbegin()
+    for i in xrange(0, NUM, 10):
+        db['%07d' % i] = value(i) * 3
+    assert db.info()['leaf_cache_size'] > 65536 + SLACK
+    assert db.trancommit()
+    for i in xrange(0, NUM, 1000):
+        assert db['%07d' % i] == value(i) * 3
+    assert db.info()['leaf_cache_size'] <= 65536
+    db.db.close()
+    os.remove('budget.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,62 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa, villa, bulkload
+
+def records():
+    for i in xrange(20000):
+        yield '%08d' % (i * 3), 'v%d' % i * (i % 13 + 1)
+
+def dump(path):
+    db = villa.open(path, 'r')
+    items = list(db.iterprefix('', villa.VL_JFORWARD))
+    rnum = db.rnum()
+    db.close()
+    return rnum, items
+
+def main():
+    # the same records stored one by one
+    db = Villa('put.db', 'n')
+    for k, v in records():
+        db.push(k, v)
+    db.push('%08d' % 300, 'dup')
+    db.close()
+    rnum, items = dump('put.db')
+    assert rnum == len(items) == 20001
+    assert items[0] == ('00000000', 'v0')
+
+    # a bulk loaded tree holds the same records in the same order, duplicates included
+    for fill in [100, 70, 1]:
+        recs = list(records())
+        recs.insert(101, ('%08d' % 300, 'dup'))
+        assert bulkload('bulk.db', recs, fill)
+        assert dump('bulk.db') == dump('put.db')
+        db = Villa('bulk.db', 'w')
+        assert db.getlist('%08d' % 300) == ['v100' * 10, 'dup']
+        # the tree is updated as usual after loading
+        for i in xrange(20000):
+            db['%08d' % (i * 3 + 1)] = 'new'
+        assert db.rnum() == 40001
+        db.close()
+        print 'fill', fill, 'file size', os.path.getsize('bulk.db')
+
+    # records out of order are refused
+    recs = list(records())
+    recs[5000], recs[5001] = recs[5001], recs[5000]
+    try:
+        bulkload('bulk.db', recs)
+        assert False
+    except villa.error:
+        pass
+    try:
+        bulkload('bulk.db', [('b', '1'), ('a', '2')])
+        assert False
+    except villa.error:
+        pass
+
+    os.remove('put.db')
+    os.remove('bulk.db')
+
+if __name__ == '__main__':
+    main()
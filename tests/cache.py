@@ -0,0 +1,37 @@
+# -*- encoding:utf-8 -*-
+
+from villa import Villa, villa
+
+def main():
+    db = Villa('cache.db', 'np')
+    for i in xrange(20000):
+        db['%08d' % i] = 'v' * 100
+    db.db.close()
+
+    db = Villa('cache.db', 'rp')
+    db.db.setcache(1024 * 1024)
+    db.db.setcachepolicy(villa.VL_CR2Q, villa.VL_CR2Q)
+
+    hot = ['%08d' % i for i in xrange(0, 20000, 800)]
+    for n in xrange(2):
+        for k in hot:
+            db.db.get(k)
+
+    info = db.db.info()
+    before = info['page_table_hits'] + info['page_table_misses']
+    for k, v in db.db.iteritems():
+        pass
+    info = db.db.info()
+    scan = info['page_table_hits'] + info['page_table_misses'] - before
+    for k in hot:
+        db.db.get(k)
+    info = db.db.info()
+    after = info['page_table_hits'] + info['page_table_misses'] - before - scan
+    print 'pages read by the scan:', scan
+    print 'pages of the hot set read again:', after
+    assert scan > len(hot)
+    assert after == 0
+    db.db.close()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,89 @@
+# -*- encoding:utf-8 -*-
+
+import hashlib
+import os
+import random
+
+from villa import Villa, villa
+
+def samples():
+    yield ''
+    yield 'a'
+    yield 'abc'
+    yield 'a' * 100000
+    yield 'abcd' * 5000
+    yield os.urandom(10000)
+    yield ''.join('%08d:%s\n' % (i, hashlib.md5(str(i % 50)).hexdigest()) for i in xrange(3000))
+
+def broken(data, dict=None):
+    try:
+        if dict is None:
+            villa.lzfdecode(data)
+        else:
+            villa.lzfdecode(data, dict)
+    except villa.error:
+        return True
+    return False
+
+def main():
+    # every sample comes back as it was
+    for data in samples():
+        enc = villa.lzfencode(data)
+        assert villa.lzfdecode(enc) == data
+    assert len(villa.lzfencode('abcd' * 5000)) < 1000
+
+    # a dictionary shortens data which resembles it and is needed to decode it
+    dict = ''.join('key%05d=%s;' % (i, hashlib.md5(str(i)).hexdigest()) for i in xrange(2000))
+    data = dict[30000:31000]
+    plain = villa.lzfencode(data)
+    enc = villa.lzfencode(data, dict)
+    assert len(enc) < len(plain) / 2
+    assert villa.lzfdecode(enc, dict) == data
+    assert broken(enc) or villa.lzfdecode(enc) != data
+    # only the last 65535 bytes of a dictionary are referred to
+    big = os.urandom(100000) + dict
+    assert villa.lzfdecode(villa.lzfencode(data, big), big) == data
+
+    # a truncated stream is refused
+    for data in samples():
+        enc = villa.lzfencode(data)
+        for n in range(len(enc) - 1, max(len(enc) - 200, -1), -1):
+            assert broken(enc[:n])
+
+    # a broken stream is refused or decoded into something else, but never crashes
+    rnd = random.Random(7)
+    for data in samples():
+        enc = villa.lzfencode(data)
+        for n in xrange(300):
+            buf = bytearray(enc)
+            for m in xrange(rnd.randint(1, 4)):
+                buf[rnd.randrange(len(buf))] = rnd.randrange(256)
+            broken(str(buf))
+            broken(str(buf), dict)
+
+    # sizes in the header which cannot be produced or do not fit into an int are refused
+    for head in ['\xff\xff\xff\xff\x7f', '\xff\xff\xff\xff\x08', '\x80\x80\x80\x80\x80\x01',
+                 '\xff\xff\xff\xff\x07', '\xe8\x07']:
+        assert broken(head + '\x10a')
+
+    # leaves of databases are compressed with the codecs given by flag letters
+    for flag in ['nf', 'nt']:
+        db = Villa('codec.db', flag)
+        for i in xrange(5000):
+            db['%08d' % i] = hashlib.md5(str(i % 100)).hexdigest() * 4
+        db.close()
+        db = Villa('codec.db', 'w')
+        for i in xrange(0, 5000, 3):
+            del db['%08d' % i]
+        db.close()
+        db = Villa('codec.db', 'r')
+        assert db.rnum() == 5000 - len(xrange(0, 5000, 3))
+        for i in xrange(5000):
+            assert db.get('%08d' % i) == (None if i % 3 == 0 else
+                                          hashlib.md5(str(i % 100)).hexdigest() * 4)
+        db.close()
+        print flag, 'file size', os.path.getsize('codec.db')
+    os.remove('codec.db')
+
+if __name__ == '__main__':
+    main()
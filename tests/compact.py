@@ -0,0 +1,73 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa
+
+NUM = 40000
+
+def value(i, tag=''):
+    return '%s%08d' % (tag, i) * 20
+
+def main():
+    db = Villa('compact.db', 'n')
+    for i in xrange(NUM):
+        db['%08d' % i] = value(i)
+    for i in xrange(NUM):
+        if i % 4:
+            del db['%08d' % i]
+    db.sync()
+    before = os.path.getsize('compact.db')
+    expect = dict(('%08d' % i, value(i)) for i in xrange(0, NUM, 4))
+
+    # compact a few pages at a time while a cursor walks the records and records are updated
+    it = db.db.iterkeys()
+    seen = []
+    steps = 0
+    n = NUM
+    while db.compact(10):
+        steps += 1
+        for m in xrange(5):
+            key = next(it, None)
+            if key is not None:
+                seen.append(key)
+        if steps % 3 == 0:
+            db['%08d' % n] = value(n, 'new')
+            expect['%08d' % n] = value(n, 'new')
+            n += 1
+        if steps % 7 == 0:
+            k = '%08d' % (steps * 4)
+            if k in expect:
+                del db[k]
+                del expect[k]
+        if steps % 11 == 0:
+            db.sync()
+        for k in ('%08d' % (steps * 40 % NUM), '%08d' % (n - 1)):
+            assert db.get(k) == expect.get(k)
+    seen.extend(it)
+    print 'compacted in', steps, 'steps'
+    assert steps > 10
+
+    # the cursor kept its order and every record is intact
+    assert seen == sorted(set(seen))
+    assert db.rnum() == len(expect)
+    for k, v in expect.iteritems():
+        assert db[k] == v
+    db.close()
+
+    after = os.path.getsize('compact.db')
+    print 'file size', before, '->', after
+    assert after < before / 2
+
+    db = Villa('compact.db', 'r')
+    assert db.rnum() == len(expect)
+    keys = list(db.iterkeys())
+    # iterkeys skips the first key
+    assert keys == sorted(expect)[1:]
+    for k in keys[::50]:
+        assert db[k] == expect[k]
+    db.close()
+    os.remove('compact.db')
+
+if __name__ == '__main__':
+    main()
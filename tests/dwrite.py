@@ -0,0 +1,70 @@
+# -*- encoding:utf-8 -*-
+
+import hashlib
+import os
+import resource
+import signal
+
+from villa import Villa
+
+def value(tag, i):
+    return ''.join(hashlib.md5('%s%d%d' % (tag, i, j)).hexdigest() for j in xrange(i % 8 + len(tag)))
+
+def crash(path, limit, tag):
+    # update every record in a transaction of a child process which cannot write files past
+    # `limit' bytes, so that the checkpoint of the commit is cut off in the middle of a write
+    # and the process dies without closing the database
+    pid = os.fork()
+    if pid == 0:
+        try:
+            db = Villa(path, 'wd')
+            db.tranbegin()
+            signal.signal(signal.SIGXFSZ, signal.SIG_IGN)
+            resource.setrlimit(resource.RLIMIT_FSIZE, (limit, limit))
+            for i in xrange(2000):
+                db['%05d' % i] = value(tag, i)
+            db.trancommit()
+        finally:
+            os._exit(0)
+    os.waitpid(pid, 0)
+
+def create(path):
+    db = Villa(path, 'nd')
+    for i in xrange(2000):
+        db['%05d' % i] = value('old', i)
+    db.close()
+    return os.path.getsize(path)
+
+def check(path, tag):
+    db = Villa(path, 'wd')
+    assert db.rnum() == 2000
+    for i in xrange(2000):
+        assert db['%05d' % i] == value(tag, i)
+    keys = list(db.iterkeys())
+    assert keys[-1] == '%05d' % 1999
+    db.close()
+    print path, 'restored with', repr(tag)
+
+def main():
+    log = 'dw.db.vlwal'
+
+    # the database file is torn while the pages are written back, but the double write log is
+    # complete, so the pages are restored from it
+    size = create('dw.db')
+    crash('dw.db', size + 4096, 'newer')
+    assert os.path.getsize(log) > 0
+    assert size < os.path.getsize('dw.db') <= size + 4096
+    check('dw.db', 'newer')
+
+    # the double write log itself is torn, so the database is left as of the last checkpoint
+    create('dw.db')
+    crash('dw.db', 4096, 'newer')
+    assert 0 < os.path.getsize(log) <= 4096
+    check('dw.db', 'old')
+
+    # the torn log was discarded by the recovery
+    check('dw.db', 'old')
+    assert not os.path.exists(log) or os.path.getsize(log) == 0
+
+if __name__ == '__main__':
+    main()
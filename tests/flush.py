@@ -0,0 +1,71 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa
+
+NUM = 20000
+KEYS = ['flushes', 'flush_writes', 'flush_calls', 'flush_bytes', 'last_flush_bytes']
+
+def stat(db):
+    info = db.info()
+    return dict((k, info[k]) for k in KEYS)
+
+def delta(a, b):
+    return dict((k, b[k] - a[k]) for k in KEYS)
+
+def main():
+    rnd = random.Random(24)
+    expect = {}
+    db = Villa('flush.db', 'n')
+    for i in xrange(NUM):
+        k = '%07d' % i
+        db[k] = expect[k] = 'v' * 100
+
+    # pages written back by a synchronization are sorted by offset, and adjacent ones are
+    # written with one call
+    a = stat(db)
+    db.sync()
+    b = stat(db)
+    d = delta(a, b)
+    print 'sync', d
+    assert d['flushes'] == 1
+    assert 0 < d['flush_calls'] <= d['flush_writes']
+    assert b['last_flush_bytes'] == d['flush_bytes'] >= NUM * 100
+    assert b['last_flush_bytes'] <= os.path.getsize('flush.db')
+
+    # nothing but the meta data is written when no page is dirty
+    db.sync()
+    c = stat(db)
+    assert c['last_flush_bytes'] < 4096
+    assert c['flush_bytes'] == b['flush_bytes'] + c['last_flush_bytes']
+
+    # pages updated here and there in a transaction are gathered at its commit
+    assert db.tranbegin()
+    for n in xrange(2000):
+        k = '%07d' % rnd.randrange(NUM)
+        db[k] = expect[k] = 'w' * rnd.randrange(50, 150)
+    a = stat(db)
+    assert db.trancommit()
+    b = stat(db)
+    d = delta(a, b)
+    print 'commit', d
+    assert d['flushes'] >= 1
+    assert d['flush_writes'] > db.info()['leaf_nodes'] / 2
+    assert d['flush_calls'] < d['flush_writes'] / 2
+    assert b['last_flush_bytes'] > 0
+    db.db.close()
+
+    # a reader writes nothing back
+    db = Villa('flush.db', 'r')
+    assert stat(db) == dict((k, 0) for k in KEYS)
+    assert db.rnum() == NUM
+    for k, v in expect.iteritems():
+        assert db[k] == v
+    assert stat(db) == dict((k, 0) for k in KEYS)
+    db.db.close()
+    os.remove('flush.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,77 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import struct
+
+from villa import Villa, villa
+
+LIMIT = 2 ** 31 - 1
+
+def magic(path):
+    with open(path, 'rb') as f:
+        return f.read(10)
+
+def stretch(path, size, large):
+    # make the file look as if it had grown to `size' bytes by appending a hole and updating the
+    # size recorded in the header
+    with open(path, 'r+b') as f:
+        f.truncate(size)
+        f.seek(24)
+        f.write(struct.pack('<q' if large else '<i', size))
+
+def fill(db, prefix, num):
+    for i in xrange(num):
+        db['%s%05d' % (prefix, i)] = os.urandom(200).encode('hex')
+
+def main():
+    # a new file has 32-bit offsets unless it is asked for
+    db = Villa('small.db', 'n')
+    fill(db, 'a', 100)
+    db.close()
+    assert magic('small.db').startswith('[depot]\n\f')
+
+    # a large file keeps its format when it is reopened without the flag
+    db = Villa('large.db', 'nl')
+    fill(db, 'a', 100)
+    db.close()
+    assert magic('large.db') == '[depot+]\n\f'
+    db = Villa('large.db', 'w')
+    fill(db, 'b', 100)
+    db.close()
+    assert magic('large.db') == '[depot+]\n\f'
+
+    # a large file grows beyond 2GB
+    stretch('large.db', LIMIT - 4096, True)
+    db = Villa('large.db', 'w')
+    fill(db, 'c', 100)
+    assert db.sync()
+    db.close()
+    assert os.path.getsize('large.db') > LIMIT
+    db = Villa('large.db', 'r')
+    assert db.rnum() == 300
+    assert len(db['c00099']) == 400
+    db.close()
+    print 'large file grew to', os.path.getsize('large.db')
+
+    # a file with 32-bit offsets refuses to grow past the limit but stays usable
+    stretch('small.db', LIMIT - 4096, False)
+    db = Villa('small.db', 'w')
+    fill(db, 'c', 100)
+    try:
+        ok = db.sync()
+    except villa.error:
+        ok = False
+    assert not ok
+    assert db['a00000']
+    db.close()
+    assert os.path.getsize('small.db') <= LIMIT
+    db = Villa('small.db', 'r')
+    assert len(db['a00099']) == 400
+    db.close()
+    print 'small file stopped at', os.path.getsize('small.db')
+
+    os.remove('small.db')
+    os.remove('large.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,110 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa, villa
+
+def value(rnd):
+    n = rnd.random()
+    if n < 0.05:
+        return os.urandom(rnd.randrange(20000, 70000))
+    if n < 0.1:
+        return ''
+    return os.urandom(rnd.randrange(1, 40)).encode('hex') + '\0' * rnd.randrange(3)
+
+def items(expect):
+    return [(k, v) for k in sorted(expect) for v in expect[k]]
+
+def check(db, expect):
+    assert db.rnum() == sum(len(vs) for vs in expect.itervalues())
+    for k, vs in expect.iteritems():
+        assert db[k] == vs[0]
+        assert db.getlist(k) == vs
+    assert list(db.db.iterprefix('', villa.VL_JFORWARD)) == items(expect)
+    assert list(db.db.itervalues()) == [v for k, v in items(expect)][1:]
+
+def update(db, expect, rnd, keys):
+    for n in xrange(20000):
+        k = rnd.choice(keys)
+        op = rnd.random()
+        if op < 0.3:
+            v = value(rnd)
+            db.push(k, v)
+            expect.setdefault(k, []).append(v)
+        elif op < 0.5:
+            v = value(rnd)
+            db[k] = v
+            if k in expect:
+                expect[k][0] = v
+            else:
+                expect[k] = [v]
+        elif op < 0.65:
+            v = value(rnd)
+            db.db.put(k, v, villa.VL_DCAT)
+            if k in expect:
+                expect[k][0] += v
+            else:
+                expect[k] = [v]
+        elif op < 0.75:
+            v = value(rnd)
+            try:
+                db.db.put(k, v, villa.VL_DKEEP)
+                assert k not in expect
+                expect[k] = [v]
+            except villa.error:
+                assert k in expect
+        elif op < 0.9:
+            if k in expect:
+                del db[k]
+                del expect[k][0]
+                if not expect[k]:
+                    del expect[k]
+        else:
+            # values read from a leaf stay valid while the leaf is updated and reloaded
+            got = db.getlist(k)
+            assert got == expect.get(k, [])
+            if k in expect:
+                db.push(k, got[0])
+                expect[k].append(got[0])
+
+def main():
+    rnd = random.Random(5)
+    keys = ['%06d' % rnd.randrange(1000000) for i in xrange(3000)]
+    expect = {}
+
+    # records are updated in leaves loaded from pages and evicted again and again by a small
+    # cache, with duplicated keys, concatenated values and values longer than leaves
+    db = Villa('leaf.db', 'n')
+    db.db.setcache(64 * 1024, 16 * 1024)
+    update(db, expect, rnd, keys)
+    check(db, expect)
+    db.db.close()
+
+    db = Villa('leaf.db', 'r')
+    db.db.setcache(64 * 1024, 16 * 1024)
+    check(db, expect)
+    db.db.close()
+
+    # the same in a large cache, within a transaction aborted and then committed
+    db = Villa('leaf.db', 'w')
+    saved = dict((k, list(vs)) for k, vs in expect.iteritems())
+    assert db.tranbegin()
+    update(db, expect, rnd, keys)
+    check(db, expect)
+    assert db.tranabort()
+    expect = saved
+    check(db, expect)
+    assert db.tranbegin()
+    update(db, expect, rnd, keys)
+    assert db.trancommit()
+    check(db, expect)
+    db.db.close()
+
+    db = Villa('leaf.db', 'r')
+    check(db, expect)
+    db.db.close()
+    os.remove('leaf.db')
+
+if __name__ == '__main__':
+    main()
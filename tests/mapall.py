@@ -0,0 +1,63 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa, villa
+
+def value(i, n):
+    return ('%d:%d;' % (i, n)) * (i % 13 + 1)
+
+def check(db, expect):
+    assert db.rnum() == len(expect)
+    for k, v in expect.iteritems():
+        assert db[k] == v
+    assert list(db.db.iterprefix('', villa.VL_JFORWARD)) == sorted(expect.items())
+
+def main():
+    rnd = random.Random(3)
+    expect = {}
+
+    # the file grows far beyond the region mapped when it was opened, and is remapped while
+    # records are read from it and updated
+    db = Villa('map.db', 'nm')
+    db.db.setcache(64 * 1024, 16 * 1024)
+    sizes = []
+    for n in xrange(8):
+        for i in xrange(n * 4000, (n + 1) * 4000):
+            k = '%07d' % rnd.randrange(1000000)
+            db[k] = expect[k] = value(i, n)
+        for k in rnd.sample(sorted(expect), 300):
+            assert db[k] == expect[k]
+            if rnd.random() < 0.3:
+                del db[k]
+                del expect[k]
+            else:
+                db[k] = expect[k] = value(len(k), n) * 5
+        db.sync()
+        sizes.append(os.path.getsize('map.db'))
+    print 'file sizes', sizes
+    assert sizes[-1] > sizes[0] * 4
+    check(db, expect)
+    db.db.close()
+
+    # a reader maps the whole file, and a writer reopening it without the flag sees the same
+    db = Villa('map.db', 'rm')
+    check(db, expect)
+    db.db.close()
+    db = Villa('map.db', 'w')
+    for k in rnd.sample(sorted(expect), 1000):
+        db[k] = expect[k] = 'x' * 3000
+    db.db.close()
+    db = Villa('map.db', 'wm')
+    check(db, expect)
+    assert db.optimize()
+    check(db, expect)
+    db.db.close()
+    db = Villa('map.db', 'rm')
+    check(db, expect)
+    db.db.close()
+    os.remove('map.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,94 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa
+
+PREFIXES = ['p%d-' % i for i in xrange(10)]
+NUM = 3000
+
+def value():
+    return os.urandom(40).encode('hex')
+
+def fill(db, expect, prefix):
+    for i in xrange(NUM):
+        k = '%s%05d' % (prefix, i)
+        if k not in expect:
+            db[k] = expect[k] = value()
+
+def check(db, expect):
+    assert db.rnum() == len(expect)
+    for k, v in expect.iteritems():
+        assert db[k] == v
+    # iterkeys skips the first key
+    assert list(db.iterkeys()) == sorted(expect)[1:]
+
+def main():
+    rnd = random.Random(11)
+    db = Villa('merge.db', 'n')
+    expect = {}
+    for p in PREFIXES:
+        fill(db, expect, p)
+    db.sync()
+    base = os.path.getsize('merge.db')
+    leaves = db.info()['leaf_nodes']
+    print 'file size', base, 'leaves', leaves
+
+    # half of the records are removed in ranges, by deleting each record or by truncating a
+    # prefix, and stored again; the freed leaves are merged away and their pages reused
+    sizes = []
+    for n in xrange(6):
+        victims = rnd.sample(PREFIXES, 5)
+        for p in victims:
+            if n % 2:
+                assert db.truncate(p)
+            else:
+                for i in xrange(NUM):
+                    del db['%s%05d' % (p, i)]
+            for i in xrange(NUM):
+                del expect['%s%05d' % (p, i)]
+        db.sync()
+        assert db.info()['leaf_nodes'] < leaves * 0.6
+        check(db, expect)
+        for p in victims:
+            fill(db, expect, p)
+        db.sync()
+        assert db.info()['leaf_nodes'] < leaves * 1.1
+        sizes.append(os.path.getsize('merge.db'))
+    print 'file sizes after ranges', sizes
+    assert max(sizes) < base * 1.1
+    assert sizes[-1] <= sizes[0] * 1.02
+    check(db, expect)
+
+    # records deleted here and there leave leaves merged away as well; the slack left in the
+    # pages rewritten meanwhile is given back by compaction
+    sizes = []
+    for n in xrange(4):
+        for k in rnd.sample(sorted(expect), len(expect) * 9 / 10):
+            del db[k]
+            del expect[k]
+        db.sync()
+        assert db.info()['leaf_nodes'] < leaves * 0.3
+        check(db, expect)
+        for p in PREFIXES:
+            fill(db, expect, p)
+        db.sync()
+        sizes.append(os.path.getsize('merge.db'))
+    print 'file sizes after scattered deletes', sizes
+    assert max(sizes) < base * 1.5
+    while db.compact():
+        pass
+    db.sync()
+    print 'file size after compaction', os.path.getsize('merge.db')
+    assert os.path.getsize('merge.db') < base * 1.15
+    check(db, expect)
+    db.close()
+
+    db = Villa('merge.db', 'r')
+    check(db, expect)
+    db.close()
+    os.remove('merge.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,47 @@
+# -*- encoding:utf-8 -*-
+
+import signal
+
+from villa import Villa
+
+def main():
+    # a hang of the commit below is a failure
+    signal.alarm(120)
+
+    db = Villa('pin.db', 'n')
+    db.settuning(8, 4, 0, 16)
+    for i in xrange(20000):
+        db['%08d' % i] = str(i)
+
+    # every non-leaf node is pinned, far more than the cache holds
+    assert db.setpinlevel(-1)
+    info = db.info()
+    print 'non-leaf nodes:', info['non_leaf_nodes'], 'pinned:', info['pinned_nodes']
+    assert info['non_leaf_nodes'] > 16
+    assert 0 < info['pinned_nodes'] <= 16
+
+    assert db.tranbegin()
+    for i in xrange(20000, 30000):
+        db['%08d' % i] = str(i)
+    assert db.trancommit()
+    assert db.rnum() == 30000
+
+    assert db.tranbegin()
+    for i in xrange(30000, 40000):
+        db['%08d' % i] = str(i)
+    assert db.tranabort()
+    assert db.rnum() == 30000
+
+    for i in xrange(0, 30000, 7):
+        assert db['%08d' % i] == str(i)
+    assert db.get('%08d' % 30000) is None
+    print db.info()['pinned_nodes'], 'pinned after the transactions'
+    db.close()
+
+    db = Villa('pin.db', 'r')
+    assert db.rnum() == 30000
+    assert list(db.iterkeys())[-1] == '%08d' % 29999
+    db.close()
+
+if __name__ == '__main__':
+    main()
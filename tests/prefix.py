@@ -0,0 +1,70 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+
+from villa import Villa, villa
+
+def keys():
+    for a in xrange(20):
+        for b in xrange(50):
+            base = '/srv/data/customers/region-%02d/account-%05d/' % (a, b * 37)
+            yield base
+            for c in xrange(20):
+                yield base + 'orders/%08d' % c
+                yield base + 'orders/%08d\0\xff' % c
+            yield base + 'z' * 300
+
+def check(db, expect):
+    assert db.rnum() == len(expect)
+    for k, v in expect.iteritems():
+        assert db[k] == v
+    for p in ['/srv/data/customers/region-07/', '/srv/data/customers/region-13/account-00185/',
+              '/srv/data/customers/region-19/account-01813/orders/0000001']:
+        got = [(k, v) for k, v in db.db.iterprefix(p, villa.VL_JFORWARD) if k.startswith(p)]
+        assert got == sorted((k, v) for k, v in expect.iteritems() if k.startswith(p))
+    assert list(db.db.iterprefix('', villa.VL_JFORWARD)) == sorted(expect.items())
+
+def main():
+    rnd = random.Random(13)
+    expect = dict((k, '%d' % n) for n, k in enumerate(keys()))
+
+    # keys sharing long prefixes are stored with the prefix of the previous key left out, and
+    # found by searching the restart points of each page
+    db = Villa('prefix.db', 'n')
+    order = expect.keys()
+    rnd.shuffle(order)
+    for k in order:
+        db[k] = expect[k]
+    check(db, expect)
+    db.db.close()
+    size = os.path.getsize('prefix.db')
+    raw = sum(len(k) for k in expect)
+    print 'file size', size, 'key bytes', raw
+    assert size < raw / 2
+
+    # removing keys changes the prefixes shared with the following ones
+    db = Villa('prefix.db', 'w')
+    for k in rnd.sample(order, len(order) / 3):
+        del db[k]
+        del expect[k]
+    for k in rnd.sample(sorted(expect), 2000):
+        db[k] = expect[k] = 'updated' * rnd.randrange(5)
+    for k in rnd.sample(sorted(expect), 2000):
+        short = k[:rnd.randrange(len(k))]
+        db[short] = expect[short] = 'short'
+    check(db, expect)
+    db.db.close()
+
+    db = Villa('prefix.db', 'r')
+    check(db, expect)
+    db.db.close()
+
+    db = Villa('prefix.db', 'w')
+    assert db.optimize()
+    check(db, expect)
+    db.db.close()
+    os.remove('prefix.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,105 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import shutil
+
+from villa import Villa, villa
+
+PATH = 'ptab.db'
+TABLE = PATH + '.vlpt'
+HEADSIZ = 32
+NUM = 20000
+
+def value(i, tag):
+    return '%s%08d' % (tag, i) * (i % 5 + 2)
+
+def update(mode, tag):
+    db = Villa(PATH, mode)
+    for i in xrange(0, NUM, 2):
+        db['%08d' % i] = value(i, tag)
+    db.close()
+
+def check(mode, tag):
+    # every record is read back whether the table is used or not
+    db = Villa(PATH, mode)
+    assert db.rnum() == NUM
+    for i in xrange(0, NUM, 3):
+        assert db['%08d' % i] == value(i, tag if i % 2 == 0 else 'base')
+    info = db.info()
+    db.close()
+    return info['page_table_hits'], info['page_table_misses']
+
+def main():
+    db = Villa(PATH, 'np')
+    for i in xrange(NUM):
+        db['%08d' % i] = value(i, 'base')
+    db.close()
+    hits, misses = check('rp', 'base')
+    print 'valid table:', hits, 'hits', misses, 'misses'
+    assert hits > 0 and misses == 0
+
+    # a missing table is not used by a reader and is rebuilt by a writer
+    os.remove(TABLE)
+    assert check('rp', 'base') == (0, 0)
+    assert not os.path.exists(TABLE)
+    update('wp', 'one')
+    hits, misses = check('rp', 'one')
+    assert hits > 0 and misses == 0
+
+    # a table left behind by a later writer is stale
+    shutil.copy(TABLE, 'stale.vlpt')
+    update('wp', 'two')
+    shutil.copy(TABLE, 'fresh.vlpt')
+    shutil.copy('stale.vlpt', TABLE)
+    assert check('rp', 'two') == (0, 0)
+    update('wp', 'three')
+    hits, misses = check('rp', 'three')
+    assert hits > 0 and misses == 0
+
+    # so is the table of a database updated by a writer without the table
+    update('w', 'four')
+    assert check('rp', 'four') == (0, 0)
+    update('wp', 'five')
+    hits, misses = check('rp', 'five')
+    assert hits > 0 and misses == 0
+
+    # entries of a stale table under a valid header are verified and count as misses
+    shutil.copy(TABLE, 'fresh.vlpt')
+    update('wp', 'six')
+    with open(TABLE, 'rb') as f:
+        head = f.read(HEADSIZ)
+    with open('fresh.vlpt', 'rb') as f:
+        f.seek(HEADSIZ)
+        body = f.read()
+    with open(TABLE, 'wb') as f:
+        f.write(head + body)
+    hits, misses = check('rp', 'six')
+    print 'forged table:', hits, 'hits', misses, 'misses'
+    assert misses > 0
+
+    # a broken table is ignored by a reader and rebuilt by a writer
+    for data in ['', 'garbage', os.urandom(HEADSIZ + 4096)]:
+        with open(TABLE, 'wb') as f:
+            f.write(data)
+        assert check('rp', 'six') == (0, 0)
+        assert check('wp', 'six')[1] > 0
+        hits, misses = check('rp', 'six')
+        assert hits > 0 and misses == 0
+
+    # a table which cannot be created makes a writer fail cleanly
+    os.remove(TABLE)
+    os.mkdir(TABLE)
+    try:
+        Villa(PATH, 'wp')
+        assert False
+    except villa.error:
+        pass
+    assert check('rp', 'six') == (0, 0)
+    assert check('w', 'six') == (0, 0)
+    os.rmdir(TABLE)
+
+    for name in [PATH, 'stale.vlpt', 'fresh.vlpt']:
+        os.remove(name)
+
+if __name__ == '__main__':
+    main()
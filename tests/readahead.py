@@ -0,0 +1,48 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa, villa
+
+NUM = 50000
+
+def scan(flag, max, cache=0):
+    db = Villa('ahead.db', flag)
+    db.db.setreadahead(max)
+    if cache:
+        db.db.setcache(cache)
+    villa.syscount(0)
+    got = list(db.db.iterprefix('', villa.VL_JFORWARD))
+    calls = villa.syscount(-1)
+    # a scan starting in the middle moves forward as well
+    assert list(db.iter('00123')) == [('00123%02d' % i, 'v' * ((12300 + i) % 300))
+                                      for i in xrange(100)]
+    db.db.close()
+    return got, calls
+
+def main():
+    db = Villa('ahead.db', 'n')
+    for i in xrange(NUM):
+        db['%07d' % i] = 'v' * (i % 300)
+    db.db.close()
+    expect = [('%07d' % i, 'v' * (i % 300)) for i in xrange(NUM)]
+
+    # scans return the same records whether leaves are read ahead or not, with any window, and
+    # when leaves read ahead are swept out of a small cache before the cursor reaches them
+    for flag in ['r', 'ra']:
+        calls = {}
+        for max in [0, 1, 4, -1, 1000]:
+            for cache in [0, 64 * 1024]:
+                got, calls[max, cache] = scan(flag, max, cache)
+                assert got == expect
+        print flag, 'calls of scans', sorted(calls.items())
+        # leaves read ahead with asynchronous I/O are loaded with fewer calls, and the window
+        # shrinks to what a small cache holds so that they are not read twice
+        if flag == 'ra':
+            assert calls[-1, 0] < calls[0, 0] * 0.7
+            for max in [1, 4, -1, 1000]:
+                assert calls[max, 64 * 1024] < calls[0, 64 * 1024] * 1.5
+    os.remove('ahead.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,57 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+import threading
+
+from villa import Villa
+
+NUM = 50000
+THREADS = 8
+
+def value(i):
+    return '%08d' % i * (i % 9 + 1)
+
+def main():
+    db = Villa('readers.db', 'n')
+    for i in xrange(NUM):
+        db['%08d' % i] = value(i)
+    db.close()
+
+    # threads share one reader whose cache is small enough to be replaced all the time
+    db = Villa('readers.db', 'rs')
+    db.setcache(256 * 1024, 64 * 1024)
+    errors = []
+
+    def work(seed):
+        rnd = random.Random(seed)
+        try:
+            for n in xrange(3000):
+                i = rnd.randrange(NUM + 100)
+                k = '%08d' % i
+                if i < NUM:
+                    assert db[k] == value(i)
+                else:
+                    assert db.get(k) is None
+                if n % 100 == 0:
+                    keys = ['%08d' % rnd.randrange(NUM) for m in xrange(50)]
+                    got = db.get_many(keys)
+                    assert got == dict((k, value(int(k))) for k in keys)
+        except Exception as e:
+            errors.append(repr(e))
+
+    threads = [threading.Thread(target=work, args=(i,)) for i in xrange(THREADS)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    info = db.info()
+    print 'cache peak', info['leaf_cache_peak'], 'errors', errors[:3]
+    assert not errors
+    assert info['leaf_cache_peak'] <= 256 * 1024 * 2
+    assert db.rnum() == NUM
+    db.close()
+    os.remove('readers.db')
+
+if __name__ == '__main__':
+    main()
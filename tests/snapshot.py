@@ -0,0 +1,86 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa, villa
+
+NUM = 5000
+
+def value(tag, i):
+    return '%s%05d' % (tag, i) * (i % 7 + 3)
+
+def check(sp, expect):
+    assert sp.rnum() == len(expect)
+    for k, v in expect.iteritems():
+        assert sp[k] == v
+    assert list(sp.iterprefix('', villa.VL_JFORWARD)) == sorted(expect.items())
+
+def main():
+    db = Villa('snap.db', 'n')
+    old = {}
+    for i in xrange(NUM):
+        k = '%05d' % i
+        db[k] = old[k] = value('old', i)
+
+    # updates, deletes and new records made after a snapshot are not seen through it, even when
+    # the pages are written back and leaves are split or merged away
+    sp = db.snapshot()
+    assert not sp.writable()
+    new = dict(old)
+    for i in xrange(0, NUM, 2):
+        k = '%05d' % i
+        db[k] = new[k] = value('new', i) * 3
+    for i in xrange(1, NUM, 3):
+        k = '%05d' % i
+        del db[k]
+        del new[k]
+    for i in xrange(NUM, NUM + 2000):
+        k = '%05d' % i
+        db[k] = new[k] = value('add', i)
+    db.sync()
+    check(sp, old)
+    assert db.rnum() == len(new)
+
+    # a later snapshot sees the state at its own moment while the earlier one is kept
+    sp2 = db.snapshot()
+    assert db.truncate('00')
+    assert db.rnum() == len([k for k in new if not k.startswith('00')])
+    check(sp, old)
+    check(sp2, new)
+    assert sp.get('00001') == value('old', 1)
+    assert sp2.get('00001') is None
+
+    # a snapshot cannot be updated
+    try:
+        sp['00000'] = 'x'
+        assert False
+    except villa.error:
+        pass
+
+    # the database is not closed while its snapshots are open
+    try:
+        db.db.close()
+        assert False
+    except villa.error:
+        pass
+    sp.close()
+    try:
+        db.db.close()
+        assert False
+    except villa.error:
+        pass
+    sp2.close()
+    for k in list(new):
+        if k.startswith('00'):
+            del new[k]
+    check(db.db, new)
+    db.db.close()
+
+    # the database is left as the writer updated it
+    db = Villa('snap.db', 'r')
+    check(db.db, new)
+    db.db.close()
+    os.remove('snap.db')
+
+if __name__ == '__main__':
+    main()
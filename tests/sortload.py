@@ -0,0 +1,60 @@
+# -*- encoding:utf-8 -*-
+
+import glob
+import os
+import random
+
+from villa import Villa, villa, sortload
+
+NUM = 60000
+
+def records():
+    rnd = random.Random(3)
+    keys = range(NUM)
+    rnd.shuffle(keys)
+    for i in keys:
+        yield '%08d' % i, 'v%d' % i * (i % 7 + 1)
+    # equal keys are kept as duplicates
+    for i in xrange(0, NUM, 1000):
+        yield '%08d' % i, 'dup'
+
+def spilled(path, runs):
+    # pass the records through while counting the sorted runs written beside the database
+    for rec in records():
+        yield rec
+    runs.append(len(glob.glob(path + '*.*')))
+
+def dump(path):
+    db = villa.open(path, 'r')
+    items = list(db.iterprefix('', villa.VL_JFORWARD))
+    rnum = db.rnum()
+    db.close()
+    return rnum, items
+
+def main():
+    db = Villa('put.db', 'n')
+    for k, v in records():
+        db.push(k, v)
+    db.close()
+    expect = dump('put.db')
+    assert expect[0] == len(expect[1]) == NUM + NUM / 1000
+
+    # the smallest buffer makes many runs which are merged in more than one pass
+    for memory, threads in [(1, 1), (1, 2), (1 << 20, 4), (0, 1)]:
+        runs = []
+        assert sortload('sort.db', spilled('sort.db', runs), 100, memory, threads)
+        print 'memory', memory, 'threads', threads, 'runs', runs[0]
+        if memory == 1:
+            assert runs[0] > 10
+        assert dump('sort.db') == expect
+        db = Villa('sort.db', 'r')
+        assert db.getlist('%08d' % 5000) == ['v5000' * 3, 'dup']
+        db.close()
+        # the runs are removed
+        assert glob.glob('sort.db*') == ['sort.db']
+
+    os.remove('put.db')
+    os.remove('sort.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,56 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa, villa
+
+NUM = 20000
+
+def lookups(db):
+    # the system calls made by each of some retrievals scattered over the file
+    counts = []
+    for i in xrange(0, NUM, 997):
+        before = villa.syscount()
+        assert db['%06d' % i] == 'v' * ((i % 7 + 3) * 30)
+        counts.append(villa.syscount() - before)
+    return counts
+
+def main():
+    assert villa.syscount() == -1
+    db = Villa('sys.db', 'np')
+    for i in xrange(NUM):
+        db['%06d' % i] = 'v' * ((i % 7 + 3) * 30)
+    db.db.close()
+
+    # a page is read with the header of its record and the rest of it, with positional calls
+    # and no seek, so a retrieval on cold caches loading a leaf, a node and the root makes two
+    # calls for each page, and one if the location of the page is looked up in the table
+    for flag, calls in [('r', 2), ('rp', 1)]:
+        db = Villa('sys.db', flag)
+        assert villa.syscount(0) == -1
+        cold = lookups(db)
+        print flag, 'calls of cold lookups', cold
+        assert all(0 < c <= calls * 3 for c in cold)
+        assert sum(cold) <= calls * (len(cold) + db.info()['non_leaf_nodes'])
+        # pages in the cache are not read again
+        assert sum(lookups(db)) == 0
+        assert villa.syscount(-1) == sum(cold)
+        db.db.close()
+
+    # the pages of a file mapped into memory are read without any call
+    db = Villa('sys.db', 'rm')
+    villa.syscount(0)
+    assert sum(lookups(db)) == 0
+    villa.syscount(-1)
+    db.db.close()
+
+    # nothing is counted while counting is disabled
+    db = Villa('sys.db', 'r')
+    lookups(db)
+    assert villa.syscount() == -1
+    db.db.close()
+    os.remove('sys.db')
+    os.remove('sys.db.vlpt')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,68 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa
+
+PREFIXES = ['a', 'b', 'ba', 'c', 'd']
+
+def fill(db):
+    for p in PREFIXES:
+        for i in xrange(3000):
+            db['%s%05d' % (p, i)] = '%s%05d' % (p, i) * 10
+
+def check(db, gone):
+    keys = list(db.db.iterkeys())
+    want = ['%s%05d' % (p, i) for p in sorted(PREFIXES) for i in xrange(3000)
+            if not any(('%s%05d' % (p, i)).startswith(g) for g in gone)]
+    # iterkeys skips the first key
+    assert keys == want[1:], (len(keys), len(want))
+    assert db.rnum() == len(want)
+    for k in want[::97]:
+        assert db[k] == k * 10
+
+def main():
+    db = Villa('trun.db', 'n')
+    fill(db)
+
+    # the keys with the prefix are removed, whole leaves or not, and nothing else
+    assert db.truncate('b')
+    check(db, ['b'])
+    assert not db.truncate('b')
+    assert not db.truncate('zz')
+
+    # the jump mode of former versions is accepted and ignored
+    assert db.db.trunprefix('d', 1)
+    check(db, ['b', 'd'])
+
+    # a range removed in a transaction comes back when it is aborted
+    assert db.tranbegin()
+    assert db.truncate('c')
+    check(db, ['b', 'c', 'd'])
+    assert db.tranabort()
+    check(db, ['b', 'd'])
+    db.close()
+
+    db = Villa('trun.db', 'r')
+    check(db, ['b', 'd'])
+    db.close()
+
+    # the pages of dropped leaves are reused
+    db = Villa('trun.db', 'w')
+    fill(db)
+    db.sync()
+    size = os.path.getsize('trun.db')
+    for n in xrange(5):
+        for p in PREFIXES:
+            db.truncate(p)
+        assert db.rnum() == 0
+        fill(db)
+        db.sync()
+    check(db, [])
+    print 'file size', size, '->', os.path.getsize('trun.db')
+    assert os.path.getsize('trun.db') < size * 1.5
+    db.close()
+    os.remove('trun.db')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,90 @@
+# -*- encoding:utf-8 -*-
+
+import os
+
+from villa import Villa
+
+def crash(path, work):
+    # run the work in a child process which dies without closing the database
+    pid = os.fork()
+    if pid == 0:
+        db = Villa(path, 'wj')
+        work(db)
+        os._exit(0)
+    os.waitpid(pid, 0)
+
+def committed(db):
+    db.tranbegin()
+    for i in xrange(1000):
+        db['a%05d' % i] = 'committed'
+    db.trancommit()
+
+def uncommitted(db):
+    committed(db)
+    db.tranbegin()
+    for i in xrange(1000):
+        db['a%05d' % i] = 'lost'
+        db['b%05d' % i] = 'lost'
+
+def twocommits(db):
+    committed(db)
+    db.tranbegin()
+    for i in xrange(1000):
+        db['b%05d' % i] = 'second'
+    db.trancommit()
+
+def check(path, bnum, bval):
+    db = Villa(path, 'wj')
+    assert db.rnum() == 1100 + bnum
+    for i in xrange(1000):
+        assert db['a%05d' % i] == 'committed'
+        assert db.get('b%05d' % i) == (bval if i < bnum else None)
+    for i in xrange(100):
+        assert db['base%03d' % i] == 'base'
+    db.close()
+    print path, 'recovered', 1100 + bnum, 'records'
+
+def create(path):
+    db = Villa(path, 'nj')
+    for i in xrange(100):
+        db['base%03d' % i] = 'base'
+    db.close()
+
+def main():
+    wal = 'wal.db.vlwal'
+
+    # a transaction not committed is rolled back
+    create('wal.db')
+    crash('wal.db', uncommitted)
+    assert os.path.getsize(wal) > 0
+    check('wal.db', 0, None)
+
+    # both transactions are redone from the log
+    create('wal.db')
+    crash('wal.db', twocommits)
+    check('wal.db', 1000, 'second')
+
+    # a torn frame at the end of the log is ignored
+    create('wal.db')
+    crash('wal.db', twocommits)
+    with open(wal, 'r+b') as f:
+        f.truncate(os.path.getsize(wal) - 3)
+    check('wal.db', 0, None)
+
+    # garbage after the last frame is ignored
+    create('wal.db')
+    crash('wal.db', twocommits)
+    with open(wal, 'ab') as f:
+        f.write('\x02\x10\x00\x00\x00garbage')
+    check('wal.db', 1000, 'second')
+
+    # a log flipped in the middle of the last frame is ignored from there
+    create('wal.db')
+    crash('wal.db', twocommits)
+    with open(wal, 'r+b') as f:
+        f.seek(os.path.getsize(wal) - 100)
+        f.write('\xff' * 8)
+    check('wal.db', 0, None)
+
+if __name__ == '__main__':
+    main()
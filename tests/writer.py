@@ -0,0 +1,92 @@
+# -*- encoding:utf-8 -*-
+
+import os
+import random
+import threading
+
+from villa import Villa
+
+NUM = 20000
+READERS = 4
+
+def value(i, gen):
+    return '%08d:%d:' % (i, gen) + 'x' * (i % 50 + gen % 7 * 30)
+
+def parse(k, v):
+    # a value is valid if it belongs to the key and is well formed, whatever its generation
+    i, gen, pad = v.split(':')
+    assert i == k and v == value(int(i), int(gen))
+    return int(gen)
+
+def main():
+    db = Villa('writer.db', 'n')
+    for i in xrange(NUM):
+        db['%08d' % i] = value(i, 0)
+    db.close()
+
+    # one thread updates the records, splitting and merging leaves, while others read them
+    db = Villa('writer.db', 'ws')
+    db.setcache(512 * 1024, 128 * 1024)
+    done = threading.Event()
+    errors = []
+    reads = [0]
+
+    def write():
+        rnd = random.Random(1)
+        try:
+            for gen in xrange(1, 6):
+                for n in xrange(4000):
+                    i = rnd.randrange(NUM)
+                    db['%08d' % i] = value(i, gen)
+                for n in xrange(500):
+                    i = rnd.randrange(NUM)
+                    db.db.put('%08d' % (NUM + i), value(NUM + i, gen))
+                db.db.put_many([('%08d' % i, value(i, gen)) for i in xrange(gen, NUM, 97)])
+                for n in xrange(500):
+                    try:
+                        del db['%08d' % (NUM + rnd.randrange(NUM))]
+                    except KeyError:
+                        pass
+        except Exception as e:
+            errors.append('writer: ' + repr(e))
+        finally:
+            done.set()
+
+    def read(seed):
+        rnd = random.Random(seed)
+        try:
+            while not done.is_set():
+                i = rnd.randrange(NUM)
+                k = '%08d' % i
+                parse(k, db[k])
+                v = db.get('%08d' % (NUM + i))
+                if v is not None:
+                    parse('%08d' % (NUM + i), v)
+                reads[0] += 1
+        except Exception as e:
+            errors.append('reader: ' + repr(e))
+
+    threads = [threading.Thread(target=read, args=(i,)) for i in xrange(READERS)]
+    threads.append(threading.Thread(target=write))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    print 'reads while writing', reads[0], 'errors', errors[:3]
+    assert not errors
+    assert reads[0] > 0
+    db.close()
+
+    # the last value written for each key is stored
+    db = Villa('writer.db', 'r')
+    keys = list(db.iterkeys())
+    assert db.rnum() == len(keys) + 1
+    for k in keys[::7]:
+        parse(k, db[k])
+    for i in xrange(5, NUM, 97):
+        assert parse('%08d' % i, db['%08d' % i]) == 5
+    db.close()
+    os.remove('writer.db')
+
+if __name__ == '__main__':
+    main()
@@ -2,6 +2,14 @@
 
 from . import villa
 
+
+def bulkload(path, iterable, fill=100):
+    return villa.bulkload(path, iterable, fill)
+
+
+def sortload(path, iterable, fill=100, memory=0, threads=1):
+    return villa.sortload(path, iterable, fill, memory, threads)
+
 class Villa(object):
     """docstring for Villa"""
 
@@ -16,7 +24,7 @@ class Villa(object):
             yield key, value
 
     def truncate(self, prefix):
-        return self.db.trunprefix(prefix, villa.VL_JFORWARD)
+        return self.db.trunprefix(prefix)
 
     def push(self, key, value):
         self.db.put(key, value, villa.VL_DDUP)
@@ -43,10 +51,13 @@ class Villa(object):
         del self.db[key]
 
     def __getattr__(self, key):
+        if key == 'db':
+            raise AttributeError(key)
         if hasattr(self.db, key):
             return getattr(self.db, key)
         else:
             return None
 
     def __del__(self):
-        self.db.close()
+        if 'db' in self.__dict__:
+            self.db.close()